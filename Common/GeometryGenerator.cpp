@@ -3,10 +3,50 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "ThreadPool.h"
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
 
 using namespace DirectX;
 
+namespace
+{
+	// Vertices generated per ParallelFor batch.  Each vertex is a few
+	// multiplies and a 44 byte store, so batches have to be large.
+	const GeometryGenerator::uint32 VerticesPerBatch = 16384;
+
+	// Writes v as vertex i of output, attribute by attribute.
+	void StoreVertex(const GeometryGenerator::MeshLayout& output, GeometryGenerator::uint32 i, const GeometryGenerator::Vertex& v)
+	{
+		const GeometryGenerator::uint32 NoAttribute = GeometryGenerator::MeshLayout::NoAttribute;
+
+		char* dst = static_cast<char*>(output.Vertices) + (size_t)i*output.VertexStride;
+		memcpy(dst + output.PositionOffset, &v.Position, sizeof(v.Position));
+		if(output.NormalOffset != NoAttribute)
+			memcpy(dst + output.NormalOffset, &v.Normal, sizeof(v.Normal));
+		if(output.TangentUOffset != NoAttribute)
+			memcpy(dst + output.TangentUOffset, &v.TangentU, sizeof(v.TangentU));
+		if(output.TexCOffset != NoAttribute)
+			memcpy(dst + output.TexCOffset, &v.TexC, sizeof(v.TexC));
+	}
+
+	// Writes index as index i of output, in output's index size.
+	void StoreIndex(const GeometryGenerator::MeshLayout& output, size_t i, GeometryGenerator::uint32 index)
+	{
+		if(output.IndexSize == sizeof(GeometryGenerator::uint16))
+			static_cast<GeometryGenerator::uint16*>(output.Indices)[i] = static_cast<GeometryGenerator::uint16>(index);
+		else
+			static_cast<GeometryGenerator::uint32*>(output.Indices)[i] = index;
+	}
+}
+
+GeometryGenerator::GeometryGenerator(ThreadPool* threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -100,9 +140,47 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
     return meshData;
 }
 
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)
+{
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+	// Each face subdivides into a square grid of vertices.
+	uint32 faceSide = (1u << numSubdivisions) + 1;
+
+	MeshSize size;
+	size.VertexCount = 6*faceSide*faceSide;
+	size.IndexCount = 36u << (2*numSubdivisions);
+	return size;
+}
+
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshLayout& output)
+{
+	CopyMesh(CreateBox(width, height, depth, numSubdivisions), output);
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+	CreateSphere(radius, sliceCount, stackCount, MeshDataLayout(meshData, SphereSize(sliceCount, stackCount)));
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+	// Rings between the poles, with the first and last vertex of each
+	// duplicated, then triangle fans at the poles and quads between rings.
+	MeshSize size;
+	size.VertexCount = (stackCount-1)*(sliceCount+1) + 2;
+	size.IndexCount = (stackCount-1)*sliceCount*6;
+	return size;
+}
+
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshLayout& output)
+{
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount + 1;
+	uint32 ringCount = stackCount - 1;
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -111,63 +189,59 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Poles: note that there will be texture coordinate distortion as there is
 	// not a unique point on the texture map to assign to the pole when mapping
 	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-
-	meshData.Vertices.push_back( topVertex );
+	uint32 southPoleIndex = ringCount*ringVertexCount + 1;
+	StoreVertex(output, 0, Vertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+	StoreVertex(output, southPoleIndex, Vertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f));
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
+	// Every ring has the same angles around the y-axis.
+	std::vector<float> sinTheta, cosTheta;
+	SinCosTable(ringVertexCount, thetaStep, sinTheta, cosTheta);
+
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
+	ForEachRowBatch(ringCount, ringVertexCount, [&](uint32 first, uint32 last)
 	{
-		float phi = i*phiStep;
-
-		// Vertices of ring.
-        for(uint32 j = 0; j <= sliceCount; ++j)
+		for(uint32 ring = first; ring < last; ++ring)
 		{
-			float theta = j*thetaStep;
-
-			Vertex v;
+			float phi = (ring+1)*phiStep;
+			float sinPhi = sinf(phi);
+			float cosPhi = cosf(phi);
 
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+			uint32 baseVertex = 1 + ring*ringVertexCount;
+			for(uint32 j = 0; j < ringVertexCount; ++j)
+			{
+				Vertex v;
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+				// spherical to cartesian; the unit vector is also the normal.
+				v.Normal = XMFLOAT3(sinPhi*cosTheta[j], cosPhi, sinPhi*sinTheta[j]);
+				v.Position = XMFLOAT3(radius*v.Normal.x, radius*v.Normal.y, radius*v.Normal.z);
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+				// Partial derivative of P with respect to theta, normalized.
+				v.TangentU = XMFLOAT3(-sinTheta[j], 0.0f, cosTheta[j]);
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+				v.TexC.x = j*thetaStep / XM_2PI;
+				v.TexC.y = phi / XM_PI;
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
+				StoreVertex(output, baseVertex + j, v);
+			}
 		}
-	}
-
-	meshData.Vertices.push_back( bottomVertex );
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	size_t k = 0;
     for(uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
+		StoreIndex(output, k++, 0);
+		StoreIndex(output, k++, i+1);
+		StoreIndex(output, k++, i);
 	}
-	
+
 	//
 	// Compute indices for inner stacks (not connected to poles).
 	//
@@ -175,51 +249,43 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
     uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
+	ForEachRowBatch(stackCount-2, ringVertexCount, [&](uint32 first, uint32 last)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		size_t index = sliceCount*3 + (size_t)first*sliceCount*6;
+		for(uint32 i = first; i < last; ++i)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			for(uint32 j = 0; j < sliceCount; ++j)
+			{
+				StoreIndex(output, index++, baseIndex + i*ringVertexCount + j);
+				StoreIndex(output, index++, baseIndex + i*ringVertexCount + j+1);
+				StoreIndex(output, index++, baseIndex + (i+1)*ringVertexCount + j);
+
+				StoreIndex(output, index++, baseIndex + (i+1)*ringVertexCount + j);
+				StoreIndex(output, index++, baseIndex + i*ringVertexCount + j+1);
+				StoreIndex(output, index++, baseIndex + (i+1)*ringVertexCount + j+1);
+			}
 		}
-	}
+	});
+	k += (size_t)(stackCount-2)*sliceCount*6;
 
 	//
 	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
 	// and connects the bottom pole to the bottom ring.
 	//
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
-
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 	
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		StoreIndex(output, k++, southPoleIndex);
+		StoreIndex(output, k++, baseIndex+i);
+		StoreIndex(output, k++, baseIndex+i+1);
 	}
-
-    return meshData;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
 	//       v1
 	//       *
 	//      / \
@@ -230,47 +296,77 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
+	std::vector<Vertex>& vertices = meshData.Vertices;
+	std::vector<uint32>& indices = meshData.Indices32;
+
+	uint32 numVertices = (uint32)vertices.size();
+	uint32 numTris = (uint32)indices.size()/3;
+
+	//
+	// Number the edge midpoints.  Triangles sharing an edge share its
+	// midpoint, keyed by the edge's sorted vertex indices.
+	//
+
+	std::unordered_map<std::uint64_t, uint32> edgeMidpoints;
+	edgeMidpoints.reserve(numTris*3/2);
+
+	std::vector<std::uint64_t> edges;
+	edges.reserve(numTris*3/2);
+
+	// midpoints[i*3+k] is the midpoint of edge k (v0v1, v1v2, v0v2) of triangle i.
+	std::vector<uint32> midpoints(numTris*3);
 	for(uint32 i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+		const uint32 corners[3][2] = { {0, 1}, {1, 2}, {0, 2} };
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			uint32 a = indices[i*3 + corners[k][0]];
+			uint32 b = indices[i*3 + corners[k][1]];
+			std::uint64_t key = ((std::uint64_t)std::min(a, b) << 32) | std::max(a, b);
+
+			auto inserted = edgeMidpoints.emplace(key, numVertices + (uint32)edges.size());
+			if(inserted.second)
+				edges.push_back(key);
+
+			midpoints[i*3+k] = inserted.first->second;
+		}
+	}
+
+	//
+	// Add the midpoint vertices after the existing ones.
+	//
+
+	vertices.resize(numVertices + edges.size());
+	for(size_t e = 0; e < edges.size(); ++e)
+	{
+		uint32 a = (uint32)(edges[e] >> 32);
+		uint32 b = (uint32)(edges[e] & 0xffffffff);
+		vertices[numVertices + e] = MidPoint(vertices[a], vertices[b]);
+	}
+
+	//
+	// Replace each triangle by four.  Triangle i moves to 12*i, which is
+	// never below where an earlier triangle is read, so going backwards the
+	// indices are rewritten in place.
+	//
+
+	indices.resize(numTris*12);
+	for(uint32 i = numTris; i-- > 0; )
+	{
+		uint32 v0 = indices[i*3+0];
+		uint32 v1 = indices[i*3+1];
+		uint32 v2 = indices[i*3+2];
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+		uint32 m0 = midpoints[i*3+0];
+		uint32 m1 = midpoints[i*3+1];
+		uint32 m2 = midpoints[i*3+2];
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+		uint32* tri = &indices[i*12];
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		tri[0] = v0;  tri[1] = m0;  tri[2] = m2;
+		tri[3] = m0;  tri[4] = m1;  tri[5] = m2;
+		tri[6] = m2;  tri[7] = m1;  tri[8] = v2;
+		tri[9] = m0;  tri[10] = v1; tri[11] = m1;
 	}
 }
 
@@ -379,9 +475,50 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     return meshData;
 }
 
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+	// Every subdivision quadruples the icosahedron's 20 faces and adds a
+	// vertex for each of its edges.
+	MeshSize size;
+	size.VertexCount = (10u << (2*numSubdivisions)) + 2;
+	size.IndexCount = 60u << (2*numSubdivisions);
+	return size;
+}
+
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, const MeshLayout& output)
+{
+	CopyMesh(CreateGeosphere(radius, numSubdivisions), output);
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount,
+		MeshDataLayout(meshData, CylinderSize(sliceCount, stackCount)));
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	// The stacks, then the top and bottom caps, each a ring and a center vertex.
+	MeshSize size;
+	size.VertexCount = (stackCount+1)*(sliceCount+1) + 2*(sliceCount+2);
+	size.IndexCount = stackCount*sliceCount*6 + 2*sliceCount*3;
+	return size;
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+									   const MeshLayout& output)
+{
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount+1;
+	uint32 ringCount = stackCount+1;
+
+	uint32 sideVertexCount = ringCount*ringVertexCount;
+	uint32 sideIndexCount = stackCount*sliceCount*6;
 
 	//
 	// Build Stacks.
@@ -392,169 +529,139 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 	// Amount to increment radius as we move up each stack level from bottom to top.
 	float radiusStep = (topRadius - bottomRadius) / stackCount;
 
-	uint32 ringCount = stackCount+1;
+	// Every ring and both caps have the same angles around the y-axis.
+	float dTheta = 2.0f*XM_PI/sliceCount;
+	std::vector<float> sines, cosines;
+	SinCosTable(ringVertexCount, dTheta, sines, cosines);
+
+	// Cylinder can be parameterized as follows, where we introduce v
+	// parameter that goes in the same direction as the v tex-coord
+	// so that the bitangent goes in the same direction as the v tex-coord.
+	//   Let r0 be the bottom radius and let r1 be the top radius.
+	//   y(v) = h - hv for v in [0,1].
+	//   r(v) = r1 + (r0-r1)v
+	//
+	//   x(t, v) = r(v)*cos(t)
+	//   y(t, v) = h - hv
+	//   z(t, v) = r(v)*sin(t)
+	// 
+	//  dx/dt = -r(v)*sin(t)
+	//  dy/dt = 0
+	//  dz/dt = +r(v)*cos(t)
+	//
+	//  dx/dv = (r0-r1)*cos(t)
+	//  dy/dv = -h
+	//  dz/dv = (r0-r1)*sin(t)
+	//
+	// The unit tangent is (-sin(t), 0, cos(t)), and its cross product with
+	// the bitangent, the normal, is (h*cos(t), r0-r1, h*sin(t)): the same
+	// length for every vertex.
+	float dr = bottomRadius-topRadius;
+	float invNormalLength = 1.0f / sqrtf(height*height + dr*dr);
+	float normalXZ = height*invNormalLength;
+	float normalY = dr*invNormalLength;
 
 	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(uint32 i = 0; i < ringCount; ++i)
+	ForEachRowBatch(ringCount, ringVertexCount, [&](uint32 first, uint32 last)
 	{
-		float y = -0.5f*height + i*stackHeight;
-		float r = bottomRadius + i*radiusStep;
-
-		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(uint32 j = 0; j <= sliceCount; ++j)
+		for(uint32 i = first; i < last; ++i)
 		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
+			float y = -0.5f*height + i*stackHeight;
+			float r = bottomRadius + i*radiusStep;
+			float v = 1.0f - (float)i/stackCount;
+
+			for(uint32 j = 0; j < ringVertexCount; ++j)
+			{
+				float c = cosines[j];
+				float s = sines[j];
+
+				Vertex vertex;
+				vertex.Position = XMFLOAT3(r*c, y, r*s);
+				vertex.Normal = XMFLOAT3(normalXZ*c, normalY, normalXZ*s);
+				vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+				vertex.TexC = XMFLOAT2((float)j/sliceCount, v);
+
+				StoreVertex(output, i*ringVertexCount + j, vertex);
+			}
 		}
-	}
-
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	uint32 ringVertexCount = sliceCount+1;
+	});
 
 	// Compute indices for each stack.
-	for(uint32 i = 0; i < stackCount; ++i)
+	ForEachRowBatch(stackCount, ringVertexCount, [&](uint32 first, uint32 last)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		size_t k = (size_t)first*sliceCount*6;
+		for(uint32 i = first; i < last; ++i)
 		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
+			for(uint32 j = 0; j < sliceCount; ++j)
+			{
+				StoreIndex(output, k++, i*ringVertexCount + j);
+				StoreIndex(output, k++, (i+1)*ringVertexCount + j);
+				StoreIndex(output, k++, (i+1)*ringVertexCount + j+1);
+
+				StoreIndex(output, k++, i*ringVertexCount + j);
+				StoreIndex(output, k++, (i+1)*ringVertexCount + j+1);
+				StoreIndex(output, k++, i*ringVertexCount + j+1);
+			}
 		}
-	}
-
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	});
 
-    return meshData;
+	BuildCylinderCap(topRadius, 0.5f*height, height, 1.0f, sliceCount, sines, cosines,
+		sideVertexCount, sideIndexCount, output);
+	BuildCylinderCap(bottomRadius, -0.5f*height, height, -1.0f, sliceCount, sines, cosines,
+		sideVertexCount + ringVertexCount+1, sideIndexCount + sliceCount*3, output);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderCap(float radius, float y, float height, float normalY, uint32 sliceCount,
+										 const std::vector<float>& sines, const std::vector<float>& cosines,
+										 uint32 baseVertex, uint32 baseIndex, const MeshLayout& output)
 {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-
-	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI/sliceCount;
-
 	// Duplicate cap ring vertices because the texture coordinates and normals differ.
 	for(uint32 i = 0; i <= sliceCount; ++i)
 	{
-		float x = topRadius*cosf(i*dTheta);
-		float z = topRadius*sinf(i*dTheta);
+		float x = radius*cosines[i];
+		float z = radius*sines[i];
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		StoreVertex(output, baseVertex + i, Vertex(x, y, z, 0.0f, normalY, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	StoreVertex(output, baseVertex + sliceCount+1, Vertex(0.0f, y, 0.0f, 0.0f, normalY, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
 
 	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
-
-	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
-	}
-}
-
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-											   uint32 sliceCount, uint32 stackCount, MeshData& meshData)
-{
-	// 
-	// Build bottom cap.
-	//
-
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-	float y = -0.5f*height;
-
-	// vertices of ring
-	float dTheta = 2.0f*XM_PI/sliceCount;
-	for(uint32 i = 0; i <= sliceCount; ++i)
-	{
-		float x = bottomRadius*cosf(i*dTheta);
-		float z = bottomRadius*sinf(i*dTheta);
-
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x/height + 0.5f;
-		float v = z/height + 0.5f;
-
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
-	}
-
-	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseVertex + sliceCount+1;
 
+	// The top cap faces up and the bottom cap down, so their windings differ.
+	size_t k = baseIndex;
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
+		StoreIndex(output, k++, centerIndex);
+		StoreIndex(output, k++, baseVertex + (normalY > 0.0f ? i+1 : i));
+		StoreIndex(output, k++, baseVertex + (normalY > 0.0f ? i : i+1));
 	}
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
     MeshData meshData;
+	CreateGrid(width, depth, m, n, MeshDataLayout(meshData, GridSize(m, n)));
+    return meshData;
+}
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	MeshSize size;
+	size.VertexCount = m*n;
+	size.IndexCount = (m-1)*(n-1)*2*3; // 3 indices per face
+	return size;
+}
 
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshLayout& output)
+{
 	//
 	// Create the vertices.
 	//
@@ -568,90 +675,161 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	ForEachRowBatch(m, n, [&](uint32 first, uint32 last)
 	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
+		for(uint32 i = first; i < last; ++i)
 		{
-			float x = -halfWidth + j*dx;
+			float z = halfDepth - i*dz;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+				Vertex v;
+				v.Position = XMFLOAT3(x, 0.0f, z);
+				v.Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+				// Stretch texture over grid.
+				v.TexC = XMFLOAT2(j*du, i*dv);
+
+				StoreVertex(output, i*n+j, v);
+			}
 		}
-	}
+	});
  
     //
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
 	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
+	ForEachRowBatch(m-1, n, [&](uint32 first, uint32 last)
 	{
-		for(uint32 j = 0; j < n-1; ++j)
+		size_t k = (size_t)first*(n-1)*6;
+		for(uint32 i = first; i < last; ++i)
 		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
-
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
+			for(uint32 j = 0; j < n-1; ++j)
+			{
+				StoreIndex(output, k,   i*n+j);
+				StoreIndex(output, k+1, i*n+j+1);
+				StoreIndex(output, k+2, (i+1)*n+j);
+
+				StoreIndex(output, k+3, (i+1)*n+j);
+				StoreIndex(output, k+4, i*n+j+1);
+				StoreIndex(output, k+5, (i+1)*n+j+1);
+
+				k += 6; // next quad
+			}
 		}
-	}
-
-    return meshData;
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
 {
     MeshData meshData;
+	CreateQuad(x, y, w, h, depth, MeshDataLayout(meshData, QuadSize()));
+    return meshData;
+}
 
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize()
+{
+	MeshSize size;
+	size.VertexCount = 4;
+	size.IndexCount = 6;
+	return size;
+}
 
+void GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth, const MeshLayout& output)
+{
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	StoreVertex(output, 0, Vertex(
         x, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
+		0.0f, 1.0f));
 
-	meshData.Vertices[1] = Vertex(
+	StoreVertex(output, 1, Vertex(
 		x, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
+		0.0f, 0.0f));
 
-	meshData.Vertices[2] = Vertex(
+	StoreVertex(output, 2, Vertex(
 		x+w, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
+		1.0f, 0.0f));
 
-	meshData.Vertices[3] = Vertex(
+	StoreVertex(output, 3, Vertex(
 		x+w, y-h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
+		1.0f, 1.0f));
 
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
+	StoreIndex(output, 0, 0);
+	StoreIndex(output, 1, 1);
+	StoreIndex(output, 2, 2);
 
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
+	StoreIndex(output, 3, 0);
+	StoreIndex(output, 4, 2);
+	StoreIndex(output, 5, 3);
+}
 
-    return meshData;
+GeometryGenerator::MeshLayout GeometryGenerator::MeshDataLayout(MeshData& meshData, const MeshSize& size)
+{
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	MeshLayout layout;
+	layout.Vertices = meshData.Vertices.data();
+	layout.VertexStride = sizeof(Vertex);
+	layout.PositionOffset = offsetof(Vertex, Position);
+	layout.NormalOffset = offsetof(Vertex, Normal);
+	layout.TangentUOffset = offsetof(Vertex, TangentU);
+	layout.TexCOffset = offsetof(Vertex, TexC);
+	layout.Indices = meshData.Indices32.data();
+	layout.IndexSize = sizeof(uint32);
+	return layout;
+}
+
+void GeometryGenerator::CopyMesh(const MeshData& meshData, const MeshLayout& output)
+{
+	for(size_t i = 0; i < meshData.Vertices.size(); ++i)
+		StoreVertex(output, (uint32)i, meshData.Vertices[i]);
+
+	for(size_t i = 0; i < meshData.Indices32.size(); ++i)
+		StoreIndex(output, i, meshData.Indices32[i]);
+}
+
+void GeometryGenerator::ForEachRowBatch(uint32 rowCount, uint32 verticesPerRow, const std::function<void(uint32, uint32)>& func)
+{
+	uint32 rowsPerBatch = std::max<uint32>(1, VerticesPerBatch / std::max<uint32>(1, verticesPerRow));
+	uint32 numBatches = (rowCount + rowsPerBatch - 1) / rowsPerBatch;
+	if(mThreadPool == nullptr || numBatches < 2)
+	{
+		func(0, rowCount);
+		return;
+	}
+
+	mThreadPool->ParallelFor(numBatches, [&](uint32 batch)
+	{
+		uint32 first = batch*rowsPerBatch;
+		func(first, std::min(first + rowsPerBatch, rowCount));
+	});
+}
+
+void GeometryGenerator::SinCosTable(uint32 count, float step, std::vector<float>& sines, std::vector<float>& cosines)
+{
+	sines.resize((count + 3) & ~3u);
+	cosines.resize(sines.size());
+
+	for(uint32 i = 0; i < count; i += 4)
+	{
+		// i*step rather than accumulated steps, so the error does not grow
+		// around the ring.
+		XMVECTOR theta = XMVectorScale(XMVectorSet((float)i, (float)(i+1), (float)(i+2), (float)(i+3)), step);
+		XMVECTOR s, c;
+		XMVectorSinCos(&s, &c, theta);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&sines[i]), s);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&cosines[i]), c);
+	}
 }
@@ -16,8 +16,11 @@
 
 #include <cstdint>
 #include <DirectXMath.h>
+#include <functional>
 #include <vector>
 
+class ThreadPool;
+
 class GeometryGenerator
 {
 public:
@@ -25,6 +28,12 @@ public:
     using uint16 = std::uint16_t;
     using uint32 = std::uint32_t;
 
+	///<summary>
+	/// Given a thread pool, the rows of large grids and the rings of large
+	/// spheres and cylinders are generated on its threads.
+	///</summary>
+	explicit GeometryGenerator(ThreadPool* threadPool = nullptr);
+
 	struct Vertex
 	{
 		Vertex(){}
@@ -58,20 +67,44 @@ public:
 		std::vector<Vertex> Vertices;
         std::vector<uint32> Indices32;
 
-        std::vector<uint16>& GetIndices16()
+		// Converts the indices to 16 bits.  Nothing is kept, so a mesh never
+		// holds two copies of its indices.
+        std::vector<uint16> GetIndices16()const
         {
-			if(mIndices16.empty())
-			{
-				mIndices16.resize(Indices32.size());
-				for(size_t i = 0; i < Indices32.size(); ++i)
-					mIndices16[i] = static_cast<uint16>(Indices32[i]);
-			}
-
-			return mIndices16;
+			return std::vector<uint16>(Indices32.begin(), Indices32.end());
         }
+	};
 
-	private:
-		std::vector<uint16> mIndices16;
+	///<summary>
+	/// Caller owned memory to generate a mesh straight into, such as a mapped
+	/// upload buffer, and how vertices and indices are laid out in it.  Each
+	/// attribute is written at its byte offset within a vertex, or skipped
+	/// if the offset is NoAttribute.  Indices are IndexSize bytes, 2 or 4;
+	/// 16 bit indices address at most 65536 vertices.
+	///</summary>
+	struct MeshLayout
+	{
+		static const uint32 NoAttribute = 0xffffffff;
+
+		void* Vertices = nullptr;
+		uint32 VertexStride = 0;
+		uint32 PositionOffset = 0;
+		uint32 NormalOffset = NoAttribute;
+		uint32 TangentUOffset = NoAttribute;
+		uint32 TexCOffset = NoAttribute;
+
+		void* Indices = nullptr;
+		uint32 IndexSize = sizeof(uint32);
+	};
+
+	///<summary>
+	/// The number of vertices and indices a Create function writes, to size
+	/// the memory a MeshLayout describes.
+	///</summary>
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
 	};
 
 	///<summary>
@@ -110,10 +143,50 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// The sizes of the meshes the Create functions with the same
+	/// parameters generate.
+	///</summary>
+	static MeshSize BoxSize(uint32 numSubdivisions);
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GeosphereSize(uint32 numSubdivisions);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n);
+	static MeshSize QuadSize();
+
+	///<summary>
+	/// The same meshes written into a MeshLayout sized by the matching Size
+	/// function.  The grid, sphere, cylinder and quad are generated in place;
+	/// the box and geosphere are subdivided in a MeshData first and written
+	/// out once.
+	///</summary>
+    void CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshLayout& output);
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshLayout& output);
+    void CreateGeosphere(float radius, uint32 numSubdivisions, const MeshLayout& output);
+    void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, const MeshLayout& output);
+    void CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshLayout& output);
+    void CreateQuad(float x, float y, float w, float h, float depth, const MeshLayout& output);
+
 private:
+	// Resizes meshData to size and describes it as a MeshLayout.
+	static MeshLayout MeshDataLayout(MeshData& meshData, const MeshSize& size);
+	static void CopyMesh(const MeshData& meshData, const MeshLayout& output);
+
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+    void BuildCylinderCap(float radius, float y, float height, float normalY, uint32 sliceCount,
+        const std::vector<float>& sines, const std::vector<float>& cosines,
+        uint32 baseVertex, uint32 baseIndex, const MeshLayout& output);
+
+	// Calls func(first, last) for consecutive ranges of [0, rowCount), each
+	// about VerticesPerBatch vertices, on the thread pool if there is more
+	// than one range.
+	void ForEachRowBatch(uint32 rowCount, uint32 verticesPerRow, const std::function<void(uint32, uint32)>& func);
+
+	// sines[i] and cosines[i] of i*step for i in [0, count), four at a time.
+	static void SinCosTable(uint32 count, float step, std::vector<float>& sines, std::vector<float>& cosines);
+
+private:
+	ThreadPool* mThreadPool = nullptr;
 };
 
@@ -0,0 +1,235 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int numWorkers)
+{
+	if( numWorkers == 0 )
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	// Enough for a ParallelFor per worker plus a few submitted tasks.
+	mTasks.resize(std::max(4 * numWorkers, 16u));
+
+	mWorkers.reserve(numWorkers);
+	for(unsigned int i = 0; i < numWorkers; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerMain, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mTaskAvailable.notify_all();
+
+	for(std::thread& worker : mWorkers)
+		worker.join();
+}
+
+unsigned int ThreadPool::ThreadCount()const
+{
+	return (unsigned int)mWorkers.size() + 1;
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> task)
+{
+	auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+	std::future<void> result = packaged->get_future();
+
+	// Without workers the task runs right away so the future never stalls.
+	if( mWorkers.empty() )
+	{
+		(*packaged)();
+		return result;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		PushTask([packaged]() { (*packaged)(); });
+	}
+	mTaskAvailable.notify_one();
+
+	return result;
+}
+
+void ThreadPool::Post(std::function<void()> task)
+{
+	if( mWorkers.empty() )
+	{
+		task();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		PushTask(std::move(task));
+	}
+	mTaskAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func,
+	unsigned int grainSize)
+{
+	if( count == 0 )
+		return;
+
+	grainSize = std::max(grainSize, 1u);
+	const unsigned int numBatches = (count + grainSize - 1) / grainSize;
+
+	if( mWorkers.empty() || numBatches == 1 )
+	{
+		for(unsigned int i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	// The job lives on this stack frame, which is safe because the helpers
+	// are waited for below.  The tasks capture only its address so they fit
+	// in std::function's in-place storage.
+	struct Job
+	{
+		const std::function<void(unsigned int)>* Func;
+		unsigned int Count;
+		unsigned int GrainSize;
+		unsigned int NumBatches;
+		std::atomic<unsigned int> NextBatch{ 0 };
+		std::atomic<unsigned int> PendingHelpers{ 0 };
+
+		void RunBatches()
+		{
+			for(;;)
+			{
+				unsigned int batch = NextBatch.fetch_add(1);
+				if( batch >= NumBatches )
+					break;
+
+				unsigned int first = batch * GrainSize;
+				unsigned int last = std::min(first + GrainSize, Count);
+				for(unsigned int i = first; i < last; ++i)
+					(*Func)(i);
+			}
+		}
+	};
+	Job job;
+	job.Func = &func;
+	job.Count = count;
+	job.GrainSize = grainSize;
+	job.NumBatches = numBatches;
+
+	const unsigned int numHelpers = std::min(numBatches - 1, (unsigned int)mWorkers.size());
+	job.PendingHelpers = numHelpers;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		Job* jobPtr = &job;
+		for(unsigned int i = 0; i < numHelpers; ++i)
+		{
+			PushTask([jobPtr]()
+			{
+				jobPtr->RunBatches();
+				jobPtr->PendingHelpers.fetch_sub(1);
+			}, jobPtr);
+		}
+	}
+	mTaskAvailable.notify_all();
+
+	job.RunBatches();
+
+	// The helpers reference func, so wait until every one of them has finished.
+	// Running those no worker has started keeps nested ParallelFor calls moving
+	// when every worker is busy; running anything else could hold this loop up
+	// for as long as that task takes.
+	while( job.PendingHelpers.load() != 0 )
+	{
+		std::function<void()> helper;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			PopTask(helper, &job);
+		}
+
+		if( helper )
+			helper();
+		else
+			std::this_thread::yield();
+	}
+}
+
+void ThreadPool::WorkerMain()
+{
+	for(;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mTaskAvailable.wait(lock, [this]() { return mStopping || mTaskCount != 0; });
+
+			if( !PopTask(task) )
+				return;
+		}
+
+		task();
+	}
+}
+
+bool ThreadPool::RunPendingTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if( !PopTask(task) )
+			return false;
+	}
+
+	task();
+	return true;
+}
+
+void ThreadPool::PushTask(std::function<void()>&& task, const void* owner)
+{
+	if( mTaskCount == mTasks.size() )
+	{
+		// Unwrap into a buffer twice the size.
+		std::vector<QueuedTask> grown(std::max(2 * mTasks.size(), (size_t)16));
+		for(size_t i = 0; i < mTaskCount; ++i)
+			grown[i] = std::move(mTasks[(mTaskHead + i) % mTasks.size()]);
+		mTasks.swap(grown);
+		mTaskHead = 0;
+	}
+
+	QueuedTask& queued = mTasks[(mTaskHead + mTaskCount) % mTasks.size()];
+	queued.Run = std::move(task);
+	queued.Owner = owner;
+	++mTaskCount;
+}
+
+bool ThreadPool::PopTask(std::function<void()>& task, const void* owner)
+{
+	size_t found = 0;
+	if( owner != nullptr )
+	{
+		while( found < mTaskCount && mTasks[(mTaskHead + found) % mTasks.size()].Owner != owner )
+			++found;
+	}
+	if( found == mTaskCount )
+		return false;
+
+	// Close the gap by moving the tasks ahead of it back one slot, so the
+	// rest keep their order.  The queue is a few tasks per worker long.
+	const size_t size = mTasks.size();
+	task = std::move(mTasks[(mTaskHead + found) % size].Run);
+	for(size_t i = found; i > 0; --i)
+		mTasks[(mTaskHead + i) % size] = std::move(mTasks[(mTaskHead + i - 1) % size]);
+
+	mTasks[mTaskHead].Run = nullptr;
+	mTasks[mTaskHead].Owner = nullptr;
+	mTaskHead = (mTaskHead + 1) % size;
+	--mTaskCount;
+	return true;
+}
@@ -0,0 +1,81 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// A fixed set of worker threads fed from a single task queue.  The calling thread
+// takes part in ParallelFor, and while it waits for the workers it runs its own
+// helper tasks that no worker has picked up yet, so ParallelFor may be nested
+// inside a task without deadlocking.  It runs nothing else, so an unrelated
+// long task, such as a posted animation frame, never delays the loop.
+//
+// The queue is a ring buffer that only grows, so once it has reached the
+// depth a frame needs, ParallelFor and Post allocate nothing.
+//***************************************************************************************
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// numWorkers == 0 creates one worker per hardware thread, minus the caller.
+	explicit ThreadPool(unsigned int numWorkers = 0);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	// Number of threads that execute a ParallelFor, including the caller.
+	unsigned int ThreadCount()const;
+
+	// Queues a task and returns a future that becomes ready once it has run.
+	std::future<void> Submit(std::function<void()> task);
+
+	// Queues a task without a future, for per-frame work that signals its own
+	// completion.  Allocates nothing if the task is small enough for
+	// std::function to store in place (a pointer or two of captures).
+	void Post(std::function<void()> task);
+
+	// Calls func(i) for every i in [0, count) and returns when all calls are done.
+	// Indices are handed out in batches of grainSize; the order is unspecified.
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func,
+		unsigned int grainSize = 1);
+
+	// Pops and runs one queued task.  Returns false if the queue was empty.
+	// Lets a thread waiting on submitted work help instead of idling.
+	bool RunPendingTask();
+
+private:
+	void WorkerMain();
+
+	// Both require mMutex to be held.  A task pushed with an owner is one of
+	// that ParallelFor's helpers.  PopTask with an owner takes the first of
+	// its tasks, wherever it is in the queue, and without one the first task.
+	void PushTask(std::function<void()>&& task, const void* owner = nullptr);
+	bool PopTask(std::function<void()>& task, const void* owner = nullptr);
+
+private:
+	struct QueuedTask
+	{
+		std::function<void()> Run;
+		const void* Owner = nullptr;
+	};
+
+	std::vector<std::thread> mWorkers;
+
+	// Ring buffer of mTaskCount tasks starting at mTaskHead.
+	std::vector<QueuedTask> mTasks;
+	size_t mTaskHead = 0;
+	size_t mTaskCount = 0;
+
+	std::mutex mMutex;
+	std::condition_variable mTaskAvailable;
+	bool mStopping = false;
+};
+
+#endif // THREADPOOL_H
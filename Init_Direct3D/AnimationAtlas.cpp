@@ -0,0 +1,245 @@
+#include "AnimationAtlas.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+
+using namespace DirectX;
+
+void AnimationAtlas::Reset(const BonePaletteLayout& layout, float sampleRate)
+{
+	mLayout = layout;
+	mSampleRate = sampleRate;
+	mClips.clear();
+	mFrames.clear();
+}
+
+UINT AnimationAtlas::AddClip(const SkinnedData& skinInfo, const std::string& clipName, bool looping)
+{
+	AnimationClipHandle handle = skinInfo.GetClipHandle(clipName);
+	if( !handle.IsValid() || !(mSampleRate > 0.0f) )
+		return UINT_MAX;
+
+	Clip clip;
+	clip.Name = clipName;
+	clip.FirstFrame = FrameCount();
+	clip.StartTime = handle.StartTime;
+	clip.Duration = std::max(handle.EndTime - handle.StartTime, 0.0f);
+	clip.Looping = looping;
+
+	// Whole steps that fit the clip, so the frames are evenly spaced.
+	if( looping )
+		clip.NumFrames = std::max(1u, (UINT)std::lround(clip.Duration * mSampleRate));
+	else
+		clip.NumFrames = (UINT)std::ceil(clip.Duration * mSampleRate) + 1;
+
+	const UINT frameByteSize = FrameByteSize();
+	mFrames.resize(mFrames.size() + (size_t)clip.NumFrames * frameByteSize);
+
+	std::vector<XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	const UINT steps = looping || clip.NumFrames == 1 ? clip.NumFrames : clip.NumFrames - 1;
+	for(UINT f = 0; f < clip.NumFrames; ++f)
+	{
+		float t = clip.StartTime + clip.Duration * f / steps;
+		skinInfo.GetFinalTransforms(handle, t, finalTransforms, cursor, scratch);
+		mLayout.Pack(finalTransforms.data(), &mFrames[(size_t)(clip.FirstFrame + f) * frameByteSize]);
+	}
+
+	mClips.push_back(clip);
+
+	return (UINT)mClips.size() - 1;
+}
+
+UINT AnimationAtlas::ClipCount()const
+{
+	return (UINT)mClips.size();
+}
+
+const AnimationAtlas::Clip& AnimationAtlas::GetClip(UINT clip)const
+{
+	return mClips[clip];
+}
+
+UINT AnimationAtlas::FindClip(const std::string& clipName)const
+{
+	for(UINT i = 0; i < (UINT)mClips.size(); ++i)
+	{
+		if( mClips[i].Name == clipName )
+			return i;
+	}
+	return UINT_MAX;
+}
+
+UINT AnimationAtlas::Frame(UINT clip, float t)const
+{
+	const Clip& c = mClips[clip];
+	if( c.Duration <= 0.0f || c.NumFrames == 1 )
+		return c.FirstFrame;
+
+	float u = (t - c.StartTime) / c.Duration;
+	if( c.Looping )
+	{
+		UINT f = (UINT)std::lround((u - std::floor(u)) * c.NumFrames);
+		return c.FirstFrame + f % c.NumFrames;
+	}
+
+	u = std::min(std::max(u, 0.0f), 1.0f);
+	return c.FirstFrame + (UINT)std::lround(u * (c.NumFrames - 1));
+}
+
+BonePaletteFormat AnimationAtlas::Format()const
+{
+	return mLayout.Format();
+}
+
+float AnimationAtlas::GetSampleRate()const
+{
+	return mSampleRate;
+}
+
+UINT AnimationAtlas::FrameCount()const
+{
+	return FrameByteSize() > 0 ? (UINT)(mFrames.size() / FrameByteSize()) : 0;
+}
+
+UINT AnimationAtlas::FrameByteSize()const
+{
+	return mLayout.SlotByteSize();
+}
+
+const BYTE* AnimationAtlas::FrameData(UINT frame)const
+{
+	return mFrames.data() + (size_t)frame * FrameByteSize();
+}
+
+const BYTE* AnimationAtlas::Data()const
+{
+	return mFrames.data();
+}
+
+size_t AnimationAtlas::ByteSize()const
+{
+	return mFrames.size();
+}
+
+namespace
+{
+	template<typename T>
+	void WriteValue(std::ofstream& fout, const T& value)
+	{
+		fout.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& fin, T& value)
+	{
+		return (bool)fin.read(reinterpret_cast<char*>(&value), sizeof(T));
+	}
+}
+
+bool AnimationAtlas::Write(const std::string& filename)const
+{
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if( !fout )
+		return false;
+
+	WriteValue(fout, (UINT)FileMagic);
+	WriteValue(fout, (UINT)FileVersion);
+	WriteValue(fout, mSampleRate);
+
+	// The layout the frames were packed for, to check against on Read.
+	WriteValue(fout, (UINT)mLayout.Format());
+	WriteValue(fout, mLayout.PaletteCount());
+	for(UINT p = 0; p < mLayout.PaletteCount(); ++p)
+	{
+		WriteValue(fout, mLayout.PaletteBoneCount(p));
+		fout.write(reinterpret_cast<const char*>(mLayout.PaletteBones(p)), mLayout.PaletteBoneCount(p) * sizeof(UINT));
+	}
+
+	WriteValue(fout, (UINT)mClips.size());
+	for(const Clip& clip : mClips)
+	{
+		WriteValue(fout, (UINT)clip.Name.size());
+		fout.write(clip.Name.data(), clip.Name.size());
+		WriteValue(fout, clip.FirstFrame);
+		WriteValue(fout, clip.NumFrames);
+		WriteValue(fout, clip.StartTime);
+		WriteValue(fout, clip.Duration);
+		WriteValue(fout, (UINT)clip.Looping);
+	}
+
+	WriteValue(fout, (UINT64)mFrames.size());
+	fout.write(reinterpret_cast<const char*>(mFrames.data()), mFrames.size());
+
+	return fout.good();
+}
+
+bool AnimationAtlas::Read(const std::string& filename, const BonePaletteLayout& layout)
+{
+	std::ifstream fin(filename, std::ios::binary);
+	if( !fin )
+		return false;
+
+	UINT magic = 0, version = 0, format = 0, numPalettes = 0;
+	float sampleRate = 0.0f;
+	if( !ReadValue(fin, magic) || !ReadValue(fin, version) || magic != FileMagic || version != FileVersion ||
+		!ReadValue(fin, sampleRate) || !ReadValue(fin, format) || !ReadValue(fin, numPalettes) )
+		return false;
+
+	// The frames are only valid for the palettes they were packed for.
+	if( format != (UINT)layout.Format() || numPalettes != layout.PaletteCount() )
+		return false;
+	for(UINT p = 0; p < numPalettes; ++p)
+	{
+		UINT numBones = 0;
+		if( !ReadValue(fin, numBones) || numBones != layout.PaletteBoneCount(p) )
+			return false;
+
+		std::vector<UINT> bones(numBones);
+		fin.read(reinterpret_cast<char*>(bones.data()), numBones * sizeof(UINT));
+		if( !fin || !std::equal(bones.begin(), bones.end(), layout.PaletteBones(p)) )
+			return false;
+	}
+
+	UINT numClips = 0;
+	if( !ReadValue(fin, numClips) )
+		return false;
+
+	std::vector<Clip> clips(numClips);
+	for(Clip& clip : clips)
+	{
+		UINT nameLength = 0, looping = 0;
+		if( !ReadValue(fin, nameLength) )
+			return false;
+		clip.Name.resize(nameLength);
+		fin.read(&clip.Name[0], nameLength);
+		if( !ReadValue(fin, clip.FirstFrame) || !ReadValue(fin, clip.NumFrames) || !ReadValue(fin, clip.StartTime) ||
+			!ReadValue(fin, clip.Duration) || !ReadValue(fin, looping) )
+			return false;
+		clip.Looping = looping != 0;
+	}
+
+	UINT64 frameBytes = 0;
+	if( !ReadValue(fin, frameBytes) || layout.SlotByteSize() == 0 || frameBytes % layout.SlotByteSize() != 0 )
+		return false;
+
+	std::vector<BYTE> frames((size_t)frameBytes);
+	if( !fin.read(reinterpret_cast<char*>(frames.data()), frames.size()) )
+		return false;
+
+	const UINT64 numFrames = frameBytes / layout.SlotByteSize();
+	for(const Clip& clip : clips)
+	{
+		if( (UINT64)clip.FirstFrame + clip.NumFrames > numFrames )
+			return false;
+	}
+
+	mLayout = layout;
+	mSampleRate = sampleRate;
+	mClips = std::move(clips);
+	mFrames = std::move(frames);
+
+	return true;
+}
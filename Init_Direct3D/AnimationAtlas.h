@@ -0,0 +1,77 @@
+#ifndef ANIMATIONATLAS_H
+#define ANIMATIONATLAS_H
+
+#include "BonePalette.h"
+
+///<summary>
+/// Animation clips baked into ready to bind bone palettes.
+///
+/// Each clip is sampled at a fixed rate and every sample is packed as one
+/// palette slot of a BonePaletteLayout, exactly what AnimationSystem would
+/// write for an instance at that time.  Uploaded once, the frames serve as
+/// the skinned constant buffers of any number of instances: playing a clip
+/// is choosing a frame with Frame and binding that slot, with no
+/// GetFinalTransforms or palette upload per instance.  Playback snaps to
+/// the nearest baked frame, so the rate trades memory for smoothness; a
+/// half float palette format halves the memory again.
+///
+/// A looping clip is baked over [start, end) and wraps, its last frame
+/// leading back to the first; a clip that does not loop includes its end
+/// time and holds it.  Atlases can be baked offline with Write and loaded
+/// with Read.
+///</summary>
+class AnimationAtlas
+{
+public:
+	// "ATLS" read as a little-endian UINT.
+	static const UINT FileMagic = 0x534C5441;
+	static const UINT FileVersion = 1;
+
+	struct Clip
+	{
+		std::string Name;
+		UINT FirstFrame = 0;
+		UINT NumFrames = 0;
+		float StartTime = 0.0f;
+		float Duration = 0.0f;
+		bool Looping = true;
+	};
+
+	// Empties the atlas; frames are laid out by layout and sampled at
+	// sampleRate frames per second.
+	void Reset(const BonePaletteLayout& layout, float sampleRate);
+
+	// Bakes clipName of skinInfo and returns its index, or UINT_MAX if the
+	// clip does not exist.
+	UINT AddClip(const SkinnedData& skinInfo, const std::string& clipName, bool looping);
+
+	UINT ClipCount()const;
+	const Clip& GetClip(UINT clip)const;
+	UINT FindClip(const std::string& clipName)const;
+
+	// The frame to bind for clip at time t, as SkinnedModelInstance::TimePos
+	// counts it.
+	UINT Frame(UINT clip, float t)const;
+
+	BonePaletteFormat Format()const;
+	float GetSampleRate()const;
+	UINT FrameCount()const;
+	UINT FrameByteSize()const;
+	const BYTE* FrameData(UINT frame)const;
+	const BYTE* Data()const;
+	size_t ByteSize()const;
+
+	bool Write(const std::string& filename)const;
+
+	// Fails unless the file was baked for a layout with the same format and
+	// palettes as layout.
+	bool Read(const std::string& filename, const BonePaletteLayout& layout);
+
+private:
+	BonePaletteLayout mLayout;
+	float mSampleRate = 30.0f;
+	std::vector<Clip> mClips;
+	std::vector<BYTE> mFrames;
+};
+
+#endif // ANIMATIONATLAS_H
@@ -0,0 +1,80 @@
+#include "AnimationPipeline.h"
+
+AnimationPipeline::AnimationPipeline(AnimationSystem* system, ThreadPool* threadPool)
+	: mSystem(system), mThreadPool(threadPool)
+{
+}
+
+AnimationPipeline::~AnimationPipeline()
+{
+	// The task references the system and the palettes.
+	if( IsPending() )
+		Fetch();
+}
+
+void AnimationPipeline::SetPalettes(BYTE* palette0, BYTE* palette1)
+{
+	if( IsPending() )
+		Fetch();
+
+	mPalettes[0] = palette0;
+	mPalettes[1] = palette1;
+	mSystem->SetPaletteBuffer(mPalettes[mCurrent]);
+}
+
+void AnimationPipeline::Publish(float dt)
+{
+	if( IsPending() )
+		Fetch();
+
+	mSystem->SetPaletteBuffer(mPalettes[1 - mCurrent]);
+
+	++mPublished;
+	mPublishedDt = dt;
+	mInFlight = true;
+	auto task = [this]()
+	{
+		mSystem->Update(mPublishedDt);
+		mCompleted.store(mPublished, std::memory_order_release);
+	};
+
+	if( mThreadPool != nullptr )
+		mThreadPool->Post(task);
+	else
+		task();
+}
+
+UINT AnimationPipeline::Fetch()
+{
+	if( mPublished == 0 )
+	{
+		mSystem->SetPaletteBuffer(mPalettes[mCurrent]);
+		mSystem->Update(0.0f);
+		mPublished = 1;
+		mCompleted.store(1, std::memory_order_relaxed);
+		return mCurrent;
+	}
+
+	if( !mInFlight )
+		return mCurrent;
+
+	while( mCompleted.load(std::memory_order_acquire) != mPublished )
+	{
+		if( mThreadPool == nullptr || !mThreadPool->RunPendingTask() )
+			std::this_thread::yield();
+	}
+
+	mInFlight = false;
+	mCurrent = 1 - mCurrent;
+	return mCurrent;
+}
+
+UINT AnimationPipeline::CurrentPalette()const
+{
+	return mCurrent;
+}
+
+bool AnimationPipeline::IsPending()const
+{
+	return mInFlight;
+}
@@ -0,0 +1,67 @@
+#ifndef ANIMATIONPIPELINE_H
+#define ANIMATIONPIPELINE_H
+
+#include "AnimationSystem.h"
+#include <atomic>
+
+///<summary>
+/// Runs an AnimationSystem one frame ahead of rendering.  The palette is
+/// double buffered: while the current frame's commands are recorded from
+/// one buffer, the next frame's poses are evaluated into the other on the
+/// thread pool.  Each frame the main thread calls Fetch to take the
+/// finished buffer, may then change the system's clips, times and level
+/// of detail view, and calls Publish to start the next evaluation.
+///
+/// The hand-off is a pair of frame counters: the task stores the number
+/// of the frame it finished with release semantics after its last palette
+/// write, and Fetch spins on it with acquire semantics, helping the pool
+/// meanwhile, so neither side takes a lock.  The system must not be
+/// touched between Publish and Fetch.
+///
+/// The buffer being written was last read by the frame before the current
+/// one, so it must be free by then; InitDirect3DApp flushes the queue
+/// every frame.
+///</summary>
+class AnimationPipeline
+{
+public:
+	AnimationPipeline(AnimationSystem* system, ThreadPool* threadPool);
+	AnimationPipeline(const AnimationPipeline& rhs) = delete;
+	AnimationPipeline& operator=(const AnimationPipeline& rhs) = delete;
+	~AnimationPipeline();
+
+	// Two buffers laid out as the system's current palette.
+	void SetPalettes(BYTE* palette0, BYTE* palette1);
+
+	// Starts evaluating the next frame, dt seconds on, into the buffer that
+	// is not current.  Fetches a frame still in flight first.
+	void Publish(float dt);
+
+	// Waits for the published frame and makes its buffer current.  Before
+	// the first Publish the current frame is evaluated here.  Returns the
+	// index of the current buffer.
+	UINT Fetch();
+
+	UINT CurrentPalette()const;
+
+	// A frame was published and not fetched yet.
+	bool IsPending()const;
+
+private:
+	AnimationSystem* mSystem = nullptr;
+	ThreadPool* mThreadPool = nullptr;
+
+	BYTE* mPalettes[2] = { nullptr, nullptr };
+	UINT mCurrent = 0;
+
+	// Only the main thread writes these.  The task reads the frame and its
+	// step, which do not change again until it has been fetched, so it can
+	// capture just the pipeline and be posted without allocating.
+	UINT64 mPublished = 0;
+	float mPublishedDt = 0.0f;
+	bool mInFlight = false;
+
+	std::atomic<UINT64> mCompleted{ 0 };
+};
+
+#endif // ANIMATIONPIPELINE_H
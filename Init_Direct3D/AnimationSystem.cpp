@@ -0,0 +1,325 @@
+#include "AnimationSystem.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+AnimationSystem::AnimationSystem(ThreadPool* threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
+UINT AnimationSystem::AddInstance(SkinnedData* skinnedInfo, const std::string& clipName,
+	float timePos, float playbackRate)
+{
+	auto instance = std::make_unique<SkinnedModelInstance>();
+	instance->SkinnedInfo = skinnedInfo;
+	instance->FinalTransforms.resize(skinnedInfo->BoneCount());
+	instance->SetClip(clipName);
+	instance->TimePos = timePos;
+	instance->PlaybackRate = playbackRate;
+
+	mInstances.push_back(std::move(instance));
+
+	return (UINT)mInstances.size() - 1;
+}
+
+void AnimationSystem::Clear()
+{
+	mInstances.clear();
+	mLodStates.clear();
+}
+
+UINT AnimationSystem::InstanceCount()const
+{
+	return (UINT)mInstances.size();
+}
+
+SkinnedModelInstance* AnimationSystem::GetInstance(UINT slot)const
+{
+	return mInstances[slot].get();
+}
+
+void AnimationSystem::SetPalette(BYTE* palette, UINT slotByteSize, BonePaletteFormat format)
+{
+	mPalette = palette;
+	mPaletteSlotByteSize = slotByteSize;
+	mPaletteFormat = format;
+	mPaletteLayout = nullptr;
+}
+
+void AnimationSystem::SetPalette(BYTE* palette, const BonePaletteLayout& layout)
+{
+	mPalette = palette;
+	mPaletteSlotByteSize = layout.SlotByteSize();
+	mPaletteFormat = layout.Format();
+	mPaletteLayout = &layout;
+}
+
+void AnimationSystem::SetPaletteBuffer(BYTE* palette)
+{
+	mPalette = palette;
+}
+
+void AnimationSystem::SetBoneBounds(const BoneBounds* boneBounds)
+{
+	mBoneBounds = boneBounds;
+}
+
+void AnimationSystem::EnablePoseCache(float timeQuantum)
+{
+	mPoseCache = std::make_unique<PoseCache>(timeQuantum);
+}
+
+void AnimationSystem::DisablePoseCache()
+{
+	mPoseCache.reset();
+}
+
+const PoseCache* AnimationSystem::GetPoseCache()const
+{
+	return mPoseCache.get();
+}
+
+void AnimationSystem::EnableLod(const AnimationLodPolicy& policy)
+{
+	mLodEnabled = true;
+	mLodPolicy = policy;
+	mLodStates.clear();
+	mLodStats = AnimationLodStats();
+}
+
+void AnimationSystem::DisableLod()
+{
+	mLodEnabled = false;
+	mLodStates.clear();
+	mLodStats = AnimationLodStats();
+}
+
+void AnimationSystem::SetLodView(const Camera& camera, const BoundingOrientedBox* shadowVolume)
+{
+	mLodEye = camera.GetPosition3f();
+
+	// The frustum comes out of the projection in view space.
+	BoundingFrustum viewFrustum;
+	BoundingFrustum::CreateFromMatrix(viewFrustum, camera.GetProj());
+	XMMATRIX view = camera.GetView();
+	XMVECTOR det = XMMatrixDeterminant(view);
+	XMMATRIX invView = XMMatrixInverse(&det, view);
+	viewFrustum.Transform(mLodFrustum, invView);
+
+	mLodProjScale = 1.0f / tanf(0.5f * camera.GetFovY());
+	mLodViewSet = true;
+
+	mLodShadowVolumeSet = shadowVolume != nullptr;
+	if( mLodShadowVolumeSet )
+		mLodShadowVolume = *shadowVolume;
+}
+
+const AnimationLodStats& AnimationSystem::GetLodStats()const
+{
+	return mLodStats;
+}
+
+void AnimationSystem::Update(float dt)
+{
+	if( mPoseCache != nullptr )
+		mPoseCache->BeginFrame();
+
+	const UINT numInstances = (UINT)mInstances.size();
+	if( mLodEnabled )
+		mLodStates.resize(numInstances);
+
+	if( mThreadPool == nullptr )
+	{
+		for(UINT i = 0; i < numInstances; ++i)
+		{
+			if( mLodEnabled )
+				UpdateInstanceLod(i, dt);
+			else
+				UpdateInstance(i, dt);
+		}
+	}
+	else
+	{
+		// A few instances per batch keeps the queue overhead small next to the
+		// cost of a pose while still balancing hundreds of instances.
+		const UINT instancesPerBatch = 4;
+		mThreadPool->ParallelFor(numInstances, [this, dt](UINT i)
+		{
+			if( mLodEnabled )
+				UpdateInstanceLod(i, dt);
+			else
+				UpdateInstance(i, dt);
+		}, instancesPerBatch);
+	}
+
+	if( !mLodEnabled )
+		return;
+
+	// Summed here rather than by the workers so they share nothing.
+	mLodStats = AnimationLodStats();
+	for(UINT i = 0; i < numInstances; ++i)
+	{
+		const LodState& state = mLodStates[i];
+		const UINT numBones = (UINT)mInstances[i]->FinalTransforms.size();
+		switch( state.Result )
+		{
+		case LodResult::Evaluated:		++mLodStats.Evaluated; break;
+		case LodResult::Extrapolated:	++mLodStats.Extrapolated; break;
+		case LodResult::Culled:			++mLodStats.Culled; break;
+		}
+		mLodStats.BonesEvaluated += state.BonesEvaluated;
+		mLodStats.BonesSkipped += numBones - state.BonesEvaluated;
+	}
+
+	++mFrameIndex;
+}
+
+void AnimationSystem::AdvanceTime(float dt)
+{
+	for(const std::unique_ptr<SkinnedModelInstance>& instance : mInstances)
+		instance->AdvanceTime(dt);
+}
+
+void AnimationSystem::UpdateInstance(UINT slot, float dt)
+{
+	SkinnedModelInstance& instance = *mInstances[slot];
+	instance.AdvanceTime(dt);
+	EvaluateInstance(instance, UINT_MAX);
+	UpdatePoseBounds(instance);
+	PackInstance(slot);
+}
+
+void AnimationSystem::UpdateInstanceLod(UINT slot, float dt)
+{
+	SkinnedModelInstance& instance = *mInstances[slot];
+	LodState& state = mLodStates[slot];
+
+	// Extrapolation works in clip time elapsed, which runs forwards for
+	// either direction of playback.
+	if( instance.AdvanceTime(dt) )
+		state.LoopedSince = true;
+	state.SinceEvaluated += dt * fabsf(instance.PlaybackRate);
+
+	// Off screen instances keep their clocks running and are evaluated
+	// again as soon as they come back.  An instance only the shadow map
+	// sees still needs a current pose, or its shadow would freeze.
+	if( mLodPolicy.CullOffscreen && mLodViewSet &&
+		mLodFrustum.Contains(instance.Bounds) == DISJOINT &&
+		!(mLodShadowVolumeSet && mLodShadowVolume.Intersects(instance.Bounds)) )
+	{
+		state.Valid = false;
+		state.Result = LodResult::Culled;
+		state.BonesEvaluated = 0;
+		return;
+	}
+
+	instance.LodLevel = SelectLod(instance);
+	AnimationLod lod = mLodPolicy.Levels.empty() ? AnimationLod() : mLodPolicy.Levels[instance.LodLevel];
+
+	// Slots are staggered so the instances of one level do not all
+	// evaluate on the same frame.
+	UINT interval = std::max(lod.UpdateInterval, 1u);
+	if( !state.Valid || (mFrameIndex + slot) % interval == 0 )
+	{
+		state.BonesEvaluated = EvaluateInstance(instance, lod.MaxBoneDepth);
+		std::swap(state.Previous, state.Evaluated);
+		state.Evaluated.assign(instance.FinalTransforms.begin(), instance.FinalTransforms.end());
+		state.EvaluationSpan = state.SinceEvaluated;
+		state.LoopedBetween = !state.Valid || state.LoopedSince;
+		state.SinceEvaluated = 0.0f;
+		state.LoopedSince = false;
+		state.Valid = true;
+		state.Result = LodResult::Evaluated;
+	}
+	else
+	{
+		// Final = Evaluated + (Evaluated - Previous) * alpha, per matrix
+		// element.  The steps are a few frames at most, so the blended
+		// rotations stay close enough to orthonormal.
+		if( !state.LoopedBetween && !state.LoopedSince && state.EvaluationSpan > 0.0f )
+		{
+			float alpha = std::min(state.SinceEvaluated / state.EvaluationSpan, 1.0f);
+			for(size_t i = 0; i < instance.FinalTransforms.size(); ++i)
+			{
+				XMMATRIX E = XMLoadFloat4x4(&state.Evaluated[i]);
+				XMMATRIX P = XMLoadFloat4x4(&state.Previous[i]);
+				XMFLOAT4X4& F = instance.FinalTransforms[i];
+				for(int r = 0; r < 4; ++r)
+					XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(F.m[r]), XMVectorLerp(P.r[r], E.r[r], 1.0f + alpha));
+			}
+		}
+		else
+		{
+			std::copy(state.Evaluated.begin(), state.Evaluated.end(), instance.FinalTransforms.begin());
+		}
+
+		state.BonesEvaluated = 0;
+		state.Result = LodResult::Extrapolated;
+	}
+
+	UpdatePoseBounds(instance);
+	PackInstance(slot);
+}
+
+UINT AnimationSystem::EvaluateInstance(SkinnedModelInstance& instance, UINT maxBoneDepth)
+{
+	if( mPoseCache != nullptr )
+	{
+		const std::vector<XMFLOAT4X4>& pose = mPoseCache->GetPose(*instance.SkinnedInfo,
+			instance.Clip, instance.TimePos, instance.Cursor, instance.Scratch);
+		std::copy(pose.begin(), pose.end(), instance.FinalTransforms.begin());
+		return (UINT)pose.size();
+	}
+
+	return instance.SkinnedInfo->GetFinalTransforms(instance.Clip, instance.TimePos,
+		instance.FinalTransforms, instance.Cursor, instance.Scratch, maxBoneDepth);
+}
+
+UINT AnimationSystem::SelectLod(const SkinnedModelInstance& instance)const
+{
+	if( !mLodViewSet || mLodPolicy.Levels.empty() )
+		return 0;
+
+	// Diameter over viewport height: 2r / (2 d tan(fovY/2)).
+	XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&instance.Bounds.Center), XMLoadFloat3(&mLodEye));
+	float distance = XMVectorGetX(XMVector3Length(toCenter));
+	float screenSize = distance > instance.Bounds.Radius ?
+		instance.Bounds.Radius * mLodProjScale / distance : FLT_MAX;
+
+	const UINT numLevels = (UINT)mLodPolicy.Levels.size();
+	for(UINT level = 0; level + 1 < numLevels; ++level)
+	{
+		if( screenSize >= mLodPolicy.Levels[level].MinScreenSize )
+			return level;
+	}
+	return numLevels - 1;
+}
+
+void AnimationSystem::UpdatePoseBounds(SkinnedModelInstance& instance)const
+{
+	if( mBoneBounds != nullptr && mBoneBounds->BoneCount() == instance.FinalTransforms.size() )
+		mBoneBounds->ComputeBounds(instance.FinalTransforms.data(), instance.PoseBounds);
+}
+
+// The pose is concatenated into instance.FinalTransforms and packed from
+// there rather than straight into the palette.  The pose bounds, the level
+// of detail extrapolation and CPU skinning all read it, and subset palettes
+// gather bones out of order and may repeat them.  The matrices are still in
+// cache when they are packed.
+void AnimationSystem::PackInstance(UINT slot)
+{
+	const SkinnedModelInstance& instance = *mInstances[slot];
+	if( mPalette != nullptr && mPaletteLayout != nullptr )
+	{
+		mPaletteLayout->Pack(instance.FinalTransforms.data(), mPalette + (size_t)slot * mPaletteSlotByteSize);
+	}
+	else if( mPalette != nullptr )
+	{
+		UINT slotBones = mPaletteSlotByteSize / BonePalette::BoneByteSize(mPaletteFormat);
+		UINT numBones = std::min((UINT)instance.FinalTransforms.size(), slotBones);
+		BonePalette::Pack(mPaletteFormat, instance.FinalTransforms.data(), numBones,
+			mPalette + (size_t)slot * mPaletteSlotByteSize);
+	}
+}
@@ -0,0 +1,267 @@
+#ifndef ANIMATIONSYSTEM_H
+#define ANIMATIONSYSTEM_H
+
+#include "../Common/ThreadPool.h"
+#include "../Common/Camera.h"
+#include <DirectXCollision.h>
+#include "PoseCache.h"
+#include "BonePalette.h"
+#include "BoneBounds.h"
+
+struct SkinnedModelInstance
+{
+	SkinnedData* SkinnedInfo = nullptr;
+	std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
+	std::string ClipName;
+	float TimePos = 0.0f;
+
+	// Multiplies the frame time; 1 plays the clip at its authored speed.
+	float PlaybackRate = 1.0f;
+
+	// ClipName resolved against SkinnedInfo; resolved on the first update.
+	AnimationClipHandle Clip;
+
+	// Keyframe positions from the previous update, one per bone.
+	AnimationCursor Cursor;
+
+	// Working storage for GetFinalTransforms, reused every frame.
+	AnimationScratch Scratch;
+
+	// World space bounds, kept current by the owner; used by the level of
+	// detail policy for culling and projected size.
+	DirectX::BoundingSphere Bounds;
+
+	// Level of detail the last AnimationSystem::Update chose.
+	UINT LodLevel = 0;
+
+	// Model space box of FinalTransforms, kept by AnimationSystem when it
+	// has BoneBounds.
+	DirectX::BoundingBox PoseBounds;
+
+	// Switches to another clip and restarts it.
+	void SetClip(const std::string& clipName)
+	{
+		ClipName = clipName;
+		Clip = SkinnedInfo->GetClipHandle(ClipName);
+		TimePos = 0.0f;
+	}
+
+	// Increments the time position, looping at whichever end of the clip a
+	// positive or negative PlaybackRate runs past.  Returns true if it
+	// looped.
+	bool AdvanceTime(float dt)
+	{
+		if (!Clip.IsValid())
+			Clip = SkinnedInfo->GetClipHandle(ClipName);
+
+		TimePos += dt * PlaybackRate;
+		if (TimePos >= Clip.StartTime && TimePos <= Clip.EndTime)
+			return false;
+
+		// Loop animation
+		float length = Clip.EndTime - Clip.StartTime;
+		if (length > 0.0f)
+		{
+			TimePos = Clip.StartTime + fmodf(TimePos - Clip.StartTime, length);
+			if (TimePos < Clip.StartTime)
+				TimePos += length;
+		}
+		else
+		{
+			TimePos = Clip.StartTime;
+		}
+		return true;
+	}
+
+	// Called every frame and increments the time position, interpolates the 
+	// animations for each bone based on the current animation clip, and 
+	// generates the final transforms which are ultimately set to the effect
+	// for processing in the vertex shader.
+	void UpdateSkinnedAnimation(float dt)
+	{
+		AdvanceTime(dt);
+
+		// Compute the final transforms for this time position.
+		SkinnedInfo->GetFinalTransforms(Clip, TimePos, FinalTransforms, Cursor, Scratch);
+	}
+};
+
+///<summary>
+/// One level of an AnimationLodPolicy.  An instance uses the first level
+/// whose MinScreenSize its projected size reaches.
+///</summary>
+struct AnimationLod
+{
+	// Bounding sphere diameter over the viewport height.
+	float MinScreenSize = 0.0f;
+
+	// Poses are evaluated every UpdateInterval frames and extrapolated from
+	// the last two in between.
+	UINT UpdateInterval = 1;
+
+	// Bones deeper in the hierarchy keep their last local transform.
+	UINT MaxBoneDepth = UINT_MAX;
+};
+
+struct AnimationLodPolicy
+{
+	// Ordered from the largest MinScreenSize down.
+	std::vector<AnimationLod> Levels;
+
+	// Instances outside the view frustum, and outside the shadow volume
+	// given to SetLodView, only advance their clocks.
+	bool CullOffscreen = true;
+};
+
+///<summary>
+/// What the last AnimationSystem::Update did.  Bones of extrapolated and
+/// culled instances count as skipped.
+///</summary>
+struct AnimationLodStats
+{
+	UINT Evaluated = 0;
+	UINT Extrapolated = 0;
+	UINT Culled = 0;
+
+	UINT64 BonesEvaluated = 0;
+	UINT64 BonesSkipped = 0;
+};
+
+///<summary>
+/// Owns the animated instances of the scene and updates them together.
+/// Each instance has its own clip, time and playback rate, and a fixed
+/// slot in a bone palette buffer (typically the mapped skinned constant
+/// buffer), whose index is returned by AddInstance.  With a thread pool,
+/// Update spreads the instances over the workers; an instance only ever
+/// reads shared, immutable SkinnedData and writes its own state and its
+/// own palette slot, so the result does not depend on the thread count.
+///</summary>
+class AnimationSystem
+{
+public:
+	explicit AnimationSystem(ThreadPool* threadPool = nullptr);
+	AnimationSystem(const AnimationSystem& rhs) = delete;
+	AnimationSystem& operator=(const AnimationSystem& rhs) = delete;
+
+	// Adds an instance playing clipName from timePos and returns its palette slot.
+	UINT AddInstance(SkinnedData* skinnedInfo, const std::string& clipName,
+		float timePos = 0.0f, float playbackRate = 1.0f);
+	void Clear();
+
+	UINT InstanceCount()const;
+	SkinnedModelInstance* GetInstance(UINT slot)const;
+
+	// Slot i of the palette starts at palette + i*slotByteSize and receives
+	// the instance's bones packed in the given format, as many as fit.  Pass
+	// nullptr to only keep the poses in each instance's FinalTransforms.
+	void SetPalette(BYTE* palette, UINT slotByteSize, BonePaletteFormat format);
+
+	// As above, but each slot is laid out as layout's subset palettes.  The
+	// layout must outlive the system or the next SetPalette.
+	void SetPalette(BYTE* palette, const BonePaletteLayout& layout);
+
+	// Moves the palette to another buffer laid out like the current one.
+	void SetPaletteBuffer(BYTE* palette);
+
+	// After each pose is computed, bounds its instance's PoseBounds with
+	// the given boxes.  They must outlive the system or be replaced first.
+	void SetBoneBounds(const BoneBounds* boneBounds);
+
+	// Instances playing the same clip at the same quantized time then share
+	// one pose per frame instead of each computing it.  Off by default.
+	void EnablePoseCache(float timeQuantum);
+	void DisablePoseCache();
+	const PoseCache* GetPoseCache()const;
+
+	// Lowers the update rate and bone count of instances that are small on
+	// screen and stops updating those off screen, see AnimationLodPolicy.
+	// Instances' Bounds must be set, and SetLodView called once the camera
+	// is positioned.  With the pose cache enabled the bone depth is ignored,
+	// since cached poses are shared.
+	void EnableLod(const AnimationLodPolicy& policy);
+	void DisableLod();
+
+	// shadowVolume, if given, is the world space volume the shadow map
+	// covers; instances in it still cast shadows and keep being posed even
+	// when the camera cannot see them.
+	void SetLodView(const Camera& camera, const DirectX::BoundingOrientedBox* shadowVolume = nullptr);
+
+	// Totals of the last Update with the level of detail enabled.
+	const AnimationLodStats& GetLodStats()const;
+
+	// Advances every instance by dt seconds and writes its palette slot.
+	void Update(float dt);
+
+	// Only advances every instance's clock, for instances whose poses come
+	// from elsewhere, such as an AnimationAtlas.
+	void AdvanceTime(float dt);
+
+private:
+	enum class LodResult
+	{
+		Evaluated,
+		Extrapolated,
+		Culled
+	};
+
+	// Poses of an instance at its last two evaluations, for extrapolation.
+	struct LodState
+	{
+		std::vector<DirectX::XMFLOAT4X4> Evaluated;
+		std::vector<DirectX::XMFLOAT4X4> Previous;
+
+		// Clip time advanced since the last evaluation, and between the two.
+		float SinceEvaluated = 0.0f;
+		float EvaluationSpan = 0.0f;
+
+		// False until the first evaluation and after the instance is culled.
+		bool Valid = false;
+
+		// The clip looped between the two evaluations, or since the last
+		// one; either way extrapolating would run backwards, so the last
+		// pose is held instead.
+		bool LoopedBetween = true;
+		bool LoopedSince = false;
+
+		LodResult Result = LodResult::Evaluated;
+		UINT BonesEvaluated = 0;
+	};
+
+	void UpdateInstance(UINT slot, float dt);
+	void UpdateInstanceLod(UINT slot, float dt);
+	UINT EvaluateInstance(SkinnedModelInstance& instance, UINT maxBoneDepth);
+	void UpdatePoseBounds(SkinnedModelInstance& instance)const;
+	void PackInstance(UINT slot);
+	UINT SelectLod(const SkinnedModelInstance& instance)const;
+
+private:
+	ThreadPool* mThreadPool = nullptr;
+	std::unique_ptr<PoseCache> mPoseCache;
+
+	// unique_ptr so render items can keep pointers while instances are added.
+	std::vector<std::unique_ptr<SkinnedModelInstance>> mInstances;
+
+	BYTE* mPalette = nullptr;
+	UINT mPaletteSlotByteSize = 0;
+	BonePaletteFormat mPaletteFormat = BonePaletteFormat::Affine3x4;
+	const BonePaletteLayout* mPaletteLayout = nullptr;
+	const BoneBounds* mBoneBounds = nullptr;
+
+	bool mLodEnabled = false;
+	AnimationLodPolicy mLodPolicy;
+	std::vector<LodState> mLodStates;
+	AnimationLodStats mLodStats;
+	UINT mFrameIndex = 0;
+
+	// World space view, and the cotangent of half the vertical field of
+	// view, which turns radius / distance into a fraction of the viewport.
+	DirectX::XMFLOAT3 mLodEye = { 0.0f, 0.0f, 0.0f };
+	DirectX::BoundingFrustum mLodFrustum;
+	float mLodProjScale = 1.0f;
+	bool mLodViewSet = false;
+
+	DirectX::BoundingOrientedBox mLodShadowVolume;
+	bool mLodShadowVolumeSet = false;
+};
+
+#endif // ANIMATIONSYSTEM_H
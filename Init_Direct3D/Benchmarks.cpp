@@ -0,0 +1,1978 @@
+#include "Benchmarks.h"
+#include "LoadM3d.h"
+#include "LoadTxtModel.h"
+#include "AnimationPipeline.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "../Common/GeometryGenerator.h"
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <DirectXPackedVector.h>
+
+#if defined(RUN_BENCHMARKS)
+// Benchmark builds count every heap allocation so AnimationAllocations can
+// check that the per-frame animation update allocates nothing.
+static std::atomic<size_t> gAllocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+	++gAllocationCount;
+	if( void* p = malloc(size ? size : 1) )
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// XMFLOAT4X4A and other over-aligned types come through these.
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	++gAllocationCount;
+	if( void* p = _aligned_malloc(size ? size : 1, (size_t)alignment) )
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	_aligned_free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(p);
+}
+#endif
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	double FileSizeMB(const std::string& filename)
+	{
+		std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+		return fin ? (double)fin.tellg() / (1024.0 * 1024.0) : 0.0;
+	}
+
+	// Runs func iterations times and reports the average time and the rate
+	// of unitsPerIteration per second.
+	template<typename Func>
+	Benchmarks::Result TimeRate(const std::string& name, double unitsPerIteration, const std::string& unit,
+		UINT iterations, Func func)
+	{
+		auto start = Clock::now();
+		for(UINT i = 0; i < iterations; ++i)
+			func();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count() / iterations;
+
+		Benchmarks::Result result;
+		result.Name = name;
+		result.Milliseconds = seconds * 1000.0;
+		result.Rate = seconds > 0.0 ? unitsPerIteration / seconds : 0.0;
+		result.RateUnit = unit;
+
+		return result;
+	}
+
+	// Runs func iterations times and reports the average time and the
+	// throughput of megaBytes per iteration.
+	template<typename Func>
+	Benchmarks::Result TimeThroughput(const std::string& name, double megaBytes, UINT iterations, Func func)
+	{
+		return TimeRate(name, megaBytes, "MB/s", iterations, func);
+	}
+
+	// GeometryGenerator::CreateGrid as it was before it wrote rows in
+	// parallel, kept to measure against.
+	void LegacyCreateGrid(float width, float depth, UINT m, UINT n, GeometryGenerator::MeshData& meshData)
+	{
+		meshData.Vertices.resize(m*n);
+		for(UINT i = 0; i < m; ++i)
+		{
+			float z = 0.5f*depth - i*depth/(m-1);
+			for(UINT j = 0; j < n; ++j)
+			{
+				float x = -0.5f*width + j*width/(n-1);
+
+				meshData.Vertices[i*n+j].Position = DirectX::XMFLOAT3(x, 0.0f, z);
+				meshData.Vertices[i*n+j].Normal   = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+				meshData.Vertices[i*n+j].TangentU = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+				meshData.Vertices[i*n+j].TexC.x = j*1.0f/(n-1);
+				meshData.Vertices[i*n+j].TexC.y = i*1.0f/(m-1);
+			}
+		}
+
+		meshData.Indices32.resize((m-1)*(n-1)*6);
+		UINT k = 0;
+		for(UINT i = 0; i < m-1; ++i)
+		{
+			for(UINT j = 0; j < n-1; ++j)
+			{
+				meshData.Indices32[k]   = i*n+j;
+				meshData.Indices32[k+1] = i*n+j+1;
+				meshData.Indices32[k+2] = (i+1)*n+j;
+				meshData.Indices32[k+3] = (i+1)*n+j;
+				meshData.Indices32[k+4] = i*n+j+1;
+				meshData.Indices32[k+5] = (i+1)*n+j+1;
+				k += 6;
+			}
+		}
+	}
+
+	// GeometryGenerator::CreateSphere as it was before, one push_back and
+	// four sinf/cosf pairs per vertex.
+	void LegacyCreateSphere(float radius, UINT sliceCount, UINT stackCount, GeometryGenerator::MeshData& meshData)
+	{
+		meshData.Vertices.push_back(GeometryGenerator::Vertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+
+		float phiStep   = DirectX::XM_PI/stackCount;
+		float thetaStep = 2.0f*DirectX::XM_PI/sliceCount;
+		for(UINT i = 1; i <= stackCount-1; ++i)
+		{
+			float phi = i*phiStep;
+			for(UINT j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j*thetaStep;
+
+				GeometryGenerator::Vertex v;
+				v.Position = DirectX::XMFLOAT3(radius*sinf(phi)*cosf(theta), radius*cosf(phi), radius*sinf(phi)*sinf(theta));
+				v.TangentU = DirectX::XMFLOAT3(-radius*sinf(phi)*sinf(theta), 0.0f, +radius*sinf(phi)*cosf(theta));
+				DirectX::XMStoreFloat3(&v.TangentU, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&v.TangentU)));
+				DirectX::XMStoreFloat3(&v.Normal, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&v.Position)));
+				v.TexC = DirectX::XMFLOAT2(theta / DirectX::XM_2PI, phi / DirectX::XM_PI);
+				meshData.Vertices.push_back(v);
+			}
+		}
+
+		meshData.Vertices.push_back(GeometryGenerator::Vertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+
+		for(UINT i = 1; i <= sliceCount; ++i)
+		{
+			meshData.Indices32.push_back(0);
+			meshData.Indices32.push_back(i+1);
+			meshData.Indices32.push_back(i);
+		}
+
+		UINT ringVertexCount = sliceCount + 1;
+		for(UINT i = 0; i < stackCount-2; ++i)
+		{
+			for(UINT j = 0; j < sliceCount; ++j)
+			{
+				meshData.Indices32.push_back(1 + i*ringVertexCount + j);
+				meshData.Indices32.push_back(1 + i*ringVertexCount + j+1);
+				meshData.Indices32.push_back(1 + (i+1)*ringVertexCount + j);
+				meshData.Indices32.push_back(1 + (i+1)*ringVertexCount + j);
+				meshData.Indices32.push_back(1 + i*ringVertexCount + j+1);
+				meshData.Indices32.push_back(1 + (i+1)*ringVertexCount + j+1);
+			}
+		}
+
+		UINT southPoleIndex = (UINT)meshData.Vertices.size()-1;
+		UINT baseIndex = southPoleIndex - ringVertexCount;
+		for(UINT i = 0; i < sliceCount; ++i)
+		{
+			meshData.Indices32.push_back(southPoleIndex);
+			meshData.Indices32.push_back(baseIndex+i);
+			meshData.Indices32.push_back(baseIndex+i+1);
+		}
+	}
+}
+
+std::vector<Benchmarks::Result> Benchmarks::ModelParsing(
+	const std::string& m3dFilename,
+	const std::string& m3dbFilename,
+	const std::string& txtFilename,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	double m3dSize = FileSizeMB(m3dFilename);
+	double m3dbSize = FileSizeMB(m3dbFilename);
+	double txtSize = FileSizeMB(txtFilename);
+
+	// Baseline: only splitting the file into tokens with stream extraction,
+	// which is a lower bound on the cost of the old "fin >> ignore >> x" loaders.
+	results.push_back(TimeThroughput("ifstream token scan (" + m3dFilename + ")", m3dSize, iterations, [&]()
+	{
+		std::ifstream fin(m3dFilename);
+		std::string token;
+		while(fin >> token) {}
+	}));
+
+	results.push_back(TimeThroughput("M3DLoader::LoadM3d (" + m3dFilename + ")", m3dSize, iterations, [&]()
+	{
+		std::vector<M3DLoader::SkinnedVertex> vertices;
+		IndexData indices;
+		std::vector<M3DLoader::Subset> subsets;
+		std::vector<M3DLoader::M3dMaterial> mats;
+		SkinnedData skinInfo;
+
+		M3DLoader loader;
+		loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo);
+	}));
+
+	if(threadPool != nullptr)
+	{
+		std::string name = "M3DLoader::LoadM3d, " + std::to_string(threadPool->ThreadCount()) + " threads (" + m3dFilename + ")";
+		results.push_back(TimeThroughput(name, m3dSize, iterations, [&]()
+		{
+			std::vector<M3DLoader::SkinnedVertex> vertices;
+			IndexData indices;
+			std::vector<M3DLoader::Subset> subsets;
+			std::vector<M3DLoader::M3dMaterial> mats;
+			SkinnedData skinInfo;
+
+			M3DLoader loader(threadPool);
+			loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo);
+		}));
+	}
+
+	if(m3dbSize > 0.0)
+	{
+		results.push_back(TimeThroughput("M3DLoader::LoadM3dBinary (" + m3dbFilename + ")", m3dbSize, iterations, [&]()
+		{
+			std::vector<M3DLoader::SkinnedVertex> vertices;
+			IndexData indices;
+			std::vector<M3DLoader::Subset> subsets;
+			std::vector<M3DLoader::M3dMaterial> mats;
+			SkinnedData skinInfo;
+
+			M3DLoader loader;
+			loader.LoadM3dBinary(m3dbFilename, vertices, indices, subsets, mats, skinInfo);
+		}));
+	}
+
+	results.push_back(TimeThroughput("TxtModelLoader::LoadTxtModel (" + txtFilename + ")", txtSize, iterations, [&]()
+	{
+		std::vector<TxtModelLoader::Vertex> vertices;
+		IndexData indices;
+
+		TxtModelLoader loader;
+		loader.LoadTxtModel(txtFilename, vertices, indices);
+	}));
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationSampling(
+	const SkinnedData& skinInfo,
+	const std::string& clipName,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	// One iteration plays the clip for framesPerIteration frames at 60 Hz,
+	// wrapping around at the end like SkinnedModelInstance does.
+	const UINT framesPerIteration = 600;
+	const float dt = 1.0f / 60.0f;
+	const float endTime = skinInfo.GetClipEndTime(clipName);
+
+	std::vector<DirectX::XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+
+	results.push_back(TimeRate("SkinnedData::GetFinalTransforms (" + clipName + ")", framesPerIteration, "frames/s", iterations, [&]()
+	{
+		float t = 0.0f;
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			t = t + dt > endTime ? 0.0f : t + dt;
+			skinInfo.GetFinalTransforms(clipName, t, finalTransforms);
+		}
+	}));
+
+	AnimationCursor cursor;
+	results.push_back(TimeRate("SkinnedData::GetFinalTransforms, cursor (" + clipName + ")", framesPerIteration, "frames/s", iterations, [&]()
+	{
+		float t = 0.0f;
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			t = t + dt > endTime ? 0.0f : t + dt;
+			skinInfo.GetFinalTransforms(clipName, t, finalTransforms, cursor);
+		}
+	}));
+
+	AnimationClipHandle clip = skinInfo.GetClipHandle(clipName);
+	AnimationCursor handleCursor;
+	AnimationScratch scratch;
+	results.push_back(TimeRate("SkinnedData::GetFinalTransforms, handle (" + clipName + ")", framesPerIteration, "frames/s", iterations, [&]()
+	{
+		float t = 0.0f;
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			t = t + dt > clip.EndTime ? 0.0f : t + dt;
+			skinInfo.GetFinalTransforms(clip, t, finalTransforms, handleCursor, scratch);
+		}
+	}));
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::ClipInterpolation(
+	const SkinnedData& skinInfo,
+	const std::string& clipName,
+	float sampleRate,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	std::shared_ptr<const AnimationClip> clip = skinInfo.GetClip(clipName);
+	SampledAnimationClip sampledClip;
+	if( clip == nullptr || !sampledClip.Build(*clip, sampleRate) )
+		return results;
+
+	const UINT framesPerIteration = 600;
+	const float dt = 1.0f / 60.0f;
+	const float endTime = clip->GetClipEndTime();
+
+	std::vector<DirectX::XMFLOAT4X4> reference(skinInfo.BoneCount());
+	std::vector<DirectX::XMFLOAT4X4> transforms(skinInfo.BoneCount());
+
+	AnimationCursor cursor;
+	results.push_back(TimeRate("AnimationClip::Interpolate (" + clipName + ")", framesPerIteration, "frames/s", iterations, [&]()
+	{
+		float t = 0.0f;
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			t = t + dt > endTime ? 0.0f : t + dt;
+			clip->Interpolate(t, reference, cursor);
+		}
+	}));
+
+	const SampledAnimationClip::Accuracy accuracies[] = { SampledAnimationClip::Accuracy::Precise, SampledAnimationClip::Accuracy::Fast };
+	const char* accuracyNames[] = { "precise", "fast" };
+	for(int mode = 0; mode < 2; ++mode)
+	{
+		SampledAnimationClip::Accuracy accuracy = accuracies[mode];
+		std::string name = "SampledAnimationClip::Interpolate, " + std::string(accuracyNames[mode]) +
+			" " + std::to_string((int)sampledClip.GetSampleRate()) + " Hz (" + clipName + ")";
+
+		results.push_back(TimeRate(name, framesPerIteration, "frames/s", iterations, [&]()
+		{
+			float t = 0.0f;
+			for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			{
+				t = t + dt > endTime ? 0.0f : t + dt;
+				sampledClip.Interpolate(t, transforms, accuracy);
+			}
+		}));
+
+		float maxError = 0.0f;
+		for(float t = clip->GetClipStartTime(); t <= endTime; t += dt)
+		{
+			clip->Interpolate(t, reference, cursor);
+			sampledClip.Interpolate(t, transforms, accuracy);
+			for(size_t i = 0; i < reference.size(); ++i)
+			{
+				for(int r = 0; r < 4; ++r)
+				{
+					for(int c = 0; c < 4; ++c)
+						maxError = std::max(maxError, std::abs(reference[i].m[r][c] - transforms[i].m[r][c]));
+				}
+			}
+		}
+
+		Result error;
+		error.Name = name + " error";
+		error.Rate = maxError;
+		error.RateUnit = "max abs";
+		results.push_back(error);
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationUpdate(
+	SkinnedData& skinInfo,
+	const std::string& clipName,
+	UINT instanceCount,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	const UINT framesPerIteration = 60;
+	const float dt = 1.0f / 60.0f;
+	const UINT slotByteSize = BonePalette::SlotByteSize(BonePaletteFormat::Affine3x4, skinInfo.BoneCount());
+	const float clipLength = skinInfo.GetClipEndTime(clipName);
+
+	AnimationSystem serial;
+	AnimationSystem parallel(threadPool);
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		float timePos = clipLength > 0.0f ? fmodf(i * 0.37f, clipLength) : 0.0f;
+		float playbackRate = 0.75f + 0.5f * (i % 5) / 4.0f;
+		serial.AddInstance(&skinInfo, clipName, timePos, playbackRate);
+		parallel.AddInstance(&skinInfo, clipName, timePos, playbackRate);
+	}
+
+	std::vector<BYTE> serialPalette((size_t)instanceCount * slotByteSize);
+	std::vector<BYTE> parallelPalette((size_t)instanceCount * slotByteSize);
+	serial.SetPalette(serialPalette.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+	parallel.SetPalette(parallelPalette.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+
+	std::string suffix = " (" + std::to_string(instanceCount) + " x " + clipName + ")";
+	results.push_back(TimeRate("AnimationSystem::Update, serial" + suffix,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			serial.Update(dt);
+	}));
+
+	if( threadPool != nullptr )
+	{
+		results.push_back(TimeRate("AnimationSystem::Update, " + std::to_string(threadPool->ThreadCount()) + " threads" + suffix,
+			(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+		{
+			for(UINT frame = 0; frame < framesPerIteration; ++frame)
+				parallel.Update(dt);
+		}));
+
+		// Both systems have now played the same frames.
+		UINT mismatches = 0;
+		for(UINT i = 0; i < instanceCount; ++i)
+		{
+			if( memcmp(&serialPalette[(size_t)i * slotByteSize], &parallelPalette[(size_t)i * slotByteSize], slotByteSize) != 0 )
+				++mismatches;
+		}
+
+		Result determinism;
+		determinism.Name = "AnimationSystem::Update, slots differing from serial" + suffix;
+		determinism.Rate = mismatches;
+		determinism.RateUnit = "slots";
+		determinism.Failed = mismatches != 0;
+		results.push_back(determinism);
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::PoseCaching(
+	SkinnedData& skinInfo,
+	const std::string& clipName,
+	UINT instanceCount,
+	float timeQuantum,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	const UINT framesPerIteration = 60;
+	const float dt = 1.0f / 60.0f;
+	const UINT numPhases = 8;
+	const float clipLength = skinInfo.GetClipEndTime(clipName);
+
+	// A background crowd: every instance is in step with one of a few phases.
+	AnimationSystem uncached(threadPool);
+	AnimationSystem cached(threadPool);
+	cached.EnablePoseCache(timeQuantum);
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		float timePos = clipLength * (i % numPhases) / numPhases;
+		uncached.AddInstance(&skinInfo, clipName, timePos);
+		cached.AddInstance(&skinInfo, clipName, timePos);
+	}
+
+	std::string suffix = " (" + std::to_string(instanceCount) + " x " + clipName + ", " +
+		std::to_string((int)(timeQuantum * 1000.0f)) + " ms quantum)";
+	results.push_back(TimeRate("AnimationSystem::Update, no pose cache" + suffix,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			uncached.Update(dt);
+	}));
+
+	results.push_back(TimeRate("AnimationSystem::Update, pose cache" + suffix,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			cached.Update(dt);
+	}));
+
+	const PoseCache* poseCache = cached.GetPoseCache();
+	UINT64 lookups = poseCache->GetHitCount() + poseCache->GetMissCount();
+
+	Result hitRate;
+	hitRate.Name = "PoseCache hit rate" + suffix;
+	hitRate.Rate = lookups > 0 ? 100.0 * poseCache->GetHitCount() / lookups : 0.0;
+	hitRate.RateUnit = "%";
+	results.push_back(hitRate);
+
+	// Both systems have played the same frames; compare their poses.
+	float maxError = 0.0f;
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		const std::vector<DirectX::XMFLOAT4X4>& exact = uncached.GetInstance(i)->FinalTransforms;
+		const std::vector<DirectX::XMFLOAT4X4>& shared = cached.GetInstance(i)->FinalTransforms;
+		for(size_t b = 0; b < exact.size(); ++b)
+		{
+			for(int r = 0; r < 4; ++r)
+			{
+				for(int c = 0; c < 4; ++c)
+					maxError = std::max(maxError, std::abs(exact[b].m[r][c] - shared[b].m[r][c]));
+			}
+		}
+	}
+
+	Result error;
+	error.Name = "PoseCache quantization error" + suffix;
+	error.Rate = maxError;
+	error.RateUnit = "max abs";
+	results.push_back(error);
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationCompression(
+	const SkinnedData& skinInfo,
+	const BoneBounds& boneBounds,
+	const std::string& clipName,
+	float tolerance,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	std::shared_ptr<const AnimationClip> clip = skinInfo.GetClip(clipName);
+	if( clip == nullptr )
+		return results;
+
+	std::vector<float> boneReach;
+	boneBounds.ComputeReach(skinInfo.GetBoneOffsets(), boneReach);
+
+	AnimationCompressionStats stats;
+	auto compressed = std::make_shared<CompressedAnimationClip>();
+	if( !compressed->Compress(*clip, skinInfo.GetBoneHierarchy(), boneReach, tolerance, &stats) )
+		return results;
+
+	// A skeleton that plays only the compressed clip.
+	std::vector<int> boneHierarchy = skinInfo.GetBoneHierarchy();
+	std::vector<DirectX::XMFLOAT4X4> boneOffsets = skinInfo.GetBoneOffsets();
+	std::unordered_map<std::string, AnimationClip> clips;
+	clips[clipName].Compressed = compressed;
+	SkinnedData compressedInfo;
+	compressedInfo.Set(boneHierarchy, boneOffsets, clips);
+
+	char tag[64];
+	snprintf(tag, sizeof(tag), ", tolerance %g (", tolerance);
+	std::string suffix = tag + clipName + ")";
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	addValue("Animation compression ratio", stats.Ratio(), "x");
+	addValue("Animation compression keyframes kept", 100.0 * stats.KeptKeyframes / stats.OriginalKeyframes, "%");
+	addValue("Animation compression bone translation error", stats.MaxTranslationError, "max");
+	addValue("Animation compression bone rotation error", stats.MaxRotationError, "max rad");
+	addValue("Animation compression model space error", stats.MaxModelError, "max");
+
+	// What reaches the screen: a skinned vertex is a weighted average of
+	// its position moved by each of its bones and lies in each of their
+	// bind pose boxes, so it moves no further than the farthest moved box
+	// corner.  The final transforms are stored transposed for the shaders.
+	const float dt = 1.0f / 60.0f;
+	AnimationClipHandle original = skinInfo.GetClipHandle(clipName);
+	AnimationClipHandle decoded = compressedInfo.GetClipHandle(clipName);
+	std::vector<DirectX::XMFLOAT4X4> exact(skinInfo.BoneCount());
+	std::vector<DirectX::XMFLOAT4X4> approximate(skinInfo.BoneCount());
+	AnimationCursor exactCursor, approximateCursor;
+	AnimationScratch scratch;
+	float maxError = 0.0f;
+	for(float t = original.StartTime; t <= original.EndTime; t += dt)
+	{
+		skinInfo.GetFinalTransforms(original, t, exact, exactCursor, scratch);
+		compressedInfo.GetFinalTransforms(decoded, t, approximate, approximateCursor, scratch);
+		for(UINT b = 0; b < (UINT)exact.size() && b < boneBounds.BoneCount(); ++b)
+		{
+			if( !boneBounds.HasBox(b) )
+				continue;
+
+			DirectX::XMMATRIX A = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&exact[b]));
+			DirectX::XMMATRIX B = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&approximate[b]));
+			DirectX::XMFLOAT3 corners[DirectX::BoundingBox::CORNER_COUNT];
+			boneBounds.GetBox(b).GetCorners(corners);
+			for(const DirectX::XMFLOAT3& corner : corners)
+			{
+				DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&corner);
+				DirectX::XMVECTOR d = DirectX::XMVectorSubtract(DirectX::XMVector3Transform(p, A), DirectX::XMVector3Transform(p, B));
+				maxError = std::max(maxError, DirectX::XMVectorGetX(DirectX::XMVector3Length(d)));
+			}
+		}
+	}
+	addValue("Animation compression skinned vertex error", maxError, "max");
+
+	results.push_back(TimeRate("SkinnedData::GetFinalTransforms, compressed" + suffix, 600, "frames/s", iterations, [&]()
+	{
+		float t = 0.0f;
+		for(UINT frame = 0; frame < 600; ++frame)
+		{
+			t = t + dt > decoded.EndTime ? 0.0f : t + dt;
+			compressedInfo.GetFinalTransforms(decoded, t, approximate, approximateCursor, scratch);
+		}
+	}));
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::PalettePacking(
+	const SkinnedData& skinInfo,
+	const std::string& clipName,
+	UINT instanceCount,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	AnimationClipHandle clip = skinInfo.GetClipHandle(clipName);
+	if( !clip.IsValid() )
+		return results;
+
+	const UINT numBones = skinInfo.BoneCount();
+	std::vector<DirectX::XMFLOAT4X4> finalTransforms(numBones);
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	skinInfo.GetFinalTransforms(clip, 0.5f * (clip.StartTime + clip.EndTime), finalTransforms, cursor, scratch);
+
+	std::string suffix = " (" + std::to_string(instanceCount) + " x " + std::to_string(numBones) + " bones)";
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	// The previous layout: a fixed 96 matrix SkinnedConstants per instance.
+	const UINT matrixSlotByteSize = (96 * sizeof(DirectX::XMFLOAT4X4) + 255) & ~255;
+	std::vector<DirectX::XMFLOAT4X4> boneTransforms(96);
+	std::vector<BYTE> matrixPalette((size_t)instanceCount * matrixSlotByteSize);
+	addValue("Bone palette bytes per instance, 4x4", matrixSlotByteSize, "bytes");
+	results.push_back(TimeRate("Bone palette upload, 4x4" + suffix, instanceCount, "instances/s", iterations, [&]()
+	{
+		for(UINT i = 0; i < instanceCount; ++i)
+		{
+			std::copy(finalTransforms.begin(), finalTransforms.end(), boneTransforms.begin());
+			memcpy(&matrixPalette[(size_t)i * matrixSlotByteSize], boneTransforms.data(), 96 * sizeof(DirectX::XMFLOAT4X4));
+		}
+	}));
+
+	const BonePaletteFormat formats[] = { BonePaletteFormat::Affine3x4, BonePaletteFormat::DualQuaternion };
+	for(BonePaletteFormat format : formats)
+	{
+		const std::string formatName = format == BonePaletteFormat::Affine3x4 ? "3x4" : "dual quaternion";
+		const UINT slotByteSize = BonePalette::SlotByteSize(format, numBones);
+		std::vector<BYTE> palette((size_t)instanceCount * slotByteSize);
+
+		addValue("Bone palette bytes per instance, " + formatName, slotByteSize, "bytes");
+		results.push_back(TimeRate("Bone palette upload, " + formatName + suffix, instanceCount, "instances/s", iterations, [&]()
+		{
+			for(UINT i = 0; i < instanceCount; ++i)
+				BonePalette::Pack(format, finalTransforms.data(), numBones, &palette[(size_t)i * slotByteSize]);
+		}));
+
+		if( format != BonePaletteFormat::DualQuaternion )
+			continue;
+
+		// Skin a few points with the dual quaternions the way Params.hlsl
+		// does and compare with the matrices; only meaningful for unscaled
+		// bones.
+		const DirectX::XMFLOAT3 points[] =
+		{
+			{ 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 2.0f, 3.0f }
+		};
+		const DirectX::XMFLOAT4* dualQuats = reinterpret_cast<const DirectX::XMFLOAT4*>(palette.data());
+		float maxError = 0.0f;
+		for(UINT b = 0; b < numBones; ++b)
+		{
+			DirectX::XMVECTOR real = DirectX::XMLoadFloat4(&dualQuats[2*b]);
+			DirectX::XMVECTOR dual = DirectX::XMLoadFloat4(&dualQuats[2*b + 1]);
+
+			// t = 2 * dual * conjugate(real), argument order as in Pack.
+			DirectX::XMVECTOR translation = DirectX::XMVectorScale(
+				DirectX::XMQuaternionMultiply(DirectX::XMQuaternionConjugate(real), dual), 2.0f);
+			DirectX::XMMATRIX M = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&finalTransforms[b]));
+
+			for(const DirectX::XMFLOAT3& point : points)
+			{
+				DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&point);
+				DirectX::XMVECTOR expected = DirectX::XMVector3Transform(p, M);
+				DirectX::XMVECTOR skinned = DirectX::XMVectorAdd(DirectX::XMVector3Rotate(p, real), translation);
+				DirectX::XMFLOAT3 difference;
+				DirectX::XMStoreFloat3(&difference, DirectX::XMVectorAbs(DirectX::XMVectorSubtract(expected, skinned)));
+				maxError = std::max(maxError, std::max(difference.x, std::max(difference.y, difference.z)));
+			}
+		}
+		addValue("Bone palette dual quaternion error", maxError, "max abs");
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::SubsetPalettes(
+	const std::string& m3dFilename,
+	const std::string& clipName,
+	UINT instanceCount,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	std::vector<M3DLoader::SkinnedVertex> vertices;
+	IndexData indices;
+	std::vector<M3DLoader::Subset> subsets;
+	std::vector<M3DLoader::M3dMaterial> mats;
+	SkinnedData skinInfo;
+	M3DLoader loader;
+	if( !loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) )
+		return results;
+
+	AnimationClipHandle clip = skinInfo.GetClipHandle(clipName);
+	if( !clip.IsValid() )
+		return results;
+
+	// Remap the vertices each subset references the way LoadSkinnedModel
+	// does.  Copies, so vertices shared by two subsets are remapped once for
+	// each.
+	BonePaletteLayout layout;
+	layout.Reset(BonePaletteFormat::Affine3x4);
+	std::vector<std::vector<UINT>> subsetVertexIds(subsets.size());
+	std::vector<std::vector<M3DLoader::SkinnedVertex>> subsetVertices(subsets.size());
+	for(size_t i = 0; i < subsets.size(); ++i)
+	{
+		std::vector<UINT>& ids = subsetVertexIds[i];
+		for(UINT k = subsets[i].FaceStart * 3; k < (subsets[i].FaceStart + subsets[i].FaceCount) * 3; ++k)
+			ids.push_back(indices.Get(k));
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+		for(UINT id : ids)
+			subsetVertices[i].push_back(vertices[id]);
+		if( !layout.AddSubset(subsetVertices[i].data(), (UINT)subsetVertices[i].size()) )
+			return results;
+	}
+
+	const UINT numBones = skinInfo.BoneCount();
+	std::vector<DirectX::XMFLOAT4X4> finalTransforms(numBones);
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	skinInfo.GetFinalTransforms(clip, 0.5f * (clip.StartTime + clip.EndTime), finalTransforms, cursor, scratch);
+
+	std::string suffix = " (" + std::to_string(instanceCount) + " x " + std::to_string(numBones) + " bones, " +
+		std::to_string(subsets.size()) + " subsets)";
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	UINT uploadedBones = 0;
+	for(UINT p = 0; p < layout.PaletteCount(); ++p)
+		uploadedBones += layout.PaletteBoneCount(p);
+
+	const UINT fullSlotByteSize = BonePalette::SlotByteSize(BonePaletteFormat::Affine3x4, numBones);
+	addValue("Bone palette bytes per instance, whole skeleton", fullSlotByteSize, "bytes");
+	addValue("Bone palette bytes per instance, per subset", layout.SlotByteSize(), "bytes");
+	addValue("Bone palette bones uploaded per instance, per subset", uploadedBones, "bones");
+	addValue("Bone palette palettes per instance, per subset", layout.PaletteCount(), "palettes");
+
+	std::vector<BYTE> fullPalette((size_t)instanceCount * fullSlotByteSize);
+	results.push_back(TimeRate("Bone palette upload, whole skeleton" + suffix, instanceCount, "instances/s", iterations, [&]()
+	{
+		for(UINT i = 0; i < instanceCount; ++i)
+			BonePalette::Pack(BonePaletteFormat::Affine3x4, finalTransforms.data(), numBones, &fullPalette[(size_t)i * fullSlotByteSize]);
+	}));
+
+	std::vector<BYTE> subsetPalette((size_t)instanceCount * layout.SlotByteSize());
+	results.push_back(TimeRate("Bone palette upload, per subset" + suffix, instanceCount, "instances/s", iterations, [&]()
+	{
+		for(UINT i = 0; i < instanceCount; ++i)
+			layout.Pack(finalTransforms.data(), &subsetPalette[(size_t)i * layout.SlotByteSize()]);
+	}));
+
+	// Skin every vertex through its subset palette, as the shader now does,
+	// and through the whole skeleton with the original indices.
+	auto skin = [](const M3DLoader::SkinnedVertex& vertex, const DirectX::XMFLOAT4* rows)
+	{
+		const float weights[4] = { vertex.BoneWeights.x, vertex.BoneWeights.y, vertex.BoneWeights.z,
+			1.0f - vertex.BoneWeights.x - vertex.BoneWeights.y - vertex.BoneWeights.z };
+		DirectX::XMFLOAT3 p = { 0.0f, 0.0f, 0.0f };
+		for(UINT i = 0; i < 4; ++i)
+		{
+			const DirectX::XMFLOAT4* r = &rows[vertex.BoneIndices[i] * 3];
+			p.x += weights[i] * (r[0].x * vertex.Pos.x + r[0].y * vertex.Pos.y + r[0].z * vertex.Pos.z + r[0].w);
+			p.y += weights[i] * (r[1].x * vertex.Pos.x + r[1].y * vertex.Pos.y + r[1].z * vertex.Pos.z + r[1].w);
+			p.z += weights[i] * (r[2].x * vertex.Pos.x + r[2].y * vertex.Pos.y + r[2].z * vertex.Pos.z + r[2].w);
+		}
+		return p;
+	};
+
+	const DirectX::XMFLOAT4* fullRows = reinterpret_cast<const DirectX::XMFLOAT4*>(fullPalette.data());
+	float maxError = 0.0f;
+	for(UINT subset = 0; subset < layout.SubsetCount(); ++subset)
+	{
+		UINT palette = layout.SubsetPalette(subset);
+		const DirectX::XMFLOAT4* subsetRows = reinterpret_cast<const DirectX::XMFLOAT4*>(subsetPalette.data() + layout.PaletteOffset(palette));
+		for(size_t k = 0; k < subsetVertexIds[subset].size(); ++k)
+		{
+			DirectX::XMFLOAT3 a = skin(vertices[subsetVertexIds[subset][k]], fullRows);
+			DirectX::XMFLOAT3 b = skin(subsetVertices[subset][k], subsetRows);
+			maxError = std::max(maxError, std::max(std::abs(a.x - b.x), std::max(std::abs(a.y - b.y), std::abs(a.z - b.z))));
+		}
+	}
+	addValue("Bone palette per subset skinning difference", maxError, "max abs");
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::CpuSkinning(
+	const std::string& m3dFilename,
+	const std::string& clipName,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	std::vector<M3DLoader::SkinnedVertex> vertices;
+	IndexData indices;
+	std::vector<M3DLoader::Subset> subsets;
+	std::vector<M3DLoader::M3dMaterial> mats;
+	SkinnedData skinInfo;
+	M3DLoader loader;
+	if( !loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) || vertices.empty() )
+		return results;
+
+	AnimationClipHandle clip = skinInfo.GetClipHandle(clipName);
+	if( !clip.IsValid() )
+		return results;
+
+	const UINT numBones = skinInfo.BoneCount();
+	const UINT numVertices = (UINT)vertices.size();
+	std::vector<DirectX::XMFLOAT4X4> finalTransforms(numBones);
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	skinInfo.GetFinalTransforms(clip, 0.5f * (clip.StartTime + clip.EndTime), finalTransforms, cursor, scratch);
+
+	// position, normal, tangent per vertex
+	auto makeStream = [](std::vector<DirectX::XMFLOAT3>& attributes)
+	{
+		SkinnedStream stream;
+		stream.Positions = &attributes[0];
+		stream.Normals = &attributes[1];
+		stream.Tangents = &attributes[2];
+		stream.Stride = 3 * sizeof(DirectX::XMFLOAT3);
+		return stream;
+	};
+	std::vector<DirectX::XMFLOAT3> reference(3 * (size_t)numVertices);
+	std::vector<DirectX::XMFLOAT3> skinned(3 * (size_t)numVertices);
+
+	std::string suffix = " (" + std::to_string(numVertices) + " vertices, " + clipName + ")";
+	results.push_back(TimeRate("CpuSkinner::SkinReference" + suffix, numVertices, "vertices/s", iterations, [&]()
+	{
+		CpuSkinner::SkinReference(vertices.data(), numVertices, finalTransforms.data(), makeStream(reference));
+	}));
+
+	CpuSkinner serial;
+	results.push_back(TimeRate("CpuSkinner::Skin, serial" + suffix, numVertices, "vertices/s", iterations, [&]()
+	{
+		serial.Skin(vertices.data(), numVertices, finalTransforms.data(), numBones, makeStream(skinned));
+	}));
+
+	auto addError = [&](const std::string& name)
+	{
+		float maxError = 0.0f;
+		for(size_t i = 0; i < skinned.size(); ++i)
+		{
+			maxError = std::max(maxError, std::max(std::abs(reference[i].x - skinned[i].x),
+				std::max(std::abs(reference[i].y - skinned[i].y), std::abs(reference[i].z - skinned[i].z))));
+		}
+
+		Result error;
+		error.Name = name + " difference from reference" + suffix;
+		error.Rate = maxError;
+		error.RateUnit = "max abs";
+		results.push_back(error);
+	};
+	addError("CpuSkinner::Skin, serial");
+
+	if( threadPool != nullptr )
+	{
+		std::fill(skinned.begin(), skinned.end(), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+		CpuSkinner parallel(threadPool);
+		results.push_back(TimeRate("CpuSkinner::Skin, " + std::to_string(threadPool->ThreadCount()) + " threads" + suffix,
+			numVertices, "vertices/s", iterations, [&]()
+		{
+			parallel.Skin(vertices.data(), numVertices, finalTransforms.data(), numBones, makeStream(skinned));
+		}));
+		addError("CpuSkinner::Skin, threaded");
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationBaking(
+	SkinnedData& skinInfo,
+	const std::string& clipName,
+	float sampleRate,
+	BonePaletteFormat format,
+	UINT instanceCount,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	if( format == BonePaletteFormat::DualQuaternion || !skinInfo.GetClipHandle(clipName).IsValid() )
+		return results;
+
+	// A single palette of every bone: one vertex weighted fully to each.
+	const UINT numBones = skinInfo.BoneCount();
+	std::vector<M3DLoader::SkinnedVertex> boneVertices(numBones);
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		boneVertices[b].BoneWeights = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+		std::fill(std::begin(boneVertices[b].BoneIndices), std::end(boneVertices[b].BoneIndices), (BYTE)b);
+	}
+	BonePaletteLayout layout;
+	layout.Reset(format);
+	layout.AddSubset(boneVertices.data(), numBones);
+
+	const std::string formatName = format == BonePaletteFormat::Affine3x4Half ? "half 3x4" : "3x4";
+	char tag[64];
+	snprintf(tag, sizeof(tag), " (%s, %g Hz, ", formatName.c_str(), sampleRate);
+	std::string suffix = tag + clipName + ")";
+
+	AnimationAtlas atlas;
+	results.push_back(TimeRate("AnimationAtlas::AddClip" + suffix, 1, "clips/s", iterations, [&]()
+	{
+		atlas.Reset(layout, sampleRate);
+		atlas.AddClip(skinInfo, clipName, true);
+	}));
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+	addValue("Animation atlas frames", atlas.FrameCount(), "frames");
+	addValue("Animation atlas size", atlas.ByteSize() / 1024.0, "KB");
+
+	// Every baked frame against the pose evaluated at its time.
+	const AnimationAtlas::Clip& clip = atlas.GetClip(0);
+	AnimationClipHandle handle = skinInfo.GetClipHandle(clipName);
+	std::vector<DirectX::XMFLOAT4X4> finalTransforms(numBones);
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	float maxError = 0.0f;
+	for(UINT f = 0; f < clip.NumFrames; ++f)
+	{
+		float t = clip.StartTime + clip.Duration * f / clip.NumFrames;
+		skinInfo.GetFinalTransforms(handle, t, finalTransforms, cursor, scratch);
+
+		const BYTE* frame = atlas.FrameData(atlas.Frame(0, t)) + layout.PaletteOffset(0);
+		for(UINT i = 0; i < numBones; ++i)
+		{
+			const UINT b = layout.PaletteBones(0)[i];
+			for(UINT r = 0; r < 3; ++r)
+			{
+				for(UINT c = 0; c < 4; ++c)
+				{
+					float baked = format == BonePaletteFormat::Affine3x4Half ?
+						DirectX::PackedVector::XMConvertHalfToFloat(reinterpret_cast<const DirectX::PackedVector::HALF*>(frame)[(i*3 + r)*4 + c]) :
+						reinterpret_cast<const float*>(frame)[(i*3 + r)*4 + c];
+					maxError = std::max(maxError, std::abs(baked - finalTransforms[b].m[r][c]));
+				}
+			}
+		}
+	}
+	addValue("Animation atlas final transform error", maxError, "max abs");
+
+	// Per frame CPU cost of a crowd: live poses and palettes against
+	// advancing clocks and choosing frames.
+	const UINT framesPerIteration = 60;
+	const float dt = 1.0f / 60.0f;
+	AnimationSystem live;
+	AnimationSystem baked;
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		float timePos = clip.Duration > 0.0f ? fmodf(i * 0.37f, clip.Duration) : 0.0f;
+		live.AddInstance(&skinInfo, clipName, timePos);
+		baked.AddInstance(&skinInfo, clipName, timePos);
+	}
+	std::vector<BYTE> palette((size_t)instanceCount * layout.SlotByteSize());
+	live.SetPalette(palette.data(), layout);
+	std::vector<UINT> frames(instanceCount);
+
+	std::string crowd = " (" + std::to_string(instanceCount) + " x " + clipName + ")";
+	results.push_back(TimeRate("Crowd update, AnimationSystem::Update" + crowd,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			live.Update(dt);
+	}));
+	results.push_back(TimeRate("Crowd update, AnimationAtlas::Frame, " + formatName + crowd,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			baked.AdvanceTime(dt);
+			for(UINT i = 0; i < instanceCount; ++i)
+				frames[i] = atlas.Frame(0, baked.GetInstance(i)->TimePos);
+		}
+	}));
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationLod(
+	SkinnedData& skinInfo,
+	const std::string& clipName,
+	const AnimationLodPolicy& policy,
+	UINT instanceCount,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	const UINT framesPerIteration = 60;
+	const float dt = 1.0f / 60.0f;
+	const UINT slotByteSize = BonePalette::SlotByteSize(BonePaletteFormat::Affine3x4, skinInfo.BoneCount());
+	const float clipLength = skinInfo.GetClipEndTime(clipName);
+
+	// A soldier sized sphere every 2.5 units; the camera stands in the
+	// third row looking down the crowd.
+	Camera camera;
+	camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+	camera.LookAt(DirectX::XMFLOAT3(11.25f, 1.7f, 5.0f), DirectX::XMFLOAT3(11.25f, 1.0f, 100.0f),
+		DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+	camera.UpdateViewMatrix();
+
+	AnimationSystem full(threadPool);
+	AnimationSystem lod(threadPool);
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		float timePos = clipLength > 0.0f ? fmodf(i * 0.37f, clipLength) : 0.0f;
+		full.AddInstance(&skinInfo, clipName, timePos);
+		lod.AddInstance(&skinInfo, clipName, timePos);
+
+		DirectX::BoundingSphere bounds;
+		bounds.Center = DirectX::XMFLOAT3((i % 10) * 2.5f, 1.0f, (i / 10) * 2.5f);
+		bounds.Radius = 1.2f;
+		full.GetInstance(i)->Bounds = bounds;
+		lod.GetInstance(i)->Bounds = bounds;
+	}
+
+	std::vector<BYTE> fullPalette((size_t)instanceCount * slotByteSize);
+	std::vector<BYTE> lodPalette((size_t)instanceCount * slotByteSize);
+	full.SetPalette(fullPalette.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+	lod.SetPalette(lodPalette.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+	lod.EnableLod(policy);
+	lod.SetLodView(camera);
+
+	std::string suffix = " (" + std::to_string(instanceCount) + " x " + clipName + ")";
+	results.push_back(TimeRate("AnimationSystem::Update, full detail" + suffix,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			full.Update(dt);
+	}));
+
+	results.push_back(TimeRate("AnimationSystem::Update, level of detail" + suffix,
+		(double)instanceCount * framesPerIteration, "instances/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+			lod.Update(dt);
+	}));
+
+	const AnimationLodStats& stats = lod.GetLodStats();
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = "AnimationSystem level of detail, " + name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+	addValue("bones evaluated", (double)stats.BonesEvaluated, "bones/frame");
+	addValue("bones skipped", (double)stats.BonesSkipped, "bones/frame");
+	addValue("instances evaluated", stats.Evaluated, "instances/frame");
+	addValue("instances extrapolated", stats.Extrapolated, "instances/frame");
+	addValue("instances culled", stats.Culled, "instances/frame");
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationPipelining(
+	SkinnedData& skinInfo,
+	const std::string& clipName,
+	UINT instanceCount,
+	double recordMs,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	const UINT framesPerIteration = 60;
+	const float dt = 1.0f / 60.0f;
+	const UINT slotByteSize = BonePalette::SlotByteSize(BonePaletteFormat::Affine3x4, skinInfo.BoneCount());
+	const size_t paletteByteSize = (size_t)instanceCount * slotByteSize;
+	const float clipLength = skinInfo.GetClipEndTime(clipName);
+
+	AnimationSystem synchronous(threadPool);
+	AnimationSystem pipelined(threadPool);
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		float timePos = clipLength > 0.0f ? fmodf(i * 0.37f, clipLength) : 0.0f;
+		synchronous.AddInstance(&skinInfo, clipName, timePos);
+		pipelined.AddInstance(&skinInfo, clipName, timePos);
+	}
+
+	std::vector<BYTE> synchronousPalette(paletteByteSize);
+	std::vector<BYTE> pipelinedPalettes(2 * paletteByteSize);
+	synchronous.SetPalette(synchronousPalette.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+	pipelined.SetPalette(pipelinedPalettes.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+
+	AnimationPipeline pipeline(&pipelined, threadPool);
+	pipeline.SetPalettes(pipelinedPalettes.data(), pipelinedPalettes.data() + paletteByteSize);
+
+	auto record = [recordMs]()
+	{
+		auto end = Clock::now() + std::chrono::duration<double, std::milli>(recordMs);
+		while( Clock::now() < end )
+			;
+	};
+
+	// Both start from the pose at their initial times.
+	synchronous.Update(0.0f);
+	pipeline.Fetch();
+
+	double synchronousSeconds = 0.0;
+	double pipelinedSeconds = 0.0;
+
+	std::string suffix = " (" + std::to_string(instanceCount) + " x " + clipName + ", " +
+		std::to_string((int)(recordMs * 1000.0)) + " us recording)";
+	results.push_back(TimeRate("Frame, animation before recording" + suffix,
+		framesPerIteration, "frames/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			auto start = Clock::now();
+			synchronous.Update(dt);
+			synchronousSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			record();
+		}
+	}));
+
+	results.push_back(TimeRate("Frame, AnimationPipeline one frame ahead" + suffix,
+		framesPerIteration, "frames/s", iterations, [&]()
+	{
+		for(UINT frame = 0; frame < framesPerIteration; ++frame)
+		{
+			auto start = Clock::now();
+			pipeline.Fetch();
+			pipeline.Publish(dt);
+			pipelinedSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			record();
+		}
+	}));
+
+	// The pipeline is a frame ahead; its last published frame is the one
+	// the synchronous system has just computed.
+	UINT current = pipeline.Fetch();
+	const BYTE* pipelinedPalette = pipelinedPalettes.data() + current * paletteByteSize;
+	UINT mismatches = 0;
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		if( memcmp(&synchronousPalette[(size_t)i * slotByteSize], &pipelinedPalette[(size_t)i * slotByteSize], slotByteSize) != 0 )
+			++mismatches;
+	}
+
+	const double frames = (double)framesPerIteration * iterations;
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+	addValue("Main thread animation time, before recording", synchronousSeconds * 1.0e6 / frames, "us/frame");
+	addValue("Main thread animation time, AnimationPipeline", pipelinedSeconds * 1.0e6 / frames, "us/frame");
+	addValue("AnimationPipeline, slots differing from synchronous", mismatches, "slots");
+	results.back().Failed = mismatches != 0;
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::SkinnedBounds(
+	const std::string& m3dFilename,
+	const std::string& clipName,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	std::vector<M3DLoader::SkinnedVertex> vertices;
+	IndexData indices;
+	std::vector<M3DLoader::Subset> subsets;
+	std::vector<M3DLoader::M3dMaterial> mats;
+	SkinnedData skinInfo;
+	M3DLoader loader;
+	if( !loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) || vertices.empty() )
+		return results;
+
+	AnimationClipHandle clip = skinInfo.GetClipHandle(clipName);
+	if( !clip.IsValid() )
+		return results;
+
+	const UINT numBones = skinInfo.BoneCount();
+	const UINT numVertices = (UINT)vertices.size();
+	const UINT numPoses = 30;
+
+	BoneBounds boneBounds;
+	boneBounds.Reset(numBones);
+	boneBounds.AddVertices(vertices.data(), numVertices);
+
+	std::vector<std::vector<DirectX::XMFLOAT4X4>> poses(numPoses, std::vector<DirectX::XMFLOAT4X4>(numBones));
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	for(UINT i = 0; i < numPoses; ++i)
+	{
+		float t = clip.StartTime + (clip.EndTime - clip.StartTime) * i / (numPoses - 1);
+		skinInfo.GetFinalTransforms(clip, t, poses[i], cursor, scratch);
+	}
+
+	std::vector<DirectX::BoundingBox> boneBoxes(numPoses);
+	std::vector<DirectX::BoundingBox> skinnedBoxes(numPoses);
+	std::vector<DirectX::XMFLOAT3> positions(numVertices);
+	SkinnedStream stream;
+	stream.Positions = positions.data();
+
+	std::string suffix = " (" + std::to_string(numVertices) + " vertices, " + std::to_string(numBones) + " bones, " + clipName + ")";
+	results.push_back(TimeRate("BoneBounds::ComputeBounds" + suffix, numPoses, "poses/s", iterations, [&]()
+	{
+		for(UINT i = 0; i < numPoses; ++i)
+			boneBounds.ComputeBounds(poses[i].data(), boneBoxes[i]);
+	}));
+
+	results.push_back(TimeRate("Skinned vertex bounds" + suffix, numPoses, "poses/s", iterations, [&]()
+	{
+		for(UINT i = 0; i < numPoses; ++i)
+		{
+			CpuSkinner::SkinReference(vertices.data(), numVertices, poses[i].data(), stream);
+			DirectX::BoundingBox::CreateFromPoints(skinnedBoxes[i], numVertices, positions.data(), sizeof(DirectX::XMFLOAT3));
+		}
+	}));
+
+	// Skin each pose once more to check the boxes against every vertex.
+	UINT outside = 0;
+	double volumeRatio = 0.0;
+	for(UINT i = 0; i < numPoses; ++i)
+	{
+		CpuSkinner::SkinReference(vertices.data(), numVertices, poses[i].data(), stream);
+
+		const DirectX::BoundingBox& box = boneBoxes[i];
+		const float tolerance = 1e-3f * std::max(box.Extents.x, std::max(box.Extents.y, box.Extents.z));
+		for(const DirectX::XMFLOAT3& p : positions)
+		{
+			if( std::abs(p.x - box.Center.x) > box.Extents.x + tolerance ||
+				std::abs(p.y - box.Center.y) > box.Extents.y + tolerance ||
+				std::abs(p.z - box.Center.z) > box.Extents.z + tolerance )
+				++outside;
+		}
+
+		const DirectX::BoundingBox& tight = skinnedBoxes[i];
+		double tightVolume = (double)tight.Extents.x * tight.Extents.y * tight.Extents.z;
+		if( tightVolume > 0.0 )
+			volumeRatio += (double)box.Extents.x * box.Extents.y * box.Extents.z / tightVolume;
+	}
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name + suffix;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+	addValue("BoneBounds, skinned vertices outside", outside, "vertices");
+	results.back().Failed = outside != 0;
+	addValue("BoneBounds, volume over skinned vertex box", volumeRatio / numPoses, "x");
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::BoneConcatenation(
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	const UINT boneCounts[] = { 58, 128, 256 };
+	const UINT numPoses = 64;
+
+	std::mt19937 rng(19);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	auto randomTransform = [&]()
+	{
+		DirectX::XMVECTOR q = DirectX::XMQuaternionNormalize(DirectX::XMVectorSet(offset(rng), offset(rng), offset(rng), offset(rng)));
+		DirectX::XMMATRIX R = DirectX::XMMatrixRotationQuaternion(q);
+		DirectX::XMMATRIX T = DirectX::XMMatrixTranslation(offset(rng), offset(rng), offset(rng));
+		DirectX::XMFLOAT4X4 M;
+		DirectX::XMStoreFloat4x4(&M, DirectX::XMMatrixMultiply(R, T));
+		return M;
+	};
+
+	for(UINT numBones : boneCounts)
+	{
+		// Short chains branching off earlier bones, like limbs off a spine.
+		std::vector<int> hierarchy(numBones);
+		hierarchy[0] = -1;
+		for(UINT i = 1; i < numBones; ++i)
+			hierarchy[i] = i % 4 == 1 ? (int)(rng() % i) : (int)i - 1;
+
+		std::vector<DirectX::XMFLOAT4X4> boneOffsets(numBones);
+		std::vector<DirectX::XMMATRIX> offsetMatrices(numBones);
+		for(UINT i = 0; i < numBones; ++i)
+		{
+			boneOffsets[i] = randomTransform();
+			offsetMatrices[i] = DirectX::XMLoadFloat4x4(&boneOffsets[i]);
+		}
+
+		std::vector<std::vector<DirectX::XMFLOAT4X4>> poses(numPoses, std::vector<DirectX::XMFLOAT4X4>(numBones));
+		for(std::vector<DirectX::XMFLOAT4X4>& pose : poses)
+		{
+			for(DirectX::XMFLOAT4X4& M : pose)
+				M = randomTransform();
+		}
+
+		std::vector<DirectX::XMFLOAT4X4> legacyToRoot(numBones);
+		std::vector<DirectX::XMMATRIX> toRoot(numBones);
+		std::vector<std::vector<DirectX::XMFLOAT4X4>> legacyFinal(numPoses, std::vector<DirectX::XMFLOAT4X4>(numBones));
+		std::vector<std::vector<DirectX::XMFLOAT4X4>> fusedFinal(numPoses, std::vector<DirectX::XMFLOAT4X4>(numBones));
+
+		std::string suffix = " (" + std::to_string(numBones) + " bones)";
+		results.push_back(TimeRate("Two loop concatenation" + suffix, (double)numPoses * numBones, "bones/s", iterations, [&]()
+		{
+			for(UINT p = 0; p < numPoses; ++p)
+			{
+				const std::vector<DirectX::XMFLOAT4X4>& toParent = poses[p];
+				legacyToRoot[0] = toParent[0];
+				for(UINT i = 1; i < numBones; ++i)
+				{
+					DirectX::XMMATRIX parentToRoot = DirectX::XMLoadFloat4x4(&legacyToRoot[hierarchy[i]]);
+					DirectX::XMStoreFloat4x4(&legacyToRoot[i],
+						DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&toParent[i]), parentToRoot));
+				}
+
+				for(UINT i = 0; i < numBones; ++i)
+				{
+					DirectX::XMMATRIX finalTransform = DirectX::XMMatrixMultiply(
+						DirectX::XMLoadFloat4x4(&boneOffsets[i]), DirectX::XMLoadFloat4x4(&legacyToRoot[i]));
+					DirectX::XMStoreFloat4x4(&legacyFinal[p][i], DirectX::XMMatrixTranspose(finalTransform));
+				}
+			}
+		}));
+
+		results.push_back(TimeRate("SkinnedData::ConcatenateTransforms" + suffix, (double)numPoses * numBones, "bones/s", iterations, [&]()
+		{
+			for(UINT p = 0; p < numPoses; ++p)
+			{
+				SkinnedData::ConcatenateTransforms(hierarchy.data(), offsetMatrices.data(), poses[p].data(),
+					toRoot.data(), fusedFinal[p].data(), numBones);
+			}
+		}));
+
+		float maxDifference = 0.0f;
+		for(UINT p = 0; p < numPoses; ++p)
+		{
+			for(UINT i = 0; i < numBones; ++i)
+			{
+				for(UINT r = 0; r < 4; ++r)
+				{
+					for(UINT c = 0; c < 4; ++c)
+						maxDifference = std::max(maxDifference, std::abs(legacyFinal[p][i].m[r][c] - fusedFinal[p][i].m[r][c]));
+				}
+			}
+		}
+
+		Result difference;
+		difference.Name = "ConcatenateTransforms, largest difference from two loops" + suffix;
+		difference.Rate = maxDifference;
+		results.push_back(difference);
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::GeometrySubdivision(
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	auto measure = [&](const std::string& name, std::function<GeometryGenerator::MeshData()> create)
+	{
+		GeometryGenerator::MeshData mesh = create();
+		const size_t numTriangles = mesh.Indices32.size() / 3;
+
+		results.push_back(TimeRate(name, (double)numTriangles, "triangles/s", iterations, [&]()
+		{
+			mesh = create();
+		}));
+
+		addValue(name + ", vertices", (double)mesh.Vertices.size(), "vertices");
+		addValue(name + ", vertices without shared midpoints", numTriangles * 6.0 / 4.0, "vertices");
+	};
+
+	GeometryGenerator geoGen;
+	measure("GeometryGenerator::CreateBox (3 subdivisions)", [&]() { return geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3); });
+	for(UINT subdivisions = 1; subdivisions <= 6; ++subdivisions)
+	{
+		measure("GeometryGenerator::CreateGeosphere (" + std::to_string(subdivisions) + " subdivisions)",
+			[&]() { return geoGen.CreateGeosphere(0.5f, subdivisions); });
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::GeometryGeneration(
+	UINT gridSize,
+	UINT ringSize,
+	UINT iterations,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+	GeometryGenerator serialGen;
+	GeometryGenerator parallelGen(threadPool);
+
+	// Each mesh is released before the next is made; a 4096 x 4096 grid is
+	// over a gigabyte.
+	auto measure = [&](const std::string& name, double numVertices, std::function<void(GeometryGenerator::MeshData&)> create)
+	{
+		results.push_back(TimeRate(name, numVertices, "vertices/s", iterations, [&]()
+		{
+			GeometryGenerator::MeshData mesh;
+			create(mesh);
+		}));
+	};
+
+	std::string threads = " (" + std::to_string(threadPool != nullptr ? threadPool->ThreadCount() : 1) + " threads)";
+
+	std::string grid = " (" + std::to_string(gridSize) + "x" + std::to_string(gridSize) + ")";
+	double gridVertices = (double)gridSize * gridSize;
+	measure("Former CreateGrid" + grid, gridVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		LegacyCreateGrid(1000.0f, 1000.0f, gridSize, gridSize, mesh);
+	});
+	measure("GeometryGenerator::CreateGrid" + grid, gridVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		mesh = serialGen.CreateGrid(1000.0f, 1000.0f, gridSize, gridSize);
+	});
+	measure("GeometryGenerator::CreateGrid" + grid + threads, gridVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		mesh = parallelGen.CreateGrid(1000.0f, 1000.0f, gridSize, gridSize);
+	});
+
+	std::string rings = " (" + std::to_string(ringSize) + " slices, " + std::to_string(ringSize) + " stacks)";
+	double sphereVertices = (double)(ringSize - 1) * (ringSize + 1) + 2;
+	double cylinderVertices = (double)(ringSize + 1) * (ringSize + 1) + 2.0 * (ringSize + 2);
+	measure("Former CreateSphere" + rings, sphereVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		LegacyCreateSphere(1.0f, ringSize, ringSize, mesh);
+	});
+	measure("GeometryGenerator::CreateSphere" + rings, sphereVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		mesh = serialGen.CreateSphere(1.0f, ringSize, ringSize);
+	});
+	measure("GeometryGenerator::CreateSphere" + rings + threads, sphereVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		mesh = parallelGen.CreateSphere(1.0f, ringSize, ringSize);
+	});
+
+	measure("GeometryGenerator::CreateCylinder" + rings, cylinderVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		mesh = serialGen.CreateCylinder(1.0f, 0.5f, 2.0f, ringSize, ringSize);
+	});
+	measure("GeometryGenerator::CreateCylinder" + rings + threads, cylinderVertices, [&](GeometryGenerator::MeshData& mesh)
+	{
+		mesh = parallelGen.CreateCylinder(1.0f, 0.5f, 2.0f, ringSize, ringSize);
+	});
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::MeshOptimization(
+	const std::string& m3dFilename,
+	const std::string& txtFilename,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	// Each iteration optimizes a fresh copy of the loaded mesh.
+	auto measure = [&](const std::string& name, const void* vertices, UINT vertexStride, UINT positionOffset,
+		UINT numVertices, const std::vector<UINT>& indices, const std::vector<M3DLoader::Subset>& subsets)
+	{
+		const BYTE* vertexBytes = static_cast<const BYTE*>(vertices);
+		std::vector<BYTE> vertexCopy;
+		std::vector<UINT> indexCopy;
+		std::vector<M3DLoader::Subset> subsetCopy;
+		MeshOptimizationStats stats;
+
+		results.push_back(TimeRate("MeshOptimizer::Optimize (" + name + ")", indices.size() / 3.0, "triangles/s", iterations, [&]()
+		{
+			vertexCopy.assign(vertexBytes, vertexBytes + (size_t)numVertices * vertexStride);
+			indexCopy = indices;
+			subsetCopy = subsets;
+			MeshOptimizer::Optimize(vertexCopy.data(), vertexStride, positionOffset, numVertices,
+				indexCopy.data(), (UINT)indexCopy.size(), subsetCopy.empty() ? nullptr : &subsetCopy, &stats);
+		}));
+
+		addValue(name + ", ACMR before", stats.Before.Acmr(), "vertices/triangle");
+		addValue(name + ", ACMR after", stats.After.Acmr(), "vertices/triangle");
+		addValue(name + ", ATVR before", stats.Before.Atvr(), "transforms/vertex");
+		addValue(name + ", ATVR after", stats.After.Atvr(), "transforms/vertex");
+		addValue(name + ", overdraw before", stats.OverdrawBefore.Overdraw(), "shaded/covered pixel");
+		addValue(name + ", overdraw after", stats.OverdrawAfter.Overdraw(), "shaded/covered pixel");
+	};
+
+	auto toUint = [](const IndexData& indices)
+	{
+		std::vector<UINT> result(indices.Count());
+		for(UINT i = 0; i < indices.Count(); ++i)
+			result[i] = indices.Get(i);
+		return result;
+	};
+
+	{
+		std::vector<TxtModelLoader::Vertex> vertices;
+		IndexData indices;
+		TxtModelLoader loader;
+		if( loader.LoadTxtModel(txtFilename, vertices, indices) )
+		{
+			measure(txtFilename, vertices.data(), sizeof(TxtModelLoader::Vertex), offsetof(TxtModelLoader::Vertex, Pos),
+				(UINT)vertices.size(), toUint(indices), {});
+		}
+	}
+
+	{
+		std::vector<M3DLoader::SkinnedVertex> vertices;
+		IndexData indices;
+		std::vector<M3DLoader::Subset> subsets;
+		std::vector<M3DLoader::M3dMaterial> mats;
+		SkinnedData skinInfo;
+		M3DLoader loader;
+		if( loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) )
+		{
+			measure(m3dFilename, vertices.data(), sizeof(M3DLoader::SkinnedVertex), offsetof(M3DLoader::SkinnedVertex, Pos),
+				(UINT)vertices.size(), toUint(indices), subsets);
+		}
+	}
+
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 64, 64);
+	measure("sphere, 64 slices and stacks", sphere.Vertices.data(), sizeof(GeometryGenerator::Vertex),
+		offsetof(GeometryGenerator::Vertex, Position), (UINT)sphere.Vertices.size(), sphere.Indices32, {});
+
+	GeometryGenerator::MeshData geosphere = geoGen.CreateGeosphere(0.5f, 5);
+	measure("geosphere, 5 subdivisions", geosphere.Vertices.data(), sizeof(GeometryGenerator::Vertex),
+		offsetof(GeometryGenerator::Vertex, Position), (UINT)geosphere.Vertices.size(), geosphere.Indices32, {});
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::MeshSimplification(
+	const std::string& m3dFilename,
+	const std::string& txtFilename,
+	const std::vector<float>& ratios,
+	UINT iterations)
+{
+	std::vector<Result> results;
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	auto measure = [&](const std::string& name, const MeshSimplifier::VertexLayout& layout, const std::vector<UINT>& indices)
+	{
+		std::vector<UINT> chain;
+		std::vector<MeshLod> lods;
+		results.push_back(TimeRate("MeshSimplifier::BuildLodChain (" + name + ")", indices.size() / 3.0, "triangles/s", iterations, [&]()
+		{
+			MeshSimplifier::BuildLodChain(layout, indices.data(), (UINT)indices.size(), ratios, chain, lods);
+		}));
+
+		for(size_t lod = 1; lod < lods.size(); ++lod)
+		{
+			std::string lodName = name + ", LOD " + std::to_string(lod);
+			addValue(lodName + " triangles", lods[lod].IndexCount / 3.0, "triangles");
+			addValue(lodName + " error", lods[lod].Error, "model units");
+		}
+	};
+
+	auto toUint = [](const IndexData& indices, UINT first, UINT count)
+	{
+		std::vector<UINT> result(count);
+		for(UINT i = 0; i < count; ++i)
+			result[i] = indices.Get(first + i);
+		return result;
+	};
+
+	{
+		std::vector<TxtModelLoader::Vertex> vertices;
+		IndexData indices;
+		TxtModelLoader loader;
+		if( loader.LoadTxtModel(txtFilename, vertices, indices) )
+		{
+			MeshSimplifier::VertexLayout layout;
+			layout.Vertices = vertices.data();
+			layout.VertexStride = sizeof(TxtModelLoader::Vertex);
+			layout.NumVertices = (UINT)vertices.size();
+			layout.PositionOffset = offsetof(TxtModelLoader::Vertex, Pos);
+			layout.NormalOffset = offsetof(TxtModelLoader::Vertex, Normal);
+			measure(txtFilename, layout, toUint(indices, 0, indices.Count()));
+		}
+	}
+
+	{
+		std::vector<M3DLoader::SkinnedVertex> vertices;
+		IndexData indices;
+		std::vector<M3DLoader::Subset> subsets;
+		std::vector<M3DLoader::M3dMaterial> mats;
+		SkinnedData skinInfo;
+		M3DLoader loader;
+		if( loader.LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) )
+		{
+			MeshSimplifier::VertexLayout layout;
+			layout.Vertices = vertices.data();
+			layout.VertexStride = sizeof(M3DLoader::SkinnedVertex);
+			layout.NumVertices = (UINT)vertices.size();
+			layout.PositionOffset = offsetof(M3DLoader::SkinnedVertex, Pos);
+			layout.NormalOffset = offsetof(M3DLoader::SkinnedVertex, Normal);
+			layout.TexCOffset = offsetof(M3DLoader::SkinnedVertex, TexC);
+			layout.BoneWeightsOffset = offsetof(M3DLoader::SkinnedVertex, BoneWeights);
+			layout.BoneIndicesOffset = offsetof(M3DLoader::SkinnedVertex, BoneIndices);
+
+			for(const M3DLoader::Subset& subset : subsets)
+			{
+				measure(m3dFilename + " subset " + std::to_string(subset.Id), layout,
+					toUint(indices, subset.FaceStart * 3, subset.FaceCount * 3));
+			}
+		}
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::MeshletCulling(const std::string& txtFilename, UINT iterations)
+{
+	std::vector<Result> results;
+
+	std::vector<TxtModelLoader::Vertex> vertices;
+	IndexData indices;
+	TxtModelLoader loader;
+	if( !loader.LoadTxtModel(txtFilename, vertices, indices) )
+		return results;
+
+	MeshOptimizer::Optimize(vertices.data(), sizeof(TxtModelLoader::Vertex),
+		offsetof(TxtModelLoader::Vertex, Pos), (UINT)vertices.size(), indices);
+
+	std::vector<UINT> original(indices.Count());
+	for(UINT i = 0; i < indices.Count(); ++i)
+		original[i] = indices.Get(i);
+	const UINT triangleCount = (UINT)original.size() / 3;
+
+	std::vector<UINT> clustered;
+	std::vector<Meshlet> clusteredMeshlets;
+	results.push_back(TimeRate("MeshletBuilder::Build (" + txtFilename + ")", triangleCount, "triangles/s", iterations, [&]()
+	{
+		clustered = original;
+		MeshletBuilder::Build(vertices.data(), sizeof(TxtModelLoader::Vertex), offsetof(TxtModelLoader::Vertex, Pos),
+			(UINT)vertices.size(), clustered.data(), (UINT)clustered.size(), clusteredMeshlets);
+	}));
+
+	// The scene's meshlets, over the optimized order.
+	std::vector<Meshlet> meshlets;
+	results.push_back(TimeRate("MeshletBuilder::BuildInOrder (" + txtFilename + ")", triangleCount, "triangles/s", iterations, [&]()
+	{
+		MeshletBuilder::BuildInOrder(vertices.data(), sizeof(TxtModelLoader::Vertex), offsetof(TxtModelLoader::Vertex, Pos),
+			(UINT)vertices.size(), original.data(), (UINT)original.size(), meshlets);
+	}));
+
+	auto addValue = [&](const std::string& name, double value, const std::string& unit)
+	{
+		Result result;
+		result.Name = name;
+		result.Rate = value;
+		result.RateUnit = unit;
+		results.push_back(result);
+	};
+
+	addValue(txtFilename + ", meshlets, Build", (double)clusteredMeshlets.size(), "meshlets");
+	addValue(txtFilename + ", meshlets, BuildInOrder", (double)meshlets.size(), "meshlets");
+	addValue(txtFilename + ", ACMR optimized", MeshOptimizer::AnalyzeVertexCache(original.data(),
+		(UINT)original.size(), (UINT)vertices.size()).Acmr(), "vertices/triangle");
+	addValue(txtFilename + ", ACMR after Build", MeshOptimizer::AnalyzeVertexCache(clustered.data(),
+		(UINT)clustered.size(), (UINT)vertices.size()).Acmr(), "vertices/triangle");
+
+	// The skull's world matrix in InitDirect3DApp::BuildRenderItems.
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixMultiply(
+		DirectX::XMMatrixScaling(0.5f, 0.5f, 0.5f), DirectX::XMMatrixTranslation(0.0f, 1.0f, 0.0f)));
+
+	struct Viewpoint
+	{
+		const char* Name;
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Target;
+	};
+	const Viewpoint viewpoints[] =
+	{
+		{ "start",        DirectX::XMFLOAT3(0.0f, 2.0f, -15.0f),   DirectX::XMFLOAT3(0.0f, 2.0f, 0.0f) },
+		{ "front",        DirectX::XMFLOAT3(0.0f, 1.0f, -8.0f),    DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ "back",         DirectX::XMFLOAT3(0.0f, 1.0f, 8.0f),     DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ "side",         DirectX::XMFLOAT3(8.0f, 1.0f, 0.0f),     DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ "above",        DirectX::XMFLOAT3(0.0f, 9.0f, -0.01f),   DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ "close-up",     DirectX::XMFLOAT3(0.0f, 1.5f, -2.5f),    DirectX::XMFLOAT3(0.0f, 1.5f, 0.0f) },
+		{ "looking away", DirectX::XMFLOAT3(0.0f, 1.0f, -8.0f),    DirectX::XMFLOAT3(0.0f, 1.0f, -16.0f) },
+	};
+
+	// Vertex shader invocations of the draws, with the cache starting empty
+	// for each, as a measure of the vertex work culling saves or costs.
+	const UINT unculledInvocations = MeshOptimizer::AnalyzeVertexCache(original.data(),
+		(UINT)original.size(), (UINT)vertices.size()).Transforms;
+	auto invocations = [&](const std::vector<UINT>& drawIndices, const std::vector<MeshletDraw>& meshletDraws)
+	{
+		UINT transforms = 0;
+		for(const MeshletDraw& draw : meshletDraws)
+		{
+			transforms += MeshOptimizer::AnalyzeVertexCache(drawIndices.data() + draw.StartIndexLocation,
+				draw.IndexCount, (UINT)vertices.size()).Transforms;
+		}
+		return transforms;
+	};
+	addValue(txtFilename + ", vertex shader invocations without culling", unculledInvocations, "vertices");
+
+	std::vector<MeshletDraw> draws;
+	std::vector<MeshletDraw> clusteredDraws;
+	for(const Viewpoint& viewpoint : viewpoints)
+	{
+		Camera camera;
+		camera.SetLens(0.25f * MathHelper::Pi, 800.0f / 600.0f, 1.0f, 1000.0f);
+		camera.LookAt(viewpoint.Position, viewpoint.Target, DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+		camera.UpdateViewMatrix();
+
+		const std::string name = std::string("MeshletCuller::Cull (") + viewpoint.Name + ")";
+		results.push_back(TimeRate(name, (double)meshlets.size(), "meshlets/s", iterations, [&]()
+		{
+			draws.clear();
+			MeshletCuller::Cull(meshlets, camera, world, 0, draws);
+		}));
+
+		MeshletCullStats stats;
+		draws.clear();
+		MeshletCuller::Cull(meshlets, camera, world, 0, draws, &stats);
+		addValue(name + " surviving triangles", stats.VisibleTriangles, "of " + std::to_string(stats.Triangles));
+		addValue(name + " frustum culled", stats.FrustumCulled, "meshlets");
+		addValue(name + " backface culled", stats.BackfaceCulled, "meshlets");
+		addValue(name + " draws", (double)draws.size(), "draws");
+		addValue(name + " vertex shader invocations", invocations(original, draws), "vertices");
+
+		clusteredDraws.clear();
+		MeshletCuller::Cull(clusteredMeshlets, camera, world, 0, clusteredDraws);
+		addValue(name + " vertex shader invocations, Build", invocations(clustered, clusteredDraws), "vertices");
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::Result> Benchmarks::AnimationAllocations(
+	SkinnedData& skinInfo,
+	const BoneBounds& boneBounds,
+	const std::string& clipName,
+	const AnimationLodPolicy& policy,
+	UINT instanceCount,
+	UINT frames,
+	ThreadPool* threadPool)
+{
+	std::vector<Result> results;
+
+#if defined(RUN_BENCHMARKS)
+	const float dt = 1.0f / 60.0f;
+	const UINT warmUpFrames = 60;
+	const UINT slotByteSize = BonePalette::SlotByteSize(BonePaletteFormat::Affine3x4, skinInfo.BoneCount());
+	const float clipLength = skinInfo.GetClipEndTime(clipName);
+	std::string suffix = " (" + clipName + ")";
+
+	// Runs frame() warmUpFrames times to size every buffer it grows, then
+	// counts the allocations of frames more.  Threads the frame hands work
+	// to are counted too, as the counter is global.
+	auto countFrames = [&](const std::string& name, const std::function<void()>& frame)
+	{
+		for(UINT i = 0; i < warmUpFrames; ++i)
+			frame();
+
+		size_t allocationsBefore = gAllocationCount.load();
+		auto start = Clock::now();
+		for(UINT i = 0; i < frames; ++i)
+			frame();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		size_t allocations = gAllocationCount.load() - allocationsBefore;
+
+		Result result;
+		result.Name = name + " allocations" + suffix;
+		result.Milliseconds = frames > 0 ? seconds * 1000.0 / frames : 0.0;
+		result.Rate = frames > 0 ? (double)allocations / frames : 0.0;
+		result.RateUnit = "allocs/frame";
+		result.Failed = allocations != 0;
+		results.push_back(result);
+	};
+
+	AnimationClipHandle clip = skinInfo.GetClipHandle(clipName);
+	std::vector<DirectX::XMFLOAT4X4> finalTransforms(skinInfo.BoneCount());
+	AnimationCursor cursor;
+	AnimationScratch scratch;
+	float t = 0.0f;
+	countFrames("SkinnedData::GetFinalTransforms", [&]()
+	{
+		t = t + dt > clip.EndTime ? 0.0f : t + dt;
+		skinInfo.GetFinalTransforms(clip, t, finalTransforms, cursor, scratch);
+	});
+
+	SkinnedModelInstance instance;
+	instance.SkinnedInfo = &skinInfo;
+	instance.FinalTransforms.resize(skinInfo.BoneCount());
+	instance.SetClip(clipName);
+	countFrames("SkinnedModelInstance::UpdateSkinnedAnimation", [&]()
+	{
+		instance.UpdateSkinnedAnimation(dt);
+	});
+
+	// A crowd set up as the scene's: a palette, pose bounds and level of
+	// detail from a camera inside it, so some instances are extrapolated
+	// and some culled.
+	Camera camera;
+	camera.SetLens(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+	camera.LookAt(DirectX::XMFLOAT3(11.25f, 1.7f, 5.0f), DirectX::XMFLOAT3(11.25f, 1.0f, 100.0f),
+		DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+	camera.UpdateViewMatrix();
+
+	auto setUpCrowd = [&](AnimationSystem& system, std::vector<BYTE>& palette)
+	{
+		for(UINT i = 0; i < instanceCount; ++i)
+		{
+			float timePos = clipLength > 0.0f ? fmodf(i * 0.37f, clipLength) : 0.0f;
+			system.AddInstance(&skinInfo, clipName, timePos);
+
+			DirectX::BoundingSphere bounds;
+			bounds.Center = DirectX::XMFLOAT3((i % 10) * 2.5f, 1.0f, (i / 10) * 2.5f);
+			bounds.Radius = 1.2f;
+			system.GetInstance(i)->Bounds = bounds;
+		}
+
+		palette.resize((size_t)instanceCount * slotByteSize);
+		system.SetPalette(palette.data(), slotByteSize, BonePaletteFormat::Affine3x4);
+		system.SetBoneBounds(&boneBounds);
+		system.EnableLod(policy);
+	};
+
+	std::string crowd = " x " + std::to_string(instanceCount);
+
+	AnimationSystem serial(nullptr);
+	std::vector<BYTE> serialPalette;
+	setUpCrowd(serial, serialPalette);
+	countFrames("AnimationSystem::Update" + crowd, [&]()
+	{
+		serial.SetLodView(camera);
+		serial.Update(dt);
+	});
+
+	if( threadPool != nullptr )
+	{
+		AnimationSystem pooled(threadPool);
+		std::vector<BYTE> pooledPalette;
+		setUpCrowd(pooled, pooledPalette);
+		countFrames("AnimationSystem::Update, thread pool" + crowd, [&]()
+		{
+			pooled.SetLodView(camera);
+			pooled.Update(dt);
+		});
+
+		AnimationSystem pipelined(threadPool);
+		std::vector<BYTE> pipelinedPalettes[2];
+		setUpCrowd(pipelined, pipelinedPalettes[0]);
+		pipelinedPalettes[1].resize(pipelinedPalettes[0].size());
+		AnimationPipeline pipeline(&pipelined, threadPool);
+		pipeline.SetPalettes(pipelinedPalettes[0].data(), pipelinedPalettes[1].data());
+		countFrames("AnimationPipeline" + crowd, [&]()
+		{
+			pipeline.Fetch();
+			pipelined.SetLodView(camera);
+			pipeline.Publish(dt);
+		});
+	}
+#endif
+
+	return results;
+}
+
+bool Benchmarks::Log(const std::vector<Result>& results)
+{
+	bool passed = true;
+	for(const Result& r : results)
+	{
+		char line[512];
+		snprintf(line, sizeof(line), "[Benchmark] %-60s %10.3f ms %12.4f %s%s\n",
+			r.Name.c_str(), r.Milliseconds, r.Rate, r.RateUnit.c_str(), r.Failed ? "  FAILED" : "");
+		OutputDebugStringA(line);
+		passed = passed && !r.Failed;
+	}
+	return passed;
+}
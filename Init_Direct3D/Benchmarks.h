@@ -0,0 +1,242 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "../Common/d3dUtil.h"
+#include "../Common/ThreadPool.h"
+#include "SampledAnimationClip.h"
+#include "AnimationSystem.h"
+#include "CompressedAnimationClip.h"
+#include "CpuSkinner.h"
+#include "AnimationAtlas.h"
+
+///<summary>
+/// Micro benchmarks for the CPU side of the renderer.  They are not run by
+/// default; define RUN_BENCHMARKS to have InitDirect3DApp::Initialize run
+/// them and print the results to the debugger output window.
+///</summary>
+class Benchmarks
+{
+public:
+	struct Result
+	{
+		std::string Name;
+		double Milliseconds = 0.0;	// average time per iteration
+		double Rate = 0.0;
+		std::string RateUnit;
+		bool Failed = false;		// a check this result reports did not hold
+	};
+
+	// Parses the text models with the tokenizer based loaders, and the M3D
+	// model again from its binary copy, reporting MB/s of file data.  With a
+	// thread pool the sectioned parallel M3D parse is timed as well.
+	static std::vector<Result> ModelParsing(
+		const std::string& m3dFilename,
+		const std::string& m3dbFilename,
+		const std::string& txtFilename,
+		UINT iterations,
+		ThreadPool* threadPool = nullptr);
+
+	// Samples a clip frame by frame by name, with an AnimationCursor, and
+	// through a clip handle with scratch storage, reporting frames per second.
+	static std::vector<Result> AnimationSampling(
+		const SkinnedData& skinInfo,
+		const std::string& clipName,
+		UINT iterations);
+
+	// Interpolates a clip with AnimationClip::Interpolate and with its
+	// SampledAnimationClip resampled at sampleRate, in both accuracy modes,
+	// reporting frames per second and the largest matrix element difference
+	// from AnimationClip::Interpolate.
+	static std::vector<Result> ClipInterpolation(
+		const SkinnedData& skinInfo,
+		const std::string& clipName,
+		float sampleRate,
+		UINT iterations);
+
+	// Updates instanceCount instances of a clip with an AnimationSystem,
+	// serially and on the thread pool, reporting instance updates per second.
+	// Also reports how many palette slots differ between the two and fails
+	// if any do.
+	static std::vector<Result> AnimationUpdate(
+		SkinnedData& skinInfo,
+		const std::string& clipName,
+		UINT instanceCount,
+		UINT iterations,
+		ThreadPool* threadPool);
+
+	// Updates instanceCount instances spread over eight phases of a clip,
+	// without and with a PoseCache of the given time quantum, reporting
+	// instance updates per second, the cache hit rate and the largest
+	// matrix element difference the quantization causes.
+	static std::vector<Result> PoseCaching(
+		SkinnedData& skinInfo,
+		const std::string& clipName,
+		UINT instanceCount,
+		float timeQuantum,
+		UINT iterations,
+		ThreadPool* threadPool);
+
+	// Compresses a clip with the given tolerance and reports the compression
+	// ratio, the share of keyframes kept, the largest per-bone errors, the
+	// largest distance any vertex of boneBounds' boxes is moved over the
+	// clip, which the tolerance bounds, and the playback rate of the
+	// compressed clip.
+	static std::vector<Result> AnimationCompression(
+		const SkinnedData& skinInfo,
+		const BoneBounds& boneBounds,
+		const std::string& clipName,
+		float tolerance,
+		UINT iterations);
+
+	// Compares the bytes per instance and the time to fill the palettes of
+	// instanceCount instances for the old 96 matrix constants, the packed
+	// 3x4 palette and dual quaternions, and checks the dual quaternions
+	// against the matrices they replace.
+	static std::vector<Result> PalettePacking(
+		const SkinnedData& skinInfo,
+		const std::string& clipName,
+		UINT instanceCount,
+		UINT iterations);
+
+	// Loads an .m3d model, gives each subset a palette of only the bones it
+	// is weighted to and compares the bytes and pack time per instance with
+	// one palette of the whole skeleton.  Also checks that skinning through
+	// the remapped indices gives the same positions.
+	static std::vector<Result> SubsetPalettes(
+		const std::string& m3dFilename,
+		const std::string& clipName,
+		UINT instanceCount,
+		UINT iterations);
+
+	// Skins every vertex of an .m3d model at the middle of a clip with the
+	// scalar reference, CpuSkinner alone and CpuSkinner on the thread pool,
+	// and reports the largest difference from the reference.
+	static std::vector<Result> CpuSkinning(
+		const std::string& m3dFilename,
+		const std::string& clipName,
+		UINT iterations,
+		ThreadPool* threadPool);
+
+	// Bakes a looping clip into an AnimationAtlas at sampleRate with the
+	// given 3x4 palette format and reports the bake time, the atlas size,
+	// the largest difference from the evaluated poses at the baked times,
+	// and the per frame CPU cost of instanceCount instances played live
+	// and from the atlas.
+	static std::vector<Result> AnimationBaking(
+		SkinnedData& skinInfo,
+		const std::string& clipName,
+		float sampleRate,
+		BonePaletteFormat format,
+		UINT instanceCount,
+		UINT iterations);
+
+	// Updates a crowd of instanceCount instances standing in rows of ten
+	// in front of a camera, a few rows of them behind it, with every pose
+	// evaluated and with the given level of detail policy.  Reports
+	// instance updates per second for both, and the bones evaluated and
+	// skipped and the instances evaluated, extrapolated and culled on the
+	// last frame.
+	static std::vector<Result> AnimationLod(
+		SkinnedData& skinInfo,
+		const std::string& clipName,
+		const AnimationLodPolicy& policy,
+		UINT instanceCount,
+		UINT iterations,
+		ThreadPool* threadPool);
+
+	// Plays frames of instanceCount instances, each followed by recordMs of
+	// busy work standing in for command recording, with AnimationSystem::
+	// Update called before the work and with an AnimationPipeline evaluating
+	// the next frame during it.  Reports frames per second, the main thread
+	// time spent on animation per frame and how many palette slots of the
+	// last frame differ between the two, failing if any do.
+	static std::vector<Result> AnimationPipelining(
+		SkinnedData& skinInfo,
+		const std::string& clipName,
+		UINT instanceCount,
+		double recordMs,
+		UINT iterations,
+		ThreadPool* threadPool);
+
+	// Bounds an .m3d model at poses spread over a clip with BoneBounds and
+	// by skinning every vertex with CpuSkinner::SkinReference, reporting
+	// poses per second for both, the skinned vertices that fall outside the
+	// BoneBounds box, failing if there are any, and how much larger its
+	// volume is than the box of the skinned vertices.
+	static std::vector<Result> SkinnedBounds(
+		const std::string& m3dFilename,
+		const std::string& clipName,
+		UINT iterations);
+
+	// Concatenates poses of synthetic 58, 128 and 256 bone hierarchies with
+	// the former two loop code (root space through XMFLOAT4X4, then the
+	// offsets) and with SkinnedData::ConcatenateTransforms.  Reports bones
+	// per second for both and the largest difference between their results.
+	static std::vector<Result> BoneConcatenation(
+		UINT iterations);
+
+	// Generates the subdivided box the scene uses and geospheres of one to
+	// six subdivisions.  Reports triangles per second and the vertex count
+	// next to the count without shared edge midpoints (six vertices for
+	// every triangle of the last level before).
+	static std::vector<Result> GeometrySubdivision(
+		UINT iterations);
+
+	// Generates a gridSize x gridSize grid and spheres and cylinders of
+	// ringSize slices and stacks with the former one vertex at a time code
+	// (grid and sphere), with GeometryGenerator on the calling thread and
+	// with it on threadPool.  Reports vertices per second.
+	static std::vector<Result> GeometryGeneration(
+		UINT gridSize,
+		UINT ringSize,
+		UINT iterations,
+		ThreadPool* threadPool);
+
+	// Runs MeshOptimizer over the skull (txtFilename), the skinned model
+	// (m3dFilename, per subset) and the generated sphere and geosphere.
+	// Reports triangles per second and ACMR, ATVR and overdraw before and
+	// after.
+	static std::vector<Result> MeshOptimization(
+		const std::string& m3dFilename,
+		const std::string& txtFilename,
+		UINT iterations);
+
+	// Builds LOD chains at ratios with MeshSimplifier for the skull
+	// (txtFilename) and each subset of the skinned model (m3dFilename).
+	// Reports original triangles per second, and each LOD's triangle count
+	// and error.
+	static std::vector<Result> MeshSimplification(
+		const std::string& m3dFilename,
+		const std::string& txtFilename,
+		const std::vector<float>& ratios,
+		UINT iterations);
+
+	// Splits the optimized txtFilename into meshlets with MeshletBuilder::
+	// Build and BuildInOrder, placed as the skull is in the scene, and culls
+	// them with MeshletCuller from sample viewpoints.  Reports build and cull
+	// throughput, the ACMR Build's reordering costs, and at each viewpoint
+	// the triangles that survive and the vertex shader invocations of the
+	// draws for both, next to those of the whole mesh.
+	static std::vector<Result> MeshletCulling(const std::string& txtFilename, UINT iterations);
+
+	// Counts the heap allocations, aligned ones included, made per frame
+	// once warmed up by the handle based GetFinalTransforms, by
+	// SkinnedModelInstance::UpdateSkinnedAnimation, and by AnimationSystem::
+	// Update of instanceCount instances with a palette, boneBounds and the
+	// given level of detail policy, serially, on threadPool and through an
+	// AnimationPipeline.  Any of them allocating fails.  Reports nothing
+	// unless RUN_BENCHMARKS is defined, as only then are allocations counted.
+	static std::vector<Result> AnimationAllocations(
+		SkinnedData& skinInfo,
+		const BoneBounds& boneBounds,
+		const std::string& clipName,
+		const AnimationLodPolicy& policy,
+		UINT instanceCount,
+		UINT frames,
+		ThreadPool* threadPool);
+
+	// Prints the results and returns false if any of them failed.
+	static bool Log(const std::vector<Result>& results);
+};
+
+#endif // BENCHMARKS_H
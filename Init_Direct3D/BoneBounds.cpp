@@ -0,0 +1,117 @@
+#include "BoneBounds.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+void BoneBounds::Reset(UINT numBones)
+{
+	mMin.assign(numBones, XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+	mMax.assign(numBones, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	mBoxes.assign(numBones, BoundingBox());
+	mBoxBones.clear();
+}
+
+void BoneBounds::AddVertices(const M3DLoader::SkinnedVertex* vertices, UINT numVertices)
+{
+	const UINT numBones = (UINT)mMin.size();
+	for(UINT v = 0; v < numVertices; ++v)
+	{
+		const M3DLoader::SkinnedVertex& vertex = vertices[v];
+		const float weights[4] =
+		{
+			vertex.BoneWeights.x,
+			vertex.BoneWeights.y,
+			vertex.BoneWeights.z,
+			1.0f - vertex.BoneWeights.x - vertex.BoneWeights.y - vertex.BoneWeights.z
+		};
+
+		for(UINT i = 0; i < 4; ++i)
+		{
+			const UINT bone = vertex.BoneIndices[i];
+			if( weights[i] <= 0.0f || bone >= numBones )
+				continue;
+
+			XMFLOAT3& lo = mMin[bone];
+			XMFLOAT3& hi = mMax[bone];
+			lo.x = std::min(lo.x, vertex.Pos.x);
+			lo.y = std::min(lo.y, vertex.Pos.y);
+			lo.z = std::min(lo.z, vertex.Pos.z);
+			hi.x = std::max(hi.x, vertex.Pos.x);
+			hi.y = std::max(hi.y, vertex.Pos.y);
+			hi.z = std::max(hi.z, vertex.Pos.z);
+		}
+	}
+
+	mBoxBones.clear();
+	for(UINT bone = 0; bone < numBones; ++bone)
+	{
+		if( mMin[bone].x > mMax[bone].x )
+			continue;
+
+		BoundingBox::CreateFromPoints(mBoxes[bone], XMLoadFloat3(&mMin[bone]), XMLoadFloat3(&mMax[bone]));
+		mBoxBones.push_back(bone);
+	}
+}
+
+UINT BoneBounds::BoneCount()const
+{
+	return (UINT)mBoxes.size();
+}
+
+bool BoneBounds::HasBox(UINT bone)const
+{
+	return mMin[bone].x <= mMax[bone].x;
+}
+
+const BoundingBox& BoneBounds::GetBox(UINT bone)const
+{
+	return mBoxes[bone];
+}
+
+void BoneBounds::ComputeReach(const std::vector<XMFLOAT4X4>& boneOffsets, std::vector<float>& reach)const
+{
+	reach.assign(mBoxes.size(), 0.0f);
+	for(UINT bone : mBoxBones)
+	{
+		if( bone >= boneOffsets.size() )
+			continue;
+
+		XMMATRIX offset = XMLoadFloat4x4(&boneOffsets[bone]);
+		XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+		mBoxes[bone].GetCorners(corners);
+		for(const XMFLOAT3& corner : corners)
+		{
+			XMVECTOR p = XMVector3Transform(XMLoadFloat3(&corner), offset);
+			reach[bone] = std::max(reach[bone], XMVectorGetX(XMVector3Length(p)));
+		}
+	}
+}
+
+bool BoneBounds::ComputeBounds(const XMFLOAT4X4* finalTransforms, BoundingBox& bounds)const
+{
+	if( mBoxBones.empty() )
+		return false;
+
+	XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+	XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+	for(UINT bone : mBoxBones)
+	{
+		// The final transforms are stored transposed for the shaders.
+		XMMATRIX M = XMMatrixTranspose(XMLoadFloat4x4(&finalTransforms[bone]));
+		const BoundingBox& box = mBoxes[bone];
+
+		// The box moved by M is bounded by its moved center and, per axis,
+		// the extents weighted by the absolute rows of M.
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&box.Center), M);
+		XMVECTOR extents = XMVectorMultiply(XMVectorAbs(M.r[0]), XMVectorReplicate(box.Extents.x));
+		extents = XMVectorMultiplyAdd(XMVectorAbs(M.r[1]), XMVectorReplicate(box.Extents.y), extents);
+		extents = XMVectorMultiplyAdd(XMVectorAbs(M.r[2]), XMVectorReplicate(box.Extents.z), extents);
+
+		lo = XMVectorMin(lo, XMVectorSubtract(center, extents));
+		hi = XMVectorMax(hi, XMVectorAdd(center, extents));
+	}
+
+	BoundingBox::CreateFromPoints(bounds, lo, hi);
+	return true;
+}
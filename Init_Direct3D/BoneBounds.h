@@ -0,0 +1,53 @@
+#ifndef BONEBOUNDS_H
+#define BONEBOUNDS_H
+
+#include "../Common/d3dUtil.h"
+#include "LoadM3d.h"
+
+///<summary>
+/// Bind pose boxes of the vertices weighted to each bone of a skinned
+/// model, used to bound an animated pose without skinning it.
+///
+/// A skinned vertex is a weighted average of its position moved by each
+/// of its bones, so it stays within the boxes of those bones moved by the
+/// same transforms.  A bone's box therefore takes every vertex with any
+/// weight on it, and the bounds of a pose are the union of the boxes
+/// transformed by the pose's final transforms: a transformed box per bone
+/// instead of a blend per vertex.
+///</summary>
+class BoneBounds
+{
+public:
+	void Reset(UINT numBones);
+
+	// Adds vertices to the boxes of the bones they are weighted to.  Their
+	// bone indices must be skeleton indices, not subset palette positions.
+	void AddVertices(const M3DLoader::SkinnedVertex* vertices, UINT numVertices);
+
+	UINT BoneCount()const;
+
+	// False for bones no vertex is weighted to; they do not widen the bounds.
+	bool HasBox(UINT bone)const;
+	const DirectX::BoundingBox& GetBox(UINT bone)const;
+
+	// For every bone, the distance from its joint to the farthest corner of
+	// its box, in the bone's own space (boneOffsets as in SkinnedData); 0
+	// for bones without a box.  A change of the bone's rotation or scale
+	// moves no vertex weighted to it further than this times the change.
+	void ComputeReach(const std::vector<DirectX::XMFLOAT4X4>& boneOffsets, std::vector<float>& reach)const;
+
+	// Model space box enclosing the model posed by finalTransforms, as
+	// SkinnedData::GetFinalTransforms writes them.  Returns false, leaving
+	// bounds unchanged, if no vertex was added.
+	bool ComputeBounds(const DirectX::XMFLOAT4X4* finalTransforms, DirectX::BoundingBox& bounds)const;
+
+private:
+	std::vector<DirectX::XMFLOAT3> mMin;
+	std::vector<DirectX::XMFLOAT3> mMax;
+	std::vector<DirectX::BoundingBox> mBoxes;
+
+	// Bones with a box, in increasing order.
+	std::vector<UINT> mBoxBones;
+};
+
+#endif // BONEBOUNDS_H
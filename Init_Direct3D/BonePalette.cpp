@@ -0,0 +1,226 @@
+#include "BonePalette.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <climits>
+
+using namespace DirectX;
+
+namespace
+{
+	// Writes one bone at rows and returns the position after it.  Half
+	// palettes advance by half a float4 per row.
+	XMFLOAT4* PackBone(BonePaletteFormat format, const XMFLOAT4X4& finalTransform, XMFLOAT4* rows)
+	{
+		if( format == BonePaletteFormat::Affine3x4 )
+		{
+			// The final transforms are already transposed; drop the constant row.
+			memcpy(rows, &finalTransform, 3 * sizeof(XMFLOAT4));
+			return rows + 3;
+		}
+
+		if( format == BonePaletteFormat::Affine3x4Half )
+		{
+			PackedVector::HALF* halves = reinterpret_cast<PackedVector::HALF*>(rows);
+			for(UINT r = 0; r < 3; ++r)
+			{
+				for(UINT c = 0; c < 4; ++c)
+					halves[r*4 + c] = PackedVector::XMConvertFloatToHalf(finalTransform.m[r][c]);
+			}
+			return reinterpret_cast<XMFLOAT4*>(halves + 12);
+		}
+
+		XMMATRIX M = XMMatrixTranspose(XMLoadFloat4x4(&finalTransform));
+
+		// Row vector convention: v' = v*R + t, with t in the last row.
+		XMVECTOR real = XMQuaternionNormalize(XMQuaternionRotationMatrix(M));
+		XMVECTOR translation = XMVectorSetW(M.r[3], 0.0f);
+
+		// dual = 0.5 * t * real.  XMQuaternionMultiply(a, b) returns the
+		// product b*a, so the arguments are swapped.
+		XMVECTOR dual = XMVectorScale(XMQuaternionMultiply(real, translation), 0.5f);
+
+		XMStoreFloat4(&rows[0], real);
+		XMStoreFloat4(&rows[1], dual);
+		return rows + 2;
+	}
+}
+
+UINT BonePalette::BoneByteSize(BonePaletteFormat format)
+{
+	switch( format )
+	{
+	case BonePaletteFormat::Affine3x4Half:
+		return 12 * sizeof(PackedVector::HALF);
+	case BonePaletteFormat::DualQuaternion:
+		return 2 * sizeof(XMFLOAT4);
+	default:
+		return 3 * sizeof(XMFLOAT4);
+	}
+}
+
+const char* BonePalette::ShaderDefine(BonePaletteFormat format)
+{
+	switch( format )
+	{
+	case BonePaletteFormat::Affine3x4Half:
+		return "HALF_BONE_PALETTE";
+	case BonePaletteFormat::DualQuaternion:
+		return "DUAL_QUATERNION_SKINNING";
+	default:
+		return nullptr;
+	}
+}
+
+UINT BonePalette::SlotByteSize(BonePaletteFormat format, UINT numBones)
+{
+	return (BoneByteSize(format) * numBones + 255) & ~255;
+}
+
+void BonePalette::Pack(BonePaletteFormat format, const XMFLOAT4X4* finalTransforms,
+	UINT numBones, void* dest)
+{
+	XMFLOAT4* rows = reinterpret_cast<XMFLOAT4*>(dest);
+	for(UINT i = 0; i < numBones; ++i)
+		rows = PackBone(format, finalTransforms[i], rows);
+}
+
+void BonePalette::Pack(BonePaletteFormat format, const XMFLOAT4X4* finalTransforms,
+	const UINT* bones, UINT numBones, void* dest)
+{
+	XMFLOAT4* rows = reinterpret_cast<XMFLOAT4*>(dest);
+	for(UINT i = 0; i < numBones; ++i)
+		rows = PackBone(format, finalTransforms[bones[i]], rows);
+}
+
+void BonePaletteLayout::Reset(BonePaletteFormat format)
+{
+	mFormat = format;
+	mPalettes.clear();
+	mSubsetPalettes.clear();
+	mBones.clear();
+	mLastPaletteLocal.clear();
+	mSlotByteSize = 0;
+}
+
+bool BonePaletteLayout::AddSubset(M3DLoader::SkinnedVertex* vertices, UINT numVertices)
+{
+	// Vertex bone indices are bytes.
+	const UINT unused = UINT_MAX;
+	bool used[256] = {};
+	std::vector<UINT> bones;
+	for(UINT v = 0; v < numVertices; ++v)
+	{
+		const M3DLoader::SkinnedVertex& vertex = vertices[v];
+		const float weights[4] = { vertex.BoneWeights.x, vertex.BoneWeights.y, vertex.BoneWeights.z,
+			1.0f - vertex.BoneWeights.x - vertex.BoneWeights.y - vertex.BoneWeights.z };
+
+		for(UINT i = 0; i < 4; ++i)
+		{
+			BYTE bone = vertex.BoneIndices[i];
+			if( weights[i] != 0.0f && !used[bone] )
+			{
+				used[bone] = true;
+				bones.push_back(bone);
+			}
+		}
+	}
+
+	if( bones.size() > BonePalette::MaxBones )
+		return false;
+
+	// Share the last palette if the subset's missing bones fit in it and the
+	// grown palette is no larger than the two separately.
+	bool shareLast = false;
+	if( !mPalettes.empty() )
+	{
+		const Palette& last = mPalettes.back();
+		UINT added = 0;
+		for(UINT bone : bones)
+		{
+			if( mLastPaletteLocal[bone] == unused )
+				++added;
+		}
+
+		shareLast = last.NumBones + added <= BonePalette::MaxBones &&
+			BonePalette::SlotByteSize(mFormat, last.NumBones + added) <=
+			BonePalette::SlotByteSize(mFormat, last.NumBones) + BonePalette::SlotByteSize(mFormat, (UINT)bones.size());
+	}
+
+	if( !shareLast )
+	{
+		Palette p;
+		p.FirstBone = (UINT)mBones.size();
+		p.Offset = mSlotByteSize;
+		mPalettes.push_back(p);
+		mLastPaletteLocal.assign(256, unused);
+	}
+
+	// Only the last palette grows, so the earlier offsets stay valid.
+	Palette& palette = mPalettes.back();
+	for(UINT bone : bones)
+	{
+		if( mLastPaletteLocal[bone] == unused )
+		{
+			mLastPaletteLocal[bone] = palette.NumBones++;
+			mBones.push_back(bone);
+		}
+	}
+	mSlotByteSize = palette.Offset + BonePalette::SlotByteSize(mFormat, palette.NumBones);
+
+	// The shader reads the unweighted influences too; any bone will do.
+	for(UINT v = 0; v < numVertices; ++v)
+	{
+		for(BYTE& bone : vertices[v].BoneIndices)
+			bone = used[bone] ? (BYTE)mLastPaletteLocal[bone] : 0;
+	}
+
+	mSubsetPalettes.push_back((UINT)mPalettes.size() - 1);
+
+	return true;
+}
+
+BonePaletteFormat BonePaletteLayout::Format()const
+{
+	return mFormat;
+}
+
+UINT BonePaletteLayout::SubsetCount()const
+{
+	return (UINT)mSubsetPalettes.size();
+}
+
+UINT BonePaletteLayout::SubsetPalette(UINT subset)const
+{
+	return mSubsetPalettes[subset];
+}
+
+UINT BonePaletteLayout::PaletteCount()const
+{
+	return (UINT)mPalettes.size();
+}
+
+UINT BonePaletteLayout::PaletteBoneCount(UINT palette)const
+{
+	return mPalettes[palette].NumBones;
+}
+
+const UINT* BonePaletteLayout::PaletteBones(UINT palette)const
+{
+	return mBones.data() + mPalettes[palette].FirstBone;
+}
+
+UINT BonePaletteLayout::PaletteOffset(UINT palette)const
+{
+	return mPalettes[palette].Offset;
+}
+
+UINT BonePaletteLayout::SlotByteSize()const
+{
+	return mSlotByteSize;
+}
+
+void BonePaletteLayout::Pack(const XMFLOAT4X4* finalTransforms, BYTE* slot)const
+{
+	for(const Palette& p : mPalettes)
+		BonePalette::Pack(mFormat, finalTransforms, mBones.data() + p.FirstBone, p.NumBones, slot + p.Offset);
+}
@@ -0,0 +1,116 @@
+#ifndef BONEPALETTE_H
+#define BONEPALETTE_H
+
+#include "../Common/d3dUtil.h"
+#include "LoadM3d.h"
+
+///<summary>
+/// Layout of the bone palette in cbSkinned (see Params.hlsl).
+///
+/// Affine3x4 stores the first three rows of each transposed final
+/// transform, whose fourth row is always (0, 0, 0, 1): 48 bytes a bone
+/// instead of 64.  Affine3x4Half stores the same rows as half floats, 24
+/// bytes a bone, for baked crowds where memory matters more than the
+/// precision lost far from the origin.  DualQuaternion stores a unit rotation quaternion and its
+/// dual part, 32 bytes a bone; it blends without the volume loss of linear
+/// blend skinning but only represents rotation and translation, so bones
+/// must not be scaled.  The shaders pick the layout with the
+/// HALF_BONE_PALETTE or DUAL_QUATERNION_SKINNING define (ShaderDefine).
+///</summary>
+enum class BonePaletteFormat
+{
+	Affine3x4,
+	Affine3x4Half,
+	DualQuaternion
+};
+
+class BonePalette
+{
+public:
+	// Size of the cbSkinned array in Params.hlsl, in bones.
+	static const UINT MaxBones = 96;
+
+	static UINT BoneByteSize(BonePaletteFormat format);
+
+	// The define that makes Params.hlsl read this format, or nullptr.
+	static const char* ShaderDefine(BonePaletteFormat format);
+
+	// Bytes of one instance's palette, padded to the 256 byte constant
+	// buffer alignment.
+	static UINT SlotByteSize(BonePaletteFormat format, UINT numBones);
+
+	// Writes numBones final transforms, as produced by
+	// SkinnedData::GetFinalTransforms, to dest in the given format.  dest may
+	// be mapped upload memory; it is written sequentially and never read.
+	static void Pack(BonePaletteFormat format, const DirectX::XMFLOAT4X4* finalTransforms,
+		UINT numBones, void* dest);
+
+	// Same, but the i-th bone written is finalTransforms[bones[i]].
+	static void Pack(BonePaletteFormat format, const DirectX::XMFLOAT4X4* finalTransforms,
+		const UINT* bones, UINT numBones, void* dest);
+};
+
+///<summary>
+/// The bone palettes read by the draws of one skinned model.
+///
+/// A subset of the mesh is usually weighted to some of the skeleton's
+/// bones only.  AddSubset gives it a palette of just those bones and
+/// rewrites its vertices' bone indices to positions in that palette, so a
+/// draw uploads only the bones it reads.  Consecutive subsets share a
+/// palette, appending their missing bones to it, while that fits in
+/// BonePalette::MaxBones and takes no more room than separate palettes;
+/// subsets weighted to mostly the same bones then do not upload them
+/// twice.  An instance's palette slot holds every palette, each at a 256
+/// byte aligned offset for its own constant buffer view.  The skeleton may
+/// have any number of bones a BYTE index can address as long as no one
+/// subset is weighted to more than MaxBones.
+///</summary>
+class BonePaletteLayout
+{
+public:
+	void Reset(BonePaletteFormat format);
+
+	// Assigns the next subset a palette holding the bones its vertices are
+	// weighted to and rewrites their bone indices to index it.  Returns
+	// false, leaving the vertices and the layout unchanged, if they use
+	// more than MaxBones bones.
+	bool AddSubset(M3DLoader::SkinnedVertex* vertices, UINT numVertices);
+
+	BonePaletteFormat Format()const;
+	UINT SubsetCount()const;
+	UINT SubsetPalette(UINT subset)const;
+
+	UINT PaletteCount()const;
+	UINT PaletteBoneCount(UINT palette)const;
+
+	// Skeleton bone indices of the palette's bones, in palette order.
+	const UINT* PaletteBones(UINT palette)const;
+
+	// Byte offset of the palette within an instance's slot.
+	UINT PaletteOffset(UINT palette)const;
+	UINT SlotByteSize()const;
+
+	// Writes every palette of one instance's slot.
+	void Pack(const DirectX::XMFLOAT4X4* finalTransforms, BYTE* slot)const;
+
+private:
+	struct Palette
+	{
+		UINT FirstBone = 0;
+		UINT NumBones = 0;
+		UINT Offset = 0;
+	};
+
+	BonePaletteFormat mFormat = BonePaletteFormat::Affine3x4;
+	std::vector<Palette> mPalettes;
+	std::vector<UINT> mSubsetPalettes;
+
+	// Bones of all palettes, each palette's contiguous.
+	std::vector<UINT> mBones;
+
+	// Position of each skeleton bone in the last palette, or UINT_MAX.
+	std::vector<UINT> mLastPaletteLocal;
+	UINT mSlotByteSize = 0;
+};
+
+#endif // BONEPALETTE_H
@@ -31,28 +31,7 @@ VertexOut VS(VertexIn vin)
     VertexOut vout;
 
 #ifdef SKINNED
-    float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    weights[0] = vin.BoneWeights.x;
-    weights[1] = vin.BoneWeights.y;
-    weights[2] = vin.BoneWeights.z;
-    weights[3] = 1.0f - weights[0] - weights[1] - weights[2];
-
-    float3 posL = float3(0.0f, 0.0f, 0.0f);
-    float3 normalL = float3(0.0f, 0.0f, 0.0f);
-    float3 tangentL = float3(0.0f, 0.0f, 0.0f);
-    for (int i = 0; i < 4; ++i)
-    {
-        // Assume no nonuniform scaling when transforming normals, so 
-        // that we do not have to use the inverse-transpose.
-
-        posL += weights[i] * mul(float4(vin.PosL, 1.0f), gBoneTransforms[vin.BoneIndices[i]]).xyz;
-        normalL += weights[i] * mul(vin.NormalL, (float3x3)gBoneTransforms[vin.BoneIndices[i]]);
-        tangentL += weights[i] * mul(vin.Tangent.xyz, (float3x3)gBoneTransforms[vin.BoneIndices[i]]);
-    }
-
-    vin.PosL = posL;
-    vin.NormalL = normalL;
-    vin.Tangent.xyz = tangentL;
+    SkinVertex(vin.BoneWeights, vin.BoneIndices, vin.PosL, vin.NormalL, vin.Tangent);
 #endif
 
     float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
@@ -0,0 +1,648 @@
+#include "CompressedAnimationClip.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Longest run of keyframes one kept pair may replace.  Bounds the cost of
+	// reducing long, nearly static tracks, which is quadratic in the run length.
+	const UINT MaxDroppedRun = 128;
+
+	// Share of the tolerance the per-bone reduction aims for.  The rest is
+	// left for the errors of the bones above it and quantization, so the
+	// check over the whole skeleton rarely has to put keys back.
+	const float ReductionShare = 0.5f;
+
+	const float SmallestThreeRange = 0.70710678f;	// |component| <= 1/sqrt(2) unless largest
+	const UINT SmallestThreeBits = 20;
+	const UINT SmallestThreeMax = (1u << SmallestThreeBits) - 1;
+
+	UINT16 QuantizeUnit(float v)
+	{
+		float q = std::floor(v * 65535.0f + 0.5f);
+		return (UINT16)std::min(std::max(q, 0.0f), 65535.0f);
+	}
+
+	UINT16 QuantizeRange(float v, float minValue, float step)
+	{
+		return step > 0.0f ? QuantizeUnit((v - minValue) / (step * 65535.0f)) : 0;
+	}
+
+	// Drops the largest component, which is rebuilt from the unit length, and
+	// stores its index in 2 bits and the other three in 20 bits each.
+	void PackRotation(const XMFLOAT4& quat, UINT16 packed[4])
+	{
+		XMFLOAT4 q;
+		XMStoreFloat4(&q, XMQuaternionNormalize(XMLoadFloat4(&quat)));
+		float c[4] = { q.x, q.y, q.z, q.w };
+
+		UINT largest = 0;
+		for(UINT i = 1; i < 4; ++i)
+		{
+			if( std::abs(c[i]) > std::abs(c[largest]) )
+				largest = i;
+		}
+
+		// q and -q are the same rotation; make the dropped component positive.
+		float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+		UINT64 bits = largest;
+		for(UINT i = 0; i < 4; ++i)
+		{
+			if( i == largest )
+				continue;
+
+			float unit = (c[i] * sign / SmallestThreeRange) * 0.5f + 0.5f;
+			float q20 = std::floor(unit * SmallestThreeMax + 0.5f);
+			bits = (bits << SmallestThreeBits) | (UINT64)std::min(std::max(q20, 0.0f), (float)SmallestThreeMax);
+		}
+
+		packed[0] = (UINT16)(bits >> 48);
+		packed[1] = (UINT16)(bits >> 32);
+		packed[2] = (UINT16)(bits >> 16);
+		packed[3] = (UINT16)bits;
+	}
+
+	XMFLOAT4 UnpackRotation(const UINT16 packed[4])
+	{
+		UINT64 bits = ((UINT64)packed[0] << 48) | ((UINT64)packed[1] << 32) | ((UINT64)packed[2] << 16) | packed[3];
+		UINT largest = (UINT)(bits >> (3 * SmallestThreeBits)) & 3;
+
+		float c[4];
+		float sumSq = 0.0f;
+		for(int i = 3, shift = 0; i >= 0; --i)
+		{
+			if( (UINT)i == largest )
+				continue;
+
+			float unit = (float)((bits >> shift) & SmallestThreeMax) / SmallestThreeMax;
+			c[i] = (unit * 2.0f - 1.0f) * SmallestThreeRange;
+			sumSq += c[i] * c[i];
+			shift += SmallestThreeBits;
+		}
+		c[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSq));
+
+		return XMFLOAT4(c[0], c[1], c[2], c[3]);
+	}
+
+	Keyframe LerpKeyframes(const Keyframe& k0, const Keyframe& k1, float t)
+	{
+		float span = k1.TimePos - k0.TimePos;
+		float lerpPercent = span > 0.0f ? (t - k0.TimePos) / span : 0.0f;
+
+		Keyframe key;
+		key.TimePos = t;
+		XMStoreFloat3(&key.Translation, XMVectorLerp(XMLoadFloat3(&k0.Translation), XMLoadFloat3(&k1.Translation), lerpPercent));
+		XMStoreFloat3(&key.Scale, XMVectorLerp(XMLoadFloat3(&k0.Scale), XMLoadFloat3(&k1.Scale), lerpPercent));
+		XMStoreFloat4(&key.RotationQuat, XMQuaternionSlerp(XMLoadFloat4(&k0.RotationQuat), XMLoadFloat4(&k1.RotationQuat), lerpPercent));
+
+		return key;
+	}
+
+	// The same interpolation, with the same end handling, as
+	// BoneAnimation::Interpolate and CompressedAnimationClip::SampleTrack
+	// over the keys listed in kept.
+	Keyframe SampleKeys(const std::vector<Keyframe>& keys, const std::vector<UINT>& kept, float t)
+	{
+		const UINT numKept = (UINT)kept.size();
+		if( numKept == 1 || t <= keys[kept[0]].TimePos )
+			return keys[kept[0]];
+		if( t >= keys[kept[numKept-1]].TimePos )
+			return keys[kept[numKept-1]];
+
+		auto next = std::lower_bound(kept.begin(), kept.end(), t,
+			[&](UINT k, float time) { return keys[k].TimePos < time; });
+		return LerpKeyframes(keys[*(next - 1)], keys[*next], t);
+	}
+
+	XMMATRIX KeyframeTransform(const Keyframe& key)
+	{
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		return XMMatrixAffineTransformation(XMLoadFloat3(&key.Scale), zero,
+			XMLoadFloat4(&key.RotationQuat), XMLoadFloat3(&key.Translation));
+	}
+
+	struct KeyError
+	{
+		float Translation = 0.0f;
+		float Rotation = 0.0f;
+		float Scale = 0.0f;
+	};
+
+	KeyError CompareKeyframes(const Keyframe& a, const Keyframe& b)
+	{
+		KeyError error;
+
+		error.Translation = XMVectorGetX(XMVector3Length(XMLoadFloat3(&a.Translation) - XMLoadFloat3(&b.Translation)));
+
+		XMVECTOR scaleDiff = XMVectorAbs(XMLoadFloat3(&a.Scale) - XMLoadFloat3(&b.Scale));
+		error.Scale = std::max(XMVectorGetX(scaleDiff), std::max(XMVectorGetY(scaleDiff), XMVectorGetZ(scaleDiff)));
+
+		// Unit quaternions a rotation angle apart are 2 sin(angle/4) apart.
+		// Unlike the acos of their dot product, which rounds every angle
+		// below about 1e-3 radians to zero in single precision, this keeps
+		// its precision for the small errors being measured.
+		XMVECTOR qa = XMQuaternionNormalize(XMLoadFloat4(&a.RotationQuat));
+		XMVECTOR qb = XMQuaternionNormalize(XMLoadFloat4(&b.RotationQuat));
+		if( XMVectorGetX(XMQuaternionDot(qa, qb)) < 0.0f )
+			qb = XMVectorNegate(qb);
+		float chord = XMVectorGetX(XMVector4Length(qa - qb));
+		error.Rotation = 4.0f * std::asin(std::min(0.5f * chord, 1.0f));
+
+		return error;
+	}
+
+	// How far a transform with the given error moves a point up to lever
+	// from the joint: the joint's own offset plus the change of the 3x3
+	// part, bounded by its Frobenius norm, times the distance.
+	float ModelError(const XMMATRIX& a, const XMMATRIX& b, float lever)
+	{
+		XMVECTOR sumSq = XMVectorZero();
+		for(int r = 0; r < 3; ++r)
+		{
+			XMVECTOR d = a.r[r] - b.r[r];
+			sumSq = XMVectorAdd(sumSq, XMVector3Dot(d, d));
+		}
+
+		float joint = XMVectorGetX(XMVector3Length(a.r[3] - b.r[3]));
+		return joint + std::sqrt(XMVectorGetX(sumSq)) * lever;
+	}
+}
+
+bool CompressedAnimationClip::Compress(const AnimationClip& clip, const std::vector<int>& boneHierarchy,
+	const std::vector<float>& boneReach, float tolerance, AnimationCompressionStats* stats)
+{
+	// A failed compression leaves an empty clip.
+	Clear();
+
+	const UINT numBones = (UINT)clip.BoneAnimations.size();
+	if( numBones == 0 || boneHierarchy.size() != numBones ||
+		!SkinnedData::ValidateBoneHierarchy(boneHierarchy.data(), numBones) )
+		return false;
+
+	if( !boneReach.empty() && boneReach.size() != numBones )
+		return false;
+
+	for(const BoneAnimation& bone : clip.BoneAnimations)
+	{
+		if( bone.Keyframes.empty() )
+			return false;
+	}
+
+	mStartTime = clip.GetClipStartTime();
+	mEndTime = clip.GetClipEndTime();
+	mTracks.assign(numBones, Track());
+	mKeyframes.clear();
+
+	//
+	// Work out how far each bone's errors travel: the number of bone levels
+	// below it and the longest chain of bone lengths it swings around.
+	//
+
+	std::vector<float> boneLength(numBones, 0.0f);
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		for(const Keyframe& key : clip.BoneAnimations[b].Keyframes)
+			boneLength[b] = std::max(boneLength[b], XMVectorGetX(XMVector3Length(XMLoadFloat3(&key.Translation))));
+	}
+
+	// Vertices skinned to a bone lie around a bone length from its joint, so
+	// even a leaf bone swings at least the average bone length.
+	float minLeverArm = 1e-3f;
+	for(float length : boneLength)
+		minLeverArm += length / numBones;
+
+	std::vector<float> leverArm(numBones, minLeverArm);
+	std::vector<UINT> levelsBelow(numBones, 0);
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		float chain = boneLength[b];
+		UINT level = 1;
+		for(int parent = boneHierarchy[b]; parent >= 0; parent = boneHierarchy[parent])
+		{
+			leverArm[parent] = std::max(leverArm[parent], chain);
+			levelsBelow[parent] = std::max(levelsBelow[parent], level);
+
+			chain += boneLength[parent];
+			++level;
+		}
+	}
+
+	// Where the bound is applied; the reduction budgets use the larger of
+	// the two, as a bone with no vertices still swings its children.
+	const std::vector<float>& reach = boneReach.empty() ? leverArm : boneReach;
+
+	//
+	// Quantize every key up front, over each track's own range, so the
+	// errors below are those of what playback will decode.
+	//
+
+	std::vector<std::vector<Keyframe>> decodedKeys(numBones);
+	UINT originalKeyframes = 0;
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[b].Keyframes;
+		originalKeyframes += (UINT)keys.size();
+
+		XMVECTOR translationMin = XMVectorReplicate(MathHelper::Infinity);
+		XMVECTOR translationMax = XMVectorReplicate(-MathHelper::Infinity);
+		XMVECTOR scaleMin = translationMin;
+		XMVECTOR scaleMax = translationMax;
+		for(const Keyframe& key : keys)
+		{
+			translationMin = XMVectorMin(translationMin, XMLoadFloat3(&key.Translation));
+			translationMax = XMVectorMax(translationMax, XMLoadFloat3(&key.Translation));
+			scaleMin = XMVectorMin(scaleMin, XMLoadFloat3(&key.Scale));
+			scaleMax = XMVectorMax(scaleMax, XMLoadFloat3(&key.Scale));
+		}
+
+		Track& track = mTracks[b];
+		XMVECTOR levels = XMVectorReplicate(65535.0f);
+		XMStoreFloat3(&track.TranslationMin, translationMin);
+		XMStoreFloat3(&track.TranslationStep, XMVectorDivide(translationMax - translationMin, levels));
+		XMStoreFloat3(&track.ScaleMin, scaleMin);
+		XMStoreFloat3(&track.ScaleStep, XMVectorDivide(scaleMax - scaleMin, levels));
+
+		decodedKeys[b].reserve(keys.size());
+		for(const Keyframe& key : keys)
+			decodedKeys[b].push_back(DecodeKeyframe(track, EncodeKeyframe(track, key)));
+	}
+
+	//
+	// Keyframe reduction: greedily extend the interval from the last kept key
+	// for as long as interpolating across it reproduces every dropped key.
+	//
+
+	std::vector<std::vector<UINT>> keptKeys(numBones);
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[b].Keyframes;
+		const std::vector<Keyframe>& decoded = decodedKeys[b];
+		const UINT numKeys = (UINT)keys.size();
+
+		float boneTolerance = ReductionShare * tolerance / (levelsBelow[b] + 1);
+		float lever = std::max(leverArm[b], reach[b]);
+		KeyError limit;
+		limit.Translation = boneTolerance;
+		limit.Rotation = boneTolerance / lever;
+		limit.Scale = boneTolerance / lever;
+
+		auto spanFits = [&](UINT first, UINT last)
+		{
+			for(UINT j = first + 1; j < last; ++j)
+			{
+				KeyError error = CompareKeyframes(keys[j], LerpKeyframes(decoded[first], decoded[last], keys[j].TimePos));
+				if( error.Translation > limit.Translation || error.Rotation > limit.Rotation || error.Scale > limit.Scale )
+					return false;
+			}
+			return true;
+		};
+
+		std::vector<UINT>& kept = keptKeys[b];
+		kept.push_back(0);
+		UINT anchor = 0;
+		for(UINT i = 1; i + 1 < numKeys; ++i)
+		{
+			if( i + 1 - anchor > MaxDroppedRun || !spanFits(anchor, i + 1) )
+			{
+				kept.push_back(i);
+				anchor = i;
+			}
+		}
+		if( numKeys > 1 )
+			kept.push_back(numKeys - 1);
+	}
+
+	//
+	// Pose the whole skeleton from the kept keys at every original key time
+	// and halfway between, and put keys back wherever a bone is out of
+	// tolerance in model space.
+	//
+
+	std::vector<float> sampleTimes;
+	for(const BoneAnimation& bone : clip.BoneAnimations)
+	{
+		for(const Keyframe& key : bone.Keyframes)
+			sampleTimes.push_back(key.TimePos);
+	}
+	std::sort(sampleTimes.begin(), sampleTimes.end());
+	sampleTimes.erase(std::unique(sampleTimes.begin(), sampleTimes.end()), sampleTimes.end());
+	for(size_t i = 0, count = sampleTimes.size(); i + 1 < count; ++i)
+		sampleTimes.push_back(0.5f * (sampleTimes[i] + sampleTimes[i+1]));
+
+	std::vector<std::vector<UINT>> allKeys(numBones);
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		allKeys[b].resize(clip.BoneAnimations[b].Keyframes.size());
+		for(UINT k = 0; k < (UINT)allKeys[b].size(); ++k)
+			allKeys[b][k] = k;
+	}
+
+	std::vector<XMMATRIX> exactLocal(numBones), exactToRoot(numBones);
+	std::vector<XMMATRIX> local(numBones), toRoot(numBones);
+	std::vector<std::pair<UINT, UINT>> restore;
+	float maxModelError = 0.0f;
+	for(;;)
+	{
+		restore.clear();
+		maxModelError = 0.0f;
+
+		for(float t : sampleTimes)
+		{
+			for(UINT b = 0; b < numBones; ++b)
+			{
+				exactLocal[b] = KeyframeTransform(SampleKeys(clip.BoneAnimations[b].Keyframes, allKeys[b], t));
+				local[b] = KeyframeTransform(SampleKeys(decodedKeys[b], keptKeys[b], t));
+
+				int parent = boneHierarchy[b];
+				exactToRoot[b] = parent < 0 ? exactLocal[b] : XMMatrixMultiply(exactLocal[b], exactToRoot[parent]);
+				toRoot[b] = parent < 0 ? local[b] : XMMatrixMultiply(local[b], toRoot[parent]);
+			}
+
+			for(UINT b = 0; b < numBones; ++b)
+			{
+				float error = ModelError(exactToRoot[b], toRoot[b], reach[b]);
+				maxModelError = std::max(maxModelError, error);
+				if( error <= tolerance )
+					continue;
+
+				// Blame the bone on the chain to the root whose own error
+				// moves this bone's points the most and that still has a
+				// dropped key around t.
+				UINT blamed = UINT_MAX;
+				float blamedError = 0.0f;
+				XMVECTOR joint = exactToRoot[b].r[3];
+				for(int c = (int)b; c >= 0; c = boneHierarchy[c])
+				{
+					const std::vector<UINT>& kept = keptKeys[c];
+					auto next = std::upper_bound(kept.begin(), kept.end(), t,
+						[&](float time, UINT k) { return time < clip.BoneAnimations[c].Keyframes[k].TimePos; });
+					if( next == kept.begin() || next == kept.end() || *next - *(next - 1) < 2 )
+						continue;
+
+					float distance = XMVectorGetX(XMVector3Length(joint - exactToRoot[c].r[3])) + reach[b];
+					float contribution = ModelError(exactLocal[c], local[c], distance);
+					if( contribution > blamedError )
+					{
+						blamed = (UINT)c;
+						blamedError = contribution;
+					}
+				}
+
+				if( blamed == UINT_MAX )
+					continue;
+
+				// Put back the dropped key of that interval interpolation
+				// misses most.
+				const std::vector<Keyframe>& keys = clip.BoneAnimations[blamed].Keyframes;
+				const std::vector<UINT>& kept = keptKeys[blamed];
+				auto next = std::upper_bound(kept.begin(), kept.end(), t,
+					[&](float time, UINT k) { return time < keys[k].TimePos; });
+				UINT first = *(next - 1);
+				UINT last = *next;
+
+				UINT worst = first + 1;
+				float worstError = -1.0f;
+				for(UINT j = first + 1; j < last; ++j)
+				{
+					XMMATRIX approximate = KeyframeTransform(LerpKeyframes(decodedKeys[blamed][first], decodedKeys[blamed][last], keys[j].TimePos));
+					float keyError = ModelError(KeyframeTransform(keys[j]), approximate, std::max(leverArm[blamed], reach[blamed]));
+					if( keyError > worstError )
+					{
+						worst = j;
+						worstError = keyError;
+					}
+				}
+				restore.push_back(std::make_pair(blamed, worst));
+			}
+		}
+
+		if( restore.empty() )
+			break;
+
+		for(const std::pair<UINT, UINT>& key : restore)
+		{
+			std::vector<UINT>& kept = keptKeys[key.first];
+			auto at = std::lower_bound(kept.begin(), kept.end(), key.second);
+			if( at == kept.end() || *at != key.second )
+				kept.insert(at, key.second);
+		}
+	}
+
+	// Every key is kept and quantization alone breaks the bound.
+	if( maxModelError > tolerance )
+	{
+		Clear();
+		return false;
+	}
+
+	//
+	// Pack the kept keys.
+	//
+
+	for(UINT b = 0; b < numBones; ++b)
+	{
+		mTracks[b].FirstKeyframe = (UINT)mKeyframes.size();
+		mTracks[b].NumKeyframes = (UINT)keptKeys[b].size();
+
+		for(UINT k : keptKeys[b])
+			mKeyframes.push_back(EncodeKeyframe(mTracks[b], clip.BoneAnimations[b].Keyframes[k]));
+	}
+
+	if( stats != nullptr )
+	{
+		*stats = AnimationCompressionStats();
+		stats->OriginalKeyframes = originalKeyframes;
+		stats->KeptKeyframes = (UINT)mKeyframes.size();
+		stats->OriginalBytes = sizeof(AnimationClip) + numBones*sizeof(BoneAnimation) + originalKeyframes*sizeof(Keyframe);
+		stats->CompressedBytes = ByteSize();
+		stats->MaxModelError = maxModelError;
+
+		// Measure what playback will actually produce at every original key.
+		for(UINT b = 0; b < numBones; ++b)
+		{
+			UINT keyIndex = 0;
+			for(const Keyframe& key : clip.BoneAnimations[b].Keyframes)
+			{
+				KeyError error = CompareKeyframes(key, SampleTrack(b, key.TimePos, keyIndex));
+				stats->MaxTranslationError = std::max(stats->MaxTranslationError, error.Translation);
+				stats->MaxRotationError = std::max(stats->MaxRotationError, error.Rotation);
+				stats->MaxScaleError = std::max(stats->MaxScaleError, error.Scale);
+			}
+		}
+	}
+
+	return true;
+}
+
+void CompressedAnimationClip::Decompress(AnimationClip& clip)const
+{
+	clip.Compressed.reset();
+	clip.BoneAnimations.assign(mTracks.size(), BoneAnimation());
+
+	for(UINT b = 0; b < (UINT)mTracks.size(); ++b)
+	{
+		const Track& track = mTracks[b];
+		std::vector<Keyframe>& keys = clip.BoneAnimations[b].Keyframes;
+		keys.reserve(track.NumKeyframes);
+		for(UINT k = 0; k < track.NumKeyframes; ++k)
+			keys.push_back(DecodeKeyframe(track, mKeyframes[track.FirstKeyframe + k]));
+	}
+}
+
+void CompressedAnimationClip::Clear()
+{
+	mStartTime = 0.0f;
+	mEndTime = 0.0f;
+	mTracks.clear();
+	mKeyframes.clear();
+}
+
+UINT CompressedAnimationClip::BoneCount()const
+{
+	return (UINT)mTracks.size();
+}
+
+UINT CompressedAnimationClip::KeyframeCount()const
+{
+	return (UINT)mKeyframes.size();
+}
+
+float CompressedAnimationClip::GetClipStartTime()const
+{
+	return mStartTime;
+}
+
+float CompressedAnimationClip::GetClipEndTime()const
+{
+	return mEndTime;
+}
+
+size_t CompressedAnimationClip::ByteSize()const
+{
+	return sizeof(CompressedAnimationClip) + mTracks.size()*sizeof(Track) + mKeyframes.size()*sizeof(PackedKeyframe);
+}
+
+void CompressedAnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
+{
+	for(UINT b = 0; b < (UINT)mTracks.size(); ++b)
+	{
+		UINT keyIndex = 0;
+		BoneTransform(b, t, boneTransforms[b], keyIndex);
+	}
+}
+
+void CompressedAnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor)const
+{
+	if( cursor.KeyIndices.size() != mTracks.size() )
+		cursor.KeyIndices.assign(mTracks.size(), 0);
+
+	for(UINT b = 0; b < (UINT)mTracks.size(); ++b)
+		BoneTransform(b, t, boneTransforms[b], cursor.KeyIndices[b]);
+}
+
+void CompressedAnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor,
+	const UINT* bones, UINT numBones)const
+{
+	if( cursor.KeyIndices.size() != mTracks.size() )
+		cursor.KeyIndices.assign(mTracks.size(), 0);
+
+	for(UINT i = 0; i < numBones; ++i)
+		BoneTransform(bones[i], t, boneTransforms[bones[i]], cursor.KeyIndices[bones[i]]);
+}
+
+void CompressedAnimationClip::BoneTransform(UINT bone, float t, XMFLOAT4X4& M, UINT& keyIndex)const
+{
+	Keyframe key = SampleTrack(bone, t, keyIndex);
+
+	XMVECTOR S = XMLoadFloat3(&key.Scale);
+	XMVECTOR P = XMLoadFloat3(&key.Translation);
+	XMVECTOR Q = XMLoadFloat4(&key.RotationQuat);
+
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+}
+
+Keyframe CompressedAnimationClip::SampleTrack(UINT bone, float t, UINT& keyIndex)const
+{
+	const Track& track = mTracks[bone];
+	const PackedKeyframe* keys = &mKeyframes[track.FirstKeyframe];
+	const UINT numKeys = track.NumKeyframes;
+
+	if( numKeys == 1 || t <= KeyTime(keys[0]) )
+		return DecodeKeyframe(track, keys[0]);
+	if( t >= KeyTime(keys[numKeys-1]) )
+		return DecodeKeyframe(track, keys[numKeys-1]);
+
+	// First interval [i, i+1] with t <= time of key i+1, found the same way
+	// as in BoneAnimation::Interpolate.
+	auto upperInterval = [&](UINT first)
+	{
+		const PackedKeyframe* next = std::lower_bound(keys + first, keys + numKeys, t,
+			[this](const PackedKeyframe& key, float time) { return KeyTime(key) < time; });
+		return (UINT)(next - keys) - 1;
+	};
+
+	const UINT MaxForwardSteps = 4;
+	UINT i = keyIndex;
+	if( i < numKeys-1 && KeyTime(keys[i]) < t )
+	{
+		UINT steps = 0;
+		while( KeyTime(keys[i+1]) < t && steps < MaxForwardSteps )
+		{
+			++i;
+			++steps;
+		}
+
+		if( KeyTime(keys[i+1]) < t )
+			i = upperInterval(i + 1);
+	}
+	else
+	{
+		i = upperInterval(0);
+	}
+	keyIndex = i;
+
+	return LerpKeyframes(DecodeKeyframe(track, keys[i]), DecodeKeyframe(track, keys[i+1]), t);
+}
+
+float CompressedAnimationClip::KeyTime(const PackedKeyframe& key)const
+{
+	return mStartTime + (mEndTime - mStartTime) * (key.Time / 65535.0f);
+}
+
+CompressedAnimationClip::PackedKeyframe CompressedAnimationClip::EncodeKeyframe(const Track& track, const Keyframe& keyframe)const
+{
+	float duration = mEndTime - mStartTime;
+
+	PackedKeyframe key;
+	key.Time = duration > 0.0f ? QuantizeUnit((keyframe.TimePos - mStartTime) / duration) : 0;
+	PackRotation(keyframe.RotationQuat, key.Rotation);
+	key.Translation[0] = QuantizeRange(keyframe.Translation.x, track.TranslationMin.x, track.TranslationStep.x);
+	key.Translation[1] = QuantizeRange(keyframe.Translation.y, track.TranslationMin.y, track.TranslationStep.y);
+	key.Translation[2] = QuantizeRange(keyframe.Translation.z, track.TranslationMin.z, track.TranslationStep.z);
+	key.Scale[0] = QuantizeRange(keyframe.Scale.x, track.ScaleMin.x, track.ScaleStep.x);
+	key.Scale[1] = QuantizeRange(keyframe.Scale.y, track.ScaleMin.y, track.ScaleStep.y);
+	key.Scale[2] = QuantizeRange(keyframe.Scale.z, track.ScaleMin.z, track.ScaleStep.z);
+
+	return key;
+}
+
+Keyframe CompressedAnimationClip::DecodeKeyframe(const Track& track, const PackedKeyframe& key)const
+{
+	Keyframe keyframe;
+	keyframe.TimePos = KeyTime(key);
+	keyframe.RotationQuat = UnpackRotation(key.Rotation);
+	keyframe.Translation = XMFLOAT3(
+		track.TranslationMin.x + key.Translation[0] * track.TranslationStep.x,
+		track.TranslationMin.y + key.Translation[1] * track.TranslationStep.y,
+		track.TranslationMin.z + key.Translation[2] * track.TranslationStep.z);
+	keyframe.Scale = XMFLOAT3(
+		track.ScaleMin.x + key.Scale[0] * track.ScaleStep.x,
+		track.ScaleMin.y + key.Scale[1] * track.ScaleStep.y,
+		track.ScaleMin.z + key.Scale[2] * track.ScaleStep.z);
+
+	return keyframe;
+}
@@ -0,0 +1,118 @@
+#ifndef COMPRESSEDANIMATIONCLIP_H
+#define COMPRESSEDANIMATIONCLIP_H
+
+#include "SkinnedData.h"
+
+///<summary>
+/// What compressing a clip achieved.  The translation, rotation and scale
+/// errors are measured at the original keyframe times against the original
+/// keys, in the bone's parent space.  MaxModelError is the bound the
+/// tolerance applies to (see CompressedAnimationClip).
+///</summary>
+struct AnimationCompressionStats
+{
+	UINT OriginalKeyframes = 0;
+	UINT KeptKeyframes = 0;
+	size_t OriginalBytes = 0;
+	size_t CompressedBytes = 0;
+
+	float MaxTranslationError = 0.0f;
+	float MaxRotationError = 0.0f;	// radians
+	float MaxScaleError = 0.0f;
+	float MaxModelError = 0.0f;	// model units
+
+	float Ratio()const { return CompressedBytes > 0 ? (float)OriginalBytes / CompressedBytes : 0.0f; }
+};
+
+///<summary>
+/// A lossy, compact form of an AnimationClip, decoded as it is interpolated.
+///
+/// Keyframes that linear (translation, scale) or spherical (rotation)
+/// interpolation of their neighbours reproduces closely enough are
+/// dropped.  The tolerance is a distance in model units: at every original
+/// keyframe time, and halfway between them, no point within a bone's reach
+/// of its joint is moved further than tolerance from where the original
+/// clip puts it in model space.  The reach is that of the vertices
+/// weighted to the bone when it is given (see BoneBounds::ComputeReach),
+/// which bounds the error of the skinned mesh.  Otherwise it is estimated
+/// by the bone's lever arm: the longest chain of child bones it swings
+/// around, and at least the average bone length.
+///
+/// Keys are first dropped against a per-bone budget: a bone's share of the
+/// tolerance shrinks with the number of bone levels below it, and its
+/// rotation and scale shares are divided by its lever arm, so joints near
+/// the root, whose errors are carried to every descendant, keep more of
+/// their keys.  The whole skeleton is then posed from the quantized keys
+/// and, wherever the bound is broken, the dropped key that interpolation
+/// misses most is put back on the bone contributing most to the error,
+/// until it holds.
+///
+/// The kept keys are stored in 22 bytes instead of 44: the time as 16 bits
+/// of the clip duration, the rotation as its three smallest components in
+/// 20 bits each, and translation and scale as 16 bits per axis of their
+/// range over the bone's track.
+///</summary>
+class CompressedAnimationClip
+{
+public:
+	// Compresses clip, whose bones are arranged by boneHierarchy (parent
+	// indices ordered as SkinnedData::ValidateBoneHierarchy checks).
+	// boneReach holds each bone's reach, or is empty to estimate it.
+	// Returns false if the clip has no bones, a bone has no keyframes, the
+	// hierarchy or reach does not match the clip, or even keeping every key
+	// the quantized clip is not within tolerance, leaving the clip empty.
+	bool Compress(const AnimationClip& clip, const std::vector<int>& boneHierarchy,
+		const std::vector<float>& boneReach, float tolerance, AnimationCompressionStats* stats = nullptr);
+
+	// Rebuilds full precision keyframes from the compressed ones.
+	void Decompress(AnimationClip& clip)const;
+
+	UINT BoneCount()const;
+	UINT KeyframeCount()const;
+	float GetClipStartTime()const;
+	float GetClipEndTime()const;
+	size_t ByteSize()const;
+
+	// Same results and cursor use as AnimationClip::Interpolate.
+	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms)const;
+	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor)const;
+	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor,
+		const UINT* bones, UINT numBones)const;
+
+private:
+	struct PackedKeyframe
+	{
+		UINT16 Time;
+		UINT16 Rotation[4];
+		UINT16 Translation[3];
+		UINT16 Scale[3];
+	};
+
+	struct Track
+	{
+		UINT FirstKeyframe = 0;
+		UINT NumKeyframes = 0;
+
+		// Dequantization: value = min + q*step, per axis.
+		DirectX::XMFLOAT3 TranslationMin = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 TranslationStep = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 ScaleMin = { 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3 ScaleStep = { 0.0f, 0.0f, 0.0f };
+	};
+
+	void BoneTransform(UINT bone, float t, DirectX::XMFLOAT4X4& M, UINT& keyIndex)const;
+	Keyframe SampleTrack(UINT bone, float t, UINT& keyIndex)const;
+	float KeyTime(const PackedKeyframe& key)const;
+	PackedKeyframe EncodeKeyframe(const Track& track, const Keyframe& keyframe)const;
+	Keyframe DecodeKeyframe(const Track& track, const PackedKeyframe& key)const;
+	void Clear();
+
+private:
+	float mStartTime = 0.0f;
+	float mEndTime = 0.0f;
+
+	std::vector<Track> mTracks;
+	std::vector<PackedKeyframe> mKeyframes;
+};
+
+#endif // COMPRESSEDANIMATIONCLIP_H
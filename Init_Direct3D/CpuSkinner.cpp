@@ -0,0 +1,126 @@
+#include "CpuSkinner.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertices per ParallelFor batch; a few thousand vertices are too few
+	// to be worth more than a handful of batches.
+	const UINT VerticesPerBatch = 512;
+
+	XMFLOAT3* StreamElement(XMFLOAT3* first, UINT stride, UINT i)
+	{
+		return reinterpret_cast<XMFLOAT3*>(reinterpret_cast<BYTE*>(first) + (size_t)i * stride);
+	}
+}
+
+CpuSkinner::CpuSkinner(ThreadPool* threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
+void CpuSkinner::Skin(const M3DLoader::SkinnedVertex* vertices, UINT numVertices,
+	const XMFLOAT4X4* finalTransforms, UINT numBones, const SkinnedStream& output)
+{
+	// The final transforms are stored transposed for the shaders.
+	if( mBoneTransforms.size() < numBones )
+		mBoneTransforms.resize(numBones);
+	for(UINT i = 0; i < numBones; ++i)
+		XMStoreFloat4x4(&mBoneTransforms[i], XMMatrixTranspose(XMLoadFloat4x4(&finalTransforms[i])));
+
+	const UINT numBatches = (numVertices + VerticesPerBatch - 1) / VerticesPerBatch;
+	if( mThreadPool == nullptr || numBatches < 2 )
+	{
+		SkinRange(vertices, 0, numVertices, output);
+		return;
+	}
+
+	mThreadPool->ParallelFor(numBatches, [&](UINT batch)
+	{
+		UINT first = batch * VerticesPerBatch;
+		SkinRange(vertices, first, std::min(first + VerticesPerBatch, numVertices), output);
+	});
+}
+
+void CpuSkinner::SkinRange(const M3DLoader::SkinnedVertex* vertices, UINT first, UINT last,
+	const SkinnedStream& output)const
+{
+	const XMFLOAT4X4* bones = mBoneTransforms.data();
+
+	for(UINT v = first; v < last; ++v)
+	{
+		const M3DLoader::SkinnedVertex& vertex = vertices[v];
+
+		XMVECTOR weights = XMVectorSet(vertex.BoneWeights.x, vertex.BoneWeights.y, vertex.BoneWeights.z, 0.0f);
+		weights = XMVectorSetW(weights, 1.0f - vertex.BoneWeights.x - vertex.BoneWeights.y - vertex.BoneWeights.z);
+
+		// Blend the four matrices once, then transform every attribute by
+		// the result instead of by each bone.
+		XMMATRIX M = XMLoadFloat4x4(&bones[vertex.BoneIndices[0]]);
+		XMVECTOR w = XMVectorSplatX(weights);
+		M.r[0] = XMVectorMultiply(M.r[0], w);
+		M.r[1] = XMVectorMultiply(M.r[1], w);
+		M.r[2] = XMVectorMultiply(M.r[2], w);
+		M.r[3] = XMVectorMultiply(M.r[3], w);
+
+		const XMVECTOR splat[3] = { XMVectorSplatY(weights), XMVectorSplatZ(weights), XMVectorSplatW(weights) };
+		for(UINT i = 1; i < 4; ++i)
+		{
+			XMMATRIX B = XMLoadFloat4x4(&bones[vertex.BoneIndices[i]]);
+			M.r[0] = XMVectorMultiplyAdd(B.r[0], splat[i-1], M.r[0]);
+			M.r[1] = XMVectorMultiplyAdd(B.r[1], splat[i-1], M.r[1]);
+			M.r[2] = XMVectorMultiplyAdd(B.r[2], splat[i-1], M.r[2]);
+			M.r[3] = XMVectorMultiplyAdd(B.r[3], splat[i-1], M.r[3]);
+		}
+
+		if( output.Positions != nullptr )
+			XMStoreFloat3(StreamElement(output.Positions, output.Stride, v), XMVector3Transform(XMLoadFloat3(&vertex.Pos), M));
+
+		// Assumes no nonuniform scaling, as the shaders do.
+		if( output.Normals != nullptr )
+			XMStoreFloat3(StreamElement(output.Normals, output.Stride, v), XMVector3TransformNormal(XMLoadFloat3(&vertex.Normal), M));
+		if( output.Tangents != nullptr )
+			XMStoreFloat3(StreamElement(output.Tangents, output.Stride, v), XMVector3TransformNormal(XMLoadFloat3(&vertex.TangentU), M));
+	}
+}
+
+void CpuSkinner::SkinReference(const M3DLoader::SkinnedVertex* vertices, UINT numVertices,
+	const XMFLOAT4X4* finalTransforms, const SkinnedStream& output)
+{
+	for(UINT v = 0; v < numVertices; ++v)
+	{
+		const M3DLoader::SkinnedVertex& vertex = vertices[v];
+		const float weights[4] = { vertex.BoneWeights.x, vertex.BoneWeights.y, vertex.BoneWeights.z,
+			1.0f - vertex.BoneWeights.x - vertex.BoneWeights.y - vertex.BoneWeights.z };
+
+		// Each final transform row r is column r of the bone matrix, as in
+		// the shader: p' = (dot(row0, p), dot(row1, p), dot(row2, p)).
+		float rows[3][4] = {};
+		for(UINT i = 0; i < 4; ++i)
+		{
+			const XMFLOAT4X4& T = finalTransforms[vertex.BoneIndices[i]];
+			for(UINT r = 0; r < 3; ++r)
+			{
+				for(UINT c = 0; c < 4; ++c)
+					rows[r][c] += weights[i] * T.m[r][c];
+			}
+		}
+
+		const XMFLOAT3* attributes[3] = { &vertex.Pos, &vertex.Normal, &vertex.TangentU };
+		XMFLOAT3* streams[3] = { output.Positions, output.Normals, output.Tangents };
+		for(UINT a = 0; a < 3; ++a)
+		{
+			if( streams[a] == nullptr )
+				continue;
+
+			// Only positions are translated.
+			const XMFLOAT3& in = *attributes[a];
+			float h = a == 0 ? 1.0f : 0.0f;
+			XMFLOAT3* out = StreamElement(streams[a], output.Stride, v);
+			out->x = rows[0][0] * in.x + rows[0][1] * in.y + rows[0][2] * in.z + rows[0][3] * h;
+			out->y = rows[1][0] * in.x + rows[1][1] * in.y + rows[1][2] * in.z + rows[1][3] * h;
+			out->z = rows[2][0] * in.x + rows[2][1] * in.y + rows[2][2] * in.z + rows[2][3] * h;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef CPUSKINNER_H
+#define CPUSKINNER_H
+
+#include "../Common/ThreadPool.h"
+#include "LoadM3d.h"
+
+///<summary>
+/// Where CpuSkinner writes the skinned attributes.  Each pointer is the
+/// first vertex's element and the next is Stride bytes further, so the
+/// attributes can go straight into an interleaved vertex buffer or into
+/// separate arrays.  Attributes left nullptr are not computed.
+///</summary>
+struct SkinnedStream
+{
+	DirectX::XMFLOAT3* Positions = nullptr;
+	DirectX::XMFLOAT3* Normals = nullptr;
+	DirectX::XMFLOAT3* Tangents = nullptr;
+	UINT Stride = sizeof(DirectX::XMFLOAT3);
+};
+
+///<summary>
+/// Skins M3DLoader::SkinnedVertex data on the CPU with the same four bone
+/// linear blend as Params.hlsl, so a model can be skinned once per frame and
+/// the result drawn by every pass, picked or bounded without a GPU.
+///
+/// The bone matrices are weighted and summed with DirectXMath vectors
+/// before a single transform per attribute, and with a thread pool the
+/// vertices are split into batches over the workers.  SkinReference is a
+/// plain scalar version kept to check it against.
+///</summary>
+class CpuSkinner
+{
+public:
+	explicit CpuSkinner(ThreadPool* threadPool = nullptr);
+	CpuSkinner(const CpuSkinner& rhs) = delete;
+	CpuSkinner& operator=(const CpuSkinner& rhs) = delete;
+
+	// finalTransforms are numBones transforms as SkinnedData::GetFinalTransforms
+	// produces them, indexed by the vertices' BoneIndices.  Not reentrant:
+	// the transforms are staged in the skinner.
+	void Skin(const M3DLoader::SkinnedVertex* vertices, UINT numVertices,
+		const DirectX::XMFLOAT4X4* finalTransforms, UINT numBones, const SkinnedStream& output);
+
+	static void SkinReference(const M3DLoader::SkinnedVertex* vertices, UINT numVertices,
+		const DirectX::XMFLOAT4X4* finalTransforms, const SkinnedStream& output);
+
+private:
+	void SkinRange(const M3DLoader::SkinnedVertex* vertices, UINT first, UINT last,
+		const SkinnedStream& output)const;
+
+private:
+	ThreadPool* mThreadPool = nullptr;
+
+	// This frame's bone transforms, transposed back to row vector form.
+	std::vector<DirectX::XMFLOAT4X4> mBoneTransforms;
+};
+
+#endif // CPUSKINNER_H
@@ -336,25 +336,25 @@ bool D3DApp::InitDirect3D()
 			IID_PPV_ARGS(&md3dDevice)));
 	}
 
-	// Ÿ(Fence) 
+	// 울타리(Fence) 생성
 	ThrowIfFailed(md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
 
-	//  ũ GPU ٸ  ʱȭ Ȯ
-	//  Ÿ   ũ
+	// 서술자의 크기는 GPU마다 다르기 때문에 초기화시 확인
+	// 렌더 타겟 뷰의 서술자 크기
 	mRtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-	//  ٽ   ũ
+	// 깊이 스텐실 뷰 서술자 크기
 	mDsvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-	//    ũ
+	// 상수 버퍼 서술자 크기
 	mCbvSrvUavDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	// Ƽ ø   
+	// 멀티 샘플링 설정  
 	D3D12_FEATURE_DATA_MULTISAMPLE_QUALITY_LEVELS msQualityLevels;
 	msQualityLevels.Format = mBackBufferFormat;
 	msQualityLevels.SampleCount = 4; // 4x MSAA
 	msQualityLevels.Flags = D3D12_MULTISAMPLE_QUALITY_LEVELS_FLAG_NONE;
 	msQualityLevels.NumQualityLevels = 0;
 
-	// ĸ  4X MSAA   ˻
+	// 후면 버퍼 4X MSAA 지원 여부 검사
 	ThrowIfFailed(md3dDevice->CheckFeatureSupport(
 		D3D12_FEATURE_MULTISAMPLE_QUALITY_LEVELS,
 		&msQualityLevels,
@@ -391,7 +391,7 @@ void D3DApp::FlushCommandQueue()
 
 void D3DApp::CreateCommandObjects()
 {
-	// Command Queue 
+	// Command Queue 생성
 	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
 	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
 	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -85,7 +85,7 @@ protected:
     int mClientWidth = 800;
     int mClientHeight = 600;
 
-    // Used to keep track of the delta-time?and game time (?.4).
+    // Used to keep track of the 밺elta-time?and game time (?.4).
     GameTimer mTimer;
 
 protected:
@@ -95,7 +95,7 @@ protected:
     ComPtr<ID3D12Fence>     mFence;
     UINT64                  mCurrentFence = 0;
 
-    //  ũ 
+    // 서술자 크기 얻기
     UINT                    mRtvDescriptorSize = 0;
     UINT                    mDsvDescriptorSize = 0;
     UINT                    mCbvSrvUavDescriptorSize = 0;
@@ -108,12 +108,12 @@ protected:
     DXGI_FORMAT             mBackBufferFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
     DXGI_FORMAT             mDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
 
-    //  ť,  Ʈ,  Ҵ 
+    // 명령 큐, 명령 리스트, 명령 할당자 선언
     ComPtr<ID3D12CommandQueue>          mCommandQueue;
     ComPtr<ID3D12CommandAllocator>      mDirectCmdListAlloc;
     ComPtr<ID3D12GraphicsCommandList>   mCommandList;
 
-    //  ü
+    // 스왑 체인
     ComPtr<IDXGISwapChain>              mSwapChain;
 
     static const int SwapChainBufferCount = 2;
@@ -123,12 +123,12 @@ protected:
     ComPtr<ID3D12DescriptorHeap>        mRtvHeap;
     D3D12_CPU_DESCRIPTOR_HANDLE         mRtvView[SwapChainBufferCount] = {};
 
-    //  ٽ 
+    // 깊이 스텐실 버퍼
     ComPtr<ID3D12Resource>              mDepthStencilBuffer;
     ComPtr<ID3D12DescriptorHeap>        mDsvHeap;
     D3D12_CPU_DESCRIPTOR_HANDLE         mDsvView = {};
 
-    // Ʈ
+    // 뷰포트
     D3D12_VIEWPORT                      mScreenViewport;
     D3D12_RECT                          mScissorRect;
 };
@@ -1,6 +1,8 @@
 #pragma once
 
-#include "SkinnedData.h"
+#include "AnimationSystem.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
 
@@ -38,14 +40,14 @@ struct SkinnedVertex
 	BYTE BoneIndices[4];
 };
 
-//  Ʈ 
+// 개별 오브젝트 상수
 struct ObjectConstants
 {
 	XMFLOAT4X4 World = MathHelper::Identity4x4();
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 };
 
-//  Ʈ  
+// 개별 오브젝트의 재질 상수
 struct MatConstants
 {
 	XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -56,7 +58,7 @@ struct MatConstants
 	XMFLOAT2 padding = { 0.0f, 0.0f };
 };
 
-//   ü
+// 조명 정보 구조체
 struct LightInfo
 {
 	UINT LightTyp = 0;
@@ -69,7 +71,7 @@ struct LightInfo
 	float SpotPower = 64.0f;
 };
 
-//  ϴ 
+// 공용 사용하는 상수
 struct PassConstants
 {
 	XMFLOAT4X4 View = MathHelper::Identity4x4();
@@ -80,46 +82,49 @@ struct PassConstants
 	XMFLOAT4X4 InvViewProj = MathHelper::Identity4x4();
 	XMFLOAT4X4 ShadowTransform = MathHelper::Identity4x4();
 
-	//  
+	// 조명 정보
 	XMFLOAT4 AmbientLight = { 0.0f, 0.0f, 0.0f, 1.0f };
 	XMFLOAT3 EyePosW = { 0.0f, 0.0f, 0.0f };
 	UINT LightCount = MAXLIGHTS;
 	LightInfo Lights[MAXLIGHTS];
 
-	// Ȱ ȿ 
+	// 안개 효과 정보
 	XMFLOAT4 FogColor = { 0.7f, 0.7f, 0.7f, 1.0f };
 	float gFogStart = 5.0f;
 	float gFogRange = 150.0f;
 	XMFLOAT2 FogPadding;
 };
 
-struct SkinnedConstants
-{
-	XMFLOAT4X4 BoneTransforms[96];
-};
-
 struct GeometryInfo
 {
 	std::string Name;
 
-	//   
+	// 정점 버퍼 뷰
 	D3D12_VERTEX_BUFFER_VIEW                VertexView = { };
 	ComPtr<ID3D12Resource>                  VertexBuffer = nullptr;
 
-	// ε  
+	// 인덱스 버퍼 뷰
 	D3D12_INDEX_BUFFER_VIEW                 IndexView = { };
 	ComPtr<ID3D12Resource>                  IndexBuffer = nullptr;
 
-	//  
+	// 정점의 갯수
 	int VertexCount = 0;
-	// ε 
+	// 인덱스의 갯수
 	int IndexCount = 0;
+	// 인덱스 형식 (16비트 또는 32비트)
+	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// 인덱스 버퍼 안에 이어 붙인 LOD 범위. 비어 있으면 IndexCount 만큼 그린다.
+	std::vector<MeshLod> Lods;
+
+	// LOD 0 의 인덱스 범위를 나눈 메시렛. 비어 있으면 클러스터 컬링을 하지 않는다.
+	std::vector<Meshlet> Meshlets;
 };
 
-// ؽó ü
+// 텍스처 구조체
 struct TextureInfo
 {
 	// Unique material name for lookup.
@@ -131,7 +136,7 @@ struct TextureInfo
 	ComPtr<ID3D12Resource> UploadHeap = nullptr;
 };
 
-//  ü
+// 재질 구조체
 struct MaterialInfo
 {
 	std::string Name;
@@ -145,31 +150,7 @@ struct MaterialInfo
 	float Roughness = 0.25f;
 };
 
-struct SkinnedModelInstance
-{
-	SkinnedData* SkinnedInfo = nullptr;
-	std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
-	std::string ClipName;
-	float TimePos = 0.0f;
-
-	// Called every frame and increments the time position, interpolates the 
-	// animations for each bone based on the current animation clip, and 
-	// generates the final transforms which are ultimately set to the effect
-	// for processing in the vertex shader.
-	void UpdateSkinnedAnimation(float dt)
-	{
-		TimePos += dt;
-
-		// Loop animation
-		if (TimePos > SkinnedInfo->GetClipEndTime(ClipName))
-			TimePos = 0.0f;
-
-		// Compute the final transforms for this time position.
-		SkinnedInfo->GetFinalTransforms(ClipName, TimePos, FinalTransforms);
-	}
-};
-
-// Ʈ ü
+// 오브젝트 구조체
 struct RenderItem
 {
 	RenderItem() = default;
@@ -181,13 +162,27 @@ struct RenderItem
 
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
-	//  
+	// 기하 정보
 	GeometryInfo* Geo = nullptr;
 	MaterialInfo* Mat = nullptr;
 
 	// Only applicable to skinned render-items.
 	UINT SkinnedCBIndex = -1;
 
+	// 인스턴스 슬롯 안에서 이 서브셋 팔레트의 바이트 오프셋
+	UINT SkinnedPaletteOffset = 0;
+
 	// nullptr if this render-item is not animated by skinned mesh.
 	SkinnedModelInstance* SkinnedModelInst = nullptr;
+
+	// 월드 공간 경계 상자. 스킨 렌더 아이템은 매 프레임 포즈로부터 갱신된다.
+	BoundingBox Bounds;
+
+	// 이번 프레임에 그릴 Geo->Lods 의 인덱스
+	UINT Lod = 0;
+
+	// 이번 프레임에 컬링에서 살아남은 메시렛 범위. MeshletCulled 가 false 면
+	// 쓰지 않고 LOD 범위를 그린다.
+	bool MeshletCulled = false;
+	std::vector<MeshletDraw> MeshletDraws;
 };
\ No newline at end of file
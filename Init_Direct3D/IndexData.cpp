@@ -0,0 +1,119 @@
+#include "IndexData.h"
+
+DXGI_FORMAT IndexData::FormatForVertexCount(size_t numVertices)
+{
+	// 16 bit indices reach vertex 65535, so they cover 65536 vertices.
+	return numVertices <= 0x10000 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+UINT IndexData::FormatStride(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R32_UINT ? sizeof(UINT) : sizeof(USHORT);
+}
+
+void IndexData::Resize(UINT count, size_t numVertices)
+{
+	Resize(count, FormatForVertexCount(numVertices));
+}
+
+void IndexData::Resize(UINT count, DXGI_FORMAT format)
+{
+	assert(format == DXGI_FORMAT_R16_UINT || format == DXGI_FORMAT_R32_UINT);
+
+	mFormat = format;
+	if( mFormat == DXGI_FORMAT_R16_UINT )
+	{
+		mIndices16.resize(count);
+		mIndices32.clear();
+	}
+	else
+	{
+		mIndices32.resize(count);
+		mIndices16.clear();
+	}
+}
+
+void IndexData::Assign(const UINT* indices, UINT count, size_t numVertices)
+{
+	Resize(count, numVertices);
+	if( mFormat == DXGI_FORMAT_R16_UINT )
+	{
+		for(UINT i = 0; i < count; ++i)
+			mIndices16[i] = (USHORT)indices[i];
+	}
+	else
+	{
+		std::copy(indices, indices + count, mIndices32.begin());
+	}
+}
+
+void IndexData::Assign(const void* indices, UINT count, DXGI_FORMAT format)
+{
+	Resize(count, format);
+	if( count > 0 )
+		memcpy(mFormat == DXGI_FORMAT_R16_UINT ? (void*)mIndices16.data() : (void*)mIndices32.data(), indices, (size_t)count*Stride());
+}
+
+void IndexData::Clear()
+{
+	mIndices16.clear();
+	mIndices32.clear();
+}
+
+void IndexData::Set(UINT i, UINT index)
+{
+	if( mFormat == DXGI_FORMAT_R16_UINT )
+	{
+		assert(index <= 0xFFFF);
+		mIndices16[i] = (USHORT)index;
+	}
+	else
+	{
+		mIndices32[i] = index;
+	}
+}
+
+UINT IndexData::Get(UINT i)const
+{
+	return mFormat == DXGI_FORMAT_R16_UINT ? mIndices16[i] : mIndices32[i];
+}
+
+DXGI_FORMAT IndexData::Format()const
+{
+	return mFormat;
+}
+
+UINT IndexData::Stride()const
+{
+	return FormatStride(mFormat);
+}
+
+UINT IndexData::Count()const
+{
+	return (UINT)(mFormat == DXGI_FORMAT_R16_UINT ? mIndices16.size() : mIndices32.size());
+}
+
+UINT IndexData::ByteSize()const
+{
+	return Count()*Stride();
+}
+
+bool IndexData::Empty()const
+{
+	return Count() == 0;
+}
+
+const void* IndexData::Data()const
+{
+	return mFormat == DXGI_FORMAT_R16_UINT ? (const void*)mIndices16.data() : (const void*)mIndices32.data();
+}
+
+const USHORT* IndexData::Data16()const
+{
+	return mFormat == DXGI_FORMAT_R16_UINT ? mIndices16.data() : nullptr;
+}
+
+const UINT* IndexData::Data32()const
+{
+	return mFormat == DXGI_FORMAT_R32_UINT ? mIndices32.data() : nullptr;
+}
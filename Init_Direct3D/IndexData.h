@@ -0,0 +1,50 @@
+#ifndef INDEXDATA_H
+#define INDEXDATA_H
+
+#include "../Common/d3dUtil.h"
+
+///<summary>
+/// Index buffer contents stored in either 16 or 32 bit form.  The width is
+/// picked from the number of vertices the indices address: meshes with at
+/// most 65536 vertices get DXGI_FORMAT_R16_UINT, which halves index memory
+/// and bandwidth, and larger meshes get DXGI_FORMAT_R32_UINT so no index is
+/// ever truncated.  Data() can be copied straight into an index buffer and
+/// Format used for its D3D12_INDEX_BUFFER_VIEW.
+///</summary>
+class IndexData
+{
+public:
+	// The narrowest index format that can address numVertices vertices.
+	static DXGI_FORMAT FormatForVertexCount(size_t numVertices);
+	static UINT FormatStride(DXGI_FORMAT format);
+
+	// Sizes the array for count indices into numVertices vertices, choosing
+	// the format.  The contents are zero until written with Set.
+	void Resize(UINT count, size_t numVertices);
+	void Resize(UINT count, DXGI_FORMAT format);
+
+	void Assign(const UINT* indices, UINT count, size_t numVertices);
+	void Assign(const void* indices, UINT count, DXGI_FORMAT format);
+	void Clear();
+
+	// Thread safe for distinct i.
+	void Set(UINT i, UINT index);
+	UINT Get(UINT i)const;
+
+	DXGI_FORMAT Format()const;
+	UINT Stride()const;
+	UINT Count()const;
+	UINT ByteSize()const;
+	bool Empty()const;
+
+	const void* Data()const;
+	const USHORT* Data16()const; // nullptr unless the format is R16_UINT
+	const UINT* Data32()const;   // nullptr unless the format is R32_UINT
+
+private:
+	DXGI_FORMAT mFormat = DXGI_FORMAT_R16_UINT;
+	std::vector<USHORT> mIndices16;
+	std::vector<UINT> mIndices32;
+};
+
+#endif // INDEXDATA_H
@@ -12,7 +12,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     {
         InitDirect3DApp theApp(hInstance);
         if (!theApp.Initialize())
-            return 0;
+            return 1;
 
         return theApp.Run();
     }
@@ -30,6 +30,9 @@ InitDirect3DApp::InitDirect3DApp(HINSTANCE hInstance)
 
 InitDirect3DApp::~InitDirect3DApp()
 {
+    // 계산 중인 다음 프레임이 스킨 데이터를 다 쓸 때까지 기다린다.
+    if (mAnimationPipeline != nullptr)
+        mAnimationPipeline->Fetch();
 }
 
 bool InitDirect3DApp::Initialize()
@@ -37,29 +40,70 @@ bool InitDirect3DApp::Initialize()
     if (!D3DApp::Initialize())
         return false;
 
-    // ʱȭ ɵ غϱ    缳 Ѵ.
+    // 초기화 명령들을 준비하기 위해 명령 목록을 재설정 한다.
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
     // -----------------------------------------------------------
-    // ʱȭ ɵ
+    // 초기화 명령들
     // -----------------------------------------------------------
 
-    // ׸  
+    // 그림자 맵 구축
     mShadowMap = std::make_unique<ShadowMap>(md3dDevice.Get(), 2048, 2048);
 
     mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
     mSceneBounds.Radius = sqrtf(10.0f * 10.0f + 15.0f * 15.0f);
     
-    // ī޶ ʱ ġ 
+    // 카메라 초기 위치 셋팅
     mCamera.SetPosition(0.0f, 2.0f, -15.0f);
 
-    // Ų  ε
-    LoadSkinnedModel();
+    // 작업자 스레드 풀 생성
+    mThreadPool = std::make_unique<ThreadPool>();
 
-    // ؽó ε
+    mMainWndCaptionBase = mMainWndCaption;
+
+    // 지난 실행에서 만든 LOD. 없거나 입력이 바뀌었으면 새로 만든다.
+    if (mMeshLods)
+        mMeshLodCache.Read(mMeshLodCacheFilename);
+
+    // 스킨 모델 로드
+    if (!LoadSkinnedModel())
+        return false;
+
+#if defined(RUN_BENCHMARKS)
+    bool benchmarksPassed = true;
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::ModelParsing(mSkinnedModelFilename, mSkinnedModelBinaryFilename, "../Models/skull.txt", 10, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationSampling(mSkinnedInfo, mSkinnedClipName, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::ClipInterpolation(mSkinnedInfo, mSkinnedClipName, 30.0f, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::ClipInterpolation(mSkinnedInfo, mSkinnedClipName, 60.0f, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::BoneConcatenation(100));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::GeometrySubdivision(10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::GeometryGeneration(4096, 2048, 3, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::MeshOptimization(mSkinnedModelFilename, "../Models/skull.txt", 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::MeshSimplification(mSkinnedModelFilename, "../Models/skull.txt", mMeshLodRatios, 3));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::MeshletCulling("../Models/skull.txt", 100));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationAllocations(mSkinnedInfo, mSkinnedBoneBounds, mSkinnedClipName, mSkinnedLodPolicy, 256, 600, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationUpdate(mSkinnedInfo, mSkinnedClipName, 256, 10, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::PalettePacking(mSkinnedInfo, mSkinnedClipName, 256, 100));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::SubsetPalettes(mSkinnedModelFilename, mSkinnedClipName, 256, 100));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::CpuSkinning(mSkinnedModelFilename, mSkinnedClipName, 100, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::SkinnedBounds(mSkinnedModelFilename, mSkinnedClipName, 100));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationBaking(mSkinnedInfo, mSkinnedClipName, 30.0f, BonePaletteFormat::Affine3x4, 1024, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationBaking(mSkinnedInfo, mSkinnedClipName, 30.0f, BonePaletteFormat::Affine3x4Half, 1024, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationCompression(mSkinnedInfo, mSkinnedBoneBounds, mSkinnedClipName, 0.01f, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationCompression(mSkinnedInfo, mSkinnedBoneBounds, mSkinnedClipName, 0.1f, 10));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::PoseCaching(mSkinnedInfo, mSkinnedClipName, 256, 1.0f / 30.0f, 10, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationLod(mSkinnedInfo, mSkinnedClipName, mSkinnedLodPolicy, 1024, 10, mThreadPool.get()));
+    benchmarksPassed &= Benchmarks::Log(Benchmarks::AnimationPipelining(mSkinnedInfo, mSkinnedClipName, 256, 2.0, 10, mThreadPool.get()));
+
+    // 검사 결과가 하나라도 실패하면 0이 아닌 코드로 종료한다.
+    if (!benchmarksPassed)
+        return false;
+#endif
+
+    // 텍스처 로드
     LoadTextures();
 
-    //   
+    // 기하 도형 생성
     BuildBoxGeometry();
     BuildGridGeometry();
     BuildSphereGeometry();
@@ -67,27 +111,30 @@ bool InitDirect3DApp::Initialize()
     BuildQuadGeometry();
     BuildSkullGeometry();
 
+    if (mMeshLodCache.IsDirty())
+        mMeshLodCache.Write(mMeshLodCacheFilename);
+
     BuildDescriptorHeaps();
 
-    //  
+    // 재질 생성
     BuildMaterials();
 
-    //  Ʈ 
+    // 렌더링할 오브젝트 생성
     BuildRenderItems();
 
-    //  
+    // 렌더링 설정
     BuildInputLayout();
     BuildShaders();
     BuildConstantBuffers();
     BuildRootSignature();
     BuildPSO();
 
-    // ʱȭ ɵ Ѵ.
+    // 초기화 명령들을 실행한다.
     ThrowIfFailed(mCommandList->Close());
     ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
     mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
-    // ʱȭ Ϸ   ٸ.
+    // 초기화가 완료 될 때까지 기다린다.
     FlushCommandQueue();
 
     return true;
@@ -144,7 +191,7 @@ void InitDirect3DApp::OnResize()
 {
     D3DApp::OnResize();
 
-    // â ũⰡ ٲǷ Ⱦ ϰ   ٽ Ѵ.
+    // 창의 크기가 바뀌었으므로 종횡비를 갱신하고 투영 행렬을 다시 계산한다.
     mCamera.SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 }
 
@@ -163,8 +210,12 @@ void InitDirect3DApp::Update(const GameTimer& gt)
     UpdateCamera(gt);
     UpdateObjectCBs(gt);
     UpdateMaterialCBs(gt);
-    UpdateSkinnedCBs(gt);
+    // 애니메이션이 이번 프레임의 그림자 상자로 컬링하도록 먼저 갱신한다.
     UpdateShadowTransform(gt);
+    UpdateSkinnedCBs(gt);
+    UpdateSkinnedVisibility();
+    UpdateMeshLods();
+    UpdateMeshletCulling();
     UpdatePassCB(gt);
     UpdateShadowPassCB(gt);
 }
@@ -195,7 +246,7 @@ void InitDirect3DApp::UpdateObjectCBs(const GameTimer& gt)
         XMMATRIX world = XMLoadFloat4x4(&e->World);
         XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
 
-        //  Ʈ   
+        // 개별 오브젝트 상수 버퍼 갱신
         ObjectConstants objConstants;
         XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 
@@ -228,16 +279,171 @@ void InitDirect3DApp::UpdateMaterialCBs(const GameTimer& gt)
 
 void InitDirect3DApp::UpdateSkinnedCBs(const GameTimer& gt)
 {
-    // We only have one skinned model being animated.
-    mSkinnedModelInst->UpdateSkinnedAnimation(gt.DeltaTime());
+    // Poses are computed on the thread pool and written straight into each
+    // instance's slot of the skinned constant buffer.
+    if (mSkinnedUseAtlas)
+    {
+        // 구운 프레임을 고르기만 한다.
+        mAnimationSystem->AdvanceTime(gt.DeltaTime());
+        for (UINT inst = 0; inst < mAnimationSystem->InstanceCount(); ++inst)
+            mSkinnedAtlasFrames[inst] = mSkinnedAtlas.Frame(mSkinnedAtlasClip, mAnimationSystem->GetInstance(inst)->TimePos);
+        return;
+    }
+
+    // 파이프라인에서는 지난 프레임 동안 계산된 팔레트를 받고, 시계와 시점을 넘겨 준 뒤
+    // 다음 프레임의 계산을 시작한다.
+    if (mAnimationPipeline != nullptr)
+    {
+        mSkinnedPaletteIndex = mAnimationPipeline->Fetch();
+        UpdateSkinnedBounds();
+        UpdateSkinnedLodCaption();
+
+        if (mSkinnedLod)
+            mAnimationSystem->SetLodView(mCamera, &mLightVolume);
+        mAnimationPipeline->Publish(gt.DeltaTime());
+        return;
+    }
+
+    if (mSkinnedLod)
+        mAnimationSystem->SetLodView(mCamera, &mLightVolume);
+
+    mAnimationSystem->Update(gt.DeltaTime());
+    UpdateSkinnedBounds();
+    UpdateSkinnedLodCaption();
+
+    if (mSkinnedOnCpu)
+        UpdateCpuSkinnedVertices();
+}
+
+void InitDirect3DApp::UpdateSkinnedBounds()
+{
+    // 포즈의 모델 공간 상자를 월드로 옮긴다. 파이프라인에서는 다음 프레임 계산을
+    // 시작하기 전에 불러야 한다.
+    for (RenderItem* ri : mRitemLayer[(int)RenderLayer::SkinnedOpaque])
+    {
+        SkinnedModelInstance* instance = ri->SkinnedModelInst;
+        instance->PoseBounds.Transform(ri->Bounds, XMLoadFloat4x4(&ri->World));
+        BoundingSphere::CreateFromBoundingBox(instance->Bounds, ri->Bounds);
+    }
+}
+
+void InitDirect3DApp::UpdateSkinnedVisibility()
+{
+    const std::vector<RenderItem*>& skinned = mRitemLayer[(int)RenderLayer::SkinnedOpaque];
+
+    // 아틀라스의 포즈에는 경계 상자가 없으므로 모두 그린다.
+    if (mSkinnedUseAtlas)
+    {
+        mSkinnedVisibleRitems = skinned;
+        mSkinnedShadowRitems = skinned;
+        return;
+    }
+
+    // 월드 공간의 카메라 절두체
+    BoundingFrustum viewFrustum;
+    BoundingFrustum::CreateFromMatrix(viewFrustum, mCamera.GetProj());
+    XMMATRIX view = mCamera.GetView();
+    XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+    BoundingFrustum worldFrustum;
+    viewFrustum.Transform(worldFrustum, invView);
+
+    mSkinnedVisibleRitems.clear();
+    mSkinnedShadowRitems.clear();
+    for (RenderItem* ri : skinned)
+    {
+        if (worldFrustum.Intersects(ri->Bounds))
+            mSkinnedVisibleRitems.push_back(ri);
+        if (mLightVolume.Intersects(ri->Bounds))
+            mSkinnedShadowRitems.push_back(ri);
+    }
+}
+
+void InitDirect3DApp::UpdateMeshLods()
+{
+    // 월드 단위 1이 거리 1에서 차지하는 픽셀 수
+    const float pixelsPerUnit = 0.5f * mClientHeight / tanf(0.5f * mCamera.GetFovY());
+    const XMVECTOR eye = mCamera.GetPosition();
+
+    for (auto& ri : mRenderitems)
+    {
+        ri->Lod = 0;
+        if (!mMeshLods || ri->Geo == nullptr || ri->Geo->Lods.size() < 2)
+            continue;
+
+        // 모델 공간의 오차를 월드 행렬의 가장 큰 축 배율로 늘린다.
+        XMMATRIX world = XMLoadFloat4x4(&ri->World);
+        float scale = std::max(XMVectorGetX(XMVector3Length(world.r[0])),
+            std::max(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+        float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(world.r[3], eye)));
+
+        // 뒤쪽 LOD 일수록 단순하고 오차가 크다.
+        const std::vector<MeshLod>& lods = ri->Geo->Lods;
+        for (UINT lod = (UINT)lods.size() - 1; lod > 0; --lod)
+        {
+            if (lods[lod].Error * scale * pixelsPerUnit <= mMeshLodPixelError * distance)
+            {
+                ri->Lod = lod;
+                break;
+            }
+        }
+    }
+}
+
+void InitDirect3DApp::UpdateMeshletCulling()
+{
+    for (auto& ri : mRenderitems)
+    {
+        ri->MeshletDraws.clear();
+
+        // 메시렛은 LOD 0 을 나눈 것이고, 스킨 메시는 포즈마다 경계가 바뀐다.
+        ri->MeshletCulled = mMeshletCulling && ri->Geo != nullptr && !ri->Geo->Meshlets.empty() &&
+            ri->Lod == 0 && ri->SkinnedModelInst == nullptr;
+        if (!ri->MeshletCulled)
+            continue;
+
+        MeshletCuller::Cull(ri->Geo->Meshlets, mCamera, ri->World, ri->Geo->StartIndexLocation, ri->MeshletDraws);
+    }
+}
+
+void InitDirect3DApp::UpdateSkinnedLodCaption()
+{
+    if (!mSkinnedLod)
+        return;
+
+    // 프레임 통계와 함께 창 제목에 표시된다.
+    const AnimationLodStats& stats = mAnimationSystem->GetLodStats();
+    mMainWndCaption = mMainWndCaptionBase +
+        L"    bones evaluated: " + std::to_wstring(stats.BonesEvaluated) +
+        L"   skipped: " + std::to_wstring(stats.BonesSkipped) +
+        L"   (instances " + std::to_wstring(stats.Evaluated) +
+        L" / extrapolated " + std::to_wstring(stats.Extrapolated) +
+        L" / culled " + std::to_wstring(stats.Culled) + L")";
+}
 
-    SkinnedConstants skinnedConstants;
-    std::copy(
-        std::begin(mSkinnedModelInst->FinalTransforms),
-        std::end(mSkinnedModelInst->FinalTransforms),
-        &skinnedConstants.BoneTransforms[0]);
+void InitDirect3DApp::UpdateCpuSkinnedVertices()
+{
+    // 인스턴스의 각 서브셋을 한 번 스키닝해서 Vertex 버퍼에 바로 쓴다.
+    // TexC 는 만들 때 채워 두었으므로 건드리지 않는다.
+    const UINT numVertices = (UINT)mSkinnedCpuVertices.size();
+    for (UINT inst = 0; inst < mAnimationSystem->InstanceCount(); ++inst)
+    {
+        const SkinnedModelInstance* instance = mAnimationSystem->GetInstance(inst);
+        Vertex* instanceVertices = reinterpret_cast<Vertex*>(mCpuSkinnedMappedData) + (size_t)inst * numVertices;
 
-    memcpy(&mSkinnedMappedData[0], &skinnedConstants, sizeof(SkinnedConstants));
+        for (UINT i = 0; i < (UINT)mSkinnedCpuFirstVertex.size(); ++i)
+        {
+            UINT first = mSkinnedCpuFirstVertex[i];
+            UINT last = i + 1 < mSkinnedCpuFirstVertex.size() ? mSkinnedCpuFirstVertex[i + 1] : numVertices;
+
+            SkinnedStream stream;
+            stream.Positions = &instanceVertices[first].Pos;
+            stream.Normals = &instanceVertices[first].Normal;
+            stream.Tangents = &instanceVertices[first].Tangent;
+            stream.Stride = sizeof(Vertex);
+            mCpuSkinner->Skin(&mSkinnedCpuVertices[first], last - first, instance->FinalTransforms.data(),
+                (UINT)instance->FinalTransforms.size(), stream);
+        }
+    }
 }
 
 void InitDirect3DApp::UpdateShadowTransform(const GameTimer& gt)
@@ -278,6 +484,12 @@ void InitDirect3DApp::UpdateShadowTransform(const GameTimer& gt)
     XMStoreFloat4x4(&mLightView, lightView);
     XMStoreFloat4x4(&mLightProj, lightProj);
     XMStoreFloat4x4(&mShadowTransform, S);
+
+    // 그림자 맵의 직교 투영 상자를 월드 공간으로 옮긴다.
+    XMMATRIX invLightProj = XMMatrixInverse(&XMMatrixDeterminant(lightProj), lightProj);
+    XMMATRIX invLightView = XMMatrixInverse(&XMMatrixDeterminant(lightView), lightView);
+    BoundingOrientedBox lightVolume(XMFLOAT3(0.0f, 0.0f, 0.5f), XMFLOAT3(1.0f, 1.0f, 0.5f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+    lightVolume.Transform(mLightVolume, invLightProj * invLightView);
 }
 
 void InitDirect3DApp::UpdatePassCB(const GameTimer& gt)
@@ -350,11 +562,11 @@ void InitDirect3DApp::UpdateShadowPassCB(const GameTimer& gt)
 
 void InitDirect3DApp::Draw(const GameTimer& gt)
 {
-    //   ο 
+    // 서술자 렌더링 파이프라인에 묶기
     ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
     mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-    // Ʈ ñ״ó    Ѵ.
+    // 루트 시그니처와 상수 버퍼 뷰을 설정한다.
     mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
 
     DrawSceneToShadowMap();
@@ -373,21 +585,21 @@ void InitDirect3DApp::Draw(const GameTimer& gt)
     // Specify the buffers we are going to render to.
     mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 
-    //    並 
+    // 공용 상수 버퍼 뷰를 설정
     D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = mPassCB->GetGPUVirtualAddress();
     mCommandList->SetGraphicsRootConstantBufferView(2, passCBAddress);
     
-    // ī̹ڽ ؽó 
+    // 스카이박스 텍스처 설정
     CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
     skyTexDescriptor.Offset(mSkyboxTexHeapIndex, mCbvSrvDescriptorSize);
     mCommandList->SetGraphicsRootDescriptorTable(3, skyTexDescriptor);
 
     // to do : Rendering   
     mCommandList->SetPipelineState(mPSOs["opaque"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::Opaque]);
+    DrawRenderItems(mRitemLayer[(int)RenderLayer::Opaque], true);
 
     mCommandList->SetPipelineState(mPSOs["skinnedOpaque"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::SkinnedOpaque]);
+    DrawRenderItems(mSkinnedVisibleRitems);
 
     mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
     DrawRenderItems(mRitemLayer[(int)RenderLayer::AlphaTested]);
@@ -402,11 +614,10 @@ void InitDirect3DApp::Draw(const GameTimer& gt)
     DrawRenderItems(mRitemLayer[(int)RenderLayer::Skybox]);
 }
 
-void InitDirect3DApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
+void InitDirect3DApp::DrawRenderItems(const std::vector<RenderItem*>& ritems, bool cullMeshlets)
 {
     UINT objCBByteSize = (sizeof(ObjectConstants) + 255) & ~255;
     UINT matCBByteSize = (sizeof(MaterialConstants) + 255) & ~255;
-    UINT skinnedCBByteSize = (sizeof(SkinnedConstants) + 255) & ~255;
 
     for (size_t i = 0; i < ritems.size(); ++i)
     {
@@ -415,19 +626,24 @@ void InitDirect3DApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
         if (ri->Geo == nullptr)
             continue;
 
-        //  Ʈ    
+        // 살아남은 메시렛이 없으면 아무것도 설정하지 않는다.
+        const bool drawMeshlets = cullMeshlets && ri->MeshletCulled;
+        if (drawMeshlets && ri->MeshletDraws.empty())
+            continue;
+
+        // 개별 오브젝트 상수 버퍼 뷰 설정
         D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = mObjectCB->GetGPUVirtualAddress();
         objCBAddress += ri->ObjCBIndex * objCBByteSize;
 
         mCommandList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-        //  Ʈ     
+        // 개별 오브젝트 재질 상수 버퍼 뷰 설정
         D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = mMaterialCB->GetGPUVirtualAddress();
         matCBAddress += ri->Mat->MatCBIndex * matCBByteSize;
 
         mCommandList->SetGraphicsRootConstantBufferView(1, matCBAddress);
 
-        // ؽó   
+        // 텍스처 버퍼 서술자 설정
         if (ri->Mat->DiffuseSrvHeapIndex != -1)
         {
             CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
@@ -436,7 +652,7 @@ void InitDirect3DApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
             mCommandList->SetGraphicsRootDescriptorTable(4, tex);
         }
 
-        // 븻 ؽó   
+        // 노말 텍스처 버퍼 서술자 설정
         if (ri->Mat->NormalSrvHeapIndex != -1)
         {
             CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
@@ -448,7 +664,14 @@ void InitDirect3DApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
         if (ri->SkinnedModelInst != nullptr)
         {
             D3D12_GPU_VIRTUAL_ADDRESS skinnedCBAddress = mSkinnedCB->GetGPUVirtualAddress();
-            skinnedCBAddress += ri->SkinnedCBIndex * skinnedCBByteSize;
+            skinnedCBAddress += (UINT64)mSkinnedPaletteIndex * mSkinnedByteSize +
+                ri->SkinnedCBIndex * mSkinnedSlotByteSize + ri->SkinnedPaletteOffset;
+            if (mSkinnedUseAtlas)
+            {
+                // 인스턴스의 현재 프레임이 그대로 상수 버퍼가 된다.
+                skinnedCBAddress = mSkinnedAtlasBuffer->GetGPUVirtualAddress() +
+                    (UINT64)mSkinnedAtlasFrames[ri->SkinnedCBIndex] * mSkinnedAtlas.FrameByteSize() + ri->SkinnedPaletteOffset;
+            }
             mCommandList->SetGraphicsRootConstantBufferView(7, skinnedCBAddress);
         }
         else
@@ -456,16 +679,32 @@ void InitDirect3DApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
             mCommandList->SetGraphicsRootConstantBufferView(7, 0);
         }
 
-        // , ε,  
+        // 정점, 인덱스, 토폴로지 연결
         mCommandList->IASetVertexBuffers(0, 1, &ri->Geo->VertexView);
         mCommandList->IASetIndexBuffer(&ri->Geo->IndexView);
         mCommandList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-        // 
+        // 렌더링. 메시렛 컬링을 했으면 살아남은 범위를 하나씩 그린다.
+        if (drawMeshlets)
+        {
+            for (const MeshletDraw& draw : ri->MeshletDraws)
+                mCommandList->DrawIndexedInstanced(draw.IndexCount, 1, draw.StartIndexLocation, ri->Geo->BaseVertexLocation, 0);
+            continue;
+        }
+
+        // LOD 가 있으면 그 인덱스 범위만 그린다.
+        UINT indexCount = ri->Geo->IndexCount;
+        UINT startIndex = ri->Geo->StartIndexLocation;
+        if (ri->Lod < ri->Geo->Lods.size())
+        {
+            indexCount = ri->Geo->Lods[ri->Lod].IndexCount;
+            startIndex += ri->Geo->Lods[ri->Lod].StartIndexLocation;
+        }
+
         mCommandList->DrawIndexedInstanced(
-            ri->Geo->IndexCount, 
+            indexCount, 
             1, 
-            ri->Geo->StartIndexLocation, 
+            startIndex, 
             ri->Geo->BaseVertexLocation, 
             0);
     }
@@ -489,7 +728,7 @@ void InitDirect3DApp::DrawSceneToShadowMap()
     // Note the active PSO also must specify a render target count of 0.
     mCommandList->OMSetRenderTargets(0, nullptr, false, &mShadowMap->Dsv());
 
-    //    並 
+    // 공용 상수 버퍼 뷰를 설정
     UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
     D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = mPassCB->GetGPUVirtualAddress() + passCBByteSize;
     mCommandList->SetGraphicsRootConstantBufferView(2, passCBAddress);
@@ -502,7 +741,7 @@ void InitDirect3DApp::DrawSceneToShadowMap()
     DrawRenderItems(mRitemLayer[(int)RenderLayer::Opaque]);
 
     mCommandList->SetPipelineState(mPSOs["skinnedShadow_opaque"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::SkinnedOpaque]);
+    DrawRenderItems(mSkinnedShadowRitems);
 
     // Change back to GENERIC_READ so we can read the texture in a shader.
     mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
@@ -560,7 +799,7 @@ void InitDirect3DApp::OnMouseMove(WPARAM btnState, int x, int y)
 {
     if ((btnState & MK_LBUTTON) != 0)
     {
-        // 콺  ȼ ̵ 4 1 Ų.
+        // 마우스 한 픽셀 이동을 4분의 1도에 대응시킨다.
         float dx = XMConvertToRadians(0.25f * static_cast<float>(x - mLastMousePos.x));
         float dy = XMConvertToRadians(0.25f * static_cast<float>(y - mLastMousePos.y));
 
@@ -639,30 +878,183 @@ void InitDirect3DApp::LoadTextures()
     }
 }
 
-void InitDirect3DApp::LoadSkinnedModel()
+bool InitDirect3DApp::LoadSkinnedModel()
 {
     std::vector<M3DLoader::SkinnedVertex> vertices;
-    std::vector<std::uint16_t> indices;
+    IndexData indices;
+
+    const M3DLoader::SkinnedVertex* vertexData = nullptr;
+    UINT numVertices = 0;
+
+    // Prefer the binary copy of the model.  Its vertex array is uploaded
+    // straight from the file mapping.  If it does not exist yet, or was
+    // built from another version of the text file or with other options,
+    // parse the text file and write the binary copy for the next run.  A
+    // binary copy without its text file is used as it is.
+    M3dFile::SourceStamp sourceStamp;
+    bool haveSource = M3dFile::StampSource(mSkinnedModelFilename,
+        mOptimizeMeshes ? M3dFile::BuildOptimized : 0, sourceStamp);
+
+    M3DLoader m3dLoader(mThreadPool.get());
+    m3dLoader.EnableLazyClips(mSkinnedClipMemoryBudget);
+    M3dFile m3dFile;
+    if (m3dFile.Open(mSkinnedModelBinaryFilename) && m3dFile.GetHeader().Skinned &&
+        (!haveSource || m3dFile.IsBuiltFrom(sourceStamp)))
+    {
+        // Open 이 구간 범위, 서브셋, 인덱스, 본 인덱스와 본 계층을 모두 검사했다.
+        m3dLoader.LoadM3dBinary(m3dFile, mSkinnedSubsets, mSkinnedMats, mSkinnedInfo);
+
+        vertexData = m3dFile.SkinnedVertices();
+        numVertices = (UINT)m3dFile.GetHeader().NumVertices;
+        indices.Assign(m3dFile.Indices(), m3dFile.GetHeader().NumTriangles * 3, m3dFile.IndexFormat());
+    }
+    else
+    {
+        m3dFile.Close();
+        if (!m3dLoader.LoadM3d(mSkinnedModelFilename, vertices, indices,
+            mSkinnedSubsets, mSkinnedMats, mSkinnedInfo))
+        {
+            MessageBox(0, L"The skinned model could not be loaded, or its bone hierarchy is invalid.", 0, 0);
+            return false;
+        }
+        if (mOptimizeMeshes)
+        {
+            MeshOptimizer::Optimize(vertices.data(), sizeof(M3DLoader::SkinnedVertex),
+                offsetof(M3DLoader::SkinnedVertex, Pos), (UINT)vertices.size(), indices, &mSkinnedSubsets);
+        }
+        M3dFile::Write(mSkinnedModelBinaryFilename, vertices, indices,
+            mSkinnedSubsets, mSkinnedMats, mSkinnedInfo, sourceStamp);
+
+        vertexData = vertices.data();
+        numVertices = (UINT)vertices.size();
+    }
 
-    M3DLoader m3dLoader;
-    m3dLoader.LoadM3d(mSkinnedModelFilename, vertices, indices,
-        mSkinnedSubsets, mSkinnedMats, mSkinnedInfo);
+    // 애니메이션이 바인드 포즈 밖으로 뻗는 만큼 여유를 둔다.
+    BoundingSphere::CreateFromPoints(mSkinnedBounds, numVertices, &vertexData[0].Pos, sizeof(M3DLoader::SkinnedVertex));
+    mSkinnedBounds.Radius *= 1.25f;
 
-    mSkinnedModelInst = std::make_unique<SkinnedModelInstance>();
-    mSkinnedModelInst->SkinnedInfo = &mSkinnedInfo;
-    mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
-    mSkinnedModelInst->ClipName = "Take1";
-    mSkinnedModelInst->TimePos = 0.0f;
+    // 본마다 가중치를 받는 정점들의 바인드 포즈 상자. 매 프레임 팔레트로 옮겨
+    // 인스턴스의 경계 상자를 만든다.
+    mSkinnedBoneBounds.Reset(mSkinnedInfo.BoneCount());
+    mSkinnedBoneBounds.AddVertices(vertexData, numVertices);
 
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(SkinnedVertex);
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+    // Only after the binary copy is written, which keeps full precision keys.
+    // The bone reach makes the tolerance a bound on the soldier's vertices.
+    if (mSkinnedClipTolerance > 0.0f)
+    {
+        std::vector<float> boneReach;
+        mSkinnedBoneBounds.ComputeReach(mSkinnedInfo.GetBoneOffsets(), boneReach);
+        mSkinnedInfo.CompressClips(mSkinnedClipTolerance, boneReach);
+    }
+
+    // Every soldier gets its own palette slot; later ones start at staggered
+    // times so a crowd does not move in lockstep.
+    mAnimationSystem = std::make_unique<AnimationSystem>(mThreadPool.get());
+    float clipLength = mSkinnedInfo.GetClipEndTime(mSkinnedClipName);
+    for (UINT i = 0; i < mSkinnedInstanceCount; ++i)
+    {
+        float timePos = clipLength > 0.0f ? fmodf(i * 0.37f, clipLength) : 0.0f;
+        mAnimationSystem->AddInstance(&mSkinnedInfo, mSkinnedClipName, timePos);
+    }
+    mAnimationSystem->SetBoneBounds(&mSkinnedBoneBounds);
+    if (mSkinnedPoseQuantum > 0.0f)
+        mAnimationSystem->EnablePoseCache(mSkinnedPoseQuantum);
+
+    // Full detail up close, then every 2nd and 4th frame without the
+    // deepest bones of the hierarchy as the soldiers get small on screen.
+    UINT lodBoneDepth = mSkinnedInfo.MaxBoneDepth() > mSkinnedLodLeafDepths ?
+        mSkinnedInfo.MaxBoneDepth() - mSkinnedLodLeafDepths : 0;
+    mSkinnedLodPolicy.Levels =
+    {
+        { 0.25f, 1, UINT_MAX },
+        { 0.1f, 2, lodBoneDepth },
+        { 0.0f, 4, lodBoneDepth },
+    };
+    if (mSkinnedLod)
+        mAnimationSystem->EnableLod(mSkinnedLodPolicy);
+
+    // 서브셋마다 자기가 쓰는 본만 담은 팔레트를 가진다.
+    mSkinnedPaletteLayout.Reset(mSkinnedPaletteFormat);
+
+    // 서브셋 정점 번호. 서브셋마다 채웠다가 되돌린다.
+    std::vector<UINT> localVertex(numVertices, UINT_MAX);
+    std::vector<UINT> subsetVertexIds;
 
     for (UINT i = 0; i < (UINT)mSkinnedSubsets.size(); ++i)
     {
         auto geo = std::make_unique<GeometryInfo>();
+        geo->Name = "sm_" + std::to_string(i);
+
+        // Each subset gets only the vertices its triangles reference, in their
+        // original order, with the indices renumbered to them.  The index
+        // width and the bone palette then depend on this subset alone, even
+        // when the subsets' vertices interleave.
+        const UINT firstIndex = mSkinnedSubsets[i].FaceStart * 3;
+        const UINT subsetIndexCount = mSkinnedSubsets[i].FaceCount * 3;
+        mSkinnedCpuFirstVertex.push_back((UINT)mSkinnedCpuVertices.size());
+        if (subsetIndexCount == 0)
+        {
+            mSkinnedPaletteLayout.AddSubset(nullptr, 0);
+            mGeometries[geo->Name] = std::move(geo);
+            continue;
+        }
+
+        subsetVertexIds.clear();
+        for (UINT k = 0; k < subsetIndexCount; ++k)
+            subsetVertexIds.push_back(indices.Get(firstIndex + k));
+        std::sort(subsetVertexIds.begin(), subsetVertexIds.end());
+        subsetVertexIds.erase(std::unique(subsetVertexIds.begin(), subsetVertexIds.end()), subsetVertexIds.end());
+
+        std::vector<M3DLoader::SkinnedVertex> subsetVertices(subsetVertexIds.size());
+        for (UINT k = 0; k < (UINT)subsetVertexIds.size(); ++k)
+        {
+            localVertex[subsetVertexIds[k]] = k;
+            subsetVertices[k] = vertexData[subsetVertexIds[k]];
+        }
 
-        //    
-        geo->VertexCount = (UINT)vertices.size();
+        IndexData subsetIndices;
+        subsetIndices.Resize(subsetIndexCount, subsetVertices.size());
+        for (UINT k = 0; k < subsetIndexCount; ++k)
+            subsetIndices.Set(k, localVertex[indices.Get(firstIndex + k)]);
+
+        for (UINT id : subsetVertexIds)
+            localVertex[id] = UINT_MAX;
+
+        // CPU 스키닝은 원래 본 인덱스로 전체 팔레트를 쓴다.
+        if (mSkinnedOnCpu)
+            mSkinnedCpuVertices.insert(mSkinnedCpuVertices.end(), subsetVertices.begin(), subsetVertices.end());
+
+        // 정점의 본 인덱스를 서브셋 팔레트 기준으로 바꾼다.
+        if (!mSkinnedPaletteLayout.AddSubset(subsetVertices.data(), (UINT)subsetVertices.size()))
+        {
+            MessageBox(0, L"A skinned subset uses more bones than BonePalette::MaxBones.", 0, 0);
+            return false;
+        }
+
+        // 서브셋마다 LOD 를 만든다. 스킨 가중치가 다른 정점끼리는 잘 합치지 않는다.
+        if (mMeshLods)
+        {
+            std::vector<UINT> indices32(subsetIndexCount);
+            for (UINT k = 0; k < subsetIndexCount; ++k)
+                indices32[k] = subsetIndices.Get(k);
+
+            MeshSimplifier::VertexLayout layout;
+            layout.Vertices = subsetVertices.data();
+            layout.VertexStride = sizeof(M3DLoader::SkinnedVertex);
+            layout.NumVertices = (UINT)subsetVertices.size();
+            layout.PositionOffset = offsetof(M3DLoader::SkinnedVertex, Pos);
+            layout.NormalOffset = offsetof(M3DLoader::SkinnedVertex, Normal);
+            layout.TexCOffset = offsetof(M3DLoader::SkinnedVertex, TexC);
+            layout.BoneWeightsOffset = offsetof(M3DLoader::SkinnedVertex, BoneWeights);
+            layout.BoneIndicesOffset = offsetof(M3DLoader::SkinnedVertex, BoneIndices);
+
+            std::vector<UINT> chain;
+            mMeshLodCache.BuildLodChain(layout, indices32.data(), subsetIndexCount, mMeshLodRatios, chain, geo->Lods);
+            subsetIndices.Assign(chain.data(), (UINT)chain.size(), subsetVertices.size());
+        }
+
+        // 정점 버퍼 및 뷰
+        geo->VertexCount = (UINT)subsetVertices.size();
         const UINT vbByteSize = geo->VertexCount * sizeof(SkinnedVertex);
 
         D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -679,16 +1071,17 @@ void InitDirect3DApp::LoadSkinnedModel()
         void* vertexDataBuff = nullptr;
         CD3DX12_RANGE vertexRange(0, 0);
         geo->VertexBuffer->Map(0, &vertexRange, &vertexDataBuff);
-        memcpy(vertexDataBuff, vertices.data(), vbByteSize);
+        memcpy(vertexDataBuff, subsetVertices.data(), vbByteSize);
         geo->VertexBuffer->Unmap(0, nullptr);
 
         geo->VertexView.BufferLocation = geo->VertexBuffer->GetGPUVirtualAddress();
         geo->VertexView.StrideInBytes = sizeof(SkinnedVertex);
         geo->VertexView.SizeInBytes = vbByteSize;
 
-        // ε   
-        geo->IndexCount = (UINT)indices.size();
-        const UINT ibByteSize = geo->IndexCount * sizeof(std::uint16_t);
+        // 인덱스 버퍼 및 뷰. 버퍼에는 모든 LOD 가 들어 있다.
+        geo->IndexCount = geo->Lods.empty() ? subsetIndices.Count() : geo->Lods[0].IndexCount;
+        geo->IndexFormat = subsetIndices.Format();
+        const UINT ibByteSize = subsetIndices.ByteSize();
 
         heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
         desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
@@ -704,155 +1097,52 @@ void InitDirect3DApp::LoadSkinnedModel()
         void* indexDataBuff = nullptr;
         CD3DX12_RANGE indexRange(0, 0);
         geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-        memcpy(indexDataBuff, indices.data(), ibByteSize);
+        memcpy(indexDataBuff, subsetIndices.Data(), ibByteSize);
         geo->IndexBuffer->Unmap(0, nullptr);
 
         geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-        geo->IndexView.Format = DXGI_FORMAT_R16_UINT;
+        geo->IndexView.Format = geo->IndexFormat;
         geo->IndexView.SizeInBytes = ibByteSize;
 
-        geo->Name = "sm_" + std::to_string(i);
-        geo->IndexCount = (UINT)mSkinnedSubsets[i].FaceCount * 3;
-        geo->StartIndexLocation = mSkinnedSubsets[i].FaceStart * 3;
+        geo->StartIndexLocation = 0;
         geo->BaseVertexLocation = 0;
         mGeometries[geo->Name] = std::move(geo);
     }    
-}
-
-void InitDirect3DApp::BuildBoxGeometry()
-{
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
 
-    //  
-    std::vector<Vertex> vertices(box.Vertices.size());
-
-    UINT k = 0;
-    for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+    if (mSkinnedOnCpu)
     {
-        vertices[k].Pos = box.Vertices[i].Position;
-        vertices[k].Normal = box.Vertices[i].Normal;
-        vertices[k].Uv = box.Vertices[i].TexC;
-        vertices[k].Tangent = box.Vertices[i].TangentU;
+        mSkinnedUseAtlas = false;
+        BuildCpuSkinnedGeometry();
     }
 
-    // ε 
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-
-    //   Է
-    auto geo = std::make_unique<GeometryInfo>();
-    geo->Name = "Box";
-
-    //    
-    geo->VertexCount = (UINT)vertices.size();
-    const UINT vbByteSize = geo->VertexCount * sizeof(Vertex);
-
-    D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
-
-    md3dDevice->CreateCommittedResource(
-        &heapProperty,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&geo->VertexBuffer));
+    if (mSkinnedUseAtlas)
+        BuildSkinnedAtlas();
 
-    void* vertexDataBuff = nullptr;
-    CD3DX12_RANGE vertexRange(0, 0);
-    geo->VertexBuffer->Map(0, &vertexRange, &vertexDataBuff);
-    memcpy(vertexDataBuff, vertices.data(), vbByteSize);
-    geo->VertexBuffer->Unmap(0, nullptr);
-
-    geo->VertexView.BufferLocation = geo->VertexBuffer->GetGPUVirtualAddress();
-    geo->VertexView.StrideInBytes = sizeof(Vertex);
-    geo->VertexView.SizeInBytes = vbByteSize;
-
-    // ε   
-    geo->IndexCount = (UINT)indices.size();
-    const UINT ibByteSize = geo->IndexCount * sizeof(std::uint16_t);
-
-    heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
-
-    md3dDevice->CreateCommittedResource(
-        &heapProperty,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&geo->IndexBuffer));
-
-    void* indexDataBuff = nullptr;
-    CD3DX12_RANGE indexRange(0, 0);
-    geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-    memcpy(indexDataBuff, indices.data(), ibByteSize);
-    geo->IndexBuffer->Unmap(0, nullptr);
-
-    geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-    geo->IndexView.Format = DXGI_FORMAT_R16_UINT;
-    geo->IndexView.SizeInBytes = ibByteSize;
-
-    mGeometries[geo->Name] = std::move(geo);
+    return true;
 }
 
-void InitDirect3DApp::BuildGridGeometry()
+void InitDirect3DApp::BuildSkinnedAtlas()
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-
-    //  
-    std::vector<Vertex> vertices(grid.Vertices.size());
-
-    UINT k = 0;
-    for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
+    // 미리 구운 파일이 같은 팔레트 배치로 만들어졌으면 그대로 쓰고, 아니면 구워서 저장한다.
+    if (!mSkinnedAtlas.Read(mSkinnedAtlasFilename, mSkinnedPaletteLayout) ||
+        mSkinnedAtlas.GetSampleRate() != mSkinnedAtlasRate ||
+        mSkinnedAtlas.FindClip(mSkinnedClipName) == UINT_MAX)
     {
-        vertices[k].Pos = grid.Vertices[i].Position;
-        vertices[k].Normal = grid.Vertices[i].Normal;
-        vertices[k].Uv = grid.Vertices[i].TexC;
-        vertices[k].Tangent = grid.Vertices[i].TangentU;
+        mSkinnedAtlas.Reset(mSkinnedPaletteLayout, mSkinnedAtlasRate);
+        mSkinnedAtlas.AddClip(mSkinnedInfo, mSkinnedClipName, true);
+        mSkinnedAtlas.Write(mSkinnedAtlasFilename);
     }
 
-    // ε 
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-
-    //   Է
-    auto geo = std::make_unique<GeometryInfo>();
-    geo->Name = "Grid";
-
-    //    
-    geo->VertexCount = (UINT)vertices.size();
-    const UINT vbByteSize = geo->VertexCount * sizeof(Vertex);
+    mSkinnedAtlasClip = mSkinnedAtlas.FindClip(mSkinnedClipName);
+    if (mSkinnedAtlasClip == UINT_MAX)
+    {
+        mSkinnedUseAtlas = false;
+        return;
+    }
+    mSkinnedAtlasFrames.assign(mAnimationSystem->InstanceCount(), mSkinnedAtlas.GetClip(mSkinnedAtlasClip).FirstFrame);
 
     D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
-
-    md3dDevice->CreateCommittedResource(
-        &heapProperty,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&geo->VertexBuffer));
-
-    void* vertexDataBuff = nullptr;
-    CD3DX12_RANGE vertexRange(0, 0);
-    geo->VertexBuffer->Map(0, &vertexRange, &vertexDataBuff);
-    memcpy(vertexDataBuff, vertices.data(), vbByteSize);
-    geo->VertexBuffer->Unmap(0, nullptr);
-
-    geo->VertexView.BufferLocation = geo->VertexBuffer->GetGPUVirtualAddress();
-    geo->VertexView.StrideInBytes = sizeof(Vertex);
-    geo->VertexView.SizeInBytes = vbByteSize;
-
-    // ε   
-    geo->IndexCount = (UINT)indices.size();
-    const UINT ibByteSize = geo->IndexCount * sizeof(std::uint16_t);
-
-    heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
+    D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(mSkinnedAtlas.ByteSize());
 
     md3dDevice->CreateCommittedResource(
         &heapProperty,
@@ -860,49 +1150,23 @@ void InitDirect3DApp::BuildGridGeometry()
         &desc,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
-        IID_PPV_ARGS(&geo->IndexBuffer));
-
-    void* indexDataBuff = nullptr;
-    CD3DX12_RANGE indexRange(0, 0);
-    geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-    memcpy(indexDataBuff, indices.data(), ibByteSize);
-    geo->IndexBuffer->Unmap(0, nullptr);
-
-    geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-    geo->IndexView.Format = DXGI_FORMAT_R16_UINT;
-    geo->IndexView.SizeInBytes = ibByteSize;
+        IID_PPV_ARGS(&mSkinnedAtlasBuffer));
 
-    mGeometries[geo->Name] = std::move(geo);
+    void* atlasData = nullptr;
+    CD3DX12_RANGE atlasRange(0, 0);
+    mSkinnedAtlasBuffer->Map(0, &atlasRange, &atlasData);
+    memcpy(atlasData, mSkinnedAtlas.Data(), mSkinnedAtlas.ByteSize());
+    mSkinnedAtlasBuffer->Unmap(0, nullptr);
 }
 
-void InitDirect3DApp::BuildSphereGeometry()
+void InitDirect3DApp::BuildCpuSkinnedGeometry()
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-
-    //  
-    std::vector<Vertex> vertices(sphere.Vertices.size());
-
-    UINT k = 0;
-    for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Pos = sphere.Vertices[i].Position;
-        vertices[k].Normal = sphere.Vertices[i].Normal;
-        vertices[k].Uv = sphere.Vertices[i].TexC;
-        vertices[k].Tangent = sphere.Vertices[i].TangentU;
-    }
-
-    // ε 
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
+    mCpuSkinner = std::make_unique<CpuSkinner>(mThreadPool.get());
 
-    //   Է
-    auto geo = std::make_unique<GeometryInfo>();
-    geo->Name = "Sphere";
-
-    //    
-    geo->VertexCount = (UINT)vertices.size();
-    const UINT vbByteSize = geo->VertexCount * sizeof(Vertex);
+    // 모든 인스턴스의 스키닝 결과를 담는 업로드 버퍼. 계속 매핑해 둔다.
+    const UINT numVertices = (UINT)mSkinnedCpuVertices.size();
+    const UINT instanceByteSize = numVertices * sizeof(Vertex);
+    const UINT vbByteSize = std::max(instanceByteSize * mAnimationSystem->InstanceCount(), 1u);
 
     D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
@@ -913,73 +1177,104 @@ void InitDirect3DApp::BuildSphereGeometry()
         &desc,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
-        IID_PPV_ARGS(&geo->VertexBuffer));
-
-    void* vertexDataBuff = nullptr;
-    CD3DX12_RANGE vertexRange(0, 0);
-    geo->VertexBuffer->Map(0, &vertexRange, &vertexDataBuff);
-    memcpy(vertexDataBuff, vertices.data(), vbByteSize);
-    geo->VertexBuffer->Unmap(0, nullptr);
-
-    geo->VertexView.BufferLocation = geo->VertexBuffer->GetGPUVirtualAddress();
-    geo->VertexView.StrideInBytes = sizeof(Vertex);
-    geo->VertexView.SizeInBytes = vbByteSize;
+        IID_PPV_ARGS(&mCpuSkinnedVB));
 
-    // ε   
-    geo->IndexCount = (UINT)indices.size();
-    const UINT ibByteSize = geo->IndexCount * sizeof(std::uint16_t);
+    mCpuSkinnedVB->Map(0, nullptr, reinterpret_cast<void**>(&mCpuSkinnedMappedData));
 
-    heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
+    // 첫 프레임 전에 바인드 포즈와 텍스처 좌표를 채운다.
+    for (UINT inst = 0; inst < mAnimationSystem->InstanceCount(); ++inst)
+    {
+        Vertex* instanceVertices = reinterpret_cast<Vertex*>(mCpuSkinnedMappedData) + (size_t)inst * numVertices;
+        for (UINT v = 0; v < numVertices; ++v)
+        {
+            instanceVertices[v].Pos = mSkinnedCpuVertices[v].Pos;
+            instanceVertices[v].Normal = mSkinnedCpuVertices[v].Normal;
+            instanceVertices[v].Uv = mSkinnedCpuVertices[v].TexC;
+            instanceVertices[v].Tangent = mSkinnedCpuVertices[v].TangentU;
+        }
+    }
 
-    md3dDevice->CreateCommittedResource(
-        &heapProperty,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&geo->IndexBuffer));
+    // 인스턴스와 서브셋마다 정점 뷰만 다르고 인덱스 버퍼는 GPU 스키닝과 같이 쓴다.
+    for (UINT inst = 0; inst < mAnimationSystem->InstanceCount(); ++inst)
+    {
+        for (UINT i = 0; i < (UINT)mSkinnedSubsets.size(); ++i)
+        {
+            const GeometryInfo* subsetGeo = mGeometries["sm_" + std::to_string(i)].get();
+
+            auto geo = std::make_unique<GeometryInfo>();
+            geo->Name = "sm_cpu_" + std::to_string(inst) + "_" + std::to_string(i);
+            geo->VertexCount = subsetGeo->VertexCount;
+            geo->VertexView.BufferLocation = mCpuSkinnedVB->GetGPUVirtualAddress() +
+                (UINT64)inst * instanceByteSize + (UINT64)mSkinnedCpuFirstVertex[i] * sizeof(Vertex);
+            geo->VertexView.StrideInBytes = sizeof(Vertex);
+            geo->VertexView.SizeInBytes = geo->VertexCount * sizeof(Vertex);
+
+            geo->IndexBuffer = subsetGeo->IndexBuffer;
+            geo->IndexCount = subsetGeo->IndexCount;
+            geo->IndexFormat = subsetGeo->IndexFormat;
+            geo->IndexView = subsetGeo->IndexView;
+            geo->StartIndexLocation = subsetGeo->StartIndexLocation;
+            geo->BaseVertexLocation = subsetGeo->BaseVertexLocation;
+            geo->Lods = subsetGeo->Lods;
+            mGeometries[geo->Name] = std::move(geo);
+        }
+    }
+}
 
-    void* indexDataBuff = nullptr;
-    CD3DX12_RANGE indexRange(0, 0);
-    geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-    memcpy(indexDataBuff, indices.data(), ibByteSize);
-    geo->IndexBuffer->Unmap(0, nullptr);
+void InitDirect3DApp::BuildBoxGeometry()
+{
+    GeometryGenerator geoGen;
+    BuildGeneratedGeometry("Box", GeometryGenerator::BoxSize(3), [&](const GeometryGenerator::MeshLayout& layout)
+    {
+        geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3, layout);
+    });
+}
 
-    geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-    geo->IndexView.Format = DXGI_FORMAT_R16_UINT;
-    geo->IndexView.SizeInBytes = ibByteSize;
+void InitDirect3DApp::BuildGridGeometry()
+{
+    GeometryGenerator geoGen(mThreadPool.get());
+    BuildGeneratedGeometry("Grid", GeometryGenerator::GridSize(60, 40), [&](const GeometryGenerator::MeshLayout& layout)
+    {
+        geoGen.CreateGrid(20.0f, 30.0f, 60, 40, layout);
+    });
+}
 
-    mGeometries[geo->Name] = std::move(geo);
+void InitDirect3DApp::BuildSphereGeometry()
+{
+    GeometryGenerator geoGen(mThreadPool.get());
+    BuildGeneratedGeometry("Sphere", GeometryGenerator::SphereSize(20, 20), [&](const GeometryGenerator::MeshLayout& layout)
+    {
+        geoGen.CreateSphere(0.5f, 20, 20, layout);
+    });
 }
 
 void InitDirect3DApp::BuildCylinderGeometry()
 {
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-
-    //  
-    std::vector<Vertex> vertices(cylinder.Vertices.size());
-
-    UINT k = 0;
-    for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+    GeometryGenerator geoGen(mThreadPool.get());
+    BuildGeneratedGeometry("Cylinder", GeometryGenerator::CylinderSize(20, 20), [&](const GeometryGenerator::MeshLayout& layout)
     {
-        vertices[k].Pos = cylinder.Vertices[i].Position;
-        vertices[k].Normal = cylinder.Vertices[i].Normal;
-        vertices[k].Uv = cylinder.Vertices[i].TexC;
-        vertices[k].Tangent = cylinder.Vertices[i].TangentU;
-    }
+        geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, layout);
+    });
+}
 
-    // ε 
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
+void InitDirect3DApp::BuildQuadGeometry()
+{
+    GeometryGenerator geoGen;
+    BuildGeneratedGeometry("Quad", GeometryGenerator::QuadSize(), [&](const GeometryGenerator::MeshLayout& layout)
+    {
+        geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, layout);
+    });
+}
 
-    //   Է
+void InitDirect3DApp::BuildGeneratedGeometry(const std::string& name, const GeometryGenerator::MeshSize& size,
+    const std::function<void(const GeometryGenerator::MeshLayout&)>& generate)
+{
+    // 기하 데이터 입력
     auto geo = std::make_unique<GeometryInfo>();
-    geo->Name = "Cylinder";
+    geo->Name = name;
 
-    //    
-    geo->VertexCount = (UINT)vertices.size();
+    // 정점 버퍼 및 뷰
+    geo->VertexCount = (UINT)size.VertexCount;
     const UINT vbByteSize = geo->VertexCount * sizeof(Vertex);
 
     D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -993,19 +1288,15 @@ void InitDirect3DApp::BuildCylinderGeometry()
         nullptr,
         IID_PPV_ARGS(&geo->VertexBuffer));
 
-    void* vertexDataBuff = nullptr;
-    CD3DX12_RANGE vertexRange(0, 0);
-    geo->VertexBuffer->Map(0, &vertexRange, &vertexDataBuff);
-    memcpy(vertexDataBuff, vertices.data(), vbByteSize);
-    geo->VertexBuffer->Unmap(0, nullptr);
-
     geo->VertexView.BufferLocation = geo->VertexBuffer->GetGPUVirtualAddress();
     geo->VertexView.StrideInBytes = sizeof(Vertex);
     geo->VertexView.SizeInBytes = vbByteSize;
 
-    // ε   
-    geo->IndexCount = (UINT)indices.size();
-    const UINT ibByteSize = geo->IndexCount * sizeof(std::uint16_t);
+    // 인덱스 버퍼 및 뷰. 정점이 65536개 이하이면 16비트 인덱스를 쓴다.
+    geo->IndexCount = (UINT)size.IndexCount;
+    geo->IndexFormat = size.VertexCount <= 0x10000 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    const UINT indexSize = geo->IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+    const UINT ibByteSize = geo->IndexCount * indexSize;
 
     heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
@@ -1018,139 +1309,134 @@ void InitDirect3DApp::BuildCylinderGeometry()
         nullptr,
         IID_PPV_ARGS(&geo->IndexBuffer));
 
-    void* indexDataBuff = nullptr;
-    CD3DX12_RANGE indexRange(0, 0);
-    geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-    memcpy(indexDataBuff, indices.data(), ibByteSize);
-    geo->IndexBuffer->Unmap(0, nullptr);
-
     geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-    geo->IndexView.Format = DXGI_FORMAT_R16_UINT;
+    geo->IndexView.Format = geo->IndexFormat;
     geo->IndexView.SizeInBytes = ibByteSize;
 
-    mGeometries[geo->Name] = std::move(geo);
-}
-
-void InitDirect3DApp::BuildQuadGeometry()
-{
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData quad = geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
-
-    //  
-    std::vector<Vertex> vertices(quad.Vertices.size());
+    // 업로드 버퍼를 매핑하고 생성기가 Vertex 배치로 바로 쓰게 한다.
+    // 중간 MeshData나 16비트 인덱스 사본을 거치지 않는다.
+    void* vertexDataBuff = nullptr;
+    void* indexDataBuff = nullptr;
+    CD3DX12_RANGE readRange(0, 0);
+    geo->VertexBuffer->Map(0, &readRange, &vertexDataBuff);
+    geo->IndexBuffer->Map(0, &readRange, &indexDataBuff);
+
+    GeometryGenerator::MeshLayout layout;
+    layout.VertexStride = sizeof(Vertex);
+    layout.PositionOffset = offsetof(Vertex, Pos);
+    layout.NormalOffset = offsetof(Vertex, Normal);
+    layout.TexCOffset = offsetof(Vertex, Uv);
+    layout.TangentUOffset = offsetof(Vertex, Tangent);
+
+    if (mOptimizeMeshes)
+    {
+        // 생성한 도형은 볼록하거나 평평해서 오버드로 정렬로 얻을 것이 없고, 정점은
+        // 이미 고리 순서로 나온다. 그래서 정점은 업로드 버퍼에 바로 쓰고, 쓰기 결합
+        // 메모리를 다시 읽지 않도록 인덱스만 CPU 배열에 생성해 정점 캐시 순서로 바꾼다.
+        std::vector<UINT> indices(geo->IndexCount);
+        layout.Vertices = vertexDataBuff;
+        layout.Indices = indices.data();
+        layout.IndexSize = sizeof(UINT);
+        generate(layout);
+
+        std::vector<UINT> original(indices);
+        MeshOptimizer::OptimizeVertexCache(indices.data(), geo->IndexCount, geo->VertexCount);
+        if (MeshOptimizer::AnalyzeVertexCache(indices.data(), geo->IndexCount, geo->VertexCount).Transforms >
+            MeshOptimizer::AnalyzeVertexCache(original.data(), geo->IndexCount, geo->VertexCount).Transforms)
+        {
+            indices.swap(original);
+        }
 
-    UINT k = 0;
-    for (size_t i = 0; i < quad.Vertices.size(); ++i, ++k)
+        if (geo->IndexFormat == DXGI_FORMAT_R16_UINT)
+        {
+            std::uint16_t* indices16 = (std::uint16_t*)indexDataBuff;
+            for (UINT i = 0; i < geo->IndexCount; ++i)
+                indices16[i] = (std::uint16_t)indices[i];
+        }
+        else
+        {
+            memcpy(indexDataBuff, indices.data(), ibByteSize);
+        }
+    }
+    else
     {
-        vertices[k].Pos = quad.Vertices[i].Position;
-        vertices[k].Normal = quad.Vertices[i].Normal;
-        vertices[k].Uv = quad.Vertices[i].TexC;
-        vertices[k].Tangent = quad.Vertices[i].TangentU;
+        layout.Vertices = vertexDataBuff;
+        layout.Indices = indexDataBuff;
+        layout.IndexSize = indexSize;
+        generate(layout);
     }
 
-    // ε 
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(quad.GetIndices16()), std::end(quad.GetIndices16()));
-
-    //   Է
-    auto geo = std::make_unique<GeometryInfo>();
-    geo->Name = "Quad";
-
-    //    
-    geo->VertexCount = (UINT)vertices.size();
-    const UINT vbByteSize = geo->VertexCount * sizeof(Vertex);
-
-    D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
-
-    md3dDevice->CreateCommittedResource(
-        &heapProperty,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&geo->VertexBuffer));
-
-    void* vertexDataBuff = nullptr;
-    CD3DX12_RANGE vertexRange(0, 0);
-    geo->VertexBuffer->Map(0, &vertexRange, &vertexDataBuff);
-    memcpy(vertexDataBuff, vertices.data(), vbByteSize);
     geo->VertexBuffer->Unmap(0, nullptr);
-
-    geo->VertexView.BufferLocation = geo->VertexBuffer->GetGPUVirtualAddress();
-    geo->VertexView.StrideInBytes = sizeof(Vertex);
-    geo->VertexView.SizeInBytes = vbByteSize;
-
-    // ε   
-    geo->IndexCount = (UINT)indices.size();
-    const UINT ibByteSize = geo->IndexCount * sizeof(std::uint16_t);
-
-    heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
-
-    md3dDevice->CreateCommittedResource(
-        &heapProperty,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&geo->IndexBuffer));
-
-    void* indexDataBuff = nullptr;
-    CD3DX12_RANGE indexRange(0, 0);
-    geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-    memcpy(indexDataBuff, indices.data(), ibByteSize);
     geo->IndexBuffer->Unmap(0, nullptr);
 
-    geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-    geo->IndexView.Format = DXGI_FORMAT_R16_UINT;
-    geo->IndexView.SizeInBytes = ibByteSize;
-
     mGeometries[geo->Name] = std::move(geo);
 }
 
 void InitDirect3DApp::BuildSkullGeometry()
 {
-    std::ifstream fin("../Models/skull.txt");
-    if (!fin)
+    std::vector<TxtModelLoader::Vertex> skullVertices;
+    IndexData indices;
+
+    TxtModelLoader txtLoader;
+    if (!txtLoader.LoadTxtModel("../Models/skull.txt", skullVertices, indices))
     {
         MessageBox(0, L"../Models/skull.txt not found.", 0, 0);
         return;
     }
 
-    UINT vCount = 0;
-    UINT tCount = 0;
-
-    std::string ignore;
+    if (mOptimizeMeshes)
+    {
+        MeshOptimizer::Optimize(skullVertices.data(), sizeof(TxtModelLoader::Vertex),
+            offsetof(TxtModelLoader::Vertex, Pos), (UINT)skullVertices.size(), indices);
+    }
 
-    fin >> ignore >> vCount;
-    fin >> ignore >> tCount;
-    fin >> ignore >> ignore >> ignore >> ignore;
+    std::vector<UINT> indices32(indices.Count());
+    for (UINT i = 0; i < indices.Count(); ++i)
+        indices32[i] = indices.Get(i);
 
-    std::vector<Vertex> vertices(vCount);
-    for (UINT i = 0; i < vCount; ++i)
+    // 메시렛은 최적화된 삼각형 순서를 그대로 잘라 만든다. 인덱스가 바뀌지
+    // 않으므로 정점 캐시와 오버드로 순서가 유지되고, 메시렛을 컬링하지
+    // 않는 그림자 패스도 최적화된 순서로 그린다.
+    std::vector<Meshlet> meshlets;
+    if (mMeshletCulling)
     {
-        fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-        fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+        MeshletBuilder::BuildInOrder(skullVertices.data(), sizeof(TxtModelLoader::Vertex),
+            offsetof(TxtModelLoader::Vertex, Pos), (UINT)skullVertices.size(),
+            indices32.data(), (UINT)indices32.size(), meshlets);
     }
 
-    fin >> ignore;
-    fin >> ignore;
-    fin >> ignore;
-
-    std::vector<std::int32_t> indices(tCount * 3);
-    for (UINT i = 0; i < tCount; ++i)
+    // LOD 들은 원본 인덱스 뒤에 이어 붙이고 정점 버퍼는 함께 쓴다.
+    std::vector<MeshLod> lods;
+    std::vector<UINT> chain;
+    if (mMeshLods)
+    {
+        MeshSimplifier::VertexLayout layout;
+        layout.Vertices = skullVertices.data();
+        layout.VertexStride = sizeof(TxtModelLoader::Vertex);
+        layout.NumVertices = (UINT)skullVertices.size();
+        layout.PositionOffset = offsetof(TxtModelLoader::Vertex, Pos);
+        layout.NormalOffset = offsetof(TxtModelLoader::Vertex, Normal);
+
+        mMeshLodCache.BuildLodChain(layout, indices32.data(), (UINT)indices32.size(), mMeshLodRatios, chain, lods);
+    }
+    else
     {
-        fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+        chain.swap(indices32);
     }
+    indices.Assign(chain.data(), (UINT)chain.size(), skullVertices.size());
 
-    fin.close();
+    std::vector<Vertex> vertices(skullVertices.size());
+    for (size_t i = 0; i < skullVertices.size(); ++i)
+    {
+        vertices[i].Pos = skullVertices[i].Pos;
+        vertices[i].Normal = skullVertices[i].Normal;
+    }
 
-    //   Է
+    // 기하 데이터 입력
     auto geo = std::make_unique<GeometryInfo>();
     geo->Name = "Skull";
 
-    //    
+    // 정점 버퍼 및 뷰
     geo->VertexCount = (UINT)vertices.size();
     const UINT vbByteSize = geo->VertexCount * sizeof(Vertex);
 
@@ -1175,9 +1461,12 @@ void InitDirect3DApp::BuildSkullGeometry()
     geo->VertexView.StrideInBytes = sizeof(Vertex);
     geo->VertexView.SizeInBytes = vbByteSize;
 
-    // ε   
-    geo->IndexCount = (UINT)indices.size();
-    const UINT ibByteSize = geo->IndexCount * sizeof(std::int32_t);
+    // 인덱스 버퍼 및 뷰. 버퍼에는 모든 LOD 가 들어 있다.
+    geo->IndexCount = lods.empty() ? indices.Count() : lods[0].IndexCount;
+    geo->Lods = lods;
+    geo->Meshlets = meshlets;
+    geo->IndexFormat = indices.Format();
+    const UINT ibByteSize = indices.ByteSize();
 
     heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     desc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
@@ -1193,11 +1482,11 @@ void InitDirect3DApp::BuildSkullGeometry()
     void* indexDataBuff = nullptr;
     CD3DX12_RANGE indexRange(0, 0);
     geo->IndexBuffer->Map(0, &indexRange, &indexDataBuff);
-    memcpy(indexDataBuff, indices.data(), ibByteSize);
+    memcpy(indexDataBuff, indices.Data(), ibByteSize);
     geo->IndexBuffer->Unmap(0, nullptr);
 
     geo->IndexView.BufferLocation = geo->IndexBuffer->GetGPUVirtualAddress();
-    geo->IndexView.Format = DXGI_FORMAT_R32_UINT;
+    geo->IndexView.Format = geo->IndexFormat;
     geo->IndexView.SizeInBytes = ibByteSize;
 
     mGeometries[geo->Name] = std::move(geo);
@@ -1394,32 +1683,53 @@ void InitDirect3DApp::BuildRenderItems()
         mRenderitems.push_back(std::move(rightSpRItem));
     }
 
-    for (UINT i = 0; i < mSkinnedMats.size(); ++i)
+    for (UINT inst = 0; inst < mAnimationSystem->InstanceCount(); ++inst)
     {
-        std::string submeshName = "sm_" + std::to_string(i);
+        // Soldiers after the first stand in rows of ten behind it.
+        float offsetX = (inst % 10) * 2.5f;
+        float offsetZ = (inst / 10) * 2.5f;
 
-        auto ritem = std::make_unique<RenderItem>();
-
-        // Reflect to change coordinate system from the RHS the data was exported out as.
-        XMMATRIX modelScale = XMMatrixScaling(0.05f, 0.05f, -0.05f);
-        XMMATRIX modelRot = XMMatrixRotationY(MathHelper::Pi);
-        XMMATRIX modelOffset = XMMatrixTranslation(0.0f, 0.0f, -5.0f);
-        XMStoreFloat4x4(&ritem->World, modelScale * modelRot * modelOffset);
-
-        ritem->TexTransform = MathHelper::Identity4x4();
-        ritem->ObjCBIndex = objectCBIndex++;
-        ritem->Mat = mMaterials[mSkinnedMats[i].Name].get();
-        ritem->Geo = mGeometries[submeshName].get();
-        ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-
-
-        // All render items for this solider.m3d instance share
-        // the same skinned model instance.
-        ritem->SkinnedCBIndex = 0;
-        ritem->SkinnedModelInst = mSkinnedModelInst.get();
-
-        mRitemLayer[(int)RenderLayer::SkinnedOpaque].push_back(ritem.get());
-        mRenderitems.push_back(std::move(ritem));
+        for (UINT i = 0; i < mSkinnedMats.size(); ++i)
+        {
+            std::string submeshName = "sm_" + std::to_string(i);
+
+            auto ritem = std::make_unique<RenderItem>();
+
+            // Reflect to change coordinate system from the RHS the data was exported out as.
+            XMMATRIX modelScale = XMMatrixScaling(0.05f, 0.05f, -0.05f);
+            XMMATRIX modelRot = XMMatrixRotationY(MathHelper::Pi);
+            XMMATRIX modelOffset = XMMatrixTranslation(offsetX, 0.0f, -5.0f + offsetZ);
+            XMStoreFloat4x4(&ritem->World, modelScale * modelRot * modelOffset);
+
+            // 병사는 움직이지 않으므로 LOD에 쓰는 월드 경계 구는 한 번만 구한다.
+            if (i == 0)
+                mSkinnedBounds.Transform(mAnimationSystem->GetInstance(inst)->Bounds, modelScale * modelRot * modelOffset);
+
+            ritem->TexTransform = MathHelper::Identity4x4();
+            ritem->ObjCBIndex = objectCBIndex++;
+            ritem->Mat = mMaterials[mSkinnedMats[i].Name].get();
+            ritem->Geo = mGeometries[submeshName].get();
+            ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+            // CPU에서 스키닝한 정점은 일반 불투명 물체로 그린다.
+            if (mSkinnedOnCpu)
+            {
+                ritem->Geo = mGeometries["sm_cpu_" + std::to_string(inst) + "_" + std::to_string(i)].get();
+                mRitemLayer[(int)RenderLayer::Opaque].push_back(ritem.get());
+                mRenderitems.push_back(std::move(ritem));
+                continue;
+            }
+
+
+            // All render items for one soldier share its skinned model
+            // instance and palette slot.
+            ritem->SkinnedCBIndex = inst;
+            ritem->SkinnedPaletteOffset = mSkinnedPaletteLayout.PaletteOffset(mSkinnedPaletteLayout.SubsetPalette(i));
+            ritem->SkinnedModelInst = mAnimationSystem->GetInstance(inst);
+
+            mRitemLayer[(int)RenderLayer::SkinnedOpaque].push_back(ritem.get());
+            mRenderitems.push_back(std::move(ritem));
+        }
     }
 }
 
@@ -1459,9 +1769,11 @@ void InitDirect3DApp::BuildShaders()
         NULL, NULL
     };
 
+    // 팔레트 형식에 정의가 없으면 두 번째 항목의 NULL 이 목록의 끝이 된다.
     const D3D_SHADER_MACRO skinnedDefines[] =
     {
         "SKINNED", "1",
+        BonePalette::ShaderDefine(mSkinnedPaletteFormat), "1",
         NULL, NULL
     };
 
@@ -1483,7 +1795,7 @@ void InitDirect3DApp::BuildShaders()
 
 void InitDirect3DApp::BuildConstantBuffers()
 {
-    //  Ʈ  
+    // 개별 오브젝트 상수 버퍼
     UINT size = sizeof(ObjectConstants);
     mObjectByteSize = ((size + 255) & ~255) * mRenderitems.size();
     D3D12_HEAP_PROPERTIES heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -1500,7 +1812,7 @@ void InitDirect3DApp::BuildConstantBuffers()
     mObjectCB->Map(0, nullptr, reinterpret_cast<void**>(&mObjectMappedData));
 
 
-    //  Ʈ   
+    // 개별 오브젝트 재질 상수 버퍼
     size = sizeof(MaterialConstants);
     mMaterialByteSize = ((size + 255) & ~255) * mMaterials.size();
     heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -1517,7 +1829,7 @@ void InitDirect3DApp::BuildConstantBuffers()
     mMaterialCB->Map(0, nullptr, reinterpret_cast<void**>(&mMaterialMappedData));
 
 
-    //   
+    // 공용 상수 버퍼
     size = sizeof(PassConstants);
     mPassByteSize = ((size + 255) & ~255)*2;
     heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -1533,10 +1845,12 @@ void InitDirect3DApp::BuildConstantBuffers()
 
     mPassCB->Map(0, nullptr, reinterpret_cast<void**>(&mPassMappedData));
 
-    size = sizeof(SkinnedConstants);
-    mSkinnedByteSize = (size + 255) & ~255;
+    // 인스턴스마다 모든 서브셋 팔레트를 담는 슬롯
+    mSkinnedSlotByteSize = mSkinnedPaletteLayout.SlotByteSize();
+    mSkinnedByteSize = mSkinnedSlotByteSize * mAnimationSystem->InstanceCount();
+    const bool pipelined = mSkinnedPipelined && !mSkinnedOnCpu && !mSkinnedUseAtlas;
     heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    desc = CD3DX12_RESOURCE_DESC::Buffer(mSkinnedByteSize);
+    desc = CD3DX12_RESOURCE_DESC::Buffer(mSkinnedByteSize * (pipelined ? 2 : 1));
 
     md3dDevice->CreateCommittedResource(
         &heapProperty,
@@ -1547,6 +1861,16 @@ void InitDirect3DApp::BuildConstantBuffers()
         IID_PPV_ARGS(&mSkinnedCB));
 
     mSkinnedCB->Map(0, nullptr, reinterpret_cast<void**>(&mSkinnedMappedData));
+
+    if (!mSkinnedOnCpu && !mSkinnedUseAtlas)
+        mAnimationSystem->SetPalette(mSkinnedMappedData, mSkinnedPaletteLayout);
+
+    // 두 번째 팔레트는 첫 번째 바로 뒤에 둔다.
+    if (pipelined)
+    {
+        mAnimationPipeline = std::make_unique<AnimationPipeline>(mAnimationSystem.get(), mThreadPool.get());
+        mAnimationPipeline->SetPalettes(mSkinnedMappedData, mSkinnedMappedData + mSkinnedByteSize);
+    }
 }
 
 void InitDirect3DApp::BuildRootSignature()
@@ -1572,19 +1896,19 @@ void InitDirect3DApp::BuildRootSignature()
     };
 
     CD3DX12_ROOT_PARAMETER param[8];
-    param[0].InitAsConstantBufferView(0); // 0 -> b0 -> CBV //  Ʈ  
-    param[1].InitAsConstantBufferView(1); // 1 -> b1 -> CBV //  Ʈ  
-    param[2].InitAsConstantBufferView(2); // 2 -> b2 -> CBV //   
+    param[0].InitAsConstantBufferView(0); // 0번 -> b0 -> CBV // 개별 오브젝트 상수 버퍼
+    param[1].InitAsConstantBufferView(1); // 1번 -> b1 -> CBV // 개별 오브젝트 재질 버퍼
+    param[2].InitAsConstantBufferView(2); // 2번 -> b2 -> CBV // 공용 상수 버퍼
     param[3].InitAsDescriptorTable(_countof(skyboxTable), skyboxTable);
     param[4].InitAsDescriptorTable(_countof(texTable), texTable);
     param[5].InitAsDescriptorTable(_countof(normalTable), normalTable);
     param[6].InitAsDescriptorTable(_countof(shadowTable), shadowTable);
-    param[7].InitAsConstantBufferView(3); // 3 -> b3 -> Skinned
+    param[7].InitAsConstantBufferView(3); // 3번 -> b3 -> Skinned
 
     auto staticSamplers = GetStaticSamplers();
 
     D3D12_ROOT_SIGNATURE_DESC sigDesc = CD3DX12_ROOT_SIGNATURE_DESC(_countof(param), param, (UINT)staticSamplers.size(), staticSamplers.data());
-    sigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT; // Է  ܰ
+    sigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT; // 입력 조립기 단계
 
     ComPtr<ID3DBlob> blobSignature;
     ComPtr<ID3DBlob> blobError;
@@ -1758,7 +2082,7 @@ void InitDirect3DApp::BuildPSO()
     D3D12_GRAPHICS_PIPELINE_STATE_DESC skyPsoDesc = opaquePsoDesc;
     skyPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
 
-    // Far < 1 ϶, --> xyww w = 1
+    // Far < 1 일때, --> xyww w = 1
     skyPsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
 
     skyPsoDesc.VS =
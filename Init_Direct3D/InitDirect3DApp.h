@@ -10,6 +10,15 @@
 #include "ShadowMap.h"
 #include "SkinnedData.h"
 #include "LoadM3d.h"
+#include "M3dFile.h"
+#include "LoadTxtModel.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "Benchmarks.h"
+#include "CpuSkinner.h"
+#include "AnimationAtlas.h"
+#include "AnimationPipeline.h"
 
 class InitDirect3DApp : public D3DApp
 {
@@ -29,12 +38,18 @@ private:
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateSkinnedCBs(const GameTimer& gt);
+	void UpdateSkinnedBounds();
+	void UpdateSkinnedVisibility();
+	void UpdateSkinnedLodCaption();
+	void UpdateMeshLods();
+	void UpdateMeshletCulling();
+	void UpdateCpuSkinnedVertices();
 	void UpdateShadowTransform(const GameTimer& gt);
 	void UpdatePassCB(const GameTimer& gt);
 	void UpdateShadowPassCB(const GameTimer& gt);
 
 	virtual void Draw(const GameTimer& gt)override;
-	void DrawRenderItems(const std::vector<RenderItem*>& ritems);
+	void DrawRenderItems(const std::vector<RenderItem*>& ritems, bool cullMeshlets = false);
 	void DrawSceneToShadowMap();
 
 	virtual void DrawBegin(const GameTimer& gt)override;
@@ -45,13 +60,15 @@ private:
 	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
 private:
-	// Skinned Model ε
-	void LoadSkinnedModel();
+	// Skinned Model 로드
+	bool LoadSkinnedModel();
+	void BuildCpuSkinnedGeometry();
+	void BuildSkinnedAtlas();
 
-	// ؽó ε
+	// 텍스처 로드
 	void LoadTextures();
 
-	//   
+	// 기하 도형 생성
 	void BuildBoxGeometry();
 	void BuildGridGeometry();
 	void BuildSphereGeometry();
@@ -59,10 +76,14 @@ private:
 	void BuildQuadGeometry();
 	void BuildSkullGeometry();
 
-	//  
+	// 업로드 버퍼를 size만큼 만들고, 매핑한 메모리에 generate가 바로 기록한다.
+	void BuildGeneratedGeometry(const std::string& name, const GeometryGenerator::MeshSize& size,
+		const std::function<void(const GeometryGenerator::MeshLayout&)>& generate);
+
+	// 재질 생성
 	void BuildMaterials();
 
-	//    
+	// 렌더링 할 아이템 생성
 	void BuildRenderItems();
 
 	void BuildInputLayout();
@@ -75,66 +96,69 @@ private:
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 2> GetStaticSamplers();
 
 private:
-	// Է ġ
+	// 입력 배치
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mSkinnedInputLayout;
 
-	//  Ʈ  
+	// 개별 오브젝트 상수 버퍼
 	ComPtr<ID3D12Resource>	mObjectCB = nullptr;
 	BYTE* mObjectMappedData = nullptr;
 	UINT mObjectByteSize = 0;
 
-	//  Ʈ   
+	// 개별 오브젝트 재질 상수 버퍼
 	ComPtr<ID3D12Resource>	mMaterialCB = nullptr;
 	BYTE* mMaterialMappedData = nullptr;
 	UINT mMaterialByteSize = 0;
 
-	//   
+	// 공용 상수 버퍼
 	ComPtr<ID3D12Resource>	mPassCB = nullptr;
 	BYTE* mPassMappedData = nullptr;
 	UINT mPassByteSize = 0;
 
-	// Skinned 
+	// Skinned 버퍼
 	ComPtr<ID3D12Resource>	mSkinnedCB = nullptr;
 	BYTE* mSkinnedMappedData = nullptr;
 	UINT mSkinnedByteSize = 0;
+	UINT mSkinnedSlotByteSize = 0;
+	BonePaletteFormat mSkinnedPaletteFormat = BonePaletteFormat::Affine3x4;
+	BonePaletteLayout mSkinnedPaletteLayout;
 
-	// Ʈ ñ״ó
+	// 루트 시그니처
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
-	// ̴ 
+	// 쉐이더 맵
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 
-	//  Ʈ 
+	// 렌더링파이프라인 스테이트 맵
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
-	//  
+	// 서술자 힙
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 	UINT mCbvSrvDescriptorSize = 0;
 
-	//   Ʈ Ʈ
+	// 렌더링 할 오브젝트 리스트
 	std::vector<std::unique_ptr<RenderItem>> mRenderitems;
 
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
-	//   
+	// 기하 구조 맵
 	std::unordered_map<std::string, std::unique_ptr<GeometryInfo>> mGeometries;
 
-	//   
+	// 재질 구조 맵
 	std::unordered_map<std::string, std::unique_ptr<MaterialInfo>> mMaterials;
 
-	// ؽó 
+	// 텍스처 맵
 	std::unordered_map<std::string, std::unique_ptr<TextureInfo>> mTextures;
 	
-	//  
+	// 쉐도우 맵
 	std::unique_ptr<ShadowMap> mShadowMap;
 
-	//  
+	// 경계 구
 	DirectX::BoundingSphere mSceneBounds;
 
-	// Ʈ 
+	// 라이트 행렬
 	float mLightNearZ = 0.0f;
 	float mLightFarZ = 0.0f;
 	XMFLOAT3 mLightPosW;
@@ -142,6 +166,9 @@ private:
 	XMFLOAT4X4 mLightProj = MathHelper::Identity4x4();
 	XMFLOAT4X4 mShadowTransform = MathHelper::Identity4x4();
 
+	// 그림자 맵이 덮는 월드 공간 상자. 그림자를 드리울 스키닝 인스턴스를 고른다.
+	BoundingOrientedBox mLightVolume;
+
 	float mLightRotationAngle = 0.0f;
 	XMFLOAT3 mBaseLightDirections[3] = {
 		XMFLOAT3(0.57735f, -0.57735f, 0.57735f),
@@ -150,25 +177,102 @@ private:
 	};
 	XMFLOAT3 mRotatedLightDirections[3];
 
-	// ī̹ڽ ؽó ε
+	// 스카이박스 텍스처 인덱스
 	UINT mSkyboxTexHeapIndex = 0;
 
-	// ׸  ؽó ε
+	// 그림자 맵 텍스처 인덱스
 	UINT mShadowMapHeapIndex = 0;
 
 	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv;
 
+	// 로딩 및 애니메이션 작업에 쓰는 스레드 풀
+	std::unique_ptr<ThreadPool> mThreadPool;
+
+	// true 면 로드하거나 생성한 메시의 삼각형과 정점 순서를 정점 캐시, 오버드로,
+	// 정점 읽기에 맞게 바꾼다. 스킨 모델은 이 값이 바뀌면 .m3db 를 다시 만든다.
+	bool mOptimizeMeshes = true;
+
+	// true 면 스컬과 스킨 모델 서브셋의 LOD 를 만들고, 오차가 화면에서
+	// mMeshLodPixelError 픽셀 이하로 보이는 가장 단순한 LOD 를 그린다.
+	bool mMeshLods = true;
+	float mMeshLodPixelError = 1.0f;
+	// 원본 대비 각 LOD 의 삼각형 비율
+	std::vector<float> mMeshLodRatios = { 0.5f, 0.25f, 0.125f, 0.0625f };
+	// 만든 LOD 를 저장해 두고 입력이 같으면 다음 실행에서 다시 쓴다.
+	std::string mMeshLodCacheFilename = "..\\Models\\lods.cache";
+	MeshLodCache mMeshLodCache;
+
+	// true 면 스컬의 삼각형 순서를 바꾸지 않고 메시렛으로 나누고, LOD 0 을 그릴 때
+	// 카메라 절두체 밖이거나 모두 뒷면인 메시렛을 빼고 그린다. 그림자 패스는
+	// 모두 그린다.
+	bool mMeshletCulling = true;
+
 	UINT mSkinnedSrvHeapStart = 0;
 	std::string mSkinnedModelFilename = "..\\Models\\soldier.m3d";
-	std::unique_ptr<SkinnedModelInstance> mSkinnedModelInst;
+	std::string mSkinnedModelBinaryFilename = "..\\Models\\soldier.m3db";
+	// Animation clips are decoded when first played; beyond this many bytes
+	// of decoded keyframes the least recently played clips are dropped.
+	size_t mSkinnedClipMemoryBudget = 64 * 1024 * 1024;
+	// Greater than zero compresses the clips, allowing this much error in
+	// model units; see CompressedAnimationClip.
+	float mSkinnedClipTolerance = 0.0f;
+	std::string mSkinnedClipName = "Take1";
+
+	// 스킨 모델 인스턴스 수와 인스턴스별 애니메이션 갱신
+	UINT mSkinnedInstanceCount = 1;
+	// 0보다 크면 같은 클립, 같은 시간(이 간격으로 양자화)의 포즈를 인스턴스끼리 공유
+	float mSkinnedPoseQuantum = 0.0f;
+	// true 면 화면 크기에 따라 갱신 주기와 본 수를 줄이고 화면 밖 인스턴스는 갱신하지 않는다.
+	// 멀리 있을 때는 계층의 가장 깊은 mSkinnedLodLeafDepths 단계(손가락 등)를 건너뛴다.
+	bool mSkinnedLod = true;
+	UINT mSkinnedLodLeafDepths = 3;
+	AnimationLodPolicy mSkinnedLodPolicy;
+	// 바인드 포즈 정점의 모델 공간 경계 구
+	DirectX::BoundingSphere mSkinnedBounds;
+	// 본별 바인드 포즈 경계 상자
+	BoneBounds mSkinnedBoneBounds;
+	// 카메라 절두체와 그림자 맵 볼륨에 걸치는 스킨 렌더 아이템
+	std::vector<RenderItem*> mSkinnedVisibleRitems;
+	std::vector<RenderItem*> mSkinnedShadowRitems;
+	// LOD 통계를 덧붙이기 전의 창 제목
+	std::wstring mMainWndCaptionBase;
+	std::unique_ptr<AnimationSystem> mAnimationSystem;
+	// true 면 다음 프레임의 팔레트를 현재 프레임의 명령을 기록하는 동안 스레드 풀에서
+	// 미리 계산한다. 스킨 상수 버퍼는 두 벌이 되고 mSkinnedPaletteIndex 가 이번 프레임의 것이다.
+	// GPU 스키닝에서만 쓰인다. 상수 버퍼가 두 배가 되고 스킨 메시가 한 프레임 늦게
+	// 그려지므로 기본으로는 끈다.
+	bool mSkinnedPipelined = false;
+	std::unique_ptr<AnimationPipeline> mAnimationPipeline;
+	UINT mSkinnedPaletteIndex = 0;
 	SkinnedData mSkinnedInfo;
 	std::vector<M3DLoader::Subset> mSkinnedSubsets;
 	std::vector<M3DLoader::M3dMaterial> mSkinnedMats;
 	std::vector<std::string> mSkinnedTextureNames;
 
-	// ī޶ Ŭ
+	// true 면 스킨 모델을 매 프레임 CPU에서 한 번 스키닝하고, 그 정점을
+	// 그림자 패스와 메인 패스가 일반 정점처럼 그린다.
+	bool mSkinnedOnCpu = false;
+	std::unique_ptr<CpuSkinner> mCpuSkinner;
+	// 본 인덱스를 바꾸지 않은 서브셋 정점들과 서브셋별 시작 위치
+	std::vector<M3DLoader::SkinnedVertex> mSkinnedCpuVertices;
+	std::vector<UINT> mSkinnedCpuFirstVertex;
+	// 인스턴스마다 mSkinnedCpuVertices 크기의 Vertex 배열
+	ComPtr<ID3D12Resource> mCpuSkinnedVB = nullptr;
+	BYTE* mCpuSkinnedMappedData = nullptr;
+
+	// true 면 mSkinnedClipName 을 mSkinnedAtlasRate 로 팔레트 아틀라스에 구워 두고
+	// 인스턴스는 매 프레임 시간과 프레임 번호만 갱신한다. GPU 스키닝에만 쓰인다.
+	bool mSkinnedUseAtlas = false;
+	float mSkinnedAtlasRate = 30.0f;
+	std::string mSkinnedAtlasFilename = "..\\Models\\soldier.atlas";
+	AnimationAtlas mSkinnedAtlas;
+	UINT mSkinnedAtlasClip = 0;
+	std::vector<UINT> mSkinnedAtlasFrames;
+	ComPtr<ID3D12Resource> mSkinnedAtlasBuffer = nullptr;
+
+	// 카메라 클래스
 	Camera mCamera;
 
-	// 콺 ǥ
+	// 마우스 좌표
 	POINT mLastMousePos = { 0, 0 };
 };
\ No newline at end of file
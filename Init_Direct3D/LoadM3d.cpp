@@ -1,14 +1,174 @@
 #include "LoadM3d.h"
+#include "M3dFile.h"
  
 using namespace DirectX;
 
+namespace
+{
+	// Below this size a section is parsed as one piece.
+	const size_t MinChunkBytes = 64*1024;
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+	}
+
+	// Counts the records in [begin, end).  A record starts at each occurrence of
+	// marker, or, with an empty marker, is one non-blank line.
+	UINT CountRecords(const char* begin, const char* end, std::string_view marker)
+	{
+		UINT count = 0;
+		std::string_view text(begin, end - begin);
+
+		if( !marker.empty() )
+		{
+			for(size_t pos = text.find(marker); pos != std::string_view::npos; pos = text.find(marker, pos + marker.size()))
+				++count;
+			return count;
+		}
+
+		bool lineHasText = false;
+		for(char c : text)
+		{
+			if( c == '\n' )
+			{
+				count += lineHasText ? 1 : 0;
+				lineHasText = false;
+			}
+			else if( !IsSpace(c) )
+			{
+				lineHasText = true;
+			}
+		}
+		return count + (lineHasText ? 1 : 0);
+	}
+}
+
+///<summary>
+/// Decodes clips from a text .m3d file.  Only the byte range of each clip
+/// is kept; the range is read back from the file when the clip is needed.
+///</summary>
+class M3DLoader::TextClipSource : public AnimationClipSource
+{
+public:
+	TextClipSource(const std::string& filename, UINT numBones)
+		: mFilename(filename), mNumBones(numBones)
+	{
+	}
+
+	void AddClip(const std::string& name, UINT64 begin, UINT64 end)
+	{
+		mClips.push_back({ name, begin, end });
+	}
+
+	UINT ClipCount()const override
+	{
+		return (UINT)mClips.size();
+	}
+
+	const std::string& ClipName(UINT clipIndex)const override
+	{
+		return mClips[clipIndex].Name;
+	}
+
+	bool LoadClip(UINT clipIndex, AnimationClip& clip) override
+	{
+		const ClipRange& range = mClips[clipIndex];
+
+		std::ifstream fin(mFilename, std::ios::binary);
+		if( !fin.seekg((std::streamoff)range.Begin) )
+			return false;
+
+		std::vector<char> text((size_t)(range.End - range.Begin));
+		if( !fin.read(text.data(), text.size()) )
+			return false;
+
+		TextTokenizer tok(text.data(), text.data() + text.size());
+		std::string_view ignore;
+		tok >> ignore >> ignore; // AnimationClip name
+		tok >> ignore; // {
+
+		clip.BoneAnimations.resize(mNumBones);
+		for(UINT boneIndex = 0; boneIndex < mNumBones; ++boneIndex)
+		{
+			mLoader.ReadBoneKeyframes(tok, mNumBones, clip.BoneAnimations[boneIndex]);
+		}
+		tok >> ignore; // }
+
+		return (bool)tok;
+	}
+
+private:
+	struct ClipRange
+	{
+		std::string Name;
+		UINT64 Begin;
+		UINT64 End;
+	};
+
+	M3DLoader mLoader;
+	std::string mFilename;
+	UINT mNumBones;
+	std::vector<ClipRange> mClips;
+};
+
+///<summary>
+/// Decodes clips from a binary .m3db file through its own file mapping.
+/// Pages of the keyframe section are only touched when a clip is decoded.
+///</summary>
+class M3DLoader::BinaryClipSource : public AnimationClipSource
+{
+public:
+	bool Open(const std::string& filename)
+	{
+		if( !mFile.Open(filename) || !mFile.GetHeader().Skinned )
+			return false;
+
+		for(UINT i = 0; i < mFile.GetHeader().NumAnimationClips; ++i)
+			mNames.push_back(mFile.GetString(mFile.Clips()[i].Name));
+
+		return true;
+	}
+
+	UINT ClipCount()const override
+	{
+		return (UINT)mNames.size();
+	}
+
+	const std::string& ClipName(UINT clipIndex)const override
+	{
+		return mNames[clipIndex];
+	}
+
+	bool LoadClip(UINT clipIndex, AnimationClip& clip) override
+	{
+		ReadBinaryClip(mFile, clipIndex, clip);
+		return true;
+	}
+
+private:
+	M3dFile mFile;
+	std::vector<std::string> mNames;
+};
+
+M3DLoader::M3DLoader(ThreadPool* threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
+void M3DLoader::EnableLazyClips(size_t clipMemoryBudget)
+{
+	mLazyClips = true;
+	mClipMemoryBudget = clipMemoryBudget;
+}
+
 bool M3DLoader::LoadM3d(const std::string& filename, 
 						std::vector<Vertex>& vertices,
-						std::vector<USHORT>& indices,
+						IndexData& indices,
 						std::vector<Subset>& subsets,
 						std::vector<M3dMaterial>& mats)
 {
-	std::ifstream fin(filename);
+	TextTokenizer tok;
 
 	UINT numMaterials = 0;
 	UINT numVertices  = 0;
@@ -16,21 +176,25 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	UINT numBones     = 0;
 	UINT numAnimationClips = 0;
 
-	std::string ignore;
+	std::string_view ignore;
 
-	if( fin )
+	if( tok.LoadFile(filename) )
 	{
-		fin >> ignore; // file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
+		tok >> ignore; // file header text
+		tok >> ignore >> numMaterials;
+		tok >> ignore >> numVertices;
+		tok >> ignore >> numTriangles;
+		tok >> ignore >> numBones;
+		tok >> ignore >> numAnimationClips;
  
-		ReadMaterials(fin, numMaterials, mats);
-		ReadSubsetTable(fin, numMaterials, subsets);
-	    ReadVertices(fin, numVertices, vertices);
-	    ReadTriangles(fin, numTriangles, indices);
+		ReadMaterials(tok, numMaterials, mats);
+		ReadSubsetTable(tok, numMaterials, subsets);
+
+		if( !ReadSectionsParallel(tok, numVertices, numTriangles, 0, 0, vertices, indices, nullptr, nullptr, nullptr) )
+		{
+		    ReadVertices(tok, numVertices, vertices);
+		    ReadTriangles(tok, numTriangles, numVertices, indices);
+		}
  
 		return true;
 	 }
@@ -39,12 +203,12 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 
 bool M3DLoader::LoadM3d(const std::string& filename, 
 						std::vector<SkinnedVertex>& vertices,
-						std::vector<USHORT>& indices,
+						IndexData& indices,
 						std::vector<Subset>& subsets,
 						std::vector<M3dMaterial>& mats,
 						SkinnedData& skinInfo)
 {
-    std::ifstream fin(filename);
+    TextTokenizer tok;
 
 	UINT numMaterials = 0;
 	UINT numVertices  = 0;
@@ -52,106 +216,420 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 	UINT numBones     = 0;
 	UINT numAnimationClips = 0;
 
-	std::string ignore;
+	std::string_view ignore;
 
-	if( fin )
+	if( tok.LoadFile(filename) )
 	{
-		fin >> ignore; // file header text
-		fin >> ignore >> numMaterials;
-		fin >> ignore >> numVertices;
-		fin >> ignore >> numTriangles;
-		fin >> ignore >> numBones;
-		fin >> ignore >> numAnimationClips;
+		tok >> ignore; // file header text
+		tok >> ignore >> numMaterials;
+		tok >> ignore >> numVertices;
+		tok >> ignore >> numTriangles;
+		tok >> ignore >> numBones;
+		tok >> ignore >> numAnimationClips;
  
 		std::vector<XMFLOAT4X4> boneOffsets;
 		std::vector<int> boneIndexToParentIndex;
 		std::unordered_map<std::string, AnimationClip> animations;
 
-		ReadMaterials(fin, numMaterials, mats);
-		ReadSubsetTable(fin, numMaterials, subsets);
-	    ReadSkinnedVertices(fin, numVertices, vertices);
-	    ReadTriangles(fin, numTriangles, indices);
-		ReadBoneOffsets(fin, numBones, boneOffsets);
-	    ReadBoneHierarchy(fin, numBones, boneIndexToParentIndex);
-	    ReadAnimationClips(fin, numBones, numAnimationClips, animations);
- 
-		skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
+		ReadMaterials(tok, numMaterials, mats);
+		ReadSubsetTable(tok, numMaterials, subsets);
+
+		if( !ReadSectionsParallel(tok, numVertices, numTriangles, numBones, numAnimationClips,
+			vertices, indices, &boneOffsets, &boneIndexToParentIndex, mLazyClips ? nullptr : &animations) )
+		{
+		    ReadSkinnedVertices(tok, numVertices, vertices);
+		    ReadTriangles(tok, numTriangles, numVertices, indices);
+			ReadBoneOffsets(tok, numBones, boneOffsets);
+		    ReadBoneHierarchy(tok, numBones, boneIndexToParentIndex);
+			if( !mLazyClips )
+			    ReadAnimationClips(tok, numBones, numAnimationClips, animations);
+		}
+
+		// GetFinalTransforms concatenates the bones in file order.
+		if( !SkinnedData::ValidateBoneHierarchy(boneIndexToParentIndex.data(), numBones) )
+			return false;
+
+		std::unique_ptr<AnimationClipSource> clipSource;
+		if( mLazyClips )
+		{
+			clipSource = IndexAnimationClips(tok, filename, numBones, numAnimationClips);
+			if( clipSource == nullptr )
+				return false;
+		}
+
+		if( clipSource != nullptr )
+			skinInfo.Set(boneIndexToParentIndex, boneOffsets, std::move(clipSource), mClipMemoryBudget);
+		else
+			skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
 
 	    return true;
 	}
     return false;
 }
 
-void M3DLoader::ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats)
+template<typename VertexType>
+bool M3DLoader::ReadSectionsParallel(const TextTokenizer& tok, UINT numVertices, UINT numTriangles,
+									 UINT numBones, UINT numAnimationClips,
+									 std::vector<VertexType>& vertices,
+									 IndexData& indices,
+									 std::vector<XMFLOAT4X4>* boneOffsets,
+									 std::vector<int>* boneIndexToParentIndex,
+									 std::unordered_map<std::string, AnimationClip>* animations)
+{
+	if( mThreadPool == nullptr || mThreadPool->ThreadCount() == 1 )
+		return false;
+
+	// Pre-scan: locate every section and split the big ones into chunks of
+	// whole records.  Nothing is written to the outputs until the layout has
+	// been validated, so on failure the caller can still parse sequentially.
+	std::unordered_map<std::string_view, TextSection> sections;
+	if( !FindSections(tok, sections) )
+		return false;
+
+	const bool skinned = boneOffsets != nullptr;
+	const bool readClips = animations != nullptr;
+	const char* required[] = { "Vertices", "Triangles", "BoneOffsets", "BoneHierarchy", "AnimationClips" };
+	for(UINT i = 0; i < (readClips ? 5u : skinned ? 4u : 2u); ++i)
+	{
+		if( sections.find(required[i]) == sections.end() )
+			return false;
+	}
+
+	std::vector<TextChunk> vertexChunks;
+	std::vector<TextChunk> triangleChunks;
+	if( !SplitSection(sections["Vertices"], "Position:", numVertices, vertexChunks) ||
+		!SplitSection(sections["Triangles"], std::string_view(), numTriangles, triangleChunks) )
+		return false;
+
+	std::vector<std::string> clipNames;
+	std::vector<TextSection> keyframeBlocks;
+	if( readClips && !FindKeyframeBlocks(sections["AnimationClips"], numBones, numAnimationClips, clipNames, keyframeBlocks, nullptr) )
+		return false;
+
+	// Everything below writes into pre-sized storage, one task per chunk or block.
+	vertices.resize(numVertices);
+	indices.Resize(numTriangles*3, numVertices);
+
+	std::vector<AnimationClip> clips(readClips ? numAnimationClips : 0);
+	for(AnimationClip& clip : clips)
+		clip.BoneAnimations.resize(numBones);
+
+	std::vector<std::function<void()>> tasks;
+	tasks.reserve(vertexChunks.size() + triangleChunks.size() + keyframeBlocks.size() + 2);
+
+	for(const TextChunk& chunk : vertexChunks)
+	{
+		tasks.push_back([this, chunk, &vertices]()
+		{
+			TextTokenizer chunkTok(chunk.Begin, chunk.End);
+			ReadVertexRange(chunkTok, chunk.First, chunk.Count, vertices);
+		});
+	}
+
+	for(const TextChunk& chunk : triangleChunks)
+	{
+		tasks.push_back([this, chunk, &indices]()
+		{
+			TextTokenizer chunkTok(chunk.Begin, chunk.End);
+			ReadTriangleRange(chunkTok, chunk.First, chunk.Count, indices);
+		});
+	}
+
+	if( skinned )
+	{
+		// The bone sections are tiny; the section readers expect their header
+		// token, so start each tokenizer at the header.
+		const TextSection& offsets = sections["BoneOffsets"];
+		const TextSection& hierarchy = sections["BoneHierarchy"];
+
+		tasks.push_back([this, offsets, numBones, boneOffsets]()
+		{
+			TextTokenizer sectionTok(offsets.Begin, offsets.End);
+			ReadBoneOffsets(sectionTok, numBones, *boneOffsets);
+		});
+		tasks.push_back([this, hierarchy, numBones, boneIndexToParentIndex]()
+		{
+			TextTokenizer sectionTok(hierarchy.Begin, hierarchy.End);
+			ReadBoneHierarchy(sectionTok, numBones, *boneIndexToParentIndex);
+		});
+
+		for(UINT i = 0; i < (UINT)keyframeBlocks.size(); ++i)
+		{
+			BoneAnimation& boneAnimation = clips[i / numBones].BoneAnimations[i % numBones];
+			const TextSection block = keyframeBlocks[i];
+
+			tasks.push_back([this, block, numBones, &boneAnimation]()
+			{
+				TextTokenizer blockTok(block.Begin, block.End);
+				ReadBoneKeyframes(blockTok, numBones, boneAnimation);
+			});
+		}
+	}
+
+	mThreadPool->ParallelFor((UINT)tasks.size(), [&tasks](UINT i) { tasks[i](); });
+
+	for(UINT i = 0; i < (UINT)clips.size(); ++i)
+		(*animations)[clipNames[i]] = std::move(clips[i]);
+
+	return true;
+}
+
+bool M3DLoader::FindSections(const TextTokenizer& tok, std::unordered_map<std::string_view, TextSection>& sections)
 {
-	 std::string ignore;
+	// Section headers are the only lines that start with '*'.  Each section
+	// runs from its header up to the next header.
+	TextSection* previous = nullptr;
+	for(const char* p = tok.Begin(); p != tok.End(); )
+	{
+		if( *p == '*' && (p == tok.Begin() || p[-1] == '\n') )
+		{
+			const char* nameBegin = p;
+			while( nameBegin != tok.End() && *nameBegin == '*' )
+				++nameBegin;
+
+			const char* nameEnd = nameBegin;
+			while( nameEnd != tok.End() && *nameEnd != '*' && !IsSpace(*nameEnd) )
+				++nameEnd;
+
+			if( previous != nullptr )
+				previous->End = p;
+
+			std::string_view name(nameBegin, nameEnd - nameBegin);
+			if( sections.find(name) != sections.end() )
+				return false;
+
+			previous = &sections[name];
+			previous->Begin = p;
+			previous->End = tok.End();
+		}
+
+		const char* newline = static_cast<const char*>(memchr(p, '\n', tok.End() - p));
+		p = newline != nullptr ? newline + 1 : tok.End();
+	}
+
+	return !sections.empty();
+}
+
+bool M3DLoader::SplitSection(const TextSection& section, std::string_view recordMarker, UINT expectedCount, std::vector<TextChunk>& chunks)
+{
+	// Skip the header line; the chunks hold records only.
+	const char* begin = static_cast<const char*>(memchr(section.Begin, '\n', section.End - section.Begin));
+	begin = begin != nullptr ? begin + 1 : section.End;
+
+	const size_t size = section.End - begin;
+	const size_t maxChunks = std::max<size_t>(1, size / MinChunkBytes);
+	const size_t numChunks = std::min<size_t>(maxChunks, mThreadPool->ThreadCount() * 4);
+
+	// Move each evenly spaced split point forward to the start of a record.
+	std::vector<const char*> splits;
+	splits.push_back(begin);
+	for(size_t i = 1; i < numChunks; ++i)
+	{
+		const char* p = std::max(begin + size*i/numChunks, splits.back());
+		std::string_view rest(p, section.End - p);
+
+		size_t pos = recordMarker.empty() ? rest.find('\n') : rest.find(recordMarker);
+		if( pos == std::string_view::npos )
+			break;
+
+		const char* split = p + pos + (recordMarker.empty() ? 1 : 0);
+		if( split != splits.back() )
+			splits.push_back(split);
+	}
+	splits.push_back(section.End);
+
+	chunks.resize(splits.size() - 1);
+	mThreadPool->ParallelFor((UINT)chunks.size(), [&](UINT i)
+	{
+		chunks[i].Begin = splits[i];
+		chunks[i].End = splits[i + 1];
+		chunks[i].Count = CountRecords(splits[i], splits[i + 1], recordMarker);
+	});
+
+	UINT first = 0;
+	for(TextChunk& chunk : chunks)
+	{
+		chunk.First = first;
+		first += chunk.Count;
+	}
+
+	return first == expectedCount;
+}
+
+bool M3DLoader::FindKeyframeBlocks(const TextSection& section, UINT numBones, UINT numAnimationClips,
+								   std::vector<std::string>& clipNames, std::vector<TextSection>& blocks,
+								   std::vector<TextSection>* clipRanges)
+{
+	// Walk the clip structure without parsing keyframes: every bone block is
+	// "BoneN #Keyframes: K { ... }" and keyframe lines contain no braces, so
+	// the end of a block is simply the next '}'.
+	TextTokenizer sectionTok(section.Begin, section.End);
+	std::string_view token;
+
+	clipNames.resize(numAnimationClips);
+	blocks.resize(numAnimationClips*numBones);
+	if( clipRanges != nullptr )
+		clipRanges->resize(numAnimationClips);
+
+	sectionTok >> token; // AnimationClips header text
+	for(UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
+	{
+		const char* clipBegin = sectionTok.Position();
+
+		sectionTok >> token >> clipNames[clipIndex];
+		sectionTok >> token;
+		if( token != "{" )
+			return false;
+
+		for(UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			const char* blockBegin = sectionTok.Position();
+
+			UINT numKeyframes = 0;
+			sectionTok >> token >> token >> numKeyframes;
+			if( !sectionTok || token != "#Keyframes:" )
+				return false;
+
+			const char* brace = static_cast<const char*>(
+				memchr(sectionTok.Position(), '}', section.End - sectionTok.Position()));
+			if( brace == nullptr )
+				return false;
+
+			TextSection& block = blocks[clipIndex*numBones + boneIndex];
+			block.Begin = blockBegin;
+			block.End = brace + 1;
+			sectionTok.Seek(block.End);
+		}
+
+		sectionTok >> token;
+		if( token != "}" )
+			return false;
+
+		if( clipRanges != nullptr )
+		{
+			(*clipRanges)[clipIndex].Begin = clipBegin;
+			(*clipRanges)[clipIndex].End = sectionTok.Position();
+		}
+	}
+
+	return true;
+}
+
+std::unique_ptr<AnimationClipSource> M3DLoader::IndexAnimationClips(const TextTokenizer& tok, const std::string& filename,
+																	 UINT numBones, UINT numAnimationClips)
+{
+	std::unordered_map<std::string_view, TextSection> sections;
+	if( !FindSections(tok, sections) || sections.find("AnimationClips") == sections.end() )
+		return nullptr;
+
+	std::vector<std::string> clipNames;
+	std::vector<TextSection> keyframeBlocks;
+	std::vector<TextSection> clipRanges;
+	if( !FindKeyframeBlocks(sections["AnimationClips"], numBones, numAnimationClips, clipNames, keyframeBlocks, &clipRanges) )
+		return nullptr;
+
+	auto source = std::make_unique<TextClipSource>(filename, numBones);
+	for(UINT i = 0; i < numAnimationClips; ++i)
+	{
+		source->AddClip(clipNames[i],
+			(UINT64)(clipRanges[i].Begin - tok.Begin()),
+			(UINT64)(clipRanges[i].End - tok.Begin()));
+	}
+
+	return source;
+}
+
+void M3DLoader::ReadMaterials(TextTokenizer& tok, UINT numMaterials, std::vector<M3dMaterial>& mats)
+{
+	 std::string_view ignore;
      mats.resize(numMaterials);
 
 	 std::string diffuseMapName;
 	 std::string normalMapName;
 
-     fin >> ignore; // materials header text
+     tok >> ignore; // materials header text
 	 for(UINT i = 0; i < numMaterials; ++i)
 	 {
-         fin >> ignore >> mats[i].Name;
-		 fin >> ignore >> mats[i].DiffuseAlbedo.x  >> mats[i].DiffuseAlbedo.y  >> mats[i].DiffuseAlbedo.z;
-		 fin >> ignore >> mats[i].FresnelR0.x >> mats[i].FresnelR0.y >> mats[i].FresnelR0.z;
-         fin >> ignore >> mats[i].Roughness;
-		 fin >> ignore >> mats[i].AlphaClip;
-		 fin >> ignore >> mats[i].MaterialTypeName;
-		 fin >> ignore >> mats[i].DiffuseMapName;
-		 fin >> ignore >> mats[i].NormalMapName;
+         tok >> ignore >> mats[i].Name;
+		 tok >> ignore >> mats[i].DiffuseAlbedo.x  >> mats[i].DiffuseAlbedo.y  >> mats[i].DiffuseAlbedo.z;
+		 tok >> ignore >> mats[i].FresnelR0.x >> mats[i].FresnelR0.y >> mats[i].FresnelR0.z;
+         tok >> ignore >> mats[i].Roughness;
+		 tok >> ignore >> mats[i].AlphaClip;
+		 tok >> ignore >> mats[i].MaterialTypeName;
+		 tok >> ignore >> mats[i].DiffuseMapName;
+		 tok >> ignore >> mats[i].NormalMapName;
 		}
 }
 
-void M3DLoader::ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets)
+void M3DLoader::ReadSubsetTable(TextTokenizer& tok, UINT numSubsets, std::vector<Subset>& subsets)
 {
-    std::string ignore;
+    std::string_view ignore;
 	subsets.resize(numSubsets);
 
-	fin >> ignore; // subset header text
+	tok >> ignore; // subset header text
 	for(UINT i = 0; i < numSubsets; ++i)
 	{
-        fin >> ignore >> subsets[i].Id;
-		fin >> ignore >> subsets[i].VertexStart;
-		fin >> ignore >> subsets[i].VertexCount;
-		fin >> ignore >> subsets[i].FaceStart;
-		fin >> ignore >> subsets[i].FaceCount;
+        tok >> ignore >> subsets[i].Id;
+		tok >> ignore >> subsets[i].VertexStart;
+		tok >> ignore >> subsets[i].VertexCount;
+		tok >> ignore >> subsets[i].FaceStart;
+		tok >> ignore >> subsets[i].FaceCount;
     }
 }
 
-void M3DLoader::ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices)
+void M3DLoader::ReadVertices(TextTokenizer& tok, UINT numVertices, std::vector<Vertex>& vertices)
 {
-	std::string ignore;
+	std::string_view ignore;
     vertices.resize(numVertices);
 
-    fin >> ignore; // vertices header text
-    for(UINT i = 0; i < numVertices; ++i)
-    {
-	    fin >> ignore >> vertices[i].Pos.x      >> vertices[i].Pos.y      >> vertices[i].Pos.z;
-		fin >> ignore >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> vertices[i].TangentU.w;
-	    fin >> ignore >> vertices[i].Normal.x   >> vertices[i].Normal.y   >> vertices[i].Normal.z;
-	    fin >> ignore >> vertices[i].TexC.x     >> vertices[i].TexC.y;
-    }
+    tok >> ignore; // vertices header text
+    ReadVertexRange(tok, 0, numVertices, vertices);
 }
 
-void M3DLoader::ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices)
+void M3DLoader::ReadSkinnedVertices(TextTokenizer& tok, UINT numVertices, std::vector<SkinnedVertex>& vertices)
 {
-	std::string ignore;
+	std::string_view ignore;
     vertices.resize(numVertices);
 
-    fin >> ignore; // vertices header text
+    tok >> ignore; // vertices header text
+    ReadVertexRange(tok, 0, numVertices, vertices);
+}
+
+void M3DLoader::ReadTriangles(TextTokenizer& tok, UINT numTriangles, UINT numVertices, IndexData& indices)
+{
+	std::string_view ignore;
+    indices.Resize(numTriangles*3, numVertices);
+
+    tok >> ignore; // triangles header text
+    ReadTriangleRange(tok, 0, numTriangles, indices);
+}
+
+void M3DLoader::ReadVertexRange(TextTokenizer& tok, UINT first, UINT count, std::vector<Vertex>& vertices)
+{
+	std::string_view ignore;
+    for(UINT i = first; i < first + count; ++i)
+    {
+	    tok >> ignore >> vertices[i].Pos.x      >> vertices[i].Pos.y      >> vertices[i].Pos.z;
+		tok >> ignore >> vertices[i].TangentU.x >> vertices[i].TangentU.y >> vertices[i].TangentU.z >> vertices[i].TangentU.w;
+	    tok >> ignore >> vertices[i].Normal.x   >> vertices[i].Normal.y   >> vertices[i].Normal.z;
+	    tok >> ignore >> vertices[i].TexC.x     >> vertices[i].TexC.y;
+    }
+}
+
+void M3DLoader::ReadVertexRange(TextTokenizer& tok, UINT first, UINT count, std::vector<SkinnedVertex>& vertices)
+{
+	std::string_view ignore;
 	int boneIndices[4];
 	float weights[4];
-    for(UINT i = 0; i < numVertices; ++i)
+    for(UINT i = first; i < first + count; ++i)
     {
         float blah;
-	    fin >> ignore >> vertices[i].Pos.x        >> vertices[i].Pos.y          >> vertices[i].Pos.z;
-		fin >> ignore >> vertices[i].TangentU.x   >> vertices[i].TangentU.y     >> vertices[i].TangentU.z >> blah /*vertices[i].TangentU.w*/;
-	    fin >> ignore >> vertices[i].Normal.x     >> vertices[i].Normal.y       >> vertices[i].Normal.z;
-	    fin >> ignore >> vertices[i].TexC.x       >> vertices[i].TexC.y;
-		fin >> ignore >> weights[0]     >> weights[1]     >> weights[2]     >> weights[3];
-		fin >> ignore >> boneIndices[0] >> boneIndices[1] >> boneIndices[2] >> boneIndices[3];
+	    tok >> ignore >> vertices[i].Pos.x        >> vertices[i].Pos.y          >> vertices[i].Pos.z;
+		tok >> ignore >> vertices[i].TangentU.x   >> vertices[i].TangentU.y     >> vertices[i].TangentU.z >> blah /*vertices[i].TangentU.w*/;
+	    tok >> ignore >> vertices[i].Normal.x     >> vertices[i].Normal.y       >> vertices[i].Normal.z;
+	    tok >> ignore >> vertices[i].TexC.x       >> vertices[i].TexC.y;
+		tok >> ignore >> weights[0]     >> weights[1]     >> weights[2]     >> weights[3];
+		tok >> ignore >> boneIndices[0] >> boneIndices[1] >> boneIndices[2] >> boneIndices[3];
 
 		vertices[i].BoneWeights.x = weights[0];
 		vertices[i].BoneWeights.y = weights[1];
@@ -164,27 +642,28 @@ void M3DLoader::ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::v
     }
 }
 
-void M3DLoader::ReadTriangles(std::ifstream& fin, UINT numTriangles, std::vector<USHORT>& indices)
+void M3DLoader::ReadTriangleRange(TextTokenizer& tok, UINT first, UINT count, IndexData& indices)
 {
-	std::string ignore;
-    indices.resize(numTriangles*3);
-
-    fin >> ignore; // triangles header text
-    for(UINT i = 0; i < numTriangles; ++i)
+    for(UINT i = first; i < first + count; ++i)
     {
-        fin >> indices[i*3+0] >> indices[i*3+1] >> indices[i*3+2];
+        UINT a = 0, b = 0, c = 0;
+        tok >> a >> b >> c;
+
+        indices.Set(i*3+0, a);
+        indices.Set(i*3+1, b);
+        indices.Set(i*3+2, c);
     }
 }
  
-void M3DLoader::ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<XMFLOAT4X4>& boneOffsets)
+void M3DLoader::ReadBoneOffsets(TextTokenizer& tok, UINT numBones, std::vector<XMFLOAT4X4>& boneOffsets)
 {
-	std::string ignore;
+	std::string_view ignore;
     boneOffsets.resize(numBones);
 
-    fin >> ignore; // BoneOffsets header text
+    tok >> ignore; // BoneOffsets header text
     for(UINT i = 0; i < numBones; ++i)
     {
-        fin >> ignore >> 
+        tok >> ignore >> 
             boneOffsets[i](0,0) >> boneOffsets[i](0,1) >> boneOffsets[i](0,2) >> boneOffsets[i](0,3) >>
             boneOffsets[i](1,0) >> boneOffsets[i](1,1) >> boneOffsets[i](1,2) >> boneOffsets[i](1,3) >>
             boneOffsets[i](2,0) >> boneOffsets[i](2,1) >> boneOffsets[i](2,2) >> boneOffsets[i](2,3) >>
@@ -192,48 +671,48 @@ void M3DLoader::ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<X
     }
 }
 
-void M3DLoader::ReadBoneHierarchy(std::ifstream& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex)
+void M3DLoader::ReadBoneHierarchy(TextTokenizer& tok, UINT numBones, std::vector<int>& boneIndexToParentIndex)
 {
-	std::string ignore;
+	std::string_view ignore;
     boneIndexToParentIndex.resize(numBones);
 
-    fin >> ignore; // BoneHierarchy header text
+    tok >> ignore; // BoneHierarchy header text
 	for(UINT i = 0; i < numBones; ++i)
 	{
-	    fin >> ignore >> boneIndexToParentIndex[i];
+	    tok >> ignore >> boneIndexToParentIndex[i];
 	}
 }
 
-void M3DLoader::ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips, 
+void M3DLoader::ReadAnimationClips(TextTokenizer& tok, UINT numBones, UINT numAnimationClips, 
 								   std::unordered_map<std::string, AnimationClip>& animations)
 {
-	std::string ignore;
-    fin >> ignore; // AnimationClips header text
+	std::string_view ignore;
+    tok >> ignore; // AnimationClips header text
     for(UINT clipIndex = 0; clipIndex < numAnimationClips; ++clipIndex)
     {
         std::string clipName;
-        fin >> ignore >> clipName;
-        fin >> ignore; // {
+        tok >> ignore >> clipName;
+        tok >> ignore; // {
 
 		AnimationClip clip;
 		clip.BoneAnimations.resize(numBones);
 
         for(UINT boneIndex = 0; boneIndex < numBones; ++boneIndex)
         {
-            ReadBoneKeyframes(fin, numBones, clip.BoneAnimations[boneIndex]);
+            ReadBoneKeyframes(tok, numBones, clip.BoneAnimations[boneIndex]);
         }
-        fin >> ignore; // }
+        tok >> ignore; // }
 
         animations[clipName] = clip;
     }
 }
 
-void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation)
+void M3DLoader::ReadBoneKeyframes(TextTokenizer& tok, UINT numBones, BoneAnimation& boneAnimation)
 {
-	std::string ignore;
+	std::string_view ignore;
     UINT numKeyframes = 0;
-    fin >> ignore >> ignore >> numKeyframes;
-    fin >> ignore; // {
+    tok >> ignore >> ignore >> numKeyframes;
+    tok >> ignore; // {
 
     boneAnimation.Keyframes.resize(numKeyframes);
     for(UINT i = 0; i < numKeyframes; ++i)
@@ -242,10 +721,10 @@ void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimati
         XMFLOAT3 p(0.0f, 0.0f, 0.0f);
         XMFLOAT3 s(1.0f, 1.0f, 1.0f);
         XMFLOAT4 q(0.0f, 0.0f, 0.0f, 1.0f);
-        fin >> ignore >> t;
-        fin >> ignore >> p.x >> p.y >> p.z;
-        fin >> ignore >> s.x >> s.y >> s.z;
-        fin >> ignore >> q.x >> q.y >> q.z >> q.w;
+        tok >> ignore >> t;
+        tok >> ignore >> p.x >> p.y >> p.z;
+        tok >> ignore >> s.x >> s.y >> s.z;
+        tok >> ignore >> q.x >> q.y >> q.z >> q.w;
 
 	    boneAnimation.Keyframes[i].TimePos      = t;
         boneAnimation.Keyframes[i].Translation  = p;
@@ -253,5 +732,169 @@ void M3DLoader::ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimati
 	    boneAnimation.Keyframes[i].RotationQuat = q;
     }
 
-    fin >> ignore; // }
-}
\ No newline at end of file
+    tok >> ignore; // }
+}
+
+bool M3DLoader::LoadM3dBinary(const std::string& filename, 
+							  std::vector<Vertex>& vertices,
+							  IndexData& indices,
+							  std::vector<Subset>& subsets,
+							  std::vector<M3dMaterial>& mats)
+{
+	M3dFile file;
+	if( !file.Open(filename) || file.GetHeader().Skinned )
+		return false;
+
+	const M3dFile::Header& header = file.GetHeader();
+
+	ReadBinaryMaterials(file, subsets, mats);
+	vertices.assign(file.Vertices(), file.Vertices() + header.NumVertices);
+
+	indices.Assign(file.Indices(), header.NumTriangles*3, file.IndexFormat());
+
+	return true;
+}
+
+bool M3DLoader::LoadM3dBinary(const std::string& filename, 
+							  std::vector<SkinnedVertex>& vertices,
+							  IndexData& indices,
+							  std::vector<Subset>& subsets,
+							  std::vector<M3dMaterial>& mats,
+							  SkinnedData& skinInfo)
+{
+	M3dFile file;
+	if( !file.Open(filename) || !file.GetHeader().Skinned )
+		return false;
+
+	const M3dFile::Header& header = file.GetHeader();
+
+	LoadM3dBinary(file, subsets, mats, skinInfo);
+	vertices.assign(file.SkinnedVertices(), file.SkinnedVertices() + header.NumVertices);
+
+	indices.Assign(file.Indices(), header.NumTriangles*3, file.IndexFormat());
+
+	return true;
+}
+
+void M3DLoader::LoadM3dBinary(const M3dFile& file,
+							  std::vector<Subset>& subsets,
+							  std::vector<M3dMaterial>& mats,
+							  SkinnedData& skinInfo)
+{
+	ReadBinaryMaterials(file, subsets, mats);
+	ReadBinarySkinInfo(file, skinInfo);
+}
+
+bool M3DLoader::ConvertM3dToBinary(const std::string& m3dFilename, const std::string& m3dbFilename)
+{
+	// Peek at the header to decide between the static and skinned layouts.
+	UINT numBones = 0;
+	{
+		std::ifstream fin(m3dFilename);
+		if( !fin )
+			return false;
+
+		std::string ignore;
+		UINT count = 0;
+		fin >> ignore; // file header text
+		fin >> ignore >> count; // #Materials
+		fin >> ignore >> count; // #Vertices
+		fin >> ignore >> count; // #Triangles
+		fin >> ignore >> numBones;
+	}
+
+	IndexData indices;
+	std::vector<Subset> subsets;
+	std::vector<M3dMaterial> mats;
+
+	M3dFile::SourceStamp source;
+	M3dFile::StampSource(m3dFilename, 0, source);
+
+	if( numBones == 0 )
+	{
+		std::vector<Vertex> vertices;
+		return LoadM3d(m3dFilename, vertices, indices, subsets, mats) &&
+			M3dFile::Write(m3dbFilename, vertices, indices, subsets, mats, source);
+	}
+
+	std::vector<SkinnedVertex> vertices;
+	SkinnedData skinInfo;
+	return LoadM3d(m3dFilename, vertices, indices, subsets, mats, skinInfo) &&
+		M3dFile::Write(m3dbFilename, vertices, indices, subsets, mats, skinInfo, source);
+}
+
+void M3DLoader::ReadBinaryMaterials(const M3dFile& file, std::vector<Subset>& subsets, std::vector<M3dMaterial>& mats)
+{
+	UINT numMaterials = file.GetHeader().NumMaterials;
+
+	subsets.assign(file.Subsets(), file.Subsets() + numMaterials);
+
+	mats.resize(numMaterials);
+	for(UINT i = 0; i < numMaterials; ++i)
+	{
+		const M3dFile::Material& m = file.Materials()[i];
+
+		mats[i].Name             = file.GetString(m.Name);
+		mats[i].DiffuseAlbedo    = m.DiffuseAlbedo;
+		mats[i].FresnelR0        = m.FresnelR0;
+		mats[i].Roughness        = m.Roughness;
+		mats[i].AlphaClip        = m.AlphaClip != 0;
+		mats[i].MaterialTypeName = file.GetString(m.MaterialTypeName);
+		mats[i].DiffuseMapName   = file.GetString(m.DiffuseMapName);
+		mats[i].NormalMapName    = file.GetString(m.NormalMapName);
+	}
+}
+
+void M3DLoader::ReadBinarySkinInfo(const M3dFile& file, SkinnedData& skinInfo)
+{
+	const M3dFile::Header& header = file.GetHeader();
+
+	std::vector<XMFLOAT4X4> boneOffsets(file.BoneOffsets(), file.BoneOffsets() + header.NumBones);
+	std::vector<int> boneIndexToParentIndex(file.BoneHierarchy(), file.BoneHierarchy() + header.NumBones);
+
+	if( mLazyClips )
+	{
+		// The clip source maps the file again, so it outlives the caller's view.
+		auto source = std::make_unique<BinaryClipSource>();
+		if( source->Open(file.GetFilename()) )
+		{
+			skinInfo.Set(boneIndexToParentIndex, boneOffsets, std::move(source), mClipMemoryBudget);
+			return;
+		}
+	}
+
+	std::unordered_map<std::string, AnimationClip> animations;
+	for(UINT clipIndex = 0; clipIndex < header.NumAnimationClips; ++clipIndex)
+	{
+		AnimationClip clip;
+		ReadBinaryClip(file, clipIndex, clip);
+
+		animations[file.GetString(file.Clips()[clipIndex].Name)] = std::move(clip);
+	}
+
+	skinInfo.Set(boneIndexToParentIndex, boneOffsets, animations);
+}
+
+void M3DLoader::ReadBinaryClip(const M3dFile& file, UINT clipIndex, AnimationClip& clip)
+{
+	const M3dFile::Header& header = file.GetHeader();
+	const M3dFile::Clip& fileClip = file.Clips()[clipIndex];
+
+	clip.BoneAnimations.resize(header.NumBones);
+
+	for(UINT boneIndex = 0; boneIndex < header.NumBones; ++boneIndex)
+	{
+		const M3dFile::Track& track = file.Tracks()[fileClip.FirstTrack + boneIndex];
+		const M3dFile::KeyframeData* keys = file.Keyframes() + track.FirstKeyframe;
+
+		std::vector<Keyframe>& keyframes = clip.BoneAnimations[boneIndex].Keyframes;
+		keyframes.resize(track.NumKeyframes);
+		for(UINT i = 0; i < track.NumKeyframes; ++i)
+		{
+			keyframes[i].TimePos      = keys[i].TimePos;
+			keyframes[i].Translation  = keys[i].Translation;
+			keyframes[i].Scale        = keys[i].Scale;
+			keyframes[i].RotationQuat = keys[i].RotationQuat;
+		}
+	}
+}
@@ -2,8 +2,11 @@
 #define LOADM3D_H
 
 #include "SkinnedData.h"
+#include "TextTokenizer.h"
+#include "IndexData.h"
+#include "../Common/ThreadPool.h"
 
-
+class M3dFile;
 
 class M3DLoader
 {
@@ -49,28 +52,113 @@ public:
         std::string NormalMapName;
     };
 
+	// With a thread pool the text loaders locate the section boundaries in one
+	// pre-scan and parse the vertex, triangle, bone and keyframe sections in
+	// parallel.  Without one they parse the file front to back.
+	explicit M3DLoader(ThreadPool* threadPool = nullptr);
+
+	// Lazy clip loading: the skinned loaders index only the clip names and
+	// where each clip lives in the file, and SkinnedData decodes a clip the
+	// first time it is played.  Decoded clips beyond clipMemoryBudget bytes
+	// are evicted, least recently used first (0 means no limit).
+	void EnableLazyClips(size_t clipMemoryBudget = 0);
+
+	// Indices come back in the narrowest width that addresses every vertex
+	// of the mesh (see IndexData).
 	bool LoadM3d(const std::string& filename, 
 		std::vector<Vertex>& vertices,
-		std::vector<USHORT>& indices,
+		IndexData& indices,
 		std::vector<Subset>& subsets,
 		std::vector<M3dMaterial>& mats);
 	bool LoadM3d(const std::string& filename, 
 		std::vector<SkinnedVertex>& vertices,
-		std::vector<USHORT>& indices,
+		IndexData& indices,
 		std::vector<Subset>& subsets,
 		std::vector<M3dMaterial>& mats,
 		SkinnedData& skinInfo);
 
+	// Binary (.m3db) counterparts of LoadM3d.  See M3dFile.h for the layout.
+	bool LoadM3dBinary(const std::string& filename, 
+		std::vector<Vertex>& vertices,
+		IndexData& indices,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats);
+	bool LoadM3dBinary(const std::string& filename, 
+		std::vector<SkinnedVertex>& vertices,
+		IndexData& indices,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats,
+		SkinnedData& skinInfo);
+
+	// Reads everything except the vertex and index arrays from an open binary
+	// file, so the caller can upload the geometry straight from the mapping.
+	void LoadM3dBinary(const M3dFile& file,
+		std::vector<Subset>& subsets,
+		std::vector<M3dMaterial>& mats,
+		SkinnedData& skinInfo);
+
+	// Parses a text .m3d file and writes it back out in the binary format.
+	bool ConvertM3dToBinary(const std::string& m3dFilename, const std::string& m3dbFilename);
+
+private:
+	class TextClipSource;
+	class BinaryClipSource;
+
+	// Text between a "***Name***" section header and the next header.
+	struct TextSection
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+	};
+
+	// A run of whole records inside a section, starting at record First.
+	struct TextChunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+		UINT First = 0;
+		UINT Count = 0;
+	};
+
+	template<typename VertexType>
+	bool ReadSectionsParallel(const TextTokenizer& tok, UINT numVertices, UINT numTriangles,
+		UINT numBones, UINT numAnimationClips,
+		std::vector<VertexType>& vertices,
+		IndexData& indices,
+		std::vector<DirectX::XMFLOAT4X4>* boneOffsets,
+		std::vector<int>* boneIndexToParentIndex,
+		std::unordered_map<std::string, AnimationClip>* animations);
+
+	bool FindSections(const TextTokenizer& tok, std::unordered_map<std::string_view, TextSection>& sections);
+	bool SplitSection(const TextSection& section, std::string_view recordMarker, UINT expectedCount, std::vector<TextChunk>& chunks);
+	bool FindKeyframeBlocks(const TextSection& section, UINT numBones, UINT numAnimationClips,
+		std::vector<std::string>& clipNames, std::vector<TextSection>& blocks,
+		std::vector<TextSection>* clipRanges);
+	std::unique_ptr<AnimationClipSource> IndexAnimationClips(const TextTokenizer& tok, const std::string& filename,
+		UINT numBones, UINT numAnimationClips);
+
+	void ReadMaterials(TextTokenizer& tok, UINT numMaterials, std::vector<M3dMaterial>& mats);
+	void ReadSubsetTable(TextTokenizer& tok, UINT numSubsets, std::vector<Subset>& subsets);
+	void ReadVertices(TextTokenizer& tok, UINT numVertices, std::vector<Vertex>& vertices);
+	void ReadSkinnedVertices(TextTokenizer& tok, UINT numVertices, std::vector<SkinnedVertex>& vertices);
+	void ReadTriangles(TextTokenizer& tok, UINT numTriangles, UINT numVertices, IndexData& indices);
+	void ReadVertexRange(TextTokenizer& tok, UINT first, UINT count, std::vector<Vertex>& vertices);
+	void ReadVertexRange(TextTokenizer& tok, UINT first, UINT count, std::vector<SkinnedVertex>& vertices);
+	void ReadTriangleRange(TextTokenizer& tok, UINT first, UINT count, IndexData& indices);
+	void ReadBoneOffsets(TextTokenizer& tok, UINT numBones, std::vector<DirectX::XMFLOAT4X4>& boneOffsets);
+	void ReadBoneHierarchy(TextTokenizer& tok, UINT numBones, std::vector<int>& boneIndexToParentIndex);
+	void ReadAnimationClips(TextTokenizer& tok, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations);
+	void ReadBoneKeyframes(TextTokenizer& tok, UINT numBones, BoneAnimation& boneAnimation);
+
+	void ReadBinaryMaterials(const M3dFile& file, std::vector<Subset>& subsets, std::vector<M3dMaterial>& mats);
+	void ReadBinarySkinInfo(const M3dFile& file, SkinnedData& skinInfo);
+	static void ReadBinaryClip(const M3dFile& file, UINT clipIndex, AnimationClip& clip);
+
 private:
-	void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<M3dMaterial>& mats);
-	void ReadSubsetTable(std::ifstream& fin, UINT numSubsets, std::vector<Subset>& subsets);
-	void ReadVertices(std::ifstream& fin, UINT numVertices, std::vector<Vertex>& vertices);
-	void ReadSkinnedVertices(std::ifstream& fin, UINT numVertices, std::vector<SkinnedVertex>& vertices);
-	void ReadTriangles(std::ifstream& fin, UINT numTriangles, std::vector<USHORT>& indices);
-	void ReadBoneOffsets(std::ifstream& fin, UINT numBones, std::vector<DirectX::XMFLOAT4X4>& boneOffsets);
-	void ReadBoneHierarchy(std::ifstream& fin, UINT numBones, std::vector<int>& boneIndexToParentIndex);
-	void ReadAnimationClips(std::ifstream& fin, UINT numBones, UINT numAnimationClips, std::unordered_map<std::string, AnimationClip>& animations);
-	void ReadBoneKeyframes(std::ifstream& fin, UINT numBones, BoneAnimation& boneAnimation);
+	ThreadPool* mThreadPool = nullptr;
+
+	bool mLazyClips = false;
+	size_t mClipMemoryBudget = 0;
 };
 
 
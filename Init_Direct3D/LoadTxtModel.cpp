@@ -0,0 +1,41 @@
+#include "LoadTxtModel.h"
+
+bool TxtModelLoader::LoadTxtModel(const std::string& filename,
+								  std::vector<Vertex>& vertices,
+								  IndexData& indices)
+{
+	TextTokenizer tok;
+	if( !tok.LoadFile(filename) )
+		return false;
+
+	UINT vCount = 0;
+	UINT tCount = 0;
+
+	std::string_view ignore;
+
+	tok >> ignore >> vCount;
+	tok >> ignore >> tCount;
+	tok >> ignore >> ignore >> ignore >> ignore; // VertexList (pos, normal) {
+
+	vertices.resize(vCount);
+	for(UINT i = 0; i < vCount; ++i)
+	{
+		tok >> vertices[i].Pos.x    >> vertices[i].Pos.y    >> vertices[i].Pos.z;
+		tok >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+	}
+
+	tok >> ignore >> ignore >> ignore; // } TriangleList {
+
+	indices.Resize(tCount*3, vCount);
+	for(UINT i = 0; i < tCount; ++i)
+	{
+		UINT a = 0, b = 0, c = 0;
+		tok >> a >> b >> c;
+
+		indices.Set(i*3+0, a);
+		indices.Set(i*3+1, b);
+		indices.Set(i*3+2, c);
+	}
+
+	return (bool)tok;
+}
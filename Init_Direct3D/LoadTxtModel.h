@@ -0,0 +1,26 @@
+#ifndef LOADTXTMODEL_H
+#define LOADTXTMODEL_H
+
+#include "TextTokenizer.h"
+#include "IndexData.h"
+
+///<summary>
+/// Loads the simple "VertexList (pos, normal) / TriangleList" text models
+/// such as skull.txt and car.txt.
+///</summary>
+class TxtModelLoader
+{
+public:
+	struct Vertex
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+	};
+
+	// The index width is chosen from the vertex count (see IndexData).
+	bool LoadTxtModel(const std::string& filename,
+		std::vector<Vertex>& vertices,
+		IndexData& indices);
+};
+
+#endif // LOADTXTMODEL_H
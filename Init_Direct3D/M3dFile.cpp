@@ -0,0 +1,445 @@
+#include "M3dFile.h"
+#include "CompressedAnimationClip.h"
+
+using namespace DirectX;
+
+namespace
+{
+	const UINT64 SectionAlignment = 16;
+
+	UINT64 AlignOffset(UINT64 offset)
+	{
+		return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+	}
+
+	// Appends a section to the output image, padded to the section alignment.
+	UINT64 AppendSection(std::vector<BYTE>& image, const void* data, UINT64 byteSize)
+	{
+		UINT64 offset = AlignOffset(image.size());
+		image.resize((size_t)(offset + byteSize));
+		if(byteSize > 0)
+			memcpy(&image[(size_t)offset], data, (size_t)byteSize);
+
+		return offset;
+	}
+
+	M3dFile::StringRef AppendString(std::string& strings, const std::string& s)
+	{
+		M3dFile::StringRef ref;
+		ref.Offset = (UINT)strings.size();
+		ref.Length = (UINT)s.size();
+		strings += s;
+
+		return ref;
+	}
+}
+
+M3dFile::~M3dFile()
+{
+	Close();
+}
+
+bool M3dFile::Open(const std::string& filename)
+{
+	Close();
+
+	std::wstring wfilename = AnsiToWString(filename);
+	mFile = CreateFileW(wfilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+	mSize = (UINT64)fileSize.QuadPart;
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = static_cast<const BYTE*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if(mData == nullptr || !Validate())
+	{
+		Close();
+		return false;
+	}
+
+	mFilename = filename;
+	return true;
+}
+
+void M3dFile::Close()
+{
+	if(mData != nullptr)
+		UnmapViewOfFile(mData);
+	if(mMapping != nullptr)
+		CloseHandle(mMapping);
+	if(mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = INVALID_HANDLE_VALUE;
+	mSize = 0;
+	mFilename.clear();
+}
+
+bool M3dFile::IsOpen()const
+{
+	return mData != nullptr;
+}
+
+const std::string& M3dFile::GetFilename()const
+{
+	return mFilename;
+}
+
+const M3dFile::Header& M3dFile::GetHeader()const
+{
+	return *Section<Header>(0);
+}
+
+const M3dFile::Material* M3dFile::Materials()const
+{
+	return Section<Material>(GetHeader().MaterialsOffset);
+}
+
+const M3DLoader::Subset* M3dFile::Subsets()const
+{
+	return Section<M3DLoader::Subset>(GetHeader().SubsetsOffset);
+}
+
+const M3DLoader::Vertex* M3dFile::Vertices()const
+{
+	assert(!GetHeader().Skinned);
+	return Section<M3DLoader::Vertex>(GetHeader().VerticesOffset);
+}
+
+const M3DLoader::SkinnedVertex* M3dFile::SkinnedVertices()const
+{
+	assert(GetHeader().Skinned);
+	return Section<M3DLoader::SkinnedVertex>(GetHeader().VerticesOffset);
+}
+
+const void* M3dFile::Indices()const
+{
+	return mData + GetHeader().IndicesOffset;
+}
+
+DXGI_FORMAT M3dFile::IndexFormat()const
+{
+	return GetHeader().IndexStride == sizeof(UINT) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+}
+
+const XMFLOAT4X4* M3dFile::BoneOffsets()const
+{
+	return Section<XMFLOAT4X4>(GetHeader().BoneOffsetsOffset);
+}
+
+const int* M3dFile::BoneHierarchy()const
+{
+	return Section<int>(GetHeader().BoneHierarchyOffset);
+}
+
+const M3dFile::Clip* M3dFile::Clips()const
+{
+	return Section<Clip>(GetHeader().ClipsOffset);
+}
+
+const M3dFile::Track* M3dFile::Tracks()const
+{
+	return Section<Track>(GetHeader().TracksOffset);
+}
+
+const M3dFile::KeyframeData* M3dFile::Keyframes()const
+{
+	return Section<KeyframeData>(GetHeader().KeyframesOffset);
+}
+
+std::string M3dFile::GetString(const StringRef& s)const
+{
+	const char* strings = reinterpret_cast<const char*>(mData + GetHeader().StringsOffset);
+	return std::string(strings + s.Offset, s.Length);
+}
+
+bool M3dFile::SectionInBounds(UINT64 offset, UINT64 count, UINT64 elementSize)const
+{
+	if(offset % 4 != 0 || offset > mSize)
+		return false;
+
+	return count * elementSize <= mSize - offset;
+}
+
+bool M3dFile::Validate()const
+{
+	const Header& h = GetHeader();
+
+	if(h.Magic != FileMagic || h.Version != FileVersion || h.FileSize != mSize)
+		return false;
+
+	UINT expectedStride = h.Skinned ? sizeof(M3DLoader::SkinnedVertex) : sizeof(M3DLoader::Vertex);
+	if(h.VertexStride != expectedStride || (h.IndexStride != sizeof(USHORT) && h.IndexStride != sizeof(UINT)))
+		return false;
+
+	UINT64 numTracks = (UINT64)h.NumAnimationClips * h.NumBones;
+
+	if(!SectionInBounds(h.MaterialsOffset, h.NumMaterials, sizeof(Material)) ||
+	   !SectionInBounds(h.SubsetsOffset, h.NumMaterials, sizeof(M3DLoader::Subset)) ||
+	   !SectionInBounds(h.VerticesOffset, h.NumVertices, h.VertexStride) ||
+	   !SectionInBounds(h.IndicesOffset, (UINT64)h.NumTriangles * 3, h.IndexStride) ||
+	   !SectionInBounds(h.BoneOffsetsOffset, h.NumBones, sizeof(XMFLOAT4X4)) ||
+	   !SectionInBounds(h.BoneHierarchyOffset, h.NumBones, sizeof(int)) ||
+	   !SectionInBounds(h.ClipsOffset, h.NumAnimationClips, sizeof(Clip)) ||
+	   !SectionInBounds(h.TracksOffset, numTracks, sizeof(Track)) ||
+	   !SectionInBounds(h.KeyframesOffset, h.NumKeyframes, sizeof(KeyframeData)) ||
+	   !SectionInBounds(h.StringsOffset, h.StringsSize, 1))
+		return false;
+
+	// Names, clips and tracks index into other sections; reject anything that
+	// would read past them.
+	auto stringInBounds = [&h](const StringRef& s)
+	{
+		return (UINT64)s.Offset + s.Length <= h.StringsSize;
+	};
+
+	const Material* materials = Materials();
+	for(UINT i = 0; i < h.NumMaterials; ++i)
+	{
+		if(!stringInBounds(materials[i].Name) ||
+		   !stringInBounds(materials[i].MaterialTypeName) ||
+		   !stringInBounds(materials[i].DiffuseMapName) ||
+		   !stringInBounds(materials[i].NormalMapName))
+			return false;
+	}
+
+	const Clip* clips = Clips();
+	for(UINT i = 0; i < h.NumAnimationClips; ++i)
+	{
+		if(!stringInBounds(clips[i].Name) ||
+		   (UINT64)clips[i].FirstTrack + h.NumBones > numTracks)
+			return false;
+	}
+
+	const Track* tracks = Tracks();
+	for(UINT64 i = 0; i < numTracks; ++i)
+	{
+		if(tracks[i].NumKeyframes == 0 ||
+		   (UINT64)tracks[i].FirstKeyframe + tracks[i].NumKeyframes > h.NumKeyframes)
+			return false;
+	}
+
+	if(h.NumBones > 0 && !SkinnedData::ValidateBoneHierarchy(BoneHierarchy(), h.NumBones))
+		return false;
+
+	// The loaders index the vertices through the subsets and the index
+	// array, and the bone palette through the vertices, without checking.
+	const M3DLoader::Subset* subsets = Subsets();
+	for(UINT i = 0; i < h.NumMaterials; ++i)
+	{
+		if((UINT64)subsets[i].FaceStart + subsets[i].FaceCount > h.NumTriangles ||
+		   (UINT64)subsets[i].VertexStart + subsets[i].VertexCount > h.NumVertices)
+			return false;
+	}
+
+	const UINT64 numIndices = (UINT64)h.NumTriangles * 3;
+	if(h.IndexStride == sizeof(USHORT))
+	{
+		const USHORT* indices = Section<USHORT>(h.IndicesOffset);
+		for(UINT64 i = 0; i < numIndices; ++i)
+		{
+			if(indices[i] >= h.NumVertices)
+				return false;
+		}
+	}
+	else
+	{
+		const UINT* indices = Section<UINT>(h.IndicesOffset);
+		for(UINT64 i = 0; i < numIndices; ++i)
+		{
+			if(indices[i] >= h.NumVertices)
+				return false;
+		}
+	}
+
+	if(h.Skinned)
+	{
+		const M3DLoader::SkinnedVertex* vertices = SkinnedVertices();
+		for(UINT i = 0; i < h.NumVertices; ++i)
+		{
+			for(int k = 0; k < 4; ++k)
+			{
+				if(vertices[i].BoneIndices[k] >= h.NumBones)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool M3dFile::StampSource(const std::string& sourceFilename, UINT buildFlags, SourceStamp& stamp)
+{
+	stamp = SourceStamp();
+	stamp.BuildFlags = buildFlags;
+
+	std::wstring wfilename = AnsiToWString(sourceFilename);
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!GetFileAttributesExW(wfilename.c_str(), GetFileExInfoStandard, &attributes))
+		return false;
+
+	stamp.Size = ((UINT64)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	stamp.WriteTime = ((UINT64)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+bool M3dFile::IsBuiltFrom(const SourceStamp& stamp)const
+{
+	const Header& h = GetHeader();
+	return h.SourceSize == stamp.Size && h.SourceWriteTime == stamp.WriteTime && h.BuildFlags == stamp.BuildFlags;
+}
+
+bool M3dFile::Write(const std::string& filename,
+	const std::vector<M3DLoader::Vertex>& vertices,
+	const IndexData& indices,
+	const std::vector<M3DLoader::Subset>& subsets,
+	const std::vector<M3DLoader::M3dMaterial>& mats,
+	const SourceStamp& source)
+{
+	return Write(filename, false, vertices.data(), sizeof(M3DLoader::Vertex), (UINT)vertices.size(),
+		indices, subsets, mats, nullptr, source);
+}
+
+bool M3dFile::Write(const std::string& filename,
+	const std::vector<M3DLoader::SkinnedVertex>& vertices,
+	const IndexData& indices,
+	const std::vector<M3DLoader::Subset>& subsets,
+	const std::vector<M3DLoader::M3dMaterial>& mats,
+	const SkinnedData& skinInfo,
+	const SourceStamp& source)
+{
+	return Write(filename, true, vertices.data(), sizeof(M3DLoader::SkinnedVertex), (UINT)vertices.size(),
+		indices, subsets, mats, &skinInfo, source);
+}
+
+bool M3dFile::Write(const std::string& filename, bool skinned,
+	const void* vertices, UINT vertexStride, UINT numVertices,
+	const IndexData& indices,
+	const std::vector<M3DLoader::Subset>& subsets,
+	const std::vector<M3DLoader::M3dMaterial>& mats,
+	const SkinnedData* skinInfo,
+	const SourceStamp& source)
+{
+	assert(subsets.size() == mats.size());
+
+	std::string strings;
+
+	std::vector<Material> materials(mats.size());
+	for(size_t i = 0; i < mats.size(); ++i)
+	{
+		materials[i].DiffuseAlbedo    = mats[i].DiffuseAlbedo;
+		materials[i].FresnelR0        = mats[i].FresnelR0;
+		materials[i].Roughness        = mats[i].Roughness;
+		materials[i].AlphaClip        = mats[i].AlphaClip ? 1 : 0;
+		materials[i].Name             = AppendString(strings, mats[i].Name);
+		materials[i].MaterialTypeName = AppendString(strings, mats[i].MaterialTypeName);
+		materials[i].DiffuseMapName   = AppendString(strings, mats[i].DiffuseMapName);
+		materials[i].NormalMapName    = AppendString(strings, mats[i].NormalMapName);
+	}
+
+	std::vector<int> boneHierarchy;
+	std::vector<XMFLOAT4X4> boneOffsets;
+	std::vector<Clip> clips;
+	std::vector<Track> tracks;
+	std::vector<KeyframeData> keyframes;
+
+	if(skinInfo != nullptr)
+	{
+		boneHierarchy = skinInfo->GetBoneHierarchy();
+		boneOffsets   = skinInfo->GetBoneOffsets();
+
+		for(const std::string& clipName : skinInfo->GetClipNames())
+		{
+			// A clip that is missing or cannot be decoded would leave the
+			// file without it; write nothing rather than an incomplete copy.
+			std::shared_ptr<const AnimationClip> animClip = skinInfo->GetClip(clipName);
+			if( animClip == nullptr )
+				return false;
+
+			if( animClip->Compressed != nullptr )
+			{
+				// The file stores full precision keyframes.
+				auto decompressed = std::make_shared<AnimationClip>();
+				animClip->Compressed->Decompress(*decompressed);
+				animClip = decompressed;
+			}
+
+			Clip clip;
+			clip.Name = AppendString(strings, clipName);
+			clip.FirstTrack = (UINT)tracks.size();
+			clips.push_back(clip);
+
+			for(const BoneAnimation& boneAnim : animClip->BoneAnimations)
+			{
+				Track track;
+				track.FirstKeyframe = (UINT)keyframes.size();
+				track.NumKeyframes = (UINT)boneAnim.Keyframes.size();
+				tracks.push_back(track);
+
+				for(const Keyframe& key : boneAnim.Keyframes)
+				{
+					KeyframeData data;
+					data.TimePos      = key.TimePos;
+					data.Translation  = key.Translation;
+					data.Scale        = key.Scale;
+					data.RotationQuat = key.RotationQuat;
+					keyframes.push_back(data);
+				}
+			}
+		}
+	}
+
+	Header header;
+	header.Skinned           = skinned ? 1 : 0;
+	header.VertexStride      = vertexStride;
+	header.IndexStride       = indices.Stride();
+	header.NumMaterials      = (UINT)mats.size();
+	header.NumVertices       = numVertices;
+	header.NumTriangles      = indices.Count() / 3;
+	header.NumBones          = (UINT)boneOffsets.size();
+	header.NumAnimationClips = (UINT)clips.size();
+	header.NumKeyframes      = (UINT)keyframes.size();
+	header.BuildFlags        = source.BuildFlags;
+	header.SourceSize        = source.Size;
+	header.SourceWriteTime   = source.WriteTime;
+
+	std::vector<BYTE> image(sizeof(Header));
+	header.MaterialsOffset     = AppendSection(image, materials.data(), materials.size() * sizeof(Material));
+	header.SubsetsOffset       = AppendSection(image, subsets.data(), subsets.size() * sizeof(M3DLoader::Subset));
+	header.VerticesOffset      = AppendSection(image, vertices, (UINT64)numVertices * vertexStride);
+	header.IndicesOffset       = AppendSection(image, indices.Data(), indices.ByteSize());
+	header.BoneOffsetsOffset   = AppendSection(image, boneOffsets.data(), boneOffsets.size() * sizeof(XMFLOAT4X4));
+	header.BoneHierarchyOffset = AppendSection(image, boneHierarchy.data(), boneHierarchy.size() * sizeof(int));
+	header.ClipsOffset         = AppendSection(image, clips.data(), clips.size() * sizeof(Clip));
+	header.TracksOffset        = AppendSection(image, tracks.data(), tracks.size() * sizeof(Track));
+	header.KeyframesOffset     = AppendSection(image, keyframes.data(), keyframes.size() * sizeof(KeyframeData));
+	header.StringsOffset       = AppendSection(image, strings.data(), strings.size());
+	header.StringsSize         = strings.size();
+	header.FileSize            = image.size();
+
+	memcpy(image.data(), &header, sizeof(Header));
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if(!fout)
+		return false;
+
+	fout.write(reinterpret_cast<const char*>(image.data()), image.size());
+
+	return fout.good();
+}
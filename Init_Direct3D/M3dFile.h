@@ -0,0 +1,202 @@
+#ifndef M3DFILE_H
+#define M3DFILE_H
+
+#include "LoadM3d.h"
+
+///<summary>
+/// Read-only, memory-mapped view of a binary .m3db file.  The binary file
+/// stores the same data as the text .m3d format, but every section is a
+/// tightly packed array aligned to 16 bytes, so the vertex and index arrays
+/// can be handed to the GPU upload straight from the mapping without any
+/// per-element parsing.
+///
+/// The header records the size and write time of the text file the binary
+/// was built from, and the build options, so a stale copy can be detected
+/// and rebuilt.
+///
+/// File layout (all offsets are from the start of the file):
+///   Header
+///   Material[NumMaterials]
+///   M3DLoader::Subset[NumMaterials]
+///   M3DLoader::Vertex or M3DLoader::SkinnedVertex[NumVertices]
+///   USHORT or UINT[NumTriangles*3] (IndexStride picks the width)
+///   XMFLOAT4X4[NumBones]           (bone offsets)
+///   int[NumBones]                  (bone hierarchy)
+///   Clip[NumAnimationClips]
+///   Track[NumAnimationClips*NumBones]
+///   KeyframeData[NumKeyframes]
+///   char[StringsSize]              (names, not null terminated)
+///</summary>
+class M3dFile
+{
+public:
+	// "M3DB" read as a little-endian UINT.
+	static const UINT FileMagic = 0x4244334D;
+	static const UINT FileVersion = 2;
+
+	// Header::BuildFlags.  The triangles and vertices were reordered by
+	// MeshOptimizer.
+	static const UINT BuildOptimized = 0x1;
+
+	struct StringRef
+	{
+		UINT Offset = 0;
+		UINT Length = 0;
+	};
+
+	struct Header
+	{
+		UINT Magic = FileMagic;
+		UINT Version = FileVersion;
+		UINT Skinned = 0;
+		UINT VertexStride = 0;
+		UINT IndexStride = 0;
+		UINT NumMaterials = 0;
+		UINT NumVertices = 0;
+		UINT NumTriangles = 0;
+		UINT NumBones = 0;
+		UINT NumAnimationClips = 0;
+		UINT NumKeyframes = 0;
+		UINT BuildFlags = 0;
+
+		// Of the source text file; zero if it was unknown.
+		UINT64 SourceSize = 0;
+		UINT64 SourceWriteTime = 0;
+
+		UINT64 MaterialsOffset = 0;
+		UINT64 SubsetsOffset = 0;
+		UINT64 VerticesOffset = 0;
+		UINT64 IndicesOffset = 0;
+		UINT64 BoneOffsetsOffset = 0;
+		UINT64 BoneHierarchyOffset = 0;
+		UINT64 ClipsOffset = 0;
+		UINT64 TracksOffset = 0;
+		UINT64 KeyframesOffset = 0;
+		UINT64 StringsOffset = 0;
+		UINT64 StringsSize = 0;
+		UINT64 FileSize = 0;
+	};
+
+	struct Material
+	{
+		DirectX::XMFLOAT4 DiffuseAlbedo;
+		DirectX::XMFLOAT3 FresnelR0;
+		float Roughness;
+		UINT AlphaClip;
+
+		StringRef Name;
+		StringRef MaterialTypeName;
+		StringRef DiffuseMapName;
+		StringRef NormalMapName;
+	};
+
+	// A clip owns NumBones consecutive tracks starting at FirstTrack.
+	struct Clip
+	{
+		StringRef Name;
+		UINT FirstTrack;
+	};
+
+	// The keyframes of one bone in one clip.
+	struct Track
+	{
+		UINT FirstKeyframe;
+		UINT NumKeyframes;
+	};
+
+	// What a binary file is built from: the source file's size and last
+	// write time, as a FILETIME, and the build options.
+	struct SourceStamp
+	{
+		UINT64 Size = 0;
+		UINT64 WriteTime = 0;
+		UINT BuildFlags = 0;
+	};
+
+	// Plain-old-data mirror of Keyframe as it is stored on disk.
+	struct KeyframeData
+	{
+		float TimePos;
+		DirectX::XMFLOAT3 Translation;
+		DirectX::XMFLOAT3 Scale;
+		DirectX::XMFLOAT4 RotationQuat;
+	};
+
+	M3dFile() = default;
+	M3dFile(const M3dFile& rhs) = delete;
+	M3dFile& operator=(const M3dFile& rhs) = delete;
+	~M3dFile();
+
+	// Maps the file and validates the header, the section bounds and every
+	// offset, index and bone index the sections hold.
+	bool Open(const std::string& filename);
+	void Close();
+	bool IsOpen()const;
+	const std::string& GetFilename()const;
+
+	const Header& GetHeader()const;
+
+	const Material* Materials()const;
+	const M3DLoader::Subset* Subsets()const;
+	const M3DLoader::Vertex* Vertices()const;
+	const M3DLoader::SkinnedVertex* SkinnedVertices()const;
+	const void* Indices()const;
+	DXGI_FORMAT IndexFormat()const;
+	const DirectX::XMFLOAT4X4* BoneOffsets()const;
+	const int* BoneHierarchy()const;
+	const Clip* Clips()const;
+	const Track* Tracks()const;
+	const KeyframeData* Keyframes()const;
+
+	std::string GetString(const StringRef& s)const;
+
+	// Stamps sourceFilename as it is now, built with buildFlags.  Returns
+	// false, with only the flags set, if the file cannot be found.
+	static bool StampSource(const std::string& sourceFilename, UINT buildFlags, SourceStamp& stamp);
+
+	// True if the open file was written with the given stamp.
+	bool IsBuiltFrom(const SourceStamp& stamp)const;
+
+	// Writes a binary copy of a model.  Returns false, writing nothing, if
+	// the file cannot be written or a clip of skinInfo cannot be loaded.
+	static bool Write(const std::string& filename,
+		const std::vector<M3DLoader::Vertex>& vertices,
+		const IndexData& indices,
+		const std::vector<M3DLoader::Subset>& subsets,
+		const std::vector<M3DLoader::M3dMaterial>& mats,
+		const SourceStamp& source);
+	static bool Write(const std::string& filename,
+		const std::vector<M3DLoader::SkinnedVertex>& vertices,
+		const IndexData& indices,
+		const std::vector<M3DLoader::Subset>& subsets,
+		const std::vector<M3DLoader::M3dMaterial>& mats,
+		const SkinnedData& skinInfo,
+		const SourceStamp& source);
+
+private:
+	static bool Write(const std::string& filename, bool skinned,
+		const void* vertices, UINT vertexStride, UINT numVertices,
+		const IndexData& indices,
+		const std::vector<M3DLoader::Subset>& subsets,
+		const std::vector<M3DLoader::M3dMaterial>& mats,
+		const SkinnedData* skinInfo,
+		const SourceStamp& source);
+
+	bool Validate()const;
+	bool SectionInBounds(UINT64 offset, UINT64 count, UINT64 elementSize)const;
+
+	template<typename T>
+	const T* Section(UINT64 offset)const
+	{
+		return reinterpret_cast<const T*>(mData + offset);
+	}
+
+private:
+	std::string mFilename;
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const BYTE* mData = nullptr;
+	UINT64 mSize = 0;
+};
+
+#endif // M3DFILE_H
@@ -0,0 +1,568 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// A FIFO vertex cache simulated with timestamps: a vertex is cached if
+	// fewer than cacheSize misses happened since it was loaded.
+	class FifoCache
+	{
+	public:
+		FifoCache(UINT numVertices, UINT cacheSize)
+			: mLoadTime(numVertices, 0), mCacheSize(cacheSize), mTime(cacheSize + 1)
+		{
+		}
+
+		// Returns true on a miss.
+		bool Access(UINT v)
+		{
+			if( mTime - mLoadTime[v] <= mCacheSize )
+				return false;
+
+			mLoadTime[v] = mTime++;
+			return true;
+		}
+
+		void Clear()
+		{
+			mTime += mCacheSize + 1;
+		}
+
+	private:
+		std::vector<UINT> mLoadTime;
+		UINT mCacheSize;
+		UINT mTime;
+	};
+
+	std::vector<M3DLoader::Subset> WholeMesh(UINT numVertices, UINT indexCount)
+	{
+		M3DLoader::Subset subset;
+		subset.Id = 0;
+		subset.VertexStart = 0;
+		subset.VertexCount = numVertices;
+		subset.FaceStart = 0;
+		subset.FaceCount = indexCount / 3;
+		return { subset };
+	}
+
+	VertexCacheStats AnalyzeSubsets(const UINT* indices, UINT numVertices,
+		const std::vector<M3DLoader::Subset>& subsets, UINT cacheSize)
+	{
+		VertexCacheStats total;
+		for(const M3DLoader::Subset& subset : subsets)
+		{
+			VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(indices + subset.FaceStart * 3,
+				subset.FaceCount * 3, numVertices, cacheSize);
+			total.Triangles += stats.Triangles;
+			total.Vertices += stats.Vertices;
+			total.Transforms += stats.Transforms;
+		}
+
+		return total;
+	}
+
+	OverdrawStats AnalyzeSubsetOverdraw(const UINT* indices, const XMFLOAT3* positions, UINT positionStride,
+		const std::vector<M3DLoader::Subset>& subsets)
+	{
+		OverdrawStats total;
+		for(const M3DLoader::Subset& subset : subsets)
+		{
+			OverdrawStats stats = MeshOptimizer::AnalyzeOverdraw(indices + subset.FaceStart * 3,
+				subset.FaceCount * 3, positions, positionStride);
+			total.PixelsCovered += stats.PixelsCovered;
+			total.PixelsShaded += stats.PixelsShaded;
+		}
+
+		return total;
+	}
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const UINT* indices, UINT indexCount, UINT numVertices,
+	UINT cacheSize)
+{
+	VertexCacheStats stats;
+	stats.Triangles = indexCount / 3;
+
+	FifoCache cache(numVertices, cacheSize);
+	std::vector<bool> used(numVertices, false);
+	for(UINT i = 0; i < stats.Triangles * 3; ++i)
+	{
+		UINT v = indices[i];
+		if( cache.Access(v) )
+			++stats.Transforms;
+
+		if( !used[v] )
+		{
+			used[v] = true;
+			++stats.Vertices;
+		}
+	}
+
+	return stats;
+}
+
+OverdrawStats MeshOptimizer::AnalyzeOverdraw(const UINT* indices, UINT indexCount, const XMFLOAT3* positions,
+	UINT positionStride, UINT resolution)
+{
+	OverdrawStats stats;
+
+	const UINT numTriangles = indexCount / 3;
+	if( numTriangles == 0 || resolution == 0 )
+		return stats;
+
+	// The corners of every triangle, gathered once for the six views.
+	std::vector<XMFLOAT3> corners(numTriangles * 3);
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for(UINT i = 0; i < numTriangles * 3; ++i)
+	{
+		corners[i] = *reinterpret_cast<const XMFLOAT3*>(
+			reinterpret_cast<const BYTE*>(positions) + (size_t)indices[i] * positionStride);
+
+		const float* c = &corners[i].x;
+		for(UINT k = 0; k < 3; ++k)
+		{
+			boundsMin[k] = std::min(boundsMin[k], c[k]);
+			boundsMax[k] = std::max(boundsMax[k], c[k]);
+		}
+	}
+
+	std::vector<float> depth((size_t)resolution * resolution);
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		const UINT u = (axis + 1) % 3;
+		const UINT v = (axis + 2) % 3;
+		const float extent = std::max(boundsMax[u] - boundsMin[u], boundsMax[v] - boundsMin[v]);
+		const float scale = extent > 0.0f ? resolution / extent : 0.0f;
+
+		for(float direction : { 1.0f, -1.0f })
+		{
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+			for(UINT t = 0; t < numTriangles; ++t)
+			{
+				float x[3], y[3], z[3];
+				for(UINT k = 0; k < 3; ++k)
+				{
+					const float* c = &corners[t * 3 + k].x;
+					x[k] = (c[u] - boundsMin[u]) * scale;
+					y[k] = (c[v] - boundsMin[v]) * scale;
+					z[k] = direction * c[axis];
+				}
+
+				// The area is the normal's component along the axis, scaled;
+				// a front face's normal points back at the viewer.
+				float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+				if( direction * area >= 0.0f )
+					continue;
+
+				// Make the area positive so inside means all weights >= 0.
+				if( area < 0.0f )
+				{
+					std::swap(x[1], x[2]);
+					std::swap(y[1], y[2]);
+					std::swap(z[1], z[2]);
+					area = -area;
+				}
+				const float invArea = 1.0f / area;
+
+				const int minX = std::max((int)std::min({ x[0], x[1], x[2] }), 0);
+				const int maxX = std::min((int)std::max({ x[0], x[1], x[2] }), (int)resolution - 1);
+				const int minY = std::max((int)std::min({ y[0], y[1], y[2] }), 0);
+				const int maxY = std::min((int)std::max({ y[0], y[1], y[2] }), (int)resolution - 1);
+
+				for(int py = minY; py <= maxY; ++py)
+				{
+					const float cy = py + 0.5f;
+					for(int px = minX; px <= maxX; ++px)
+					{
+						// Barycentric weights at the pixel centre, times area.
+						const float cx = px + 0.5f;
+						const float w0 = (x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy);
+						const float w1 = (x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy);
+						const float w2 = area - w0 - w1;
+						if( w0 < 0.0f || w1 < 0.0f || w2 < 0.0f )
+							continue;
+
+						float& stored = depth[(size_t)py * resolution + px];
+						const float d = (w0 * z[0] + w1 * z[1] + w2 * z[2]) * invArea;
+						if( d >= stored )
+							continue;
+
+						if( stored == FLT_MAX )
+							++stats.PixelsCovered;
+						++stats.PixelsShaded;
+						stored = d;
+					}
+				}
+			}
+		}
+	}
+
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(UINT* indices, UINT indexCount, UINT numVertices, UINT cacheSize)
+{
+	const UINT numTriangles = indexCount / 3;
+	if( numTriangles == 0 )
+		return;
+
+	// The triangles around each vertex, and how many of them are not yet
+	// emitted.
+	std::vector<UINT> liveTriangles(numVertices, 0);
+	for(UINT i = 0; i < numTriangles * 3; ++i)
+		++liveTriangles[indices[i]];
+
+	std::vector<UINT> adjacencyStart(numVertices + 1, 0);
+	for(UINT v = 0; v < numVertices; ++v)
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+
+	std::vector<UINT> adjacency(numTriangles * 3);
+	std::vector<UINT> adjacencyEnd(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for(UINT t = 0; t < numTriangles; ++t)
+	{
+		for(UINT c = 0; c < 3; ++c)
+			adjacency[adjacencyEnd[indices[t * 3 + c]]++] = t;
+	}
+
+	// Cache timestamps as in FifoCache, but read for the age of a vertex.
+	std::vector<UINT> loadTime(numVertices, 0);
+	UINT time = cacheSize + 1;
+
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<UINT> deadEnds;
+	std::vector<UINT> candidates;
+	deadEnds.reserve(numTriangles * 3);
+
+	std::vector<UINT> output(numTriangles * 3);
+	UINT numEmitted = 0;
+	UINT nextUnvisited = 0;
+
+	UINT fan = indices[0];
+	while( fan != UINT_MAX )
+	{
+		// Emit every remaining triangle around the fan vertex.
+		candidates.clear();
+		for(UINT k = adjacencyStart[fan]; k < adjacencyStart[fan + 1]; ++k)
+		{
+			UINT t = adjacency[k];
+			if( emitted[t] )
+				continue;
+
+			for(UINT c = 0; c < 3; ++c)
+			{
+				UINT v = indices[t * 3 + c];
+				output[numEmitted * 3 + c] = v;
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+
+				if( time - loadTime[v] > cacheSize )
+					loadTime[v] = time++;
+			}
+
+			emitted[t] = true;
+			++numEmitted;
+		}
+
+		// The next fan is the candidate that has been in the cache longest
+		// and whose remaining triangles still fit before it is evicted.
+		UINT next = UINT_MAX;
+		int bestPriority = -1;
+		for(UINT v : candidates)
+		{
+			if( liveTriangles[v] == 0 )
+				continue;
+
+			int priority = 0;
+			if( time - loadTime[v] + 2 * liveTriangles[v] <= cacheSize )
+				priority = (int)(time - loadTime[v]);
+
+			if( priority > bestPriority )
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if( next == UINT_MAX )
+		{
+			// Dead end: back up to a recently used vertex with triangles
+			// left, or else the next unvisited one.
+			while( next == UINT_MAX && !deadEnds.empty() )
+			{
+				UINT v = deadEnds.back();
+				deadEnds.pop_back();
+				if( liveTriangles[v] > 0 )
+					next = v;
+			}
+
+			while( next == UINT_MAX && nextUnvisited < numVertices )
+			{
+				if( liveTriangles[nextUnvisited] > 0 )
+					next = nextUnvisited;
+				else
+					++nextUnvisited;
+			}
+		}
+
+		fan = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(UINT* indices, UINT indexCount, const XMFLOAT3* positions,
+	UINT positionStride, UINT numVertices, UINT cacheSize, float threshold)
+{
+	const UINT numTriangles = indexCount / 3;
+	if( numTriangles == 0 )
+		return;
+
+	auto position = [positions, positionStride](UINT v)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(
+			reinterpret_cast<const BYTE*>(positions) + (size_t)v * positionStride));
+	};
+
+	FifoCache cache(numVertices, cacheSize);
+	auto misses = [&](UINT t)
+	{
+		UINT count = 0;
+		for(UINT c = 0; c < 3; ++c)
+			count += cache.Access(indices[t * 3 + c]) ? 1 : 0;
+		return count;
+	};
+
+	// A triangle that misses on all three vertices shares nothing with the
+	// cache, so the order can be cut before it for free.
+	std::vector<UINT> clusters;
+	for(UINT t = 0; t < numTriangles; ++t)
+	{
+		if( misses(t) == 3 )
+			clusters.push_back(t);
+	}
+	if( clusters.empty() || clusters[0] != 0 )
+		clusters.insert(clusters.begin(), 0);
+
+	//
+	// Split each cluster wherever the ACMR so far is within threshold of
+	// the whole cluster's, so the pieces can be sorted without losing much
+	// of the cache order.  The last piece is merged into the one before,
+	// since it is often a few triangles with a poor ACMR.
+	//
+
+	std::vector<UINT> pieces;
+	for(size_t c = 0; c < clusters.size(); ++c)
+	{
+		UINT first = clusters[c];
+		UINT last = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+
+		cache.Clear();
+		UINT clusterMisses = 0;
+		for(UINT t = first; t < last; ++t)
+			clusterMisses += misses(t);
+		float limit = threshold * clusterMisses / (last - first);
+
+		cache.Clear();
+		pieces.push_back(first);
+		UINT pieceStart = first;
+		UINT pieceMisses = 0;
+		for(UINT t = first; t + 1 < last; ++t)
+		{
+			pieceMisses += misses(t);
+			if( pieceMisses <= limit * (t + 1 - pieceStart) )
+			{
+				pieceStart = t + 1;
+				pieces.push_back(pieceStart);
+				pieceMisses = 0;
+				cache.Clear();
+			}
+		}
+		if( pieces.back() != first )
+			pieces.pop_back();
+	}
+
+	//
+	// Sort the pieces so the ones facing away from the mesh centre come
+	// first.  Both centroids are weighted by triangle area.
+	//
+
+	const UINT numPieces = (UINT)pieces.size();
+	std::vector<XMFLOAT3> centroids(numPieces);
+	std::vector<XMFLOAT3> normals(numPieces);
+
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	for(UINT p = 0; p < numPieces; ++p)
+	{
+		UINT last = p + 1 < numPieces ? pieces[p + 1] : numTriangles;
+
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for(UINT t = pieces[p]; t < last; ++t)
+		{
+			XMVECTOR p0 = position(indices[t * 3 + 0]);
+			XMVECTOR p1 = position(indices[t * 3 + 1]);
+			XMVECTOR p2 = position(indices[t * 3 + 2]);
+
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			float triangleArea = 0.5f * XMVectorGetX(XMVector3Length(n));
+
+			centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), triangleArea / 3.0f));
+			normal = XMVectorAdd(normal, n);
+			area += triangleArea;
+		}
+
+		meshCentroid = XMVectorAdd(meshCentroid, centroid);
+		meshArea += area;
+
+		XMStoreFloat3(&centroids[p], area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : centroid);
+		XMStoreFloat3(&normals[p], XMVector3Normalize(normal));
+	}
+	if( meshArea > 0.0f )
+		meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+	std::vector<float> facing(numPieces);
+	for(UINT p = 0; p < numPieces; ++p)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&centroids[p]), meshCentroid);
+		facing[p] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[p])));
+	}
+
+	std::vector<UINT> order(numPieces);
+	for(UINT p = 0; p < numPieces; ++p)
+		order[p] = p;
+	std::stable_sort(order.begin(), order.end(), [&facing](UINT a, UINT b) { return facing[a] > facing[b]; });
+
+	std::vector<UINT> output;
+	output.reserve(numTriangles * 3);
+	for(UINT p : order)
+	{
+		UINT last = p + 1 < numPieces ? pieces[p + 1] : numTriangles;
+		output.insert(output.end(), indices + pieces[p] * 3, indices + last * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(UINT* indices, UINT indexCount, UINT numVertices, std::vector<UINT>& remap)
+{
+	remap.assign(numVertices, UINT_MAX);
+
+	UINT next = 0;
+	for(UINT i = 0; i < indexCount; ++i)
+	{
+		UINT& newIndex = remap[indices[i]];
+		if( newIndex == UINT_MAX )
+			newIndex = next++;
+		indices[i] = newIndex;
+	}
+
+	for(UINT v = 0; v < numVertices; ++v)
+	{
+		if( remap[v] == UINT_MAX )
+			remap[v] = next++;
+	}
+}
+
+void MeshOptimizer::RemapVertices(void* vertices, UINT vertexStride, UINT numVertices, const std::vector<UINT>& remap)
+{
+	BYTE* data = static_cast<BYTE*>(vertices);
+	std::vector<BYTE> original(data, data + (size_t)numVertices * vertexStride);
+	for(UINT v = 0; v < numVertices; ++v)
+		memcpy(data + (size_t)remap[v] * vertexStride, &original[(size_t)v * vertexStride], vertexStride);
+}
+
+void MeshOptimizer::Optimize(void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+	UINT* indices, UINT indexCount, std::vector<M3DLoader::Subset>* subsets,
+	MeshOptimizationStats* stats)
+{
+	std::vector<M3DLoader::Subset> wholeMesh;
+	if( subsets == nullptr || subsets->empty() )
+	{
+		wholeMesh = WholeMesh(numVertices, indexCount);
+		subsets = &wholeMesh;
+	}
+
+	const XMFLOAT3* positions = reinterpret_cast<const XMFLOAT3*>(static_cast<const BYTE*>(vertices) + positionOffset);
+
+	if( stats != nullptr )
+	{
+		stats->Before = AnalyzeSubsets(indices, numVertices, *subsets, DefaultCacheSize);
+		stats->OverdrawBefore = AnalyzeSubsetOverdraw(indices, positions, vertexStride, *subsets);
+	}
+
+	std::vector<UINT> original;
+	for(const M3DLoader::Subset& subset : *subsets)
+	{
+		UINT* first = indices + subset.FaceStart * 3;
+		UINT count = subset.FaceCount * 3;
+
+		// Keep the original order if it was already better for the cache.
+		original.assign(first, first + count);
+		OptimizeVertexCache(first, count, numVertices);
+		if( AnalyzeVertexCache(first, count, numVertices).Transforms >
+			AnalyzeVertexCache(original.data(), count, numVertices).Transforms )
+		{
+			std::copy(original.begin(), original.end(), first);
+		}
+
+		// Likewise keep the cache order unless sorting the clusters sheds
+		// overdraw for no more than the ACMR it was allowed to cost.
+		original.assign(first, first + count);
+		OverdrawStats cacheOverdraw = AnalyzeOverdraw(first, count, positions, vertexStride);
+		UINT cacheTransforms = AnalyzeVertexCache(first, count, numVertices).Transforms;
+
+		OptimizeOverdraw(first, count, positions, vertexStride, numVertices);
+		if( AnalyzeOverdraw(first, count, positions, vertexStride).PixelsShaded >= cacheOverdraw.PixelsShaded ||
+			AnalyzeVertexCache(first, count, numVertices).Transforms > DefaultOverdrawThreshold * cacheTransforms )
+		{
+			std::copy(original.begin(), original.end(), first);
+		}
+	}
+
+	std::vector<UINT> remap;
+	OptimizeVertexFetch(indices, indexCount, numVertices, remap);
+	RemapVertices(vertices, vertexStride, numVertices, remap);
+
+	// Vertices are numbered by first use, so a subset whose vertices were
+	// its own before still has a contiguous range.
+	for(M3DLoader::Subset& subset : *subsets)
+	{
+		if( subset.FaceCount == 0 )
+			continue;
+
+		const UINT* first = indices + subset.FaceStart * 3;
+		const UINT* last = first + subset.FaceCount * 3;
+		UINT minVertex = *std::min_element(first, last);
+		UINT maxVertex = *std::max_element(first, last);
+		subset.VertexStart = minVertex;
+		subset.VertexCount = maxVertex - minVertex + 1;
+	}
+
+	if( stats != nullptr )
+	{
+		stats->After = AnalyzeSubsets(indices, numVertices, *subsets, DefaultCacheSize);
+		stats->OverdrawAfter = AnalyzeSubsetOverdraw(indices, positions, vertexStride, *subsets);
+	}
+}
+
+void MeshOptimizer::Optimize(void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+	IndexData& indices, std::vector<M3DLoader::Subset>* subsets, MeshOptimizationStats* stats)
+{
+	std::vector<UINT> indices32(indices.Count());
+	for(UINT i = 0; i < indices.Count(); ++i)
+		indices32[i] = indices.Get(i);
+
+	Optimize(vertices, vertexStride, positionOffset, numVertices, indices32.data(), (UINT)indices32.size(), subsets, stats);
+
+	indices.Assign(indices32.data(), (UINT)indices32.size(), numVertices);
+}
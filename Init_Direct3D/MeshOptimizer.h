@@ -0,0 +1,125 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "../Common/d3dUtil.h"
+#include "LoadM3d.h"
+#include "IndexData.h"
+
+///<summary>
+/// How an index buffer uses the post-transform vertex cache, simulated as a
+/// FIFO.  ACMR is vertex shader invocations per triangle: 3 means no reuse
+/// at all and about 0.5 is the limit for large regular meshes.  ATVR is
+/// invocations per distinct vertex, where 1 means each vertex is shaded
+/// once.
+///</summary>
+struct VertexCacheStats
+{
+	UINT Triangles = 0;
+	UINT Vertices = 0;
+	UINT Transforms = 0;
+
+	float Acmr()const { return Triangles > 0 ? (float)Transforms / Triangles : 0.0f; }
+	float Atvr()const { return Vertices > 0 ? (float)Transforms / Vertices : 0.0f; }
+};
+
+///<summary>
+/// Pixel shader invocations of a mesh drawn with depth testing and back
+/// face culling, summed over views along the six axis directions.
+/// Overdraw is shaded pixels per covered pixel: 1 means every pixel was
+/// shaded once, by the triangle that ends up visible.
+///</summary>
+struct OverdrawStats
+{
+	UINT64 PixelsCovered = 0;
+	UINT64 PixelsShaded = 0;
+
+	float Overdraw()const { return PixelsCovered > 0 ? (float)PixelsShaded / PixelsCovered : 0.0f; }
+};
+
+///<summary>
+/// Cache and overdraw statistics of a mesh before and after
+/// MeshOptimizer::Optimize, summed over its subsets.  Each subset is a
+/// separate draw, so the cache is simulated from empty and the depth
+/// buffer cleared for each.
+///</summary>
+struct MeshOptimizationStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+
+	OverdrawStats OverdrawBefore;
+	OverdrawStats OverdrawAfter;
+};
+
+///<summary>
+/// Reorders the triangles and vertices of a mesh for the GPU, in three
+/// steps that each keep the previous one's gains:
+///
+/// 1. Vertex cache (Tipsify, Sander et al. 2007): triangles are emitted as
+///    fans around a vertex, and the next fan vertex is the one still in
+///    the cache whose remaining triangles fit before it is evicted.  This
+///    takes linear time, which matters at the skull's 60k triangles.  A
+///    mesh whose order was already better, as the skull's is, keeps it.
+/// 2. Overdraw: the order is cut into clusters where a triangle misses the
+///    cache on all three vertices, and again wherever the ACMR so far is
+///    within threshold of the whole cluster's.  The clusters are then
+///    sorted so those facing away from the mesh centre come first.  They
+///    tend to occlude the rest, so fewer covered pixels get shaded.  The
+///    new order is only kept if AnalyzeOverdraw shows less overdraw and
+///    the ACMR stays within threshold of the cache order's.
+/// 3. Vertex fetch: vertices are renumbered in order of first use, so
+///    the input assembler reads the vertex buffer nearly sequentially.
+///
+/// Triangles never move between subsets and keep their winding.
+///</summary>
+class MeshOptimizer
+{
+public:
+	static const UINT DefaultCacheSize = 16;
+	static constexpr float DefaultOverdrawThreshold = 1.05f;
+	static const UINT DefaultOverdrawResolution = 128;
+
+	// Simulates a FIFO cache of cacheSize vertices over the triangles of
+	// indices.
+	static VertexCacheStats AnalyzeVertexCache(const UINT* indices, UINT indexCount, UINT numVertices,
+		UINT cacheSize = DefaultCacheSize);
+
+	// Rasterizes the triangles of indices in order, from each axis
+	// direction, orthographically into a resolution square fitted to the
+	// mesh.  Clockwise triangles face the viewer, as in Direct3D.
+	static OverdrawStats AnalyzeOverdraw(const UINT* indices, UINT indexCount, const DirectX::XMFLOAT3* positions,
+		UINT positionStride, UINT resolution = DefaultOverdrawResolution);
+
+	// Step 1 on indices, in place.
+	static void OptimizeVertexCache(UINT* indices, UINT indexCount, UINT numVertices,
+		UINT cacheSize = DefaultCacheSize);
+
+	// Step 2 on indices, in place, which should already be in cache order.
+	// positions is the first vertex's position, positionStride bytes apart.
+	// threshold >= 1 is how much worse than its cluster's the ACMR of a
+	// split off piece may be.
+	static void OptimizeOverdraw(UINT* indices, UINT indexCount, const DirectX::XMFLOAT3* positions,
+		UINT positionStride, UINT numVertices,
+		UINT cacheSize = DefaultCacheSize, float threshold = DefaultOverdrawThreshold);
+
+	// Step 3.  Renumbers indices and writes the new number of each old
+	// vertex to remap.  Vertices no triangle uses go last, in their order.
+	static void OptimizeVertexFetch(UINT* indices, UINT indexCount, UINT numVertices, std::vector<UINT>& remap);
+
+	// Moves vertex v of vertices, each vertexStride bytes, to remap[v].
+	static void RemapVertices(void* vertices, UINT vertexStride, UINT numVertices, const std::vector<UINT>& remap);
+
+	// All three steps on a mesh.  vertices holds numVertices vertices of
+	// vertexStride bytes with an XMFLOAT3 position at positionOffset.  With
+	// subsets, triangles are reordered within each subset's faces and each
+	// VertexStart and VertexCount is updated to the vertices it now uses;
+	// without, the whole mesh is one subset.
+	static void Optimize(void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+		UINT* indices, UINT indexCount, std::vector<M3DLoader::Subset>* subsets = nullptr,
+		MeshOptimizationStats* stats = nullptr);
+	static void Optimize(void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+		IndexData& indices, std::vector<M3DLoader::Subset>* subsets = nullptr,
+		MeshOptimizationStats* stats = nullptr);
+};
+
+#endif // MESHOPTIMIZER_H
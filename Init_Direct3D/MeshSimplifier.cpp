@@ -0,0 +1,904 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <queue>
+
+using namespace DirectX;
+
+namespace
+{
+	// A symmetric 4x4 matrix that sums weighted squared distances to
+	// planes, and the sum of the weights.
+	struct Quadric
+	{
+		double A00 = 0, A01 = 0, A02 = 0, A03 = 0;
+		double A11 = 0, A12 = 0, A13 = 0;
+		double A22 = 0, A23 = 0;
+		double A33 = 0;
+		double Weight = 0;
+
+		void AddPlane(XMVECTOR normal, XMVECTOR point, double weight)
+		{
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, normal);
+			double a = n.x, b = n.y, c = n.z;
+			double d = -XMVectorGetX(XMVector3Dot(normal, point));
+
+			A00 += weight * a * a; A01 += weight * a * b; A02 += weight * a * c; A03 += weight * a * d;
+			A11 += weight * b * b; A12 += weight * b * c; A13 += weight * b * d;
+			A22 += weight * c * c; A23 += weight * c * d;
+			A33 += weight * d * d;
+			Weight += weight;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A00 += q.A00; A01 += q.A01; A02 += q.A02; A03 += q.A03;
+			A11 += q.A11; A12 += q.A12; A13 += q.A13;
+			A22 += q.A22; A23 += q.A23;
+			A33 += q.A33;
+			Weight += q.Weight;
+		}
+
+		double Evaluate(const XMFLOAT3& p)const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double result = A00 * x * x + A11 * y * y + A22 * z * z + A33 +
+				2.0 * (A01 * x * y + A02 * x * z + A03 * x + A12 * y * z + A13 * y + A23 * z);
+			return result > 0.0 ? result : 0.0;
+		}
+	};
+
+	// Border edges also get a plane through the edge, perpendicular to its
+	// triangle, so the outline resists moving inwards.
+	const double BorderWeight = 10.0;
+
+	// Kinds are per group of vertices at one position.  A group with more
+	// than one vertex lies on a seam, and moves only along it.
+	enum class VertexKind : BYTE
+	{
+		Manifold,
+		Border,
+		Locked
+	};
+
+	struct Collapse
+	{
+		double Cost;
+		UINT From;	// groups
+		UINT To;
+		UINT Version;
+
+		bool operator>(const Collapse& rhs)const { return Cost > rhs.Cost; }
+	};
+
+	///<summary>
+	/// The state of one run of edge collapses, which later LODs continue
+	/// from.  Collapses work on groups of vertices at one position: every
+	/// vertex of the group moves onto the vertex of the target group that
+	/// its own triangles already use.
+	///</summary>
+	class Simplifier
+	{
+	public:
+		Simplifier(const MeshSimplifier::VertexLayout& layout, const UINT* indices, UINT indexCount);
+
+		// Collapses edges until at most targetTriangles are left, or no
+		// collapse keeps the surface within maxError.
+		void Reduce(UINT targetTriangles, float maxError);
+
+		UINT TriangleCount()const { return mLiveTriangles; }
+		float Error()const { return mError; }
+
+		// The remaining triangles, in their original order.
+		void GetIndices(std::vector<UINT>& indices)const;
+
+	private:
+		void WeldPositions();
+		void BuildQuadrics();
+		void ClassifyVertices();
+
+		bool Evaluate(UINT from, UINT to, double& cost, double& error);
+		bool Cost(UINT from, UINT to, double& cost, double& error);
+		bool IsLegal(UINT from, UINT to);
+		void PushBestCollapse(UINT group);
+		void Perform(UINT from, UINT to);
+
+		bool Contains(UINT t, UINT group)const;
+		float AttributeDistance(UINT a, UINT b)const;
+		const BYTE* VertexData(UINT v)const;
+
+	private:
+		MeshSimplifier::VertexLayout mLayout;
+		UINT mNumVertices;
+
+		std::vector<XMFLOAT3> mPositions;
+
+		// Vertices at the same position form a group, named by its first
+		// vertex, and are linked in a ring by mNextWedge.
+		std::vector<UINT> mGroup;
+		std::vector<UINT> mNextWedge;
+		std::vector<VertexKind> mKinds;	// by group
+		std::vector<Quadric> mQuadrics;	// by group
+
+		std::vector<UINT> mTriangles;
+		std::vector<bool> mTriangleAlive;
+		std::vector<std::vector<UINT>> mVertexTriangles;
+		std::vector<bool> mGroupAlive;
+		std::vector<UINT> mVersions;	// by group
+		UINT mLiveTriangles = 0;
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> mQueue;
+		float mError = 0.0f;
+
+		// Scratch for Evaluate and Perform.
+		std::vector<std::pair<UINT, UINT>> mWedgeTargets;
+		std::vector<std::pair<double, UINT>> mCandidates;
+		std::vector<UINT> mFromNeighbors;
+		std::vector<UINT> mToNeighbors;
+	};
+
+	Simplifier::Simplifier(const MeshSimplifier::VertexLayout& layout, const UINT* indices, UINT indexCount)
+		: mLayout(layout), mNumVertices(layout.NumVertices)
+	{
+		mPositions.resize(mNumVertices);
+		for(UINT v = 0; v < mNumVertices; ++v)
+			memcpy(&mPositions[v], VertexData(v) + mLayout.PositionOffset, sizeof(XMFLOAT3));
+
+		WeldPositions();
+
+		// Triangles with two corners at one position are dropped up front.
+		mTriangles.reserve(indexCount);
+		for(UINT i = 0; i + 2 < indexCount; i += 3)
+		{
+			UINT a = mGroup[indices[i]];
+			UINT b = mGroup[indices[i + 1]];
+			UINT c = mGroup[indices[i + 2]];
+			if( a != b && b != c && a != c )
+				mTriangles.insert(mTriangles.end(), indices + i, indices + i + 3);
+		}
+
+		const UINT numTriangles = (UINT)mTriangles.size() / 3;
+		mTriangleAlive.assign(numTriangles, true);
+		mLiveTriangles = numTriangles;
+
+		mVertexTriangles.resize(mNumVertices);
+		for(UINT t = 0; t < numTriangles; ++t)
+		{
+			for(UINT c = 0; c < 3; ++c)
+				mVertexTriangles[mTriangles[t * 3 + c]].push_back(t);
+		}
+
+		mGroupAlive.assign(mNumVertices, true);
+		mVersions.assign(mNumVertices, 0);
+
+		BuildQuadrics();
+		ClassifyVertices();
+
+		for(UINT v = 0; v < mNumVertices; ++v)
+		{
+			if( mGroup[v] == v )
+				PushBestCollapse(v);
+		}
+	}
+
+	const BYTE* Simplifier::VertexData(UINT v)const
+	{
+		return static_cast<const BYTE*>(mLayout.Vertices) + (size_t)v * mLayout.VertexStride;
+	}
+
+	void Simplifier::WeldPositions()
+	{
+		std::vector<UINT> order(mNumVertices);
+		for(UINT v = 0; v < mNumVertices; ++v)
+			order[v] = v;
+
+		auto less = [this](UINT a, UINT b) { return memcmp(&mPositions[a], &mPositions[b], sizeof(XMFLOAT3)) < 0; };
+		std::sort(order.begin(), order.end(), [&less](UINT a, UINT b) { return less(a, b) || (!less(b, a) && a < b); });
+
+		mGroup.resize(mNumVertices);
+		mNextWedge.resize(mNumVertices);
+		for(UINT first = 0; first < mNumVertices; )
+		{
+			UINT last = first + 1;
+			while( last < mNumVertices && !less(order[first], order[last]) )
+				++last;
+
+			for(UINT i = first; i < last; ++i)
+			{
+				mGroup[order[i]] = order[first];
+				mNextWedge[order[i]] = order[i + 1 < last ? i + 1 : first];
+			}
+			first = last;
+		}
+	}
+
+	void Simplifier::BuildQuadrics()
+	{
+		mQuadrics.resize(mNumVertices);
+
+		const UINT numTriangles = (UINT)mTriangleAlive.size();
+		for(UINT t = 0; t < numTriangles; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&mPositions[mTriangles[t * 3 + 0]]);
+			XMVECTOR p1 = XMLoadFloat3(&mPositions[mTriangles[t * 3 + 1]]);
+			XMVECTOR p2 = XMLoadFloat3(&mPositions[mTriangles[t * 3 + 2]]);
+
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			if( XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f )
+				continue;
+
+			Quadric plane;
+			plane.AddPlane(XMVector3Normalize(normal), p0, 1.0);
+			for(UINT c = 0; c < 3; ++c)
+				mQuadrics[mGroup[mTriangles[t * 3 + c]]].Add(plane);
+		}
+	}
+
+	void Simplifier::ClassifyVertices()
+	{
+		// Sort the directed edges between groups, keeping a triangle of
+		// each.  An edge of a closed manifold appears once in each
+		// direction.
+		struct Edge
+		{
+			UINT64 Key;
+			UINT Triangle;
+			UINT Corner;
+
+			bool operator<(const Edge& rhs)const { return Key < rhs.Key; }
+		};
+		auto key = [](UINT a, UINT b) { return ((UINT64)a << 32) | b; };
+
+		const UINT numTriangles = (UINT)mTriangleAlive.size();
+		std::vector<Edge> edges(numTriangles * 3);
+		for(UINT t = 0; t < numTriangles; ++t)
+		{
+			for(UINT c = 0; c < 3; ++c)
+				edges[t * 3 + c] = { key(mGroup[mTriangles[t * 3 + c]], mGroup[mTriangles[t * 3 + (c + 1) % 3]]), t, c };
+		}
+		std::sort(edges.begin(), edges.end());
+
+		auto count = [&edges](UINT64 k)
+		{
+			Edge probe = { k, 0, 0 };
+			auto range = std::equal_range(edges.begin(), edges.end(), probe);
+			return (UINT)(range.second - range.first);
+		};
+
+		std::vector<UINT> borderEdges(mNumVertices, 0);
+		std::vector<bool> complex(mNumVertices, false);
+		for(const Edge& edge : edges)
+		{
+			UINT a = (UINT)(edge.Key >> 32);
+			UINT b = (UINT)(edge.Key & 0xffffffff);
+			UINT forwardCount = count(edge.Key);
+			UINT reverseCount = count(key(b, a));
+
+			if( forwardCount > 1 || reverseCount > 1 )
+			{
+				complex[a] = true;
+				complex[b] = true;
+				continue;
+			}
+			if( reverseCount != 0 )
+				continue;
+
+			++borderEdges[a];
+			++borderEdges[b];
+
+			const UINT t = edge.Triangle;
+			const UINT c = edge.Corner;
+			XMVECTOR p0 = XMLoadFloat3(&mPositions[mTriangles[t * 3 + c]]);
+			XMVECTOR p1 = XMLoadFloat3(&mPositions[mTriangles[t * 3 + (c + 1) % 3]]);
+			XMVECTOR p2 = XMLoadFloat3(&mPositions[mTriangles[t * 3 + (c + 2) % 3]]);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			XMVECTOR side = XMVector3Cross(XMVectorSubtract(p1, p0), normal);
+			if( XMVectorGetX(XMVector3LengthSq(side)) == 0.0f )
+				continue;
+
+			Quadric constraint;
+			constraint.AddPlane(XMVector3Normalize(side), p0, BorderWeight);
+			mQuadrics[a].Add(constraint);
+			mQuadrics[b].Add(constraint);
+		}
+
+		mKinds.assign(mNumVertices, VertexKind::Locked);
+		for(UINT v = 0; v < mNumVertices; ++v)
+		{
+			if( mGroup[v] != v || complex[v] )
+				continue;
+
+			if( borderEdges[v] == 0 )
+				mKinds[v] = VertexKind::Manifold;
+			else if( borderEdges[v] == 2 )
+				mKinds[v] = VertexKind::Border;
+		}
+	}
+
+	bool Simplifier::Contains(UINT t, UINT group)const
+	{
+		return mGroup[mTriangles[t * 3 + 0]] == group ||
+			mGroup[mTriangles[t * 3 + 1]] == group ||
+			mGroup[mTriangles[t * 3 + 2]] == group;
+	}
+
+	float Simplifier::AttributeDistance(UINT a, UINT b)const
+	{
+		const BYTE* va = VertexData(a);
+		const BYTE* vb = VertexData(b);
+		float distance = 0.0f;
+
+		if( mLayout.NormalOffset != MeshSimplifier::NoAttribute )
+		{
+			XMFLOAT3 na, nb;
+			memcpy(&na, va + mLayout.NormalOffset, sizeof(XMFLOAT3));
+			memcpy(&nb, vb + mLayout.NormalOffset, sizeof(XMFLOAT3));
+			float cosine = XMVectorGetX(XMVector3Dot(XMVector3Normalize(XMLoadFloat3(&na)), XMVector3Normalize(XMLoadFloat3(&nb))));
+			distance += mLayout.NormalWeight * (1.0f - cosine);
+		}
+
+		if( mLayout.TexCOffset != MeshSimplifier::NoAttribute )
+		{
+			XMFLOAT2 ta, tb;
+			memcpy(&ta, va + mLayout.TexCOffset, sizeof(XMFLOAT2));
+			memcpy(&tb, vb + mLayout.TexCOffset, sizeof(XMFLOAT2));
+			float du = ta.x - tb.x;
+			float dv = ta.y - tb.y;
+			distance += mLayout.TexCWeight * (du * du + dv * dv);
+		}
+
+		if( mLayout.BoneWeightsOffset != MeshSimplifier::NoAttribute &&
+			mLayout.BoneIndicesOffset != MeshSimplifier::NoAttribute )
+		{
+			// Half the summed weight differences per bone: 0 for the same
+			// influences, 1 for disjoint ones.
+			float wa[4], wb[4];
+			memcpy(wa, va + mLayout.BoneWeightsOffset, 3 * sizeof(float));
+			memcpy(wb, vb + mLayout.BoneWeightsOffset, 3 * sizeof(float));
+			wa[3] = 1.0f - wa[0] - wa[1] - wa[2];
+			wb[3] = 1.0f - wb[0] - wb[1] - wb[2];
+			const BYTE* ba = va + mLayout.BoneIndicesOffset;
+			const BYTE* bb = vb + mLayout.BoneIndicesOffset;
+
+			auto weightOf = [](const BYTE* bones, const float* weights, BYTE bone)
+			{
+				float weight = 0.0f;
+				for(UINT i = 0; i < 4; ++i)
+				{
+					if( bones[i] == bone )
+						weight += weights[i];
+				}
+				return weight;
+			};
+
+			// Each bone once, whichever vertex it first appears in.
+			float difference = 0.0f;
+			for(UINT i = 0; i < 8; ++i)
+			{
+				BYTE bone = i < 4 ? ba[i] : bb[i - 4];
+				bool seen = false;
+				for(UINT j = 0; j < i; ++j)
+					seen = seen || (j < 4 ? ba[j] : bb[j - 4]) == bone;
+				if( !seen )
+					difference += fabsf(weightOf(ba, wa, bone) - weightOf(bb, wb, bone));
+			}
+			distance += mLayout.BoneWeight * 0.5f * difference;
+		}
+
+		return distance;
+	}
+
+	bool Simplifier::Evaluate(UINT from, UINT to, double& cost, double& error)
+	{
+		return Cost(from, to, cost, error) && IsLegal(from, to);
+	}
+
+	bool Simplifier::Cost(UINT from, UINT to, double& cost, double& error)
+	{
+		if( from == to || !mGroupAlive[to] )
+			return false;
+
+		// Each vertex of from moves onto the one vertex of to its triangles
+		// use.  One whose triangles use none, or two, would lose its
+		// attributes, so the group can only move along the seam.
+		UINT sharedTriangles = 0;
+		mWedgeTargets.clear();
+		for(UINT w = from; ; )
+		{
+			UINT target = UINT_MAX;
+			bool used = false;
+			for(UINT t : mVertexTriangles[w])
+			{
+				if( !mTriangleAlive[t] )
+					continue;
+				used = true;
+
+				for(UINT c = 0; c < 3; ++c)
+				{
+					UINT v = mTriangles[t * 3 + c];
+					if( mGroup[v] != to )
+						continue;
+					if( target != UINT_MAX && target != v )
+						return false;
+					target = v;
+					++sharedTriangles;
+				}
+			}
+
+			if( target == UINT_MAX && used )
+				return false;
+			mWedgeTargets.push_back({ w, target });
+
+			w = mNextWedge[w];
+			if( w == from )
+				break;
+		}
+
+		// An edge inside the surface has a triangle on either side, and a
+		// border vertex may only slide along its border edge.
+		UINT edgeTriangles = mKinds[from] == VertexKind::Border ? 1 : 2;
+		if( sharedTriangles != edgeTriangles )
+			return false;
+
+		// The error is the weighted mean squared distance to the merged
+		// planes; the cost sums them, so flat regions go first.
+		Quadric merged = mQuadrics[from];
+		merged.Add(mQuadrics[to]);
+		double distanceSq = merged.Evaluate(mPositions[to]);
+		error = distanceSq / std::max(merged.Weight, 1.0);
+
+		XMVECTOR target = XMLoadFloat3(&mPositions[to]);
+		float edgeLengthSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(target, XMLoadFloat3(&mPositions[from]))));
+		float attributes = 0.0f;
+		for(const auto& wedge : mWedgeTargets)
+		{
+			if( wedge.second != UINT_MAX )
+				attributes = std::max(attributes, AttributeDistance(wedge.first, wedge.second));
+		}
+		cost = distanceSq + (double)attributes * edgeLengthSq;
+		return true;
+	}
+
+	bool Simplifier::IsLegal(UINT from, UINT to)
+	{
+		// Uses the wedge targets Cost left.
+		UINT edgeTriangles = mKinds[from] == VertexKind::Border ? 1 : 2;
+		XMVECTOR target = XMLoadFloat3(&mPositions[to]);
+
+		// Link condition: the only positions adjacent to both ends are the
+		// ones opposite the edge, else the collapse pinches the surface.
+		mFromNeighbors.clear();
+		for(const auto& wedge : mWedgeTargets)
+		{
+			for(UINT t : mVertexTriangles[wedge.first])
+			{
+				if( !mTriangleAlive[t] )
+					continue;
+				for(UINT c = 0; c < 3; ++c)
+					mFromNeighbors.push_back(mGroup[mTriangles[t * 3 + c]]);
+			}
+		}
+
+		mToNeighbors.clear();
+		for(UINT w = to; ; )
+		{
+			for(UINT t : mVertexTriangles[w])
+			{
+				if( !mTriangleAlive[t] )
+					continue;
+				for(UINT c = 0; c < 3; ++c)
+					mToNeighbors.push_back(mGroup[mTriangles[t * 3 + c]]);
+			}
+			w = mNextWedge[w];
+			if( w == to )
+				break;
+		}
+
+		std::sort(mFromNeighbors.begin(), mFromNeighbors.end());
+		mFromNeighbors.erase(std::unique(mFromNeighbors.begin(), mFromNeighbors.end()), mFromNeighbors.end());
+		std::sort(mToNeighbors.begin(), mToNeighbors.end());
+		mToNeighbors.erase(std::unique(mToNeighbors.begin(), mToNeighbors.end()), mToNeighbors.end());
+
+		// A vertex of a tetrahedron, or the tip of a lone triangle, would
+		// collapse the piece it is on to nothing.
+		if( mFromNeighbors.size() <= edgeTriangles + 2 )
+			return false;
+
+		UINT common = 0;
+		for(UINT group : mFromNeighbors)
+		{
+			if( group != from && group != to && std::binary_search(mToNeighbors.begin(), mToNeighbors.end(), group) )
+				++common;
+		}
+		if( common != edgeTriangles )
+			return false;
+
+		// No remaining triangle may turn over.
+		for(const auto& wedge : mWedgeTargets)
+		{
+			for(UINT t : mVertexTriangles[wedge.first])
+			{
+				if( !mTriangleAlive[t] || Contains(t, to) )
+					continue;
+
+				XMVECTOR p[3];
+				XMVECTOR q[3];
+				for(UINT c = 0; c < 3; ++c)
+				{
+					UINT v = mTriangles[t * 3 + c];
+					p[c] = XMLoadFloat3(&mPositions[v]);
+					q[c] = v == wedge.first ? target : p[c];
+				}
+
+				XMVECTOR before = XMVector3Cross(XMVectorSubtract(p[1], p[0]), XMVectorSubtract(p[2], p[0]));
+				XMVECTOR after = XMVector3Cross(XMVectorSubtract(q[1], q[0]), XMVectorSubtract(q[2], q[0]));
+				if( XMVectorGetX(XMVector3Dot(before, after)) <= 0.0f )
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	void Simplifier::PushBestCollapse(UINT group)
+	{
+		++mVersions[group];
+		if( !mGroupAlive[group] || mKinds[group] == VertexKind::Locked )
+			return;
+
+		// Cost every neighbour, then check topology in order of cost until
+		// a collapse is legal; the checks are the expensive part.
+		mCandidates.clear();
+		for(UINT w = group; ; )
+		{
+			for(UINT t : mVertexTriangles[w])
+			{
+				if( !mTriangleAlive[t] )
+					continue;
+
+				for(UINT c = 0; c < 3; ++c)
+					mCandidates.push_back({ 0.0, mGroup[mTriangles[t * 3 + c]] });
+			}
+			w = mNextWedge[w];
+			if( w == group )
+				break;
+		}
+
+		std::sort(mCandidates.begin(), mCandidates.end(),
+			[](const std::pair<double, UINT>& a, const std::pair<double, UINT>& b) { return a.second < b.second; });
+		mCandidates.erase(std::unique(mCandidates.begin(), mCandidates.end(),
+			[](const std::pair<double, UINT>& a, const std::pair<double, UINT>& b) { return a.second == b.second; }), mCandidates.end());
+
+		size_t numCandidates = 0;
+		for(const auto& candidate : mCandidates)
+		{
+			double cost, error;
+			if( Cost(group, candidate.second, cost, error) )
+				mCandidates[numCandidates++] = { cost, candidate.second };
+		}
+		mCandidates.resize(numCandidates);
+		std::sort(mCandidates.begin(), mCandidates.end());
+
+		for(const auto& candidate : mCandidates)
+		{
+			double cost, error;
+			Cost(group, candidate.second, cost, error);
+			if( IsLegal(group, candidate.second) )
+			{
+				mQueue.push({ candidate.first, group, candidate.second, mVersions[group] });
+				return;
+			}
+		}
+	}
+
+	void Simplifier::Perform(UINT from, UINT to)
+	{
+		// Evaluate left the vertex each of from's moves onto.
+		mQuadrics[to].Add(mQuadrics[from]);
+
+		for(const auto& wedge : mWedgeTargets)
+		{
+			for(UINT t : mVertexTriangles[wedge.first])
+			{
+				if( !mTriangleAlive[t] )
+					continue;
+
+				if( Contains(t, to) )
+				{
+					mTriangleAlive[t] = false;
+					--mLiveTriangles;
+					continue;
+				}
+
+				for(UINT c = 0; c < 3; ++c)
+				{
+					if( mTriangles[t * 3 + c] == wedge.first )
+						mTriangles[t * 3 + c] = wedge.second;
+				}
+				mVertexTriangles[wedge.second].push_back(t);
+			}
+
+			mVertexTriangles[wedge.first].clear();
+			mVertexTriangles[wedge.first].shrink_to_fit();
+		}
+		mGroupAlive[from] = false;
+
+		// Everything around to may now have a different best collapse.
+		std::vector<UINT> neighbors;
+		for(UINT w = to; ; )
+		{
+			auto& triangles = mVertexTriangles[w];
+			triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+				[this](UINT t) { return !mTriangleAlive[t]; }), triangles.end());
+
+			for(UINT t : triangles)
+			{
+				for(UINT c = 0; c < 3; ++c)
+					neighbors.push_back(mGroup[mTriangles[t * 3 + c]]);
+			}
+
+			w = mNextWedge[w];
+			if( w == to )
+				break;
+		}
+
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		for(UINT group : neighbors)
+			PushBestCollapse(group);
+	}
+
+	void Simplifier::Reduce(UINT targetTriangles, float maxError)
+	{
+		const double maxErrorSq = (double)maxError * maxError;
+
+		while( mLiveTriangles > targetTriangles && !mQueue.empty() )
+		{
+			Collapse collapse = mQueue.top();
+			mQueue.pop();
+
+			if( !mGroupAlive[collapse.From] || collapse.Version != mVersions[collapse.From] )
+				continue;
+
+			// Changes around the target since the collapse was queued can
+			// make it illegal or dearer.
+			double cost, error;
+			if( !Evaluate(collapse.From, collapse.To, cost, error) )
+			{
+				PushBestCollapse(collapse.From);
+				continue;
+			}
+			if( cost > collapse.Cost * 1.0001 + 1e-12 )
+			{
+				collapse.Cost = cost;
+				mQueue.push(collapse);
+				continue;
+			}
+
+			// Too far from the original.  Cheaper ones by this measure may
+			// still be queued behind it, since the order includes attributes.
+			if( error > maxErrorSq )
+				continue;
+
+			Perform(collapse.From, collapse.To);
+			mError = std::max(mError, (float)sqrt(error));
+		}
+	}
+
+	void Simplifier::GetIndices(std::vector<UINT>& indices)const
+	{
+		indices.clear();
+		indices.reserve(mLiveTriangles * 3);
+
+		const UINT numTriangles = (UINT)mTriangleAlive.size();
+		for(UINT t = 0; t < numTriangles; ++t)
+		{
+			if( mTriangleAlive[t] )
+				indices.insert(indices.end(), &mTriangles[t * 3], &mTriangles[t * 3] + 3);
+		}
+	}
+}
+
+void MeshSimplifier::BuildLodChain(const VertexLayout& layout, const UINT* indices, UINT indexCount,
+	const std::vector<float>& ratios, std::vector<UINT>& chain, std::vector<MeshLod>& lods,
+	float maxError)
+{
+	chain.assign(indices, indices + indexCount);
+
+	lods.clear();
+	MeshLod original;
+	original.IndexCount = indexCount;
+	lods.push_back(original);
+
+	Simplifier simplifier(layout, indices, indexCount);
+	std::vector<UINT> lodIndices;
+	for(float ratio : ratios)
+	{
+		simplifier.Reduce((UINT)(ratio * (indexCount / 3)), maxError);
+		if( simplifier.TriangleCount() * 3 >= lods.back().IndexCount )
+			break;
+
+		simplifier.GetIndices(lodIndices);
+		MeshOptimizer::OptimizeVertexCache(lodIndices.data(), (UINT)lodIndices.size(), layout.NumVertices);
+
+		MeshLod lod;
+		lod.StartIndexLocation = (UINT)chain.size();
+		lod.IndexCount = (UINT)lodIndices.size();
+		lod.Error = simplifier.Error();
+		lods.push_back(lod);
+
+		chain.insert(chain.end(), lodIndices.begin(), lodIndices.end());
+	}
+}
+
+namespace
+{
+	// 64-bit FNV-1a.
+	class InputHash
+	{
+	public:
+		void Add(const void* data, size_t byteSize)
+		{
+			const BYTE* bytes = static_cast<const BYTE*>(data);
+			for(size_t i = 0; i < byteSize; ++i)
+			{
+				mHash ^= bytes[i];
+				mHash *= 0x100000001B3ull;
+			}
+		}
+
+		template<typename T>
+		void AddValue(const T& value)
+		{
+			Add(&value, sizeof(T));
+		}
+
+		UINT64 Get()const { return mHash; }
+
+	private:
+		UINT64 mHash = 0xCBF29CE484222325ull;
+	};
+
+	template<typename T>
+	void WriteValue(std::ofstream& fout, const T& value)
+	{
+		fout.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& fin, T& value)
+	{
+		return (bool)fin.read(reinterpret_cast<char*>(&value), sizeof(T));
+	}
+}
+
+void MeshLodCache::BuildLodChain(const MeshSimplifier::VertexLayout& layout, const UINT* indices, UINT indexCount,
+	const std::vector<float>& ratios, std::vector<UINT>& chain, std::vector<MeshLod>& lods, float maxError)
+{
+	InputHash hash;
+	hash.AddValue(layout.VertexStride);
+	hash.AddValue(layout.NumVertices);
+	hash.AddValue(layout.PositionOffset);
+	hash.AddValue(layout.NormalOffset);
+	hash.AddValue(layout.TexCOffset);
+	hash.AddValue(layout.BoneWeightsOffset);
+	hash.AddValue(layout.BoneIndicesOffset);
+	hash.AddValue(layout.NormalWeight);
+	hash.AddValue(layout.TexCWeight);
+	hash.AddValue(layout.BoneWeight);
+	hash.Add(layout.Vertices, (size_t)layout.NumVertices * layout.VertexStride);
+	hash.AddValue(indexCount);
+	hash.Add(indices, (size_t)indexCount * sizeof(UINT));
+	hash.Add(ratios.data(), ratios.size() * sizeof(float));
+	hash.AddValue(maxError);
+	const UINT64 key = hash.Get();
+
+	for(size_t i = 0; i < mEntries.size(); ++i)
+	{
+		Entry& entry = mEntries[i];
+		if( entry.Key != key )
+			continue;
+
+		// A damaged file must not index past the vertex buffer.
+		if( std::any_of(entry.Chain.begin(), entry.Chain.end(), [&layout](UINT v) { return v >= layout.NumVertices; }) )
+		{
+			mEntries.erase(mEntries.begin() + i);
+			break;
+		}
+
+		entry.Used = true;
+		chain = entry.Chain;
+		lods = entry.Lods;
+		return;
+	}
+
+	MeshSimplifier::BuildLodChain(layout, indices, indexCount, ratios, chain, lods, maxError);
+
+	Entry entry;
+	entry.Key = key;
+	entry.Chain = chain;
+	entry.Lods = lods;
+	entry.Used = true;
+	mEntries.push_back(std::move(entry));
+	mDirty = true;
+}
+
+bool MeshLodCache::IsDirty()const
+{
+	return mDirty;
+}
+
+bool MeshLodCache::Write(const std::string& filename)const
+{
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if( !fout )
+		return false;
+
+	UINT numUsed = 0;
+	for(const Entry& entry : mEntries)
+		numUsed += entry.Used ? 1 : 0;
+
+	WriteValue(fout, (UINT)FileMagic);
+	WriteValue(fout, (UINT)FileVersion);
+	WriteValue(fout, numUsed);
+	for(const Entry& entry : mEntries)
+	{
+		if( !entry.Used )
+			continue;
+
+		WriteValue(fout, entry.Key);
+		WriteValue(fout, (UINT)entry.Lods.size());
+		fout.write(reinterpret_cast<const char*>(entry.Lods.data()), entry.Lods.size() * sizeof(MeshLod));
+		WriteValue(fout, (UINT)entry.Chain.size());
+		fout.write(reinterpret_cast<const char*>(entry.Chain.data()), entry.Chain.size() * sizeof(UINT));
+	}
+
+	return fout.good();
+}
+
+bool MeshLodCache::Read(const std::string& filename)
+{
+	mEntries.clear();
+	mDirty = false;
+
+	std::ifstream fin(filename, std::ios::binary);
+	if( !fin )
+		return false;
+
+	UINT magic = 0, version = 0, numEntries = 0;
+	if( !ReadValue(fin, magic) || !ReadValue(fin, version) || magic != FileMagic || version != FileVersion ||
+		!ReadValue(fin, numEntries) )
+		return false;
+
+	std::vector<Entry> entries(numEntries);
+	for(Entry& entry : entries)
+	{
+		UINT numLods = 0, chainSize = 0;
+		if( !ReadValue(fin, entry.Key) || !ReadValue(fin, numLods) )
+			return false;
+		entry.Lods.resize(numLods);
+		fin.read(reinterpret_cast<char*>(entry.Lods.data()), numLods * sizeof(MeshLod));
+
+		if( !fin || !ReadValue(fin, chainSize) )
+			return false;
+		entry.Chain.resize(chainSize);
+		fin.read(reinterpret_cast<char*>(entry.Chain.data()), chainSize * sizeof(UINT));
+		if( !fin )
+			return false;
+
+		// Every LOD must lie within the chain.
+		for(const MeshLod& lod : entry.Lods)
+		{
+			if( (UINT64)lod.StartIndexLocation + lod.IndexCount > chainSize )
+				return false;
+		}
+	}
+
+	mEntries = std::move(entries);
+	return true;
+}
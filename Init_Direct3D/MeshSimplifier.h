@@ -0,0 +1,117 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include "../Common/d3dUtil.h"
+#include <cfloat>
+
+///<summary>
+/// One level of detail: a range of an index buffer whose LODs are stored
+/// back to back and share one vertex buffer, so switching LOD only changes
+/// the arguments of DrawIndexedInstanced.
+///</summary>
+struct MeshLod
+{
+	UINT StartIndexLocation = 0;
+	UINT IndexCount = 0;
+
+	// The largest root mean square distance, in model units, from a vertex
+	// that collapsed to the planes of the original triangles merged into
+	// it.  0 for LOD 0.
+	float Error = 0.0f;
+};
+
+///<summary>
+/// Simplifies meshes with quadric error metrics (Garland and Heckbert
+/// 1997) to build LOD chains.
+///
+/// Edges are collapsed into one of their own vertices, cheapest first, so
+/// every LOD indexes the original vertex buffer and keeps its normals,
+/// texture coordinates and skin weights exactly.  The cost of a collapse
+/// is the summed squared distance to the planes of the triangles already
+/// merged into the surviving vertex, plus a penalty for the attributes the
+/// removed vertex had that the surviving one does not.
+///
+/// Vertices that share a position (UV or normal seams) collapse together
+/// and only along the seam, each onto the vertex on its own side.  Vertices
+/// on an open border only move along it, non-manifold ones never move, and
+/// triangles may not flip over.
+///</summary>
+class MeshSimplifier
+{
+public:
+	static const UINT NoAttribute = 0xffffffff;
+
+	// The vertices a mesh's indices refer to.  Attributes at NoAttribute
+	// offsets are not compared.  Bone weights are an XMFLOAT3 whose fourth
+	// weight is implied, with four BYTE bone indices, as in
+	// M3DLoader::SkinnedVertex.
+	struct VertexLayout
+	{
+		const void* Vertices = nullptr;
+		UINT VertexStride = 0;
+		UINT NumVertices = 0;
+
+		UINT PositionOffset = 0;
+		UINT NormalOffset = NoAttribute;
+		UINT TexCOffset = NoAttribute;
+		UINT BoneWeightsOffset = NoAttribute;
+		UINT BoneIndicesOffset = NoAttribute;
+
+		// How much collapsing across a difference in an attribute costs,
+		// relative to moving the surface by the length of the edge.
+		float NormalWeight = 1.0f;
+		float TexCWeight = 1.0f;
+		float BoneWeight = 1.0f;
+	};
+
+	// Writes indices followed by one LOD per ratio (its fraction of the
+	// original triangles) to chain, and their ranges, starting with the
+	// original mesh as LOD 0, to lods.  The chain stops early when no
+	// collapse is left within maxError or the mesh cannot get simpler.
+	// Each LOD is reordered for the vertex cache.
+	static void BuildLodChain(const VertexLayout& layout, const UINT* indices, UINT indexCount,
+		const std::vector<float>& ratios, std::vector<UINT>& chain, std::vector<MeshLod>& lods,
+		float maxError = FLT_MAX);
+};
+
+///<summary>
+/// LOD chains kept between runs, since simplifying a large mesh takes far
+/// longer than loading it.  A chain is keyed by a hash of everything
+/// BuildLodChain reads (the vertices, layout, indices, ratios and error
+/// limit), so it is only reused for exactly the same input and any change
+/// to the model or the options builds it again.
+///</summary>
+class MeshLodCache
+{
+public:
+	static const UINT FileMagic = 0x43444F4C;
+	static const UINT FileVersion = 1;
+
+	// MeshSimplifier::BuildLodChain, or its result from an earlier call with
+	// the same arguments.
+	void BuildLodChain(const MeshSimplifier::VertexLayout& layout, const UINT* indices, UINT indexCount,
+		const std::vector<float>& ratios, std::vector<UINT>& chain, std::vector<MeshLod>& lods,
+		float maxError = FLT_MAX);
+
+	// True if a chain was built since Read, so the file is out of date.
+	bool IsDirty()const;
+
+	// Writes only the chains used since Read, which drops those of inputs
+	// that no longer exist.
+	bool Write(const std::string& filename)const;
+	bool Read(const std::string& filename);
+
+private:
+	struct Entry
+	{
+		UINT64 Key = 0;
+		std::vector<UINT> Chain;
+		std::vector<MeshLod> Lods;
+		bool Used = false;
+	};
+
+	std::vector<Entry> mEntries;
+	bool mDirty = false;
+};
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,402 @@
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <climits>
+
+using namespace DirectX;
+
+namespace
+{
+	// Unit face normals, zero for degenerate triangles so they fit any cone.
+	void ComputeFaceNormals(const BYTE* positions, UINT vertexStride, const UINT* indices, UINT triangleCount,
+		std::vector<XMFLOAT3>& normals)
+	{
+		auto position = [&](UINT v)
+		{
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + (size_t)v * vertexStride));
+		};
+
+		normals.resize(triangleCount);
+		for(UINT t = 0; t < triangleCount; ++t)
+		{
+			XMVECTOR p0 = position(indices[t * 3 + 0]);
+			XMVECTOR p1 = position(indices[t * 3 + 1]);
+			XMVECTOR p2 = position(indices[t * 3 + 2]);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+
+			float length = XMVectorGetX(XMVector3Length(n));
+			XMStoreFloat3(&normals[t], length > 0.0f ? XMVectorScale(n, 1.0f / length) : XMVectorZero());
+		}
+	}
+
+	// Fills in the sphere around meshletVertices and the cone around the
+	// normals of meshletTriangles, whose sum is normalSum.
+	void ComputeMeshletBounds(const BYTE* positions, UINT vertexStride,
+		const std::vector<UINT>& meshletVertices, const std::vector<UINT>& meshletTriangles,
+		const std::vector<XMFLOAT3>& normals, FXMVECTOR normalSum,
+		std::vector<XMFLOAT3>& points, Meshlet& meshlet)
+	{
+		points.resize(meshletVertices.size());
+		for(size_t i = 0; i < meshletVertices.size(); ++i)
+			points[i] = *reinterpret_cast<const XMFLOAT3*>(positions + (size_t)meshletVertices[i] * vertexStride);
+		BoundingSphere::CreateFromPoints(meshlet.Bounds, points.size(), points.data(), sizeof(XMFLOAT3));
+
+		// The cone's half angle is the widest angle between the average
+		// normal and a triangle's.
+		float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+		if( sumLength > 0.0f )
+		{
+			XMVECTOR axis = XMVectorScale(normalSum, 1.0f / sumLength);
+			float minDot = 1.0f;
+			for(UINT t : meshletTriangles)
+			{
+				XMVECTOR n = XMLoadFloat3(&normals[t]);
+				if( XMVectorGetX(XMVector3LengthSq(n)) > 0.0f )
+					minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(n, axis)));
+			}
+			XMStoreFloat3(&meshlet.ConeAxis, axis);
+			meshlet.ConeCos = minDot;
+		}
+	}
+}
+
+void MeshletBuilder::Build(const void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+	UINT* indices, UINT indexCount, std::vector<Meshlet>& meshlets,
+	UINT maxVertices, UINT maxTriangles)
+{
+	meshlets.clear();
+
+	const UINT triangleCount = indexCount / 3;
+	if( triangleCount == 0 )
+		return;
+
+	const BYTE* positions = reinterpret_cast<const BYTE*>(vertices) + positionOffset;
+
+	std::vector<XMFLOAT3> normals;
+	ComputeFaceNormals(positions, vertexStride, indices, triangleCount, normals);
+
+	// The triangles around each vertex, vertex v's in
+	// vertexTriangles[firstTriangle[v], firstTriangle[v + 1]).
+	std::vector<UINT> firstTriangle(numVertices + 1, 0);
+	for(UINT i = 0; i < triangleCount * 3; ++i)
+		++firstTriangle[indices[i] + 1];
+	for(UINT v = 0; v < numVertices; ++v)
+		firstTriangle[v + 1] += firstTriangle[v];
+
+	std::vector<UINT> vertexTriangles(triangleCount * 3);
+	std::vector<UINT> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+	for(UINT i = 0; i < triangleCount * 3; ++i)
+		vertexTriangles[cursor[indices[i]]++] = i / 3;
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	// The meshlet a vertex was last added to, and its number in it.
+	std::vector<UINT> vertexMeshlet(numVertices, UINT_MAX);
+	std::vector<UINT> localVertex(numVertices, 0);
+
+	std::vector<UINT> output;
+	output.reserve(triangleCount * 3);
+
+	std::vector<UINT> meshletTriangles;
+	std::vector<UINT> meshletVertices;
+	std::vector<UINT> candidates;
+	std::vector<UINT> localIndices;
+	std::vector<XMFLOAT3> points;
+
+	UINT scan = 0;
+	UINT seed = UINT_MAX;
+	for(;;)
+	{
+		if( seed == UINT_MAX )
+		{
+			while( scan < triangleCount && emitted[scan] )
+				++scan;
+			if( scan == triangleCount )
+				break;
+			seed = scan;
+		}
+
+		const UINT id = (UINT)meshlets.size();
+		meshletTriangles.clear();
+		meshletVertices.clear();
+		candidates.clear();
+		XMVECTOR normalSum = XMVectorZero();
+
+		auto addTriangle = [&](UINT t)
+		{
+			emitted[t] = true;
+			meshletTriangles.push_back(t);
+			normalSum = XMVectorAdd(normalSum, XMLoadFloat3(&normals[t]));
+
+			for(UINT k = 0; k < 3; ++k)
+			{
+				UINT v = indices[t * 3 + k];
+				if( vertexMeshlet[v] == id )
+					continue;
+
+				vertexMeshlet[v] = id;
+				localVertex[v] = (UINT)meshletVertices.size();
+				meshletVertices.push_back(v);
+
+				for(UINT i = firstTriangle[v]; i < firstTriangle[v + 1]; ++i)
+				{
+					if( !emitted[vertexTriangles[i]] )
+						candidates.push_back(vertexTriangles[i]);
+				}
+			}
+		};
+
+		addTriangle(seed);
+		while( meshletTriangles.size() < maxTriangles )
+		{
+			float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+			XMVECTOR axis = sumLength > 0.0f ? XMVectorScale(normalSum, 1.0f / sumLength) : XMVectorZero();
+
+			UINT best = UINT_MAX;
+			UINT bestNewVertices = 4;
+			float bestDot = -FLT_MAX;
+			for(size_t i = 0; i < candidates.size(); )
+			{
+				UINT t = candidates[i];
+				if( emitted[t] )
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				++i;
+
+				UINT newVertices = 0;
+				for(UINT k = 0; k < 3; ++k)
+				{
+					if( vertexMeshlet[indices[t * 3 + k]] != id )
+						++newVertices;
+				}
+				if( meshletVertices.size() + newVertices > maxVertices || newVertices > bestNewVertices )
+					continue;
+
+				float d = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[t]), axis));
+				if( newVertices < bestNewVertices || d > bestDot )
+				{
+					best = t;
+					bestNewVertices = newVertices;
+					bestDot = d;
+				}
+			}
+
+			if( best == UINT_MAX )
+				break;
+
+			addTriangle(best);
+		}
+
+		// Carry on from a free triangle next to this meshlet.
+		seed = UINT_MAX;
+		for(UINT t : candidates)
+		{
+			if( !emitted[t] )
+			{
+				seed = t;
+				break;
+			}
+		}
+
+		// Reorder the meshlet's triangles for the vertex cache, on indices
+		// local to the meshlet so the cost does not depend on the mesh size.
+		localIndices.clear();
+		for(UINT t : meshletTriangles)
+		{
+			for(UINT k = 0; k < 3; ++k)
+				localIndices.push_back(localVertex[indices[t * 3 + k]]);
+		}
+		MeshOptimizer::OptimizeVertexCache(localIndices.data(), (UINT)localIndices.size(), (UINT)meshletVertices.size());
+
+		Meshlet meshlet;
+		meshlet.StartIndexLocation = (UINT)output.size();
+		meshlet.IndexCount = (UINT)localIndices.size();
+		meshlet.VertexCount = (UINT)meshletVertices.size();
+		for(UINT local : localIndices)
+			output.push_back(meshletVertices[local]);
+
+		ComputeMeshletBounds(positions, vertexStride, meshletVertices, meshletTriangles, normals, normalSum,
+			points, meshlet);
+
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshletBuilder::BuildInOrder(const void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+	const UINT* indices, UINT indexCount, std::vector<Meshlet>& meshlets,
+	UINT maxVertices, UINT maxTriangles)
+{
+	meshlets.clear();
+
+	const UINT triangleCount = indexCount / 3;
+	if( triangleCount == 0 )
+		return;
+
+	const BYTE* positions = reinterpret_cast<const BYTE*>(vertices) + positionOffset;
+
+	std::vector<XMFLOAT3> normals;
+	ComputeFaceNormals(positions, vertexStride, indices, triangleCount, normals);
+
+	// The meshlet a vertex was last added to.
+	std::vector<UINT> vertexMeshlet(numVertices, UINT_MAX);
+
+	std::vector<UINT> meshletTriangles;
+	std::vector<UINT> meshletVertices;
+	std::vector<XMFLOAT3> points;
+	XMVECTOR normalSum = XMVectorZero();
+
+	auto finishMeshlet = [&]()
+	{
+		Meshlet meshlet;
+		meshlet.StartIndexLocation = meshletTriangles.front() * 3;
+		meshlet.IndexCount = (UINT)meshletTriangles.size() * 3;
+		meshlet.VertexCount = (UINT)meshletVertices.size();
+		ComputeMeshletBounds(positions, vertexStride, meshletVertices, meshletTriangles, normals, normalSum,
+			points, meshlet);
+		meshlets.push_back(meshlet);
+
+		meshletTriangles.clear();
+		meshletVertices.clear();
+		normalSum = XMVectorZero();
+	};
+
+	for(UINT t = 0; t < triangleCount; ++t)
+	{
+		const UINT id = (UINT)meshlets.size();
+
+		UINT newVertices = 0;
+		UINT sharedVertices = 0;
+		for(UINT k = 0; k < 3; ++k)
+		{
+			if( vertexMeshlet[indices[t * 3 + k]] == id )
+				++sharedVertices;
+			else
+				++newVertices;
+		}
+
+		// A triangle that shares no vertex with the meshlet is where the
+		// optimizer jumped to another part of the mesh, usually the start
+		// of one of its clusters; starting a new meshlet there keeps the
+		// bounds tight.
+		if( !meshletTriangles.empty() &&
+			(meshletTriangles.size() == maxTriangles || meshletVertices.size() + newVertices > maxVertices ||
+			 (sharedVertices == 0 && meshletTriangles.size() >= maxTriangles / 4)) )
+		{
+			finishMeshlet();
+		}
+
+		const UINT current = (UINT)meshlets.size();
+		meshletTriangles.push_back(t);
+		normalSum = XMVectorAdd(normalSum, XMLoadFloat3(&normals[t]));
+		for(UINT k = 0; k < 3; ++k)
+		{
+			UINT v = indices[t * 3 + k];
+			if( vertexMeshlet[v] != current )
+			{
+				vertexMeshlet[v] = current;
+				meshletVertices.push_back(v);
+			}
+		}
+	}
+
+	finishMeshlet();
+}
+
+void MeshletCuller::Cull(const std::vector<Meshlet>& meshlets, const Camera& camera,
+	const XMFLOAT4X4& world, UINT startIndexLocation,
+	std::vector<MeshletDraw>& draws, MeshletCullStats* stats)
+{
+	XMMATRIX W = XMLoadFloat4x4(&world);
+
+	// Rows of the transposed world * view * proj give the clip space planes
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w in model space.
+	XMMATRIX M = XMMatrixTranspose(XMMatrixMultiply(XMMatrixMultiply(W, camera.GetView()), camera.GetProj()));
+	XMVECTOR planes[6] =
+	{
+		XMVectorAdd(M.r[3], M.r[0]),
+		XMVectorSubtract(M.r[3], M.r[0]),
+		XMVectorAdd(M.r[3], M.r[1]),
+		XMVectorSubtract(M.r[3], M.r[1]),
+		M.r[2],
+		XMVectorSubtract(M.r[3], M.r[2]),
+	};
+	for(XMVECTOR& plane : planes)
+		plane = XMPlaneNormalize(plane);
+
+	// A mirroring world matrix swaps which side of a triangle is the front.
+	XMVECTOR determinant = XMMatrixDeterminant(W);
+	XMMATRIX invWorld = XMMatrixInverse(&determinant, W);
+	XMVECTOR eye = XMVector3TransformCoord(camera.GetPosition(), invWorld);
+	const bool mirrored = XMVectorGetX(determinant) < 0.0f;
+
+	const size_t firstDraw = draws.size();
+	for(const Meshlet& meshlet : meshlets)
+	{
+		XMVECTOR center = XMLoadFloat3(&meshlet.Bounds.Center);
+		const float radius = meshlet.Bounds.Radius;
+
+		bool culled = false;
+		for(const XMVECTOR& plane : planes)
+		{
+			if( XMVectorGetX(XMPlaneDotCoord(plane, center)) < -radius )
+			{
+				culled = true;
+				break;
+			}
+		}
+
+		if( culled )
+		{
+			if( stats != nullptr )
+				++stats->FrustumCulled;
+		}
+		else if( meshlet.ConeCos > 0.0f && !mirrored )
+		{
+			// A triangle faces away if the eye is behind its plane.  Over the
+			// normals in the cone and the points in the sphere, the smallest
+			// distance from the eye along the normal is
+			// |d| cos(angle(d, axis) + half angle) - radius.
+			XMVECTOR d = XMVectorSubtract(center, eye);
+			float along = XMVectorGetX(XMVector3Dot(d, XMLoadFloat3(&meshlet.ConeAxis)));
+			float across = sqrtf(std::max(XMVectorGetX(XMVector3LengthSq(d)) - along * along, 0.0f));
+			float coneSin = sqrtf(std::max(1.0f - meshlet.ConeCos * meshlet.ConeCos, 0.0f));
+
+			if( along * meshlet.ConeCos - across * coneSin > radius )
+			{
+				culled = true;
+				if( stats != nullptr )
+					++stats->BackfaceCulled;
+			}
+		}
+
+		if( stats != nullptr )
+		{
+			++stats->Meshlets;
+			stats->Triangles += meshlet.IndexCount / 3;
+		}
+
+		if( culled )
+			continue;
+
+		if( stats != nullptr )
+			stats->VisibleTriangles += meshlet.IndexCount / 3;
+
+		UINT start = startIndexLocation + meshlet.StartIndexLocation;
+		if( draws.size() > firstDraw && draws.back().StartIndexLocation + draws.back().IndexCount == start )
+		{
+			draws.back().IndexCount += meshlet.IndexCount;
+		}
+		else
+		{
+			MeshletDraw draw;
+			draw.StartIndexLocation = start;
+			draw.IndexCount = meshlet.IndexCount;
+			draws.push_back(draw);
+		}
+	}
+}
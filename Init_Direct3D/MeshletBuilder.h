@@ -0,0 +1,104 @@
+#ifndef MESHLETBUILDER_H
+#define MESHLETBUILDER_H
+
+#include "../Common/d3dUtil.h"
+#include "../Common/Camera.h"
+#include <DirectXCollision.h>
+
+///<summary>
+/// A cluster of neighbouring triangles stored as one range of an index
+/// buffer, with the bounds needed to reject it on the CPU.
+///</summary>
+struct Meshlet
+{
+	// Relative to the start of the geometry's index range.
+	UINT StartIndexLocation = 0;
+	UINT IndexCount = 0;
+
+	// Distinct vertices the triangles use.
+	UINT VertexCount = 0;
+
+	// Model space sphere around the triangles.
+	DirectX::BoundingSphere Bounds;
+
+	// Every triangle's normal is within the cone around ConeAxis whose
+	// half angle has cosine ConeCos.  ConeCos <= 0 means the triangles face
+	// too many ways for the cone to ever cull the meshlet.
+	DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+	float ConeCos = 0.0f;
+};
+
+///<summary>
+/// A run of consecutive surviving meshlets, drawn with one
+/// DrawIndexedInstanced.
+///</summary>
+struct MeshletDraw
+{
+	UINT StartIndexLocation = 0;
+	UINT IndexCount = 0;
+};
+
+struct MeshletCullStats
+{
+	UINT Meshlets = 0;
+	UINT Triangles = 0;
+	UINT FrustumCulled = 0;
+	UINT BackfaceCulled = 0;
+	UINT VisibleTriangles = 0;
+};
+
+///<summary>
+/// Partitions a mesh into meshlets of at most maxVertices vertices and
+/// maxTriangles triangles.
+///
+/// A meshlet grows from a seed triangle by adding the neighbouring triangle
+/// that brings in the fewest new vertices, ties going to the one whose
+/// normal is closest to the meshlet's average.  That keeps meshlets compact,
+/// for tight spheres, and flat, for narrow normal cones.  The next seed is a
+/// free neighbour of the previous meshlet, so the mesh is consumed as one
+/// front rather than leaving scattered islands.  Each meshlet's triangles
+/// are then reordered for the vertex cache.
+///</summary>
+class MeshletBuilder
+{
+public:
+	static const UINT DefaultMaxVertices = 64;
+	static const UINT DefaultMaxTriangles = 124;
+
+	// Reorders the triangles of indices, in place, so each meshlet's are
+	// consecutive, and writes the meshlets to meshlets.  vertices holds
+	// numVertices vertices of vertexStride bytes with an XMFLOAT3 position
+	// at positionOffset.  Triangles keep their winding.
+	static void Build(const void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+		UINT* indices, UINT indexCount, std::vector<Meshlet>& meshlets,
+		UINT maxVertices = DefaultMaxVertices, UINT maxTriangles = DefaultMaxTriangles);
+
+	// Writes meshlets over the triangles of indices without moving any:
+	// each is a run of consecutive triangles, cut where a limit would be
+	// exceeded or where a triangle shares no vertex with the run so far.
+	// For a mesh already ordered by MeshOptimizer, whose fans and overdraw
+	// clusters are local, the runs cull nearly as well as Build's meshlets
+	// and the optimizer's vertex cache and overdraw order is kept.
+	static void BuildInOrder(const void* vertices, UINT vertexStride, UINT positionOffset, UINT numVertices,
+		const UINT* indices, UINT indexCount, std::vector<Meshlet>& meshlets,
+		UINT maxVertices = DefaultMaxVertices, UINT maxTriangles = DefaultMaxTriangles);
+};
+
+///<summary>
+/// Rejects meshlets on the CPU before drawing: those outside the camera
+/// frustum, and those whose normal cone shows every triangle faces away
+/// from the camera.  Both tests are done in model space, so the bounds are
+/// never transformed.  The frustum planes come from world * view * proj,
+/// and facing is unchanged by any world matrix that does not mirror.
+///</summary>
+class MeshletCuller
+{
+public:
+	// Appends the surviving meshlets, merged into runs, to draws, offset by
+	// startIndexLocation.  Adds to stats if not null.
+	static void Cull(const std::vector<Meshlet>& meshlets, const Camera& camera,
+		const DirectX::XMFLOAT4X4& world, UINT startIndexLocation,
+		std::vector<MeshletDraw>& draws, MeshletCullStats* stats = nullptr);
+};
+
+#endif // MESHLETBUILDER_H
@@ -59,11 +59,90 @@ cbuffer cbPass : register(b2)
 	float2 FogPadding;
 };
 
+// Must match BonePalette::MaxBones.  Vertex bone indices refer to the
+// palette of the subset being drawn (see BonePaletteLayout), which holds
+// only the bones it is weighted to; the rest of the array is never read.
+#define MAXBONES 96
+
 cbuffer cbSkinned : register(b3)
 {
-	float4x4 gBoneTransforms[96];
+#if defined(DUAL_QUATERNION_SKINNING)
+	// Per bone: unit rotation quaternion, then its dual part.
+	float4 gBoneDualQuats[MAXBONES * 2];
+#elif defined(HALF_BONE_PALETTE)
+	// Per bone: the three rows below as half floats, two rows per uint4.
+	uint4 gBoneHalfRows[MAXBONES * 3 / 2];
+#else
+	// Per bone: the first three rows of the transposed bone transform.
+	float4 gBoneRows[MAXBONES * 3];
+#endif
 };
 
+#ifdef SKINNED
+#ifndef DUAL_QUATERNION_SKINNING
+// Row r of bone b is BoneRow(b * 3 + r).
+float4 BoneRow(uint index)
+{
+#ifdef HALF_BONE_PALETTE
+	uint4 packed = gBoneHalfRows[index / 2];
+	uint2 halves = (index & 1) ? packed.zw : packed.xy;
+	return float4(f16tof32(halves.x), f16tof32(halves.x >> 16), f16tof32(halves.y), f16tof32(halves.y >> 16));
+#else
+	return gBoneRows[index];
+#endif
+}
+#endif
+
+// Blends the four bone transforms of a vertex and applies them to the
+// position, normal and tangent in place.  Assumes no nonuniform scaling,
+// so normals do not need the inverse-transpose.
+void SkinVertex(float3 boneWeights, uint4 boneIndices, inout float3 posL, inout float3 normalL, inout float3 tangentL)
+{
+	float weights[4] = { boneWeights.x, boneWeights.y, boneWeights.z,
+		1.0f - boneWeights.x - boneWeights.y - boneWeights.z };
+
+#ifdef DUAL_QUATERNION_SKINNING
+	// Keep every quaternion in the hemisphere of the first so they blend
+	// along the shorter arc.
+	float4 real0 = gBoneDualQuats[boneIndices[0] * 2];
+	float4 real = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	float4 dual = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < 4; ++i)
+	{
+		float4 r = gBoneDualQuats[boneIndices[i] * 2];
+		float4 d = gBoneDualQuats[boneIndices[i] * 2 + 1];
+		float w = dot(r, real0) < 0.0f ? -weights[i] : weights[i];
+		real += w * r;
+		dual += w * d;
+	}
+
+	float invLength = rsqrt(dot(real, real));
+	real *= invLength;
+	dual *= invLength;
+
+	float3 t = 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+	posL = posL + 2.0f * cross(real.xyz, cross(real.xyz, posL) + real.w * posL) + t;
+	normalL = normalL + 2.0f * cross(real.xyz, cross(real.xyz, normalL) + real.w * normalL);
+	tangentL = tangentL + 2.0f * cross(real.xyz, cross(real.xyz, tangentL) + real.w * tangentL);
+#else
+	float4 row0 = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	float4 row1 = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	float4 row2 = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < 4; ++i)
+	{
+		row0 += weights[i] * BoneRow(boneIndices[i] * 3);
+		row1 += weights[i] * BoneRow(boneIndices[i] * 3 + 1);
+		row2 += weights[i] * BoneRow(boneIndices[i] * 3 + 2);
+	}
+
+	float4 p = float4(posL, 1.0f);
+	posL = float3(dot(row0, p), dot(row1, p), dot(row2, p));
+	normalL = float3(dot(row0.xyz, normalL), dot(row1.xyz, normalL), dot(row2.xyz, normalL));
+	tangentL = float3(dot(row0.xyz, tangentL), dot(row1.xyz, tangentL), dot(row2.xyz, tangentL));
+#endif
+}
+#endif
+
 TextureCube	 gCubeMap	: register(t0);
 Texture2D    gTexture_0 : register(t1);
 Texture2D    gNormal_0 : register(t2);
@@ -0,0 +1,126 @@
+#include "PoseCache.h"
+#include <cmath>
+
+PoseCache::PoseCache(float timeQuantum, UINT capacity)
+	: mTimeQuantum(timeQuantum > 0.0f ? timeQuantum : 0.0f),
+	mCapacity(capacity)
+{
+}
+
+float PoseCache::GetTimeQuantum()const
+{
+	return mTimeQuantum;
+}
+
+void PoseCache::SetTimeQuantum(float timeQuantum)
+{
+	// Keys from the old quantum would map to different times.
+	mTimeQuantum = timeQuantum > 0.0f ? timeQuantum : 0.0f;
+	Clear();
+}
+
+float PoseCache::QuantizeTime(float timePos)const
+{
+	if( mTimeQuantum <= 0.0f )
+		return timePos;
+
+	return std::floor(timePos / mTimeQuantum + 0.5f) * mTimeQuantum;
+}
+
+void PoseCache::BeginFrame()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if( mPoses.size() > mCapacity )
+		mPoses.clear();
+}
+
+void PoseCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mPoses.clear();
+}
+
+const std::vector<DirectX::XMFLOAT4X4>& PoseCache::GetPose(const SkinnedData& skinnedInfo,
+	const AnimationClipHandle& clip, float timePos, AnimationCursor& cursor, AnimationScratch& scratch)
+{
+	Key key = MakeKey(skinnedInfo, clip, timePos);
+
+	Pose* pose = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		std::unique_ptr<Pose>& entry = mPoses[key];
+		if( entry == nullptr )
+		{
+			entry = std::make_unique<Pose>();
+			++mMisses;
+		}
+		else
+		{
+			++mHits;
+		}
+		pose = entry.get();
+	}
+
+	// Computed outside the lock so different keys are evaluated in parallel.
+	std::call_once(pose->Computed, [&]()
+	{
+		pose->FinalTransforms.resize(skinnedInfo.BoneCount());
+		skinnedInfo.GetFinalTransforms(clip, QuantizeTime(timePos), pose->FinalTransforms, cursor, scratch);
+	});
+
+	return pose->FinalTransforms;
+}
+
+UINT64 PoseCache::GetHitCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mHits;
+}
+
+UINT64 PoseCache::GetMissCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMisses;
+}
+
+UINT PoseCache::GetPoseCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return (UINT)mPoses.size();
+}
+
+void PoseCache::ResetCounters()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mHits = 0;
+	mMisses = 0;
+}
+
+PoseCache::Key PoseCache::MakeKey(const SkinnedData& skinnedInfo, const AnimationClipHandle& clip, float timePos)const
+{
+	Key key;
+	key.Skeleton = &skinnedInfo;
+	key.Clip = clip.Index;
+
+	if( mTimeQuantum > 0.0f )
+	{
+		key.Time = (INT64)std::floor(timePos / mTimeQuantum + 0.5f);
+	}
+	else
+	{
+		UINT bits;
+		memcpy(&bits, &timePos, sizeof(bits));
+		key.Time = bits;
+	}
+
+	return key;
+}
+
+size_t PoseCache::KeyHash::operator()(const Key& key)const
+{
+	size_t h = std::hash<const void*>()(key.Skeleton);
+	h ^= std::hash<UINT>()(key.Clip) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	h ^= std::hash<INT64>()(key.Time) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	return h;
+}
@@ -0,0 +1,83 @@
+#ifndef POSECACHE_H
+#define POSECACHE_H
+
+#include "SkinnedData.h"
+#include <unordered_map>
+
+///<summary>
+/// Shares final bone transforms between instances that play the same clip
+/// of the same skeleton at the same time.  Times are rounded to a multiple
+/// of the time quantum, so a larger quantum lets more instances share a
+/// pose at the cost of playing in steps of that size; a quantum of zero
+/// only shares exactly equal times.
+///
+/// A pose depends only on its key, so it is computed once and kept until
+/// the cache outgrows its capacity.  GetPose may be called from several
+/// threads at once; the first caller for a key computes the pose and the
+/// others wait for it.
+///</summary>
+class PoseCache
+{
+public:
+	explicit PoseCache(float timeQuantum = 1.0f / 30.0f, UINT capacity = 4096);
+	PoseCache(const PoseCache& rhs) = delete;
+	PoseCache& operator=(const PoseCache& rhs) = delete;
+
+	float GetTimeQuantum()const;
+	void SetTimeQuantum(float timeQuantum);
+
+	// Time at which poses for timePos are actually sampled.
+	float QuantizeTime(float timePos)const;
+
+	// Drops every pose if the cache holds more than its capacity.  Must not
+	// run concurrently with GetPose, since it invalidates returned poses.
+	void BeginFrame();
+	void Clear();
+
+	// Returns the final transforms of clip at the quantized timePos.  cursor
+	// and scratch are the caller's and are only used on a miss.
+	const std::vector<DirectX::XMFLOAT4X4>& GetPose(const SkinnedData& skinnedInfo,
+		const AnimationClipHandle& clip, float timePos, AnimationCursor& cursor, AnimationScratch& scratch);
+
+	UINT64 GetHitCount()const;
+	UINT64 GetMissCount()const;
+	UINT GetPoseCount()const;
+	void ResetCounters();
+
+private:
+	struct Key
+	{
+		const SkinnedData* Skeleton;
+		UINT Clip;
+		INT64 Time;		// quantized time step, or the bits of the time when the quantum is zero
+
+		bool operator==(const Key& rhs)const
+		{
+			return Skeleton == rhs.Skeleton && Clip == rhs.Clip && Time == rhs.Time;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key)const;
+	};
+
+	struct Pose
+	{
+		std::once_flag Computed;
+		std::vector<DirectX::XMFLOAT4X4> FinalTransforms;
+	};
+
+	Key MakeKey(const SkinnedData& skinnedInfo, const AnimationClipHandle& clip, float timePos)const;
+
+private:
+	float mTimeQuantum = 0.0f;
+	UINT mCapacity = 0;
+
+	mutable std::mutex mMutex;
+	std::unordered_map<Key, std::unique_ptr<Pose>, KeyHash> mPoses;
+	UINT64 mHits = 0;
+	UINT64 mMisses = 0;
+};
+
+#endif // POSECACHE_H
@@ -0,0 +1,275 @@
+#include "SampledAnimationClip.h"
+#include "CompressedAnimationClip.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Evaluates one bone the way BoneAnimation::Interpolate does, but returns
+	// the decomposed transform.  Sample times only increase, so keyIndex just
+	// walks forward through the keyframes.
+	void SampleBone(const BoneAnimation& bone, float t, UINT& keyIndex,
+		XMVECTOR& translation, XMVECTOR& scale, XMVECTOR& rotation)
+	{
+		const std::vector<Keyframe>& keys = bone.Keyframes;
+
+		const Keyframe* key = nullptr;
+		if( t <= keys.front().TimePos )
+			key = &keys.front();
+		else if( t >= keys.back().TimePos )
+			key = &keys.back();
+
+		if( key != nullptr )
+		{
+			translation = XMLoadFloat3(&key->Translation);
+			scale = XMLoadFloat3(&key->Scale);
+			rotation = XMLoadFloat4(&key->RotationQuat);
+			return;
+		}
+
+		while( keys[keyIndex+1].TimePos < t )
+			++keyIndex;
+
+		const Keyframe& k0 = keys[keyIndex];
+		const Keyframe& k1 = keys[keyIndex+1];
+		float lerpPercent = (t - k0.TimePos) / (k1.TimePos - k0.TimePos);
+
+		translation = XMVectorLerp(XMLoadFloat3(&k0.Translation), XMLoadFloat3(&k1.Translation), lerpPercent);
+		scale = XMVectorLerp(XMLoadFloat3(&k0.Scale), XMLoadFloat3(&k1.Scale), lerpPercent);
+		rotation = XMQuaternionSlerp(XMLoadFloat4(&k0.RotationQuat), XMLoadFloat4(&k1.RotationQuat), lerpPercent);
+	}
+}
+
+bool SampledAnimationClip::Build(const AnimationClip& clip, float sampleRate)
+{
+	Clear();
+
+	if( clip.Compressed != nullptr )
+	{
+		AnimationClip decompressed;
+		clip.Compressed->Decompress(decompressed);
+		return Build(decompressed, sampleRate);
+	}
+
+	if( clip.BoneAnimations.empty() || !(sampleRate > 0.0f) )
+		return false;
+
+	for(const BoneAnimation& bone : clip.BoneAnimations)
+	{
+		if( bone.Keyframes.empty() )
+			return false;
+	}
+
+	mBoneCount = (UINT)clip.BoneAnimations.size();
+	mGroupCount = (mBoneCount + 3) / 4;
+	mStartTime = clip.GetClipStartTime();
+	mEndTime = clip.GetClipEndTime();
+
+	// Round the rate up so the last sample lands exactly on the end time.
+	float duration = mEndTime - mStartTime;
+	if( duration > 0.0f )
+	{
+		mSampleCount = (UINT)std::ceil(duration * sampleRate) + 1;
+		mSampleRate = (mSampleCount - 1) / duration;
+	}
+	else
+	{
+		mSampleCount = 1;
+		mSampleRate = sampleRate;
+	}
+
+	// Padding lanes keep the identity transform.
+	const UINT groupFloats = ChannelCount * 4;
+	mSamples.assign((size_t)mSampleCount * mGroupCount * groupFloats, 0.0f);
+	for(UINT sample = 0; sample < mSampleCount; ++sample)
+	{
+		for(UINT group = 0; group < mGroupCount; ++group)
+		{
+			float* channels = &mSamples[((size_t)sample * mGroupCount + group) * groupFloats];
+			for(UINT lane = 0; lane < 4; ++lane)
+			{
+				channels[ScaleX*4 + lane] = 1.0f;
+				channels[ScaleY*4 + lane] = 1.0f;
+				channels[ScaleZ*4 + lane] = 1.0f;
+				channels[RotationW*4 + lane] = 1.0f;
+			}
+		}
+	}
+
+	for(UINT bone = 0; bone < mBoneCount; ++bone)
+	{
+		const UINT group = bone / 4;
+		const UINT lane = bone % 4;
+
+		UINT keyIndex = 0;
+		XMVECTOR previousRotation = XMQuaternionIdentity();
+		for(UINT sample = 0; sample < mSampleCount; ++sample)
+		{
+			float t = sample + 1 < mSampleCount ? mStartTime + sample / mSampleRate : mEndTime;
+
+			XMVECTOR translation, scale, rotation;
+			SampleBone(clip.BoneAnimations[bone], t, keyIndex, translation, scale, rotation);
+
+			// q and -q are the same rotation; pick the one nearer the previous
+			// sample so nlerp between them follows the shorter arc.
+			if( sample > 0 && XMVectorGetX(XMVector4Dot(rotation, previousRotation)) < 0.0f )
+				rotation = XMVectorNegate(rotation);
+			previousRotation = rotation;
+
+			float* channels = &mSamples[((size_t)sample * mGroupCount + group) * groupFloats];
+			channels[TranslationX*4 + lane] = XMVectorGetX(translation);
+			channels[TranslationY*4 + lane] = XMVectorGetY(translation);
+			channels[TranslationZ*4 + lane] = XMVectorGetZ(translation);
+			channels[ScaleX*4 + lane] = XMVectorGetX(scale);
+			channels[ScaleY*4 + lane] = XMVectorGetY(scale);
+			channels[ScaleZ*4 + lane] = XMVectorGetZ(scale);
+			channels[RotationX*4 + lane] = XMVectorGetX(rotation);
+			channels[RotationY*4 + lane] = XMVectorGetY(rotation);
+			channels[RotationZ*4 + lane] = XMVectorGetZ(rotation);
+			channels[RotationW*4 + lane] = XMVectorGetW(rotation);
+		}
+	}
+
+	return true;
+}
+
+void SampledAnimationClip::Clear()
+{
+	mBoneCount = 0;
+	mGroupCount = 0;
+	mSampleCount = 0;
+	mSampleRate = 0.0f;
+	mStartTime = 0.0f;
+	mEndTime = 0.0f;
+	mSamples.clear();
+}
+
+UINT SampledAnimationClip::BoneCount()const
+{
+	return mBoneCount;
+}
+
+UINT SampledAnimationClip::SampleCount()const
+{
+	return mSampleCount;
+}
+
+float SampledAnimationClip::GetSampleRate()const
+{
+	return mSampleRate;
+}
+
+float SampledAnimationClip::GetClipStartTime()const
+{
+	return mStartTime;
+}
+
+float SampledAnimationClip::GetClipEndTime()const
+{
+	return mEndTime;
+}
+
+size_t SampledAnimationClip::ByteSize()const
+{
+	return mSamples.size()*sizeof(float);
+}
+
+const float* SampledAnimationClip::GroupSample(UINT sample, UINT group)const
+{
+	return &mSamples[((size_t)sample * mGroupCount + group) * ChannelCount * 4];
+}
+
+void SampledAnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, Accuracy accuracy)const
+{
+	if( mSampleCount == 0 )
+		return;
+
+	// Uniform samples: the interval is found by scaling the time.
+	float u = (std::min(std::max(t, mStartTime), mEndTime) - mStartTime) * mSampleRate;
+	UINT sample0 = std::min((UINT)u, mSampleCount - 1);
+	UINT sample1 = std::min(sample0 + 1, mSampleCount - 1);
+	XMVECTOR lerpPercent = XMVectorReplicate(std::min(u - (float)sample0, 1.0f));
+
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR zero = XMVectorZero();
+
+	for(UINT group = 0; group < mGroupCount; ++group)
+	{
+		const float* s0 = GroupSample(sample0, group);
+		const float* s1 = GroupSample(sample1, group);
+
+		XMVECTOR c[ChannelCount];
+		for(UINT i = 0; i < ChannelCount; ++i)
+		{
+			XMVECTOR v0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(s0 + i*4));
+			XMVECTOR v1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(s1 + i*4));
+			c[i] = XMVectorLerpV(v0, v1, lerpPercent);
+		}
+
+		// nlerp: renormalize the four blended rotations at once.
+		XMVECTOR lengthSq = XMVectorMultiply(c[RotationX], c[RotationX]);
+		lengthSq = XMVectorMultiplyAdd(c[RotationY], c[RotationY], lengthSq);
+		lengthSq = XMVectorMultiplyAdd(c[RotationZ], c[RotationZ], lengthSq);
+		lengthSq = XMVectorMultiplyAdd(c[RotationW], c[RotationW], lengthSq);
+		XMVECTOR invLength = accuracy == Accuracy::Fast ?
+			XMVectorReciprocalSqrtEst(lengthSq) : XMVectorReciprocalSqrt(lengthSq);
+
+		XMVECTOR x = XMVectorMultiply(c[RotationX], invLength);
+		XMVECTOR y = XMVectorMultiply(c[RotationY], invLength);
+		XMVECTOR z = XMVectorMultiply(c[RotationZ], invLength);
+		XMVECTOR w = XMVectorMultiply(c[RotationW], invLength);
+
+		// Scale * Rotation(q) * Translation, the same matrix
+		// XMMatrixAffineTransformation builds, for four bones.
+		XMVECTOR x2 = XMVectorAdd(x, x);
+		XMVECTOR y2 = XMVectorAdd(y, y);
+		XMVECTOR z2 = XMVectorAdd(z, z);
+
+		XMVECTOR xx = XMVectorMultiply(x, x2);
+		XMVECTOR yy = XMVectorMultiply(y, y2);
+		XMVECTOR zz = XMVectorMultiply(z, z2);
+		XMVECTOR xy = XMVectorMultiply(x, y2);
+		XMVECTOR xz = XMVectorMultiply(x, z2);
+		XMVECTOR yz = XMVectorMultiply(y, z2);
+		XMVECTOR wx = XMVectorMultiply(w, x2);
+		XMVECTOR wy = XMVectorMultiply(w, y2);
+		XMVECTOR wz = XMVectorMultiply(w, z2);
+
+		XMMATRIX row0(
+			XMVectorMultiply(XMVectorSubtract(one, XMVectorAdd(yy, zz)), c[ScaleX]),
+			XMVectorMultiply(XMVectorAdd(xy, wz), c[ScaleX]),
+			XMVectorMultiply(XMVectorSubtract(xz, wy), c[ScaleX]),
+			zero);
+		XMMATRIX row1(
+			XMVectorMultiply(XMVectorSubtract(xy, wz), c[ScaleY]),
+			XMVectorMultiply(XMVectorSubtract(one, XMVectorAdd(xx, zz)), c[ScaleY]),
+			XMVectorMultiply(XMVectorAdd(yz, wx), c[ScaleY]),
+			zero);
+		XMMATRIX row2(
+			XMVectorMultiply(XMVectorAdd(xz, wy), c[ScaleZ]),
+			XMVectorMultiply(XMVectorSubtract(yz, wx), c[ScaleZ]),
+			XMVectorMultiply(XMVectorSubtract(one, XMVectorAdd(xx, yy)), c[ScaleZ]),
+			zero);
+		XMMATRIX row3(c[TranslationX], c[TranslationY], c[TranslationZ], one);
+
+		// Each XMMATRIX holds one row for four bones; transposing turns it
+		// into that row of each bone's matrix.
+		row0 = XMMatrixTranspose(row0);
+		row1 = XMMatrixTranspose(row1);
+		row2 = XMMatrixTranspose(row2);
+		row3 = XMMatrixTranspose(row3);
+
+		const UINT firstBone = group * 4;
+		const UINT lanes = std::min(4u, mBoneCount - firstBone);
+		for(UINT lane = 0; lane < lanes; ++lane)
+		{
+			XMFLOAT4X4& M = boneTransforms[firstBone + lane];
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(M.m[0]), row0.r[lane]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(M.m[1]), row1.r[lane]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(M.m[2]), row2.r[lane]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(M.m[3]), row3.r[lane]);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef SAMPLEDANIMATIONCLIP_H
+#define SAMPLEDANIMATIONCLIP_H
+
+#include "SkinnedData.h"
+
+///<summary>
+/// An AnimationClip resampled to a uniform rate and stored structure of
+/// arrays.  Every sample holds, for each group of four bones, the ten
+/// channels (translation xyz, scale xyz, rotation xyzw) as four-wide
+/// vectors, so Interpolate blends four bones per SIMD operation and builds
+/// their affine matrices together instead of one XMMatrixAffineTransformation
+/// per bone.  Because the samples are evenly spaced, finding the interval for
+/// a time is a multiply rather than a keyframe search, and no AnimationCursor
+/// is needed.
+///
+/// Rotations are blended with nlerp; neighbouring samples are kept in the
+/// same hemisphere when the clip is built so the shorter arc is always taken.
+/// At 30 Hz or more the difference from slerp is well below what is visible.
+///</summary>
+class SampledAnimationClip
+{
+public:
+	enum class Accuracy
+	{
+		Fast,		// reciprocal square root estimate when normalizing rotations
+		Precise		// full precision normalization
+	};
+
+	// Resamples clip at sampleRate samples per second.  Returns false if the
+	// clip has no bones, a bone has no keyframes or the rate is not positive.
+	bool Build(const AnimationClip& clip, float sampleRate);
+	void Clear();
+
+	UINT BoneCount()const;
+	UINT SampleCount()const;
+	float GetSampleRate()const;
+	float GetClipStartTime()const;
+	float GetClipEndTime()const;
+	size_t ByteSize()const;
+
+	// Same contract as AnimationClip::Interpolate: boneTransforms must hold
+	// BoneCount() matrices and receives each bone's to-parent transform.
+	void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms,
+		Accuracy accuracy = Accuracy::Precise)const;
+
+private:
+	// Channels of one sample of a bone group, each four bones wide.
+	enum Channel
+	{
+		TranslationX, TranslationY, TranslationZ,
+		ScaleX, ScaleY, ScaleZ,
+		RotationX, RotationY, RotationZ, RotationW,
+		ChannelCount
+	};
+
+	const float* GroupSample(UINT sample, UINT group)const;
+
+private:
+	UINT mBoneCount = 0;
+	UINT mGroupCount = 0;
+	UINT mSampleCount = 0;
+	float mSampleRate = 0.0f;
+	float mStartTime = 0.0f;
+	float mEndTime = 0.0f;
+
+	// [sample][group][channel][lane]
+	std::vector<float> mSamples;
+};
+
+#endif // SAMPLEDANIMATIONCLIP_H
@@ -1,4 +1,6 @@
 #include "SkinnedData.h"
+#include <algorithm>
+#include "CompressedAnimationClip.h"
 
 using namespace DirectX;
 
@@ -28,7 +30,18 @@ float BoneAnimation::GetEndTime()const
 	return f;
 }
 
+void AnimationCursor::Reset()
+{
+	std::fill(KeyIndices.begin(), KeyIndices.end(), 0);
+}
+
 void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	UINT keyIndex = 0;
+	Interpolate(t, M, keyIndex);
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M, UINT& keyIndex)const
 {
 	if( t <= Keyframes.front().TimePos )
 	{
@@ -50,36 +63,66 @@ void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
 	}
 	else
 	{
-		for(UINT i = 0; i < Keyframes.size()-1; ++i)
+		// We want the first interval [i, i+1] with t <= Keyframes[i+1].TimePos.
+		// Any i with Keyframes[i].TimePos < t lies at or before it, so from
+		// such a cursor we step forward; otherwise (a seek backwards or a
+		// loop) we binary search.
+		const UINT numKeyframes = (UINT)Keyframes.size();
+		const UINT MaxForwardSteps = 4;
+
+		UINT i = keyIndex;
+		if( i < numKeyframes-1 && Keyframes[i].TimePos < t )
 		{
-			if( t >= Keyframes[i].TimePos && t <= Keyframes[i+1].TimePos )
+			UINT steps = 0;
+			while( Keyframes[i+1].TimePos < t && steps < MaxForwardSteps )
 			{
-				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
+				++i;
+				++steps;
+			}
 
-				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
-				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
+			if( Keyframes[i+1].TimePos < t )
+				i = UpperInterval(t, i + 1);
+		}
+		else
+		{
+			i = UpperInterval(t, 0);
+		}
+		keyIndex = i;
 
-				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
-				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
+		float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i+1].TimePos - Keyframes[i].TimePos);
 
-				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
-				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
+		XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+		XMVECTOR s1 = XMLoadFloat3(&Keyframes[i+1].Scale);
 
-				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
-				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+		XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+		XMVECTOR p1 = XMLoadFloat3(&Keyframes[i+1].Translation);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+		XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+		XMVECTOR q1 = XMLoadFloat4(&Keyframes[i+1].RotationQuat);
 
-				break;
-			}
-		}
+		XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+		XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+		XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
 	}
 }
 
+UINT BoneAnimation::UpperInterval(float t, UINT first)const
+{
+	// First keyframe at or after t, searching from first; the interval ends there.
+	auto next = std::lower_bound(Keyframes.begin() + first, Keyframes.end(), t,
+		[](const Keyframe& key, float time) { return key.TimePos < time; });
+
+	return (UINT)(next - Keyframes.begin()) - 1;
+}
+
 float AnimationClip::GetClipStartTime()const
 {
+	if( Compressed != nullptr )
+		return Compressed->GetClipStartTime();
+
 	// Find smallest start time over all bones in this clip.
 	float t = MathHelper::Infinity;
 	for(UINT i = 0; i < BoneAnimations.size(); ++i)
@@ -92,6 +135,9 @@ float AnimationClip::GetClipStartTime()const
 
 float AnimationClip::GetClipEndTime()const
 {
+	if( Compressed != nullptr )
+		return Compressed->GetClipEndTime();
+
 	// Find largest end time over all bones in this clip.
 	float t = 0.0f;
 	for(UINT i = 0; i < BoneAnimations.size(); ++i)
@@ -104,22 +150,69 @@ float AnimationClip::GetClipEndTime()const
 
 void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
 {
+	if( Compressed != nullptr )
+	{
+		Compressed->Interpolate(t, boneTransforms);
+		return;
+	}
+
 	for(UINT i = 0; i < BoneAnimations.size(); ++i)
 	{
 		BoneAnimations[i].Interpolate(t, boneTransforms[i]);
 	}
 }
 
+void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor)const
+{
+	if( Compressed != nullptr )
+	{
+		Compressed->Interpolate(t, boneTransforms, cursor);
+		return;
+	}
+
+	if( cursor.KeyIndices.size() != BoneAnimations.size() )
+		cursor.KeyIndices.assign(BoneAnimations.size(), 0);
+
+	for(UINT i = 0; i < BoneAnimations.size(); ++i)
+	{
+		BoneAnimations[i].Interpolate(t, boneTransforms[i], cursor.KeyIndices[i]);
+	}
+}
+
+void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor,
+	const UINT* bones, UINT numBones)const
+{
+	if( Compressed != nullptr )
+	{
+		Compressed->Interpolate(t, boneTransforms, cursor, bones, numBones);
+		return;
+	}
+
+	if( cursor.KeyIndices.size() != BoneAnimations.size() )
+		cursor.KeyIndices.assign(BoneAnimations.size(), 0);
+
+	for(UINT i = 0; i < numBones; ++i)
+	{
+		UINT bone = bones[i];
+		BoneAnimations[bone].Interpolate(t, boneTransforms[bone], cursor.KeyIndices[bone]);
+	}
+}
+
 float SkinnedData::GetClipStartTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipStartTime();
+	std::unique_lock<std::mutex> lock(mClipMutex);
+
+	// The times of an evicted clip are remembered, so this decodes at most once.
+	const ClipSlot* slot = FindClip(clipName, false, lock);
+	return slot != nullptr ? slot->StartTime : 0.0f;
 }
 
 float SkinnedData::GetClipEndTime(const std::string& clipName)const
 {
-	auto clip = mAnimations.find(clipName);
-	return clip->second.GetClipEndTime();
+	std::unique_lock<std::mutex> lock(mClipMutex);
+
+	const ClipSlot* slot = FindClip(clipName, false, lock);
+	return slot != nullptr ? slot->EndTime : 0.0f;
 }
 
 UINT SkinnedData::BoneCount()const
@@ -127,54 +220,413 @@ UINT SkinnedData::BoneCount()const
 	return mBoneHierarchy.size();
 }
 
+const std::vector<int>& SkinnedData::GetBoneHierarchy()const
+{
+	return mBoneHierarchy;
+}
+
+UINT SkinnedData::BoneDepth(UINT bone)const
+{
+	return mBoneDepths[bone];
+}
+
+UINT SkinnedData::MaxBoneDepth()const
+{
+	return mBonesUpToDepth.empty() ? 0 : (UINT)mBonesUpToDepth.size() - 1;
+}
+
+bool SkinnedData::ValidateBoneHierarchy(const int* boneHierarchy, UINT numBones)
+{
+	if( numBones == 0 || boneHierarchy[0] >= 0 )
+		return false;
+
+	for(UINT i = 1; i < numBones; ++i)
+	{
+		if( boneHierarchy[i] < 0 || (UINT)boneHierarchy[i] >= i )
+			return false;
+	}
+
+	return true;
+}
+
+void SkinnedData::ConcatenateTransforms(const int* boneHierarchy, const XMMATRIX* boneOffsets,
+	const XMFLOAT4X4* toParentTransforms, XMMATRIX* toRootTransforms,
+	XMFLOAT4X4* finalTransforms, UINT numBones)
+{
+	for(UINT i = 0; i < numBones; ++i)
+	{
+		XMMATRIX toParent = XMLoadFloat4x4(&toParentTransforms[i]);
+
+		// Parents come first, so the parent's to-root is already done.
+		XMMATRIX toRoot = i == 0 ? toParent : XMMatrixMultiply(toParent, toRootTransforms[boneHierarchy[i]]);
+		toRootTransforms[i] = toRoot;
+
+		XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(XMMatrixMultiply(boneOffsets[i], toRoot)));
+	}
+}
+
+void SkinnedData::ComputeBoneDepths()
+{
+	mBoneOffsetMatrices.resize(mBoneOffsets.size());
+	for(size_t i = 0; i < mBoneOffsets.size(); ++i)
+		mBoneOffsetMatrices[i] = XMLoadFloat4x4(&mBoneOffsets[i]);
+
+	// Parents come before their children, as GetFinalTransforms assumes.
+	const UINT numBones = (UINT)mBoneHierarchy.size();
+	mBoneDepths.assign(numBones, 0);
+	for(UINT i = 1; i < numBones; ++i)
+		mBoneDepths[i] = mBoneDepths[mBoneHierarchy[i]] + 1;
+
+	mBonesByDepth.resize(numBones);
+	for(UINT i = 0; i < numBones; ++i)
+		mBonesByDepth[i] = i;
+	std::stable_sort(mBonesByDepth.begin(), mBonesByDepth.end(),
+		[this](UINT a, UINT b) { return mBoneDepths[a] < mBoneDepths[b]; });
+
+	UINT maxDepth = 0;
+	for(UINT depth : mBoneDepths)
+		maxDepth = std::max(maxDepth, depth);
+
+	mBonesUpToDepth.assign(numBones > 0 ? maxDepth + 1 : 0, 0);
+	for(UINT depth : mBoneDepths)
+		++mBonesUpToDepth[depth];
+	for(UINT d = 1; d < (UINT)mBonesUpToDepth.size(); ++d)
+		mBonesUpToDepth[d] += mBonesUpToDepth[d-1];
+}
+
+const std::vector<XMFLOAT4X4>& SkinnedData::GetBoneOffsets()const
+{
+	return mBoneOffsets;
+}
+
+std::vector<std::string> SkinnedData::GetClipNames()const
+{
+	std::vector<std::string> names;
+	names.reserve(mClips.size());
+	for(const ClipSlot& slot : mClips)
+		names.push_back(slot.Name);
+
+	return names;
+}
+
+std::shared_ptr<const AnimationClip> SkinnedData::GetClip(const std::string& clipName)const
+{
+	std::unique_lock<std::mutex> lock(mClipMutex);
+
+	const ClipSlot* slot = FindClip(clipName, true, lock);
+	return slot != nullptr ? slot->Clip : nullptr;
+}
+
+std::shared_ptr<const AnimationClip> SkinnedData::GetClip(const AnimationClipHandle& clip)const
+{
+	if( clip.Index >= mClips.size() )
+		return nullptr;
+
+	// A resident clip is returned without taking mClipMutex, so decoding
+	// another clip does not hold this up.  The atomic load still takes the
+	// library's shared_ptr spin lock and bumps the clip's use count.  The
+	// last use only matters when clips can be evicted.
+	ClipSlot& slot = mClips[clip.Index];
+	std::shared_ptr<const AnimationClip> resident = std::atomic_load(&slot.Clip);
+	if( resident != nullptr )
+	{
+		if( mClipMemoryBudget != 0 )
+			slot.LastUse.store(++mClipUseCounter, std::memory_order_relaxed);
+		return resident;
+	}
+
+	std::unique_lock<std::mutex> lock(mClipMutex);
+
+	const ClipSlot* found = FindClip(clip.Index, true, lock);
+	return found != nullptr ? found->Clip : nullptr;
+}
+
+AnimationClipHandle SkinnedData::GetClipHandle(const std::string& clipName)const
+{
+	std::unique_lock<std::mutex> lock(mClipMutex);
+
+	AnimationClipHandle handle;
+
+	const ClipSlot* slot = FindClip(clipName, false, lock);
+	if( slot != nullptr )
+	{
+		handle.Index     = (UINT)(slot - mClips.data());
+		handle.StartTime = slot->StartTime;
+		handle.EndTime   = slot->EndTime;
+	}
+
+	return handle;
+}
+
+UINT SkinnedData::GetResidentClipCount()const
+{
+	std::lock_guard<std::mutex> lock(mClipMutex);
+
+	UINT count = 0;
+	for(const ClipSlot& slot : mClips)
+		count += slot.Clip != nullptr ? 1 : 0;
+
+	return count;
+}
+
+size_t SkinnedData::GetResidentClipBytes()const
+{
+	std::lock_guard<std::mutex> lock(mClipMutex);
+	return mResidentClipBytes;
+}
+
 void SkinnedData::Set(std::vector<int>& boneHierarchy, 
 		              std::vector<XMFLOAT4X4>& boneOffsets,
 		              std::unordered_map<std::string, AnimationClip>& animations)
 {
-	mBoneHierarchy = boneHierarchy;
-	mBoneOffsets   = boneOffsets;
-	mAnimations    = animations;
+	std::lock_guard<std::mutex> lock(mClipMutex);
+
+	mBoneHierarchy = std::move(boneHierarchy);
+	mBoneOffsets   = std::move(boneOffsets);
+	ComputeBoneDepths();
+
+	mClipSource.reset();
+	mClipMemoryBudget = 0;
+	mClipIndices.clear();
+	mClips = std::vector<ClipSlot>(animations.size());
+	mResidentClipBytes = 0;
+
+	UINT clipIndex = 0;
+	for(auto& e : animations)
+	{
+		ClipSlot& slot = mClips[clipIndex];
+		slot.Name       = e.first;
+		slot.TimesKnown = true;
+		slot.StartTime  = e.second.GetClipStartTime();
+		slot.EndTime    = e.second.GetClipEndTime();
+		slot.Bytes      = ClipBytes(e.second);
+		slot.Clip       = std::make_shared<const AnimationClip>(std::move(e.second));
+
+		mResidentClipBytes += slot.Bytes;
+		mClipIndices[slot.Name] = clipIndex++;
+	}
+	animations.clear();
 }
- 
-void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms)const
+
+void SkinnedData::Set(std::vector<int>& boneHierarchy, 
+		              std::vector<XMFLOAT4X4>& boneOffsets,
+		              std::unique_ptr<AnimationClipSource> clipSource,
+		              size_t clipMemoryBudget)
 {
-	UINT numBones = mBoneOffsets.size();
+	std::lock_guard<std::mutex> lock(mClipMutex);
+
+	mBoneHierarchy = std::move(boneHierarchy);
+	mBoneOffsets   = std::move(boneOffsets);
+	ComputeBoneDepths();
 
-	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
+	mClipSource = std::move(clipSource);
+	mClipMemoryBudget = clipMemoryBudget;
+	mClipIndices.clear();
+	mResidentClipBytes = 0;
 
-	// Interpolate all the bones of this clip at the given time instance.
-	auto clip = mAnimations.find(clipName);
-	clip->second.Interpolate(timePos, toParentTransforms);
+	UINT numClips = mClipSource->ClipCount();
+	mClips = std::vector<ClipSlot>(numClips);
+	for(UINT i = 0; i < numClips; ++i)
+	{
+		mClips[i].Name = mClipSource->ClipName(i);
+		mClipIndices[mClips[i].Name] = i;
+	}
+}
 
-	//
-	// Traverse the hierarchy and transform all the bones to the root space.
-	//
+const SkinnedData::ClipSlot* SkinnedData::FindClip(const std::string& clipName, bool needKeyframes,
+	std::unique_lock<std::mutex>& lock)const
+{
+	auto index = mClipIndices.find(clipName);
+	if( index == mClipIndices.end() )
+		return nullptr;
 
-	std::vector<XMFLOAT4X4> toRootTransforms(numBones);
+	return FindClip(index->second, needKeyframes, lock);
+}
 
-	// The root bone has index 0.  The root bone has no parent, so its toRootTransform
-	// is just its local bone transform.
-	toRootTransforms[0] = toParentTransforms[0];
+const SkinnedData::ClipSlot* SkinnedData::FindClip(UINT clipIndex, bool needKeyframes,
+	std::unique_lock<std::mutex>& lock)const
+{
+	if( clipIndex >= mClips.size() )
+		return nullptr;
 
-	// Now find the toRootTransform of the children.
-	for(UINT i = 1; i < numBones; ++i)
+	ClipSlot& slot = mClips[clipIndex];
+	if( !needKeyframes && slot.TimesKnown )
+		return &slot;
+
+	slot.LastUse = ++mClipUseCounter;
+
+	if( slot.Clip != nullptr || mClipSource == nullptr )
+		return slot.Clip != nullptr ? &slot : nullptr;
+
+	// Decode without mClipMutex, so threads playing resident clips are not
+	// held up.  Another thread may decode the same clip meanwhile; the
+	// first one back installs it.
+	const float tolerance = mClipTolerance;
+	const std::vector<float> boneReach = tolerance > 0.0f ? mClipBoneReach : std::vector<float>();
+	lock.unlock();
+
+	std::shared_ptr<const AnimationClip> decoded;
 	{
-		XMMATRIX toParent = XMLoadFloat4x4(&toParentTransforms[i]);
+		auto clip = std::make_shared<AnimationClip>();
+
+		std::lock_guard<std::mutex> sourceLock(mClipSourceMutex);
+		if( mClipSource->LoadClip(clipIndex, *clip) )
+			decoded = std::move(clip);
+	}
+
+	std::shared_ptr<const AnimationClip> compressed;
+	if( decoded != nullptr )
+		compressed = CompressClip(*decoded, tolerance, boneReach);
+
+	lock.lock();
 
-		int parentIndex = mBoneHierarchy[i];
-		XMMATRIX parentToRoot = XMLoadFloat4x4(&toRootTransforms[parentIndex]);
+	if( slot.Clip != nullptr )
+		return &slot;
+	if( decoded == nullptr )
+		return nullptr;
 
-		XMMATRIX toRoot = XMMatrixMultiply(toParent, parentToRoot);
+	// The times are those of the original keys, which compression keeps.
+	slot.TimesKnown = true;
+	slot.StartTime  = decoded->GetClipStartTime();
+	slot.EndTime    = decoded->GetClipEndTime();
+	if( compressed != nullptr )
+		decoded = std::move(compressed);
 
-		XMStoreFloat4x4(&toRootTransforms[i], toRoot);
+	slot.Bytes = ClipBytes(*decoded);
+	std::atomic_store(&slot.Clip, std::move(decoded));
+
+	mResidentClipBytes += slot.Bytes;
+	EvictClips(&slot);
+
+	return &slot;
+}
+
+void SkinnedData::EvictClips(const ClipSlot* keep)const
+{
+	// Clips can only be evicted if they can be decoded again.
+	if( mClipSource == nullptr || mClipMemoryBudget == 0 )
+		return;
+
+	while( mResidentClipBytes > mClipMemoryBudget )
+	{
+		ClipSlot* oldest = nullptr;
+		for(ClipSlot& slot : mClips)
+		{
+			if( slot.Clip != nullptr && &slot != keep && (oldest == nullptr || slot.LastUse < oldest->LastUse) )
+				oldest = &slot;
+		}
+
+		if( oldest == nullptr )
+			break;
+
+		// Callers that still hold the clip keep it alive until they are done.
+		std::atomic_store(&oldest->Clip, std::shared_ptr<const AnimationClip>());
+		mResidentClipBytes -= oldest->Bytes;
 	}
+}
 
-	// Premultiply by the bone offset transform to get the final transform.
-	for(UINT i = 0; i < numBones; ++i)
+void SkinnedData::CompressClips(float tolerance, const std::vector<float>& boneReach)
+{
+	std::lock_guard<std::mutex> lock(mClipMutex);
+
+	mClipTolerance = tolerance;
+	mClipBoneReach = boneReach;
+	for(ClipSlot& slot : mClips)
 	{
-		XMMATRIX offset = XMLoadFloat4x4(&mBoneOffsets[i]);
-		XMMATRIX toRoot = XMLoadFloat4x4(&toRootTransforms[i]);
-        XMMATRIX finalTransform = XMMatrixMultiply(offset, toRoot);
-		XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(finalTransform));
+		if( slot.Clip == nullptr )
+			continue;
+
+		std::shared_ptr<const AnimationClip> clip = CompressClip(*slot.Clip, tolerance, boneReach);
+		if( clip == nullptr )
+			continue;
+
+		mResidentClipBytes -= slot.Bytes;
+		slot.Bytes = ClipBytes(*clip);
+		std::atomic_store(&slot.Clip, std::move(clip));
+		mResidentClipBytes += slot.Bytes;
 	}
-}
\ No newline at end of file
+}
+
+std::shared_ptr<const AnimationClip> SkinnedData::CompressClip(const AnimationClip& clip, float tolerance,
+	const std::vector<float>& boneReach)const
+{
+	if( tolerance <= 0.0f || clip.Compressed != nullptr )
+		return nullptr;
+
+	auto compressed = std::make_shared<CompressedAnimationClip>();
+	if( !compressed->Compress(clip, mBoneHierarchy, boneReach, tolerance) )
+		return nullptr;
+
+	auto result = std::make_shared<AnimationClip>();
+	result->Compressed = std::move(compressed);
+
+	return result;
+}
+
+size_t SkinnedData::ClipBytes(const AnimationClip& clip)
+{
+	size_t bytes = sizeof(AnimationClip) + clip.BoneAnimations.size()*sizeof(BoneAnimation);
+	if( clip.Compressed != nullptr )
+		bytes += clip.Compressed->ByteSize();
+
+	for(const BoneAnimation& boneAnimation : clip.BoneAnimations)
+		bytes += boneAnimation.Keyframes.size()*sizeof(Keyframe);
+
+	return bytes;
+}
+ 
+void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	AnimationCursor cursor;
+	GetFinalTransforms(clipName, timePos, finalTransforms, cursor);
+}
+
+void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms,
+									 AnimationCursor& cursor)const
+{
+	AnimationScratch scratch;
+	GetFinalTransforms(GetClipHandle(clipName), timePos, finalTransforms, cursor, scratch);
+}
+
+void SkinnedData::GetFinalTransforms(const AnimationClipHandle& clipHandle, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms,
+									 AnimationCursor& cursor, AnimationScratch& scratch)const
+{
+	GetFinalTransforms(clipHandle, timePos, finalTransforms, cursor, scratch, UINT_MAX);
+}
+
+UINT SkinnedData::GetFinalTransforms(const AnimationClipHandle& clipHandle, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms,
+									 AnimationCursor& cursor, AnimationScratch& scratch, UINT maxBoneDepth)const
+{
+	// Checked before scratch is sized, so a failed call does not make it
+	// look like it holds the previous pose.
+	std::shared_ptr<const AnimationClip> clip = GetClip(clipHandle);
+	if( clip == nullptr )
+		return 0;
+
+	UINT numBones = mBoneOffsets.size();
+
+	std::vector<XMFLOAT4X4>& toParentTransforms = scratch.ToParentTransforms;
+	std::vector<XMMATRIX>& toRootTransforms = scratch.ToRootTransforms;
+	if( toParentTransforms.size() != numBones )
+		maxBoneDepth = UINT_MAX;
+	toParentTransforms.resize(numBones);
+	toRootTransforms.resize(numBones);
+
+	// Interpolate the bones of this clip down to maxBoneDepth at the given
+	// time instance.
+	UINT numInterpolated = numBones;
+	if( maxBoneDepth >= MaxBoneDepth() )
+		clip->Interpolate(timePos, toParentTransforms, cursor);
+	else
+	{
+		numInterpolated = mBonesUpToDepth[maxBoneDepth];
+		clip->Interpolate(timePos, toParentTransforms, cursor, mBonesByDepth.data(), numInterpolated);
+	}
+
+	// Transform all the bones to the root space and premultiply by the bone
+	// offset transform to get the final transform.
+	ConcatenateTransforms(mBoneHierarchy.data(), mBoneOffsetMatrices.data(), toParentTransforms.data(),
+		toRootTransforms.data(), finalTransforms.data(), numBones);
+
+	return numInterpolated;
+}
@@ -3,6 +3,9 @@
 
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
+#include <atomic>
+#include <climits>
+#include <mutex>
 
 ///<summary>
 /// A Keyframe defines the bone transformation at an instant in time.
@@ -18,6 +21,21 @@ struct Keyframe
     DirectX::XMFLOAT4 RotationQuat;
 };
 
+///<summary>
+/// Playback position hint for one animated instance.  For every bone it
+/// remembers the keyframe interval used by the previous Interpolate call,
+/// so playing forward only has to step past the keyframes that were
+/// crossed since the last frame.  Seeks and loops fall back to a binary
+/// search, and any stale or out of range index is tolerated, so a cursor
+/// may be reused across clips without being reset.
+///</summary>
+struct AnimationCursor
+{
+	std::vector<UINT> KeyIndices;
+
+	void Reset();
+};
+
 ///<summary>
 /// A BoneAnimation is defined by a list of keyframes.  For time
 /// values inbetween two keyframes, we interpolate between the
@@ -32,9 +50,18 @@ struct BoneAnimation
 
     void Interpolate(float t, DirectX::XMFLOAT4X4& M)const;
 
+	// keyIndex is the bone's entry in an AnimationCursor.
+    void Interpolate(float t, DirectX::XMFLOAT4X4& M, UINT& keyIndex)const;
+
 	std::vector<Keyframe> Keyframes; 	
+
+private:
+	// Index i of the first interval [i, i+1] at or after first with t <= Keyframes[i+1].TimePos.
+	UINT UpperInterval(float t, UINT first)const;
 };
 
+class CompressedAnimationClip;
+
 ///<summary>
 /// Examples of AnimationClips are "Walk", "Run", "Attack", "Defend".
 /// An AnimationClip requires a BoneAnimation for every bone to form
@@ -46,37 +73,239 @@ struct AnimationClip
 	float GetClipEndTime()const;
 
     void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms)const;
+    void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor)const;
+
+	// Only interpolates the numBones bones listed in bones; the other
+	// entries of boneTransforms are left as they are.
+    void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms, AnimationCursor& cursor,
+		const UINT* bones, UINT numBones)const;
 
     std::vector<BoneAnimation> BoneAnimations; 	
+
+	// Set instead of BoneAnimations for a compressed clip, which is then
+	// decoded as it is interpolated.
+	std::shared_ptr<const CompressedAnimationClip> Compressed;
+};
+
+///<summary>
+/// Supplies the keyframes of animation clips on demand.  A loader that
+/// indexes only the clip names and their location in the file hands one
+/// of these to SkinnedData, which decodes a clip the first time it is
+/// played and may throw it away again to stay within a memory budget.
+///</summary>
+class AnimationClipSource
+{
+public:
+	virtual ~AnimationClipSource() = default;
+
+	virtual UINT ClipCount()const = 0;
+	virtual const std::string& ClipName(UINT clipIndex)const = 0;
+
+	// Decodes clip clipIndex.  May be called again after the clip was evicted.
+	virtual bool LoadClip(UINT clipIndex, AnimationClip& clip) = 0;
+};
+
+///<summary>
+/// A clip of one SkinnedData resolved ahead of time.  Playing through a
+/// handle skips the name lookup, and the clip's start and end times are
+/// cached so the per-frame loop test costs nothing.
+///</summary>
+struct AnimationClipHandle
+{
+	UINT Index = UINT_MAX;
+	float StartTime = 0.0f;
+	float EndTime = 0.0f;
+
+	bool IsValid()const { return Index != UINT_MAX; }
+};
+
+///<summary>
+/// Caller-owned working storage for GetFinalTransforms.  After the first
+/// call has sized it, updating a pose performs no heap allocations.
+///</summary>
+struct AnimationScratch
+{
+	std::vector<DirectX::XMFLOAT4X4> ToParentTransforms;
+
+	// Kept as aligned XMMATRIX so a parent's transform is reused without
+	// a reload or a store.
+	std::vector<DirectX::XMMATRIX> ToRootTransforms;
 };
 
 class SkinnedData
 {
 public:
+	SkinnedData() = default;
+	SkinnedData(const SkinnedData& rhs) = delete;
+	SkinnedData& operator=(const SkinnedData& rhs) = delete;
 
 	UINT BoneCount()const;
 
+	const std::vector<int>& GetBoneHierarchy()const;
+
+	// Number of ancestors of a bone; the root has depth 0.
+	UINT BoneDepth(UINT bone)const;
+	UINT MaxBoneDepth()const;
+	const std::vector<DirectX::XMFLOAT4X4>& GetBoneOffsets()const;
+
+	// Clip names, in file order for lazily loaded clips.
+	std::vector<std::string> GetClipNames()const;
+
+	// Returns the clip, decoding it first if it is not resident, or nullptr if
+	// there is no such clip.  The clip stays valid while the pointer is held,
+	// even if it is evicted meanwhile.  Getting a resident clip through a
+	// handle does not take mClipMutex, so it never waits for a clip being
+	// decoded.  It is not lock free: std::atomic_load of a shared_ptr takes
+	// a short library spin lock, and every call touches the clip's shared
+	// use count, so threads getting the same clip still contend briefly.
+	std::shared_ptr<const AnimationClip> GetClip(const std::string& clipName)const;
+	std::shared_ptr<const AnimationClip> GetClip(const AnimationClipHandle& clip)const;
+
+	// Resolves a clip name once; returns an invalid handle if there is no such clip.
+	AnimationClipHandle GetClipHandle(const std::string& clipName)const;
+
+	// Zero if there is no such clip.
 	float GetClipStartTime(const std::string& clipName)const;
 	float GetClipEndTime(const std::string& clipName)const;
 
+	// True if bone 0 is the root and every other bone's parent comes before
+	// it, the order GetFinalTransforms concatenates the bones in.  The
+	// loaders reject hierarchies that fail this; Set requires it.
+	static bool ValidateBoneHierarchy(const int* boneHierarchy, UINT numBones);
+
+	// The concatenation step of GetFinalTransforms in one pass: for each
+	// bone, to-root = to-parent * parent's to-root, and the final transform
+	// offset * to-root, transposed for the shaders.  boneHierarchy must be
+	// ordered as ValidateBoneHierarchy checks; toRootTransforms is
+	// numBones matrices of working storage.
+	static void ConcatenateTransforms(const int* boneHierarchy, const DirectX::XMMATRIX* boneOffsets,
+		const DirectX::XMFLOAT4X4* toParentTransforms, DirectX::XMMATRIX* toRootTransforms,
+		DirectX::XMFLOAT4X4* finalTransforms, UINT numBones);
+
+	// Takes the contents of the arguments; every clip stays resident.
 	void Set(
 		std::vector<int>& boneHierarchy, 
 		std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
 		std::unordered_map<std::string, AnimationClip>& animations);
 
+	// Lazy variant: clips are decoded from clipSource on first use.  Once the
+	// decoded clips take more than clipMemoryBudget bytes the least recently
+	// used ones are evicted (0 means no limit).
+	void Set(
+		std::vector<int>& boneHierarchy, 
+		std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
+		std::unique_ptr<AnimationClipSource> clipSource,
+		size_t clipMemoryBudget = 0);
+
+	// Replaces every clip, and every clip decoded later, with a compressed
+	// copy that moves no point within a bone's reach more than tolerance
+	// model units from the original, at every keyframe time and between
+	// them (see CompressedAnimationClip).  With boneReach from
+	// BoneBounds::ComputeReach that bounds the skinned mesh; without it the
+	// reach is estimated.  A clip that cannot be compressed that closely
+	// stays as it is.  A tolerance of zero stops compressing clips that are
+	// decoded from now on.
+	void CompressClips(float tolerance, const std::vector<float>& boneReach = std::vector<float>());
+
+	// Number and size of the clips that are currently decoded.
+	UINT GetResidentClipCount()const;
+	size_t GetResidentClipBytes()const;
+
 	 // In a real project, you'd want to cache the result if there was a chance
 	 // that you were calling this several times with the same clipName at 
-	 // the same timePos.
+	 // the same timePos.  If the clip does not exist or cannot be decoded,
+	 // finalTransforms is left as it is.
     void GetFinalTransforms(const std::string& clipName, float timePos, 
 		 std::vector<DirectX::XMFLOAT4X4>& finalTransforms)const;
 
+	// Same as above, but keyframe lookups start from the cursor, which makes
+	// steady playback O(1) per bone instead of O(keyframes).
+    void GetFinalTransforms(const std::string& clipName, float timePos, 
+		 std::vector<DirectX::XMFLOAT4X4>& finalTransforms, AnimationCursor& cursor)const;
+
+	// Steady-state form used every frame: no string hashing, and with a sized
+	// finalTransforms and warm scratch and cursor, no heap allocations.
+    void GetFinalTransforms(const AnimationClipHandle& clip, float timePos, 
+		 std::vector<DirectX::XMFLOAT4X4>& finalTransforms, AnimationCursor& cursor,
+		 AnimationScratch& scratch)const;
+
+	// Level of detail form: only bones at most maxBoneDepth below the root
+	// are interpolated.  Deeper ones, typically fingers and face, keep the
+	// local transform scratch holds from the previous call and move rigidly
+	// with their parent.  A scratch that was never used interpolates every
+	// bone.  Returns the number of bones interpolated, zero if the clip does
+	// not exist or cannot be decoded.
+    UINT GetFinalTransforms(const AnimationClipHandle& clip, float timePos, 
+		 std::vector<DirectX::XMFLOAT4X4>& finalTransforms, AnimationCursor& cursor,
+		 AnimationScratch& scratch, UINT maxBoneDepth)const;
+
+private:
+	struct ClipSlot
+	{
+		std::string Name;
+
+		// Read with std::atomic_load outside mClipMutex; only replaced,
+		// with std::atomic_store, while mClipMutex is held.  The shared_ptr
+		// atomics are implemented with a spin lock, not lock free.
+		std::shared_ptr<const AnimationClip> Clip;
+
+		// Known once the clip has been decoded, and kept after eviction.
+		bool TimesKnown = false;
+		float StartTime = 0.0f;
+		float EndTime = 0.0f;
+
+		size_t Bytes = 0;
+		std::atomic<UINT64> LastUse{ 0 };
+	};
+
+	// Looks a clip up and, if needKeyframes is set or its times are not
+	// known yet, decodes it.  lock must hold mClipMutex; it is released
+	// while the clip is decoded and held again on return.
+	const ClipSlot* FindClip(const std::string& clipName, bool needKeyframes,
+		std::unique_lock<std::mutex>& lock)const;
+	const ClipSlot* FindClip(UINT clipIndex, bool needKeyframes,
+		std::unique_lock<std::mutex>& lock)const;
+	void EvictClips(const ClipSlot* keep)const;
+
+	// A compressed copy of clip, or nullptr if it should stay as it is.
+	std::shared_ptr<const AnimationClip> CompressClip(const AnimationClip& clip, float tolerance,
+		const std::vector<float>& boneReach)const;
+
+	static size_t ClipBytes(const AnimationClip& clip);
+	void ComputeBoneDepths();
+
 private:
     // Gives parentIndex of ith bone.
 	std::vector<int> mBoneHierarchy;
 
+	// mBoneOffsets loaded once for ConcatenateTransforms.
+	std::vector<DirectX::XMMATRIX> mBoneOffsetMatrices;
+
+	// Bones ordered by depth, and the number of bones at each depth or less,
+	// so the bones down to a depth are a prefix of mBonesByDepth.
+	std::vector<UINT> mBoneDepths;
+	std::vector<UINT> mBonesByDepth;
+	std::vector<UINT> mBonesUpToDepth;
+
 	std::vector<DirectX::XMFLOAT4X4> mBoneOffsets;
-   
-	std::unordered_map<std::string, AnimationClip> mAnimations;
+
+	std::unordered_map<std::string, UINT> mClipIndices;
+
+	// Decoding and eviction happen inside const getters, so the clip cache
+	// is mutable and guarded by a mutex.  The slots themselves are only
+	// created by Set, never moved.
+	mutable std::vector<ClipSlot> mClips;
+	mutable std::mutex mClipMutex;
+	mutable size_t mResidentClipBytes = 0;
+	mutable std::atomic<UINT64> mClipUseCounter{ 0 };
+
+	// Serializes calls into mClipSource, which are made without mClipMutex.
+	mutable std::mutex mClipSourceMutex;
+
+	std::unique_ptr<AnimationClipSource> mClipSource;
+	size_t mClipMemoryBudget = 0;
+	float mClipTolerance = 0.0f;
+	std::vector<float> mClipBoneReach;
 };
  
 #endif // SKINNEDDATA_H
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "TextTokenizer.h"
+#include <charconv>
+
+namespace
+{
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+	}
+}
+
+TextTokenizer::TextTokenizer(const char* begin, const char* end)
+	: mBegin(begin),
+	mEnd(end),
+	mPos(begin)
+{
+}
+
+bool TextTokenizer::LoadFile(const std::string& filename)
+{
+	std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+	if(!fin)
+		return false;
+
+	std::streamsize size = fin.tellg();
+	fin.seekg(0, std::ios::beg);
+
+	mBuffer.resize((size_t)size);
+	if(size > 0 && !fin.read(mBuffer.data(), size))
+		return false;
+
+	mBegin = mBuffer.data();
+	mEnd = mBegin + mBuffer.size();
+	mPos = mBegin;
+	mFailed = false;
+
+	return true;
+}
+
+TextTokenizer::operator bool()const
+{
+	return !mFailed;
+}
+
+bool TextTokenizer::AtEnd()
+{
+	SkipWhitespace();
+	return mPos == mEnd;
+}
+
+const char* TextTokenizer::Begin()const
+{
+	return mBegin;
+}
+
+const char* TextTokenizer::End()const
+{
+	return mEnd;
+}
+
+const char* TextTokenizer::Position()const
+{
+	return mPos;
+}
+
+void TextTokenizer::Seek(const char* position)
+{
+	assert(position >= mBegin && position <= mEnd);
+	mPos = position;
+}
+
+void TextTokenizer::SkipWhitespace()
+{
+	while(mPos != mEnd && IsSpace(*mPos))
+		++mPos;
+}
+
+std::string_view TextTokenizer::Next()
+{
+	SkipWhitespace();
+
+	const char* start = mPos;
+	while(mPos != mEnd && !IsSpace(*mPos))
+		++mPos;
+
+	return std::string_view(start, mPos - start);
+}
+
+void TextTokenizer::Skip(UINT count)
+{
+	for(UINT i = 0; i < count; ++i)
+		Next();
+}
+
+TextTokenizer& TextTokenizer::operator>>(std::string_view& token)
+{
+	token = Next();
+	return *this;
+}
+
+TextTokenizer& TextTokenizer::operator>>(std::string& token)
+{
+	token = Next();
+	return *this;
+}
+
+template<typename T>
+TextTokenizer& TextTokenizer::ReadNumber(T& x)
+{
+	std::string_view token = Next();
+
+	// Like stream extraction, a token that is not a number yields zero and
+	// puts the tokenizer into the failed state.
+	auto result = std::from_chars(token.data(), token.data() + token.size(), x);
+	if(token.empty() || result.ec != std::errc() || result.ptr != token.data() + token.size())
+	{
+		x = T(0);
+		mFailed = true;
+	}
+
+	return *this;
+}
+
+TextTokenizer& TextTokenizer::operator>>(float& x)
+{
+	return ReadNumber(x);
+}
+
+TextTokenizer& TextTokenizer::operator>>(int& x)
+{
+	return ReadNumber(x);
+}
+
+TextTokenizer& TextTokenizer::operator>>(UINT& x)
+{
+	return ReadNumber(x);
+}
+
+TextTokenizer& TextTokenizer::operator>>(USHORT& x)
+{
+	return ReadNumber(x);
+}
+
+TextTokenizer& TextTokenizer::operator>>(bool& x)
+{
+	int value = 0;
+	ReadNumber(value);
+	x = value != 0;
+
+	return *this;
+}
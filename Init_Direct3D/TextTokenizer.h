@@ -0,0 +1,68 @@
+#ifndef TEXTTOKENIZER_H
+#define TEXTTOKENIZER_H
+
+#include "../Common/d3dUtil.h"
+#include <string_view>
+
+///<summary>
+/// Splits a text model file into whitespace separated tokens.  The whole
+/// file is read into memory with one read, and numbers are converted with
+/// std::from_chars, which is locale independent and correctly rounded, so
+/// the results match stream extraction bit for bit.
+///
+/// The extraction operators mirror std::ifstream so loaders can keep the
+/// familiar "tok >> ignore >> x" shape.  Extracting into a std::string_view
+/// skips a token without allocating.
+///</summary>
+class TextTokenizer
+{
+public:
+	TextTokenizer() = default;
+
+	// Tokenizes the caller-owned range [begin, end).
+	TextTokenizer(const char* begin, const char* end);
+
+	TextTokenizer(const TextTokenizer& rhs) = delete;
+	TextTokenizer& operator=(const TextTokenizer& rhs) = delete;
+
+	// Reads the whole file into an internal buffer and tokenizes it.
+	bool LoadFile(const std::string& filename);
+
+	// True while no token failed to convert.
+	explicit operator bool()const;
+	bool AtEnd();
+
+	const char* Begin()const;
+	const char* End()const;
+	const char* Position()const;
+	void Seek(const char* position);
+
+	// Returns the next token, or an empty view at the end of the text.
+	std::string_view Next();
+	void Skip(UINT count = 1);
+
+	TextTokenizer& operator>>(std::string_view& token);
+	TextTokenizer& operator>>(std::string& token);
+	TextTokenizer& operator>>(float& x);
+	TextTokenizer& operator>>(int& x);
+	TextTokenizer& operator>>(UINT& x);
+	TextTokenizer& operator>>(USHORT& x);
+	TextTokenizer& operator>>(bool& x);
+
+private:
+	void SkipWhitespace();
+
+	template<typename T>
+	TextTokenizer& ReadNumber(T& x);
+
+private:
+	std::vector<char> mBuffer;
+
+	const char* mBegin = nullptr;
+	const char* mEnd = nullptr;
+	const char* mPos = nullptr;
+
+	bool mFailed = false;
+};
+
+#endif // TEXTTOKENIZER_H